@@ -0,0 +1,139 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/cpp/communication/brotli_dictionary_trainer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+// Length of the substrings whose frequencies score the segments.
+constexpr size_t kDmerSize = sizeof(uint64_t);
+
+uint64_t DmerAt(std::string_view data, size_t offset) {
+  uint64_t dmer;
+  std::memcpy(&dmer, data.data() + offset, kDmerSize);
+  return dmer;
+}
+
+struct Segment {
+  size_t offset;
+  int64_t score;
+};
+
+}  // namespace
+
+absl::StatusOr<std::string> TrainBrotliDictionary(
+    const std::vector<std::string>& samples,
+    const BrotliDictionaryTrainingOptions& options) {
+  if (options.segment_size < kDmerSize ||
+      options.max_size < options.segment_size) {
+    return absl::InvalidArgumentError(
+        "Segment size must be between 8 and the dictionary size");
+  }
+
+  // Number of samples every d-mer occurs in.
+  absl::flat_hash_map<uint64_t, int> frequencies;
+  // Concatenation of the samples. Segments never span two samples.
+  std::string corpus;
+  std::vector<size_t> sample_ends;
+  for (const std::string& sample : samples) {
+    absl::flat_hash_set<uint64_t> dmers;
+    for (size_t i = 0; i + kDmerSize <= sample.size(); ++i) {
+      dmers.insert(DmerAt(sample, i));
+    }
+    for (uint64_t dmer : dmers) {
+      ++frequencies[dmer];
+    }
+    corpus.append(sample);
+    sample_ends.push_back(corpus.size());
+  }
+  const auto sample_end = [&sample_ends](size_t offset) {
+    return *std::upper_bound(sample_ends.begin(), sample_ends.end(), offset);
+  };
+
+  const size_t segment_size = options.segment_size;
+  const size_t epoch_size = std::max(
+      segment_size, corpus.size() / (options.max_size / segment_size));
+  std::vector<Segment> segments;
+  // Prefix sums of the d-mer scores of the current epoch.
+  std::vector<int64_t> prefix;
+  for (size_t begin = 0; begin + segment_size <= corpus.size();
+       begin += epoch_size) {
+    const size_t end = std::min(corpus.size(), begin + epoch_size);
+    prefix.assign(1, 0);
+    for (size_t i = begin; i + kDmerSize <= end; ++i) {
+      int64_t score = 0;
+      // D-mers that occur in a single sample do not help other payloads.
+      if (i + kDmerSize <= sample_end(i)) {
+        const auto it = frequencies.find(DmerAt(corpus, i));
+        if (it != frequencies.end() && it->second > 1) {
+          score = it->second;
+        }
+      }
+      prefix.push_back(prefix.back() + score);
+    }
+
+    Segment best = {0, 0};
+    for (size_t start = begin; start + segment_size <= end; ++start) {
+      if (start + segment_size > sample_end(start)) {
+        continue;
+      }
+      const int64_t score =
+          prefix[start - begin + segment_size - kDmerSize + 1] -
+          prefix[start - begin];
+      if (score > best.score) {
+        best = {start, score};
+      }
+    }
+    if (best.score == 0) {
+      continue;
+    }
+    for (size_t i = best.offset; i + kDmerSize <= best.offset + segment_size;
+         ++i) {
+      frequencies[DmerAt(corpus, i)] = 0;
+    }
+    segments.push_back(best);
+  }
+  if (segments.empty()) {
+    return absl::InvalidArgumentError("Samples have no content in common");
+  }
+
+  std::stable_sort(segments.begin(), segments.end(),
+                   [](const Segment& a, const Segment& b) {
+                     return a.score < b.score;
+                   });
+  std::string dictionary;
+  dictionary.reserve(segments.size() * segment_size);
+  for (const Segment& segment : segments) {
+    dictionary.append(corpus, segment.offset, segment_size);
+  }
+  if (dictionary.size() > options.max_size) {
+    dictionary.erase(0, dictionary.size() - options.max_size);
+  }
+  return dictionary;
+}
+
+}  // namespace privacy_sandbox::server_common
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_CPP_COMMUNICATION_BROTLI_DICTIONARY_TRAINER_H_
+#define SRC_CPP_COMMUNICATION_BROTLI_DICTIONARY_TRAINER_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+
+namespace privacy_sandbox::server_common {
+
+struct BrotliDictionaryTrainingOptions {
+  // Upper bound of the dictionary size.
+  size_t max_size = 32 * 1024;
+  // Length of the segments the dictionary is assembled from. Must be at least
+  // 8.
+  size_t segment_size = 64;
+};
+
+// Builds a raw dictionary for BrotliSharedDictionary from sample payloads,
+// e.g. compression groups captured from production traffic.
+//
+// The samples are split into as many epochs as the dictionary has segments,
+// and the segment of each epoch that covers the most 8-byte substrings shared
+// by several samples is picked. Substrings covered by a picked segment no
+// longer count for the following epochs. The most valuable segments are placed
+// at the end of the dictionary, where they are the cheapest to refer to.
+absl::StatusOr<std::string> TrainBrotliDictionary(
+    const std::vector<std::string>& samples,
+    const BrotliDictionaryTrainingOptions& options =
+        BrotliDictionaryTrainingOptions());
+
+}  // namespace privacy_sandbox::server_common
+
+#endif  // SRC_CPP_COMMUNICATION_BROTLI_DICTIONARY_TRAINER_H_
@@ -0,0 +1,76 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Trains a dictionary for BrotliSharedDictionary from sample payloads, one per
+// file, and writes it to --output. Run with:
+//
+//   bazel run //src/cpp/communication:brotli_dictionary_trainer -- \
+//     --output=/tmp/dictionary.bin /path/to/samples/*.json
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/status/statusor.h"
+#include "src/cpp/communication/brotli_dictionary_trainer.h"
+
+ABSL_FLAG(std::string, output, "", "File to write the dictionary to.");
+ABSL_FLAG(size_t, max_size, 32 * 1024, "Maximum size of the dictionary.");
+ABSL_FLAG(size_t, segment_size, 64,
+          "Length of the segments the dictionary is assembled from.");
+
+int main(int argc, char** argv) {
+  std::vector<char*> args = absl::ParseCommandLine(argc, argv);
+  const std::string output = absl::GetFlag(FLAGS_output);
+  if (output.empty() || args.size() < 2) {
+    std::cerr << "Usage: " << args[0] << " --output=FILE SAMPLE..."
+              << std::endl;
+    return 2;
+  }
+
+  std::vector<std::string> samples;
+  for (size_t i = 1; i < args.size(); ++i) {
+    std::ifstream file(args[i], std::ios::binary);
+    if (!file) {
+      std::cerr << "Unable to open " << args[i] << std::endl;
+      return 2;
+    }
+    std::stringstream sample;
+    sample << file.rdbuf();
+    samples.push_back(sample.str());
+  }
+
+  privacy_sandbox::server_common::BrotliDictionaryTrainingOptions options;
+  options.max_size = absl::GetFlag(FLAGS_max_size);
+  options.segment_size = absl::GetFlag(FLAGS_segment_size);
+  const absl::StatusOr<std::string> dictionary =
+      privacy_sandbox::server_common::TrainBrotliDictionary(samples, options);
+  if (!dictionary.ok()) {
+    std::cerr << dictionary.status() << std::endl;
+    return 1;
+  }
+  std::ofstream file(output, std::ios::binary);
+  file << *dictionary;
+  if (!file) {
+    std::cerr << "Unable to write " << output << std::endl;
+    return 1;
+  }
+  std::cout << "Wrote a " << dictionary->size() << "-byte dictionary from "
+            << samples.size() << " samples to " << output << std::endl;
+  return 0;
+}
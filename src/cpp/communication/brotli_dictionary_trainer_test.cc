@@ -0,0 +1,79 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/cpp/communication/brotli_dictionary_trainer.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/str_format.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+using ::testing::HasSubstr;
+
+std::vector<std::string> SamplePayloads() {
+  std::vector<std::string> samples;
+  for (int i = 0; i < 50; ++i) {
+    samples.push_back(absl::StrFormat(
+        R"({"partitions":[{"id":%d,"compressionGroupId":%d,)"
+        R"("arguments":[{"tags":["structured","groupNames"],)"
+        R"("data":["interest_group_%d"]}]}]})",
+        i, i % 3, i * 7919));
+  }
+  return samples;
+}
+
+TEST(BrotliDictionaryTrainerTest, PicksSharedContent) {
+  BrotliDictionaryTrainingOptions options;
+  options.max_size = 1024;
+  options.segment_size = 16;
+  absl::StatusOr<std::string> dictionary =
+      TrainBrotliDictionary(SamplePayloads(), options);
+  ASSERT_TRUE(dictionary.ok()) << dictionary.status();
+  EXPECT_LE(dictionary->size(), options.max_size);
+  EXPECT_EQ(dictionary->size() % options.segment_size, 0);
+  EXPECT_THAT(*dictionary, HasSubstr("compressionGroup"));
+  EXPECT_THAT(*dictionary, HasSubstr("groupNames"));
+}
+
+TEST(BrotliDictionaryTrainerTest, RespectsMaxSize) {
+  BrotliDictionaryTrainingOptions options;
+  options.max_size = 100;
+  options.segment_size = 32;
+  absl::StatusOr<std::string> dictionary =
+      TrainBrotliDictionary(SamplePayloads(), options);
+  ASSERT_TRUE(dictionary.ok()) << dictionary.status();
+  EXPECT_LE(dictionary->size(), options.max_size);
+}
+
+TEST(BrotliDictionaryTrainerTest, FailsWithoutSharedContent) {
+  absl::StatusOr<std::string> dictionary =
+      TrainBrotliDictionary({std::string(100, 'a'), std::string(100, 'b')});
+  EXPECT_TRUE(absl::IsInvalidArgument(dictionary.status()));
+}
+
+TEST(BrotliDictionaryTrainerTest, RejectsSmallSegments) {
+  BrotliDictionaryTrainingOptions options;
+  options.segment_size = 4;
+  EXPECT_TRUE(absl::IsInvalidArgument(
+      TrainBrotliDictionary(SamplePayloads(), options).status()));
+}
+
+}  // namespace
+}  // namespace privacy_sandbox::server_common
@@ -13,16 +13,172 @@
 // limitations under the License.
 #include "src/cpp/communication/compression.h"
 
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/blocking_counter.h"
 #include "glog/logging.h"
+#include "quiche/common/quiche_data_writer.h"
 #include "src/cpp/communication/compression_brotli.h"
 #include "src/cpp/communication/uncompressed.h"
 
 namespace privacy_sandbox::server_common {
 
+namespace {
+
+// Frames `marker`, e.g. kCompressionGroupReference, followed by `value`.
+std::string BuildFramingExtension(uint32_t marker, uint32_t value) {
+  std::string output(2 * sizeof(uint32_t), '\0');
+  quiche::QuicheDataWriter data_writer(output.size(), output.data());
+  data_writer.WriteUInt32(marker);
+  data_writer.WriteUInt32(value);
+  return output;
+}
+
+// Reads the next compression group of `data_reader` if it is a reference, and
+// returns the position of the group it refers to, which must be lower than
+// `num_earlier_groups`.
+absl::StatusOr<std::optional<uint32_t>> ReadReference(
+    quiche::QuicheDataReader& data_reader, size_t num_earlier_groups) {
+  quiche::QuicheDataReader peek_reader(data_reader.PeekRemainingPayload());
+  uint32_t marker = 0;
+  if (!peek_reader.ReadUInt32(&marker) ||
+      marker != kCompressionGroupReference) {
+    return std::nullopt;
+  }
+  uint32_t k = 0;
+  if (!data_reader.Seek(sizeof(uint32_t)) || !data_reader.ReadUInt32(&k)) {
+    return absl::InvalidArgumentError(
+        "Failed to read compression group reference");
+  }
+  if (k >= num_earlier_groups) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Compression group reference to ", k, " is not to an earlier group"));
+  }
+  return k;
+}
+
+}  // namespace
+
 void CompressionGroupConcatenator::AddCompressionGroup(
     std::string plaintext_compression_group) {
   VLOG(9) << "Adding compression group: " << plaintext_compression_group;
-  partitions_.push_back(plaintext_compression_group);
+  partitions_.push_back(std::move(plaintext_compression_group));
+}
+
+absl::StatusOr<std::string>
+CompressionGroupConcatenator::BuildCachedCompressionGroup(
+    std::string_view partition) const {
+  if (cache_ == nullptr) {
+    return BuildCompressionGroup(partition);
+  }
+  const std::string cache_key = CacheKey();
+  if (cache_key.empty()) {
+    return BuildCompressionGroup(partition);
+  }
+  if (std::shared_ptr<const std::string> cached =
+          cache_->Lookup(cache_key, partition)) {
+    return *cached;
+  }
+  absl::StatusOr<std::string> compression_group =
+      BuildCompressionGroup(partition);
+  if (compression_group.ok()) {
+    cache_->Insert(cache_key, partition, *compression_group);
+  }
+  return compression_group;
+}
+
+absl::StatusOr<std::string>
+CompressionGroupConcatenator::BuildFramedCompressionGroup(
+    std::string_view partition) const {
+  absl::StatusOr<std::string> compression_group =
+      BuildCachedCompressionGroup(partition);
+  if (!compression_group.ok() || !size_hints_) {
+    return compression_group;
+  }
+  std::string output =
+      BuildFramingExtension(kCompressionGroupSizeHint, partition.size());
+  output.append(*compression_group);
+  return output;
+}
+
+absl::StatusOr<std::vector<std::string>>
+CompressionGroupConcatenator::BuildCompressionGroups() const {
+  const std::vector<std::optional<uint32_t>> earlier_occurrences =
+      EarlierOccurrences();
+  std::vector<std::string> compression_groups;
+  compression_groups.reserve(partitions_.size());
+  for (size_t i = 0; i < partitions_.size(); ++i) {
+    if (earlier_occurrences[i].has_value()) {
+      compression_groups.push_back(BuildFramingExtension(
+          kCompressionGroupReference, *earlier_occurrences[i]));
+      continue;
+    }
+    absl::StatusOr<std::string> compression_group =
+        BuildFramedCompressionGroup(partitions_[i]);
+    if (!compression_group.ok()) {
+      return compression_group.status();
+    }
+    compression_groups.push_back(*std::move(compression_group));
+  }
+  return compression_groups;
+}
+
+std::vector<std::optional<uint32_t>>
+CompressionGroupConcatenator::EarlierOccurrences() const {
+  std::vector<std::optional<uint32_t>> earlier_occurrences(partitions_.size());
+  if (!deduplicate_) {
+    return earlier_occurrences;
+  }
+  // Position of the first occurrence of every partition.
+  absl::flat_hash_map<std::string_view, uint32_t> first_occurrences;
+  for (size_t i = 0; i < partitions_.size(); ++i) {
+    const auto [it, inserted] = first_occurrences.emplace(partitions_[i], i);
+    if (!inserted) {
+      earlier_occurrences[i] = it->second;
+    }
+  }
+  return earlier_occurrences;
+}
+
+absl::StatusOr<std::string> CompressionGroupConcatenator::BuildIndexed()
+    const {
+  absl::StatusOr<std::vector<std::string>> maybe_compression_groups =
+      BuildCompressionGroups();
+  if (!maybe_compression_groups.ok()) {
+    return maybe_compression_groups.status();
+  }
+  const std::vector<std::string>& compression_groups =
+      *maybe_compression_groups;
+  size_t compression_groups_size = 0;
+  for (const std::string& compression_group : compression_groups) {
+    compression_groups_size += compression_group.size();
+  }
+
+  const size_t index_size =
+      sizeof(uint32_t) * (compression_groups.size() + 1);
+  std::string output(index_size, '\0');
+  output.reserve(index_size + compression_groups_size);
+  quiche::QuicheDataWriter data_writer(output.size(), output.data());
+  data_writer.WriteUInt32(compression_groups.size());
+  uint32_t end_offset = 0;
+  for (const std::string& compression_group : compression_groups) {
+    end_offset += compression_group.size();
+    data_writer.WriteUInt32(end_offset);
+  }
+  for (const std::string& compression_group : compression_groups) {
+    output.append(compression_group);
+  }
+  return output;
 }
 
 std::unique_ptr<CompressionGroupConcatenator>
@@ -34,6 +190,395 @@ CompressionGroupConcatenator::Create(CompressionType type) {
   }
 }
 
+absl::StatusOr<CompressionGroupIndex> CompressionGroupIndex::Parse(
+    std::string_view indexed_blob) {
+  quiche::QuicheDataReader data_reader(indexed_blob);
+  uint32_t num_compression_groups = 0;
+  std::string_view offsets;
+  if (!data_reader.ReadUInt32(&num_compression_groups) ||
+      !data_reader.ReadStringPiece(
+          &offsets, sizeof(uint32_t) * num_compression_groups)) {
+    return absl::InvalidArgumentError("Failed to read compression group index");
+  }
+  const CompressionGroupIndex index(num_compression_groups, offsets,
+                                    data_reader.PeekRemainingPayload());
+  uint32_t previous_end_offset = 0;
+  for (size_t k = 0; k < num_compression_groups; ++k) {
+    if (index.EndOffset(k) < previous_end_offset) {
+      return absl::InvalidArgumentError(
+          "Compression group offsets are not increasing");
+    }
+    previous_end_offset = index.EndOffset(k);
+  }
+  if (previous_end_offset != index.compression_groups_.size()) {
+    return absl::InvalidArgumentError(
+        "Compression group index does not match the blob size");
+  }
+  return index;
+}
+
+absl::StatusOr<std::string_view> CompressionGroupIndex::GetCompressionGroup(
+    size_t k) const {
+  if (k >= num_compression_groups_) {
+    return absl::OutOfRangeError(absl::StrCat("No compression group ", k));
+  }
+  const uint32_t begin = k == 0 ? 0 : EndOffset(k - 1);
+  return compression_groups_.substr(begin, EndOffset(k) - begin);
+}
+
+uint32_t CompressionGroupIndex::EndOffset(size_t k) const {
+  quiche::QuicheDataReader data_reader(
+      offsets_.substr(sizeof(uint32_t) * k, sizeof(uint32_t)));
+  uint32_t end_offset = 0;
+  data_reader.ReadUInt32(&end_offset);
+  return end_offset;
+}
+
+absl::StatusOr<std::string>
+CompressedBlobReader::ExtractOneCompressionGroup() {
+  absl::StatusOr<std::optional<uint32_t>> reference =
+      ReadCompressionGroupReference();
+  if (!reference.ok()) {
+    return reference.status();
+  }
+  absl::StatusOr<std::string> output;
+  if (reference->has_value()) {
+    output = ExtractReferencedCompressionGroup(**reference);
+  } else {
+    const std::string_view remaining = data_reader_.PeekRemainingPayload();
+    if (absl::Status status = ReadSizeHint(); status.ok()) {
+      output = DecompressOneCompressionGroup();
+    } else {
+      output = status;
+    }
+    compression_groups_.push_back(remaining.substr(
+        0, remaining.size() - data_reader_.BytesRemaining()));
+  }
+  if (!output.ok()) {
+    size_hint_.reset();
+    return output;
+  }
+  if (absl::Status status = AddDecompressedSize(output->size()); !status.ok()) {
+    return status;
+  }
+  return output;
+}
+
+absl::StatusOr<std::pmr::string>
+CompressedBlobReader::ExtractOneCompressionGroup(
+    std::pmr::memory_resource* resource) {
+  absl::StatusOr<std::optional<uint32_t>> reference =
+      ReadCompressionGroupReference();
+  if (!reference.ok()) {
+    return reference.status();
+  }
+  absl::StatusOr<std::pmr::string> output;
+  if (reference->has_value()) {
+    absl::StatusOr<std::string> group =
+        ExtractReferencedCompressionGroup(**reference);
+    if (group.ok()) {
+      output = std::pmr::string(*group, resource);
+    } else {
+      output = group.status();
+    }
+  } else {
+    const std::string_view remaining = data_reader_.PeekRemainingPayload();
+    if (absl::Status status = ReadSizeHint(); status.ok()) {
+      output = DecompressOneCompressionGroup(resource);
+    } else {
+      output = status;
+    }
+    compression_groups_.push_back(remaining.substr(
+        0, remaining.size() - data_reader_.BytesRemaining()));
+  }
+  if (!output.ok()) {
+    size_hint_.reset();
+    return output;
+  }
+  if (absl::Status status = AddDecompressedSize(output->size()); !status.ok()) {
+    return status;
+  }
+  return output;
+}
+
+absl::StatusOr<std::string_view>
+CompressedBlobReader::ExtractOneCompressionGroupView(
+    absl::FunctionRef<
+        absl::StatusOr<std::string_view>(quiche::QuicheDataReader&)>
+        read_group) {
+  absl::StatusOr<std::optional<uint32_t>> reference =
+      ReadCompressionGroupReference();
+  if (!reference.ok()) {
+    return reference.status();
+  }
+  absl::StatusOr<std::string_view> output;
+  if (reference->has_value()) {
+    // Reading the earlier group again costs nothing, so there is nothing to
+    // keep for the following references.
+    output = CreateLimitedGroupReader(compression_groups_[**reference],
+                                      RemainingBlobSize())
+                 ->ExtractOneCompressionGroupView(read_group);
+  } else {
+    const std::string_view remaining = data_reader_.PeekRemainingPayload();
+    if (absl::Status status = ReadSizeHint(); status.ok()) {
+      output = read_group(data_reader_);
+    } else {
+      output = status;
+    }
+    compression_groups_.push_back(remaining.substr(
+        0, remaining.size() - data_reader_.BytesRemaining()));
+  }
+  if (!output.ok()) {
+    size_hint_.reset();
+    return output;
+  }
+  if (absl::Status status = AddDecompressedSize(output->size()); !status.ok()) {
+    return status;
+  }
+  return output;
+}
+
+absl::StatusOr<std::pmr::string>
+CompressedBlobReader::DecompressOneCompressionGroup(
+    std::pmr::memory_resource* resource) {
+  absl::StatusOr<std::string> group = DecompressOneCompressionGroup();
+  if (!group.ok()) {
+    return group.status();
+  }
+  return std::pmr::string(group->data(), group->size(), resource);
+}
+
+absl::StatusOr<std::vector<absl::StatusOr<std::string>>>
+CompressedBlobReader::ExtractAll(Executor& executor) {
+  const size_t first = compression_groups_.size();
+  // Positions, from `first` on, of the groups to decompress, and of the
+  // references along with the groups they refer to.
+  std::vector<size_t> compressed;
+  std::vector<std::pair<size_t, uint32_t>> references;
+  // Size hints of the groups in `compressed`, if they have one.
+  std::vector<std::optional<uint32_t>> size_hints;
+  // Total of the size hints, to reject an oversized blob up front.
+  size_t hinted_size = 0;
+  while (!IsDoneReading()) {
+    const size_t i = compression_groups_.size() - first;
+    absl::StatusOr<std::optional<uint32_t>> reference =
+        ReadCompressionGroupReference();
+    if (!reference.ok()) {
+      return reference.status();
+    }
+    if (reference->has_value()) {
+      references.emplace_back(i, **reference);
+      continue;
+    }
+    const std::string_view remaining = data_reader_.PeekRemainingPayload();
+    if (absl::Status status = ReadSizeHint(); !status.ok()) {
+      return status;
+    }
+    size_hints.push_back(std::exchange(size_hint_, std::nullopt));
+    hinted_size += size_hints.back().value_or(0);
+    if (hinted_size > limits_.max_blob_size - decompressed_size_) {
+      return absl::ResourceExhaustedError(absl::StrCat(
+          "Compression groups of at least ", hinted_size,
+          " bytes exceed the decompression limit"));
+    }
+    if (absl::StatusOr<std::string_view> compression_group =
+            SkipOneCompressionGroup();
+        !compression_group.ok()) {
+      return compression_group.status();
+    }
+    compression_groups_.push_back(remaining.substr(
+        0, remaining.size() - data_reader_.BytesRemaining()));
+    compressed.push_back(i);
+  }
+
+  std::vector<absl::StatusOr<std::string>> outputs(compression_groups_.size() -
+                                                   first);
+  if (!compressed.empty()) {
+    // The groups decompress at the same time, so none of them can see what
+    // the others take from the blob limit. Each gets a fixed share of what is
+    // left instead: its size hint, or an even split of the rest among the
+    // groups without one.
+    const size_t unhinted =
+        std::count(size_hints.begin(), size_hints.end(), std::nullopt);
+    const size_t share =
+        unhinted == 0
+            ? 0
+            : (limits_.max_blob_size - decompressed_size_ - hinted_size) /
+                  unhinted;
+    const auto extract = [this, first, &outputs](size_t i, size_t max_size) {
+      outputs[i] =
+          CreateLimitedGroupReader(compression_groups_[first + i], max_size)
+              ->ExtractOneCompressionGroup();
+    };
+    // The calling thread takes the last group instead of idling.
+    absl::BlockingCounter pending(compressed.size() - 1);
+    for (size_t j = 0; j + 1 < compressed.size(); ++j) {
+      executor.Run([&extract, &pending, i = compressed[j],
+                    max_size = size_hints[j].value_or(share)] {
+        extract(i, max_size);
+        pending.DecrementCount();
+      });
+    }
+    extract(compressed.back(), size_hints.back().value_or(share));
+    pending.Wait();
+  }
+  for (size_t i : compressed) {
+    if (!outputs[i].ok()) {
+      continue;
+    }
+    if (absl::Status status = AddDecompressedSize(outputs[i]->size());
+        !status.ok()) {
+      return status;
+    }
+  }
+  // In order, so that references to references find their group resolved.
+  // Referenced groups decompressed here are limited by what the groups above
+  // left.
+  for (const auto& [i, k] : references) {
+    outputs[i] =
+        k < first ? ExtractReferencedCompressionGroup(k) : outputs[k - first];
+    if (!outputs[i].ok()) {
+      continue;
+    }
+    if (absl::Status status = AddDecompressedSize(outputs[i]->size());
+        !status.ok()) {
+      return status;
+    }
+  }
+  return outputs;
+}
+
+absl::StatusOr<std::string> CompressedBlobReader::ExtractCompressionGroup(
+    const CompressionGroupIndex& index, size_t k) const {
+  absl::StatusOr<std::string_view> compression_group =
+      index.GetCompressionGroup(k);
+  if (!compression_group.ok()) {
+    return compression_group.status();
+  }
+  quiche::QuicheDataReader data_reader(*compression_group);
+  absl::StatusOr<std::optional<uint32_t>> reference =
+      ReadReference(data_reader, k);
+  if (!reference.ok()) {
+    return reference.status();
+  }
+  if (reference->has_value()) {
+    // Concatenators only refer to groups that are not references themselves,
+    // so there is no chain to follow.
+    compression_group = index.GetCompressionGroup(**reference);
+    if (!compression_group.ok()) {
+      return compression_group.status();
+    }
+    quiche::QuicheDataReader referenced_reader(*compression_group);
+    uint32_t marker = 0;
+    if (referenced_reader.ReadUInt32(&marker) &&
+        marker == kCompressionGroupReference) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Compression group reference to ", **reference,
+                       " is to another reference"));
+    }
+  }
+  return CreateLimitedGroupReader(*compression_group, RemainingBlobSize())
+      ->ExtractOneCompressionGroup();
+}
+
+absl::StatusOr<std::optional<uint32_t>>
+CompressedBlobReader::ReadCompressionGroupReference() {
+  absl::StatusOr<std::optional<uint32_t>> reference =
+      ReadReference(data_reader_, compression_groups_.size());
+  if (reference.ok() && reference->has_value()) {
+    compression_groups_.push_back(compression_groups_[**reference]);
+  }
+  return reference;
+}
+
+absl::StatusOr<std::string>
+CompressedBlobReader::ExtractReferencedCompressionGroup(uint32_t k) {
+  if (const auto it = referenced_compression_groups_.find(k);
+      it != referenced_compression_groups_.end()) {
+    return it->second;
+  }
+  absl::StatusOr<std::string> output =
+      CreateLimitedGroupReader(compression_groups_[k], RemainingBlobSize())
+          ->ExtractOneCompressionGroup();
+  if (output.ok()) {
+    referenced_compression_groups_.emplace(k, *output);
+  }
+  return output;
+}
+
+absl::Status CompressedBlobReader::ReadSizeHint() {
+  size_hint_.reset();
+  quiche::QuicheDataReader peek_reader(data_reader_.PeekRemainingPayload());
+  uint32_t marker = 0;
+  if (!peek_reader.ReadUInt32(&marker) || marker != kCompressionGroupSizeHint) {
+    return absl::OkStatus();
+  }
+  uint32_t size_hint = 0;
+  if (!data_reader_.Seek(sizeof(uint32_t)) ||
+      !data_reader_.ReadUInt32(&size_hint)) {
+    return absl::InvalidArgumentError(
+        "Failed to read compression group size hint");
+  }
+  if (size_hint > max_decompressed_size()) {
+    return absl::ResourceExhaustedError(
+        absl::StrCat("Compression group of ", size_hint,
+                     " bytes exceeds the decompression limit"));
+  }
+  size_hint_ = size_hint;
+  return absl::OkStatus();
+}
+
+absl::Status CompressedBlobReader::AddDecompressedSize(size_t size) {
+  if (const std::optional<uint32_t> size_hint =
+          std::exchange(size_hint_, std::nullopt);
+      size_hint.has_value() && size != *size_hint) {
+    return absl::DataLossError(
+        absl::StrCat("Compression group of ", size,
+                     " bytes does not match its size hint of ", *size_hint));
+  }
+  if (size > max_decompressed_size()) {
+    return absl::ResourceExhaustedError(
+        absl::StrCat("Compression group of ", size,
+                     " bytes exceeds the decompression limit"));
+  }
+  decompressed_size_ += size;
+  return absl::OkStatus();
+}
+
+size_t CompressedBlobReader::max_decompressed_size() const {
+  if (size_hint_.has_value()) {
+    return *size_hint_;
+  }
+  return std::min(limits_.max_compression_group_size, RemainingBlobSize());
+}
+
+size_t CompressedBlobReader::RemainingBlobSize() const {
+  return limits_.max_blob_size - decompressed_size_;
+}
+
+std::unique_ptr<CompressedBlobReader>
+CompressedBlobReader::CreateLimitedGroupReader(
+    std::string_view compression_group, size_t max_size) const {
+  std::unique_ptr<CompressedBlobReader> reader =
+      CreateGroupReader(compression_group);
+  max_size = std::min(limits_.max_compression_group_size, max_size);
+  reader->set_decompression_limits({max_size, max_size});
+  return reader;
+}
+
+absl::StatusOr<std::string_view>
+CompressedBlobReader::SkipOneCompressionGroup() {
+  const std::string_view remaining = data_reader_.PeekRemainingPayload();
+  uint32_t compression_group_size = 0;
+  if (!data_reader_.ReadUInt32(&compression_group_size)) {
+    return absl::InvalidArgumentError("Failed to read compression group size");
+  }
+  if (!data_reader_.Seek(compression_group_size)) {
+    return absl::InvalidArgumentError("Failed to read compression group");
+  }
+  return remaining.substr(0, sizeof(uint32_t) + compression_group_size);
+}
+
 std::unique_ptr<CompressedBlobReader> CompressedBlobReader::Create(
     CompressionGroupConcatenator::CompressionType type,
     std::string_view compressed) {
@@ -17,16 +17,48 @@
 #ifndef COMPONENTS_DATA_SERVER_REQUEST_HANDLER_COMPRESSION_H_
 #define COMPONENTS_DATA_SERVER_REQUEST_HANDLER_COMPRESSION_H_
 
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <memory_resource>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "quiche/common/quiche_data_reader.h"
+#include "src/cpp/communication/compression_group_cache.h"
+#include "src/cpp/concurrent/executor.h"
 
 namespace privacy_sandbox::server_common {
 
+// Marks a compression group that repeats an earlier one of the same blob. Such
+// a group is framed as 4 bytes of kCompressionGroupReference followed by 4
+// bytes for the position of the earlier group, counting from 0. It takes the
+// place of the size of an ordinary group, or of the dictionary ID of a Brotli
+// group compressed with a shared dictionary.
+inline constexpr uint32_t kCompressionGroupReference = 0xFFFFFFFF;
+
+// Marks a compression group that starts with its decompressed size. Such a
+// group is framed as 4 bytes of kCompressionGroupSizeHint, 4 bytes for the
+// decompressed size, and then the usual framing of the group.
+inline constexpr uint32_t kCompressionGroupSizeHint = 0xFFFFFFFE;
+
+// Caps the output of a CompressedBlobReader, so that a small compressed blob
+// cannot inflate into an arbitrary amount of memory. Decompression fails with
+// ResourceExhausted as soon as a limit is exceeded.
+struct DecompressionLimits {
+  // Maximum size of one decompressed compression group.
+  size_t max_compression_group_size = std::numeric_limits<size_t>::max();
+  // Maximum total size of the decompressed compression groups of a blob,
+  // including the repeats of referenced groups.
+  size_t max_blob_size = std::numeric_limits<size_t>::max();
+};
+
 // Responsible for concatenating compression groups according to the compression
 // specification
 // https://github.com/WICG/turtledove/blob/main/FLEDGE_Key_Value_Server_API.md#response-version-20
@@ -55,11 +87,107 @@ class CompressionGroupConcatenator {
   // the compressed input.
   virtual absl::StatusOr<std::string> Build() const = 0;
 
+  // Same as Build(), but prefixes the output with an offset table, which lets
+  // CompressionGroupIndex reach any compression group without reading the ones
+  // before it. The format is:
+  // - 4 bytes for the number of compression groups N
+  // - N times 4 bytes for the offset of the end of every compression group,
+  //   relative to the end of the table
+  // - the output of Build()
+  absl::StatusOr<std::string> BuildIndexed() const;
+
+  // Takes the compression groups from `cache`, which must outlive this object,
+  // when they were compressed before with the same codec and parameters, and
+  // adds the ones compressed here. Concatenators whose CacheKey() is empty do
+  // not use the cache.
+  void set_cache(CompressionGroupCache* cache) { cache_ = cache; }
+
+  // Replaces every compression group that is identical to an earlier one by a
+  // reference to it (see kCompressionGroupReference), which is neither
+  // compressed nor decompressed again. Only for clients that read such
+  // references. StreamingCompressionGroupConcatenator does not deduplicate.
+  void set_deduplicate(bool deduplicate) { deduplicate_ = deduplicate; }
+
+  // Prefixes every compression group with its decompressed size (see
+  // kCompressionGroupSizeHint), so that readers allocate the output once and
+  // reject oversized groups before decompressing them. Only for clients that
+  // read size hints.
+  void set_size_hints(bool size_hints) { size_hints_ = size_hints; }
+
  protected:
   const std::vector<std::string>& Partitions() const { return partitions_; }
 
+  // Compresses and frames one compression group, the way Build() does.
+  virtual absl::StatusOr<std::string> BuildCompressionGroup(
+      std::string_view partition) const = 0;
+
+  // Identifies the codec and the parameters of BuildCompressionGroup() in
+  // the cache: concatenators with the same key must produce the same output.
+  // Empty if compression groups are not worth caching.
+  virtual std::string CacheKey() const { return ""; }
+
+  // Same as BuildCompressionGroup(), but goes through the cache if one is set,
+  // and adds the size hint if set to.
+  absl::StatusOr<std::string> BuildFramedCompressionGroup(
+      std::string_view partition) const;
+
+  // Compresses and frames all the compression groups, deduplicating them if
+  // set to.
+  absl::StatusOr<std::vector<std::string>> BuildCompressionGroups() const;
+
+  // For every partition, the position of the first identical partition if it
+  // is a later occurrence that is replaced by a reference. All empty unless
+  // deduplicating.
+  std::vector<std::optional<uint32_t>> EarlierOccurrences() const;
+
+  bool size_hints() const { return size_hints_; }
+
  private:
+  friend class StreamingCompressionGroupConcatenator;
+
+  // Same as BuildCompressionGroup(), but goes through the cache if one is set.
+  absl::StatusOr<std::string> BuildCachedCompressionGroup(
+      std::string_view partition) const;
+
   std::vector<std::string> partitions_;
+  CompressionGroupCache* cache_ = nullptr;
+  bool deduplicate_ = false;
+  bool size_hints_ = false;
+};
+
+// Offset table of a blob built with
+// CompressionGroupConcatenator::BuildIndexed(). Does not own the blob. Cheap to
+// copy.
+class CompressionGroupIndex {
+ public:
+  // Validates the offset table at the start of `indexed_blob`.
+  static absl::StatusOr<CompressionGroupIndex> Parse(
+      std::string_view indexed_blob);
+
+  size_t num_compression_groups() const { return num_compression_groups_; }
+
+  // Returns compression group `k`, still compressed and framed, e.g. to serve
+  // it again as is or to pass it to
+  // CompressedBlobReader::ExtractCompressionGroup().
+  absl::StatusOr<std::string_view> GetCompressionGroup(size_t k) const;
+
+  // The compression groups without the offset table, as returned by Build().
+  std::string_view compression_groups() const { return compression_groups_; }
+
+ private:
+  CompressionGroupIndex(size_t num_compression_groups,
+                        std::string_view offsets,
+                        std::string_view compression_groups)
+      : num_compression_groups_(num_compression_groups),
+        offsets_(offsets),
+        compression_groups_(compression_groups) {}
+
+  // Returns the end offset of compression group `k`.
+  uint32_t EndOffset(size_t k) const;
+
+  size_t num_compression_groups_;
+  std::string_view offsets_;
+  std::string_view compression_groups_;
 };
 
 // Responsible for parsing a compression blob generated by the
@@ -76,6 +204,11 @@ class CompressedBlobReader {
 
   virtual ~CompressedBlobReader() = default;
 
+  // Applies to the groups extracted from now on. Unlimited by default.
+  void set_decompression_limits(DecompressionLimits limits) {
+    limits_ = limits;
+  }
+
   // Returns true if no more compression group is left to extract.
   bool IsDoneReading() const { return data_reader_.IsDoneReading(); }
 
@@ -89,10 +222,116 @@ class CompressedBlobReader {
   //     LOG(INFO) << "one group: " << *maybe_one_group;
   //   } else {...}
   // }
-  virtual absl::StatusOr<std::string> ExtractOneCompressionGroup() = 0;
+  //
+  // A reference to an earlier group (see kCompressionGroupReference) returns
+  // that group again. The earlier group is decompressed once more on the
+  // first reference to it, and kept for the following ones. A group with a
+  // size hint (see kCompressionGroupSizeHint) must decompress to exactly that
+  // size.
+  //
+  // The default implementation handles the framing and calls
+  // DecompressOneCompressionGroup(); readers with their own framing may
+  // override it.
+  virtual absl::StatusOr<std::string> ExtractOneCompressionGroup();
+
+  // Same as above, but allocates the decompressed group from `resource`, e.g.
+  // a RequestArena.
+  absl::StatusOr<std::pmr::string> ExtractOneCompressionGroup(
+      std::pmr::memory_resource* resource);
+
+  // Decompresses all the remaining compression groups at the same time, on
+  // `executor` and on the calling thread, and returns them in order, each with
+  // its own status. Reads the framing of all groups first, and fails without
+  // decompressing anything if it is malformed. References to earlier groups
+  // are copies of them and are not decompressed again. Blocks until all groups
+  // are decompressed; the reader is done reading afterwards.
+  //
+  // As the groups decompress at the same time, the blob limit is split among
+  // them up front: a group with a size hint gets that much, and the others
+  // share the rest evenly. A blob whose groups differ a lot in size may then
+  // fail here but not one group at a time; size hints avoid that.
+  absl::StatusOr<std::vector<absl::StatusOr<std::string>>> ExtractAll(
+      Executor& executor);
+
+  // Decompresses compression group `k` of `index` directly. Does not change
+  // the reader state, so the reader may be created over any blob of the same
+  // kind, e.g. index.compression_groups().
+  absl::StatusOr<std::string> ExtractCompressionGroup(
+      const CompressionGroupIndex& index, size_t k) const;
 
  protected:
+  // Decompresses the next compression group, which is not a reference.
+  virtual absl::StatusOr<std::string> DecompressOneCompressionGroup() = 0;
+
+  // Same as above, but allocates the decompressed group from `resource`. The
+  // default implementation copies the output of the overload above; readers
+  // override it to decompress into `resource` directly.
+  virtual absl::StatusOr<std::pmr::string> DecompressOneCompressionGroup(
+      std::pmr::memory_resource* resource);
+
+  // Advances past the next compression group, which is not a reference, and
+  // returns it, including its framing.
+  virtual absl::StatusOr<std::string_view> SkipOneCompressionGroup();
+
+  // Size hint of the group being decompressed, if it has one. Decompressors
+  // reserve that much output.
+  std::optional<uint32_t> size_hint() const { return size_hint_; }
+
+  // Size that the output of the group being decompressed must not exceed.
+  // Decompressors fail with ResourceExhausted as soon as they go past it.
+  size_t max_decompressed_size() const;
+
+  // Returns a reader of the same kind for one group returned by
+  // SkipOneCompressionGroup(). Called concurrently by ExtractAll().
+  virtual std::unique_ptr<CompressedBlobReader> CreateGroupReader(
+      std::string_view compression_group) const = 0;
+
+  // Same as ExtractOneCompressionGroup(), for readers whose compression groups
+  // hold their output as is: `read_group` reads the next group, which is not a
+  // reference, from the given reader and returns a view of its output into the
+  // blob. References return a view of the group they refer to. Nothing is
+  // copied.
+  absl::StatusOr<std::string_view> ExtractOneCompressionGroupView(
+      absl::FunctionRef<absl::StatusOr<std::string_view>(
+          quiche::QuicheDataReader&)>
+          read_group);
+
   quiche::QuicheDataReader data_reader_;
+
+ private:
+  // Reads the next compression group if it is a reference to an earlier one,
+  // and returns the position of that one.
+  absl::StatusOr<std::optional<uint32_t>> ReadCompressionGroupReference();
+
+  // Returns earlier compression group `k`, decompressing it if needed.
+  absl::StatusOr<std::string> ExtractReferencedCompressionGroup(uint32_t k);
+
+  // Reads the size hint of the next compression group if it has one, and
+  // checks it against the limits.
+  absl::Status ReadSizeHint();
+
+  // Checks the size of a group that was just extracted against its size hint,
+  // and counts it against the limit of the blob.
+  absl::Status AddDecompressedSize(size_t size);
+
+  // What is left of the blob limit.
+  size_t RemainingBlobSize() const;
+
+  // Same as CreateGroupReader(), with the group limit of this reader and at
+  // most `max_size` bytes of output.
+  std::unique_ptr<CompressedBlobReader> CreateLimitedGroupReader(
+      std::string_view compression_group, size_t max_size) const;
+
+  // Framed compression groups read so far. References point to the framing of
+  // the group they refer to.
+  std::vector<std::string_view> compression_groups_;
+  // Decompressed compression groups that references were read for, by
+  // position.
+  absl::flat_hash_map<uint32_t, std::string> referenced_compression_groups_;
+  DecompressionLimits limits_;
+  std::optional<uint32_t> size_hint_;
+  // Total size of the groups extracted so far.
+  size_t decompressed_size_ = 0;
 };
 
 }  // namespace privacy_sandbox::server_common
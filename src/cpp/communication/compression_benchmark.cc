@@ -0,0 +1,364 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures building and extracting compression groups for every codec. Each
+// benchmark takes the size of one compression group in bytes and the number of
+// groups per response.
+//
+// Run with:
+//   bazel run -c opt //src/cpp/communication:compression_benchmark -- \
+//     --benchmark_format=json
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "include/grpc/event_engine/event_engine.h"
+#include "src/cpp/communication/brotli_dictionary_trainer.h"
+#include "src/cpp/communication/compression_brotli.h"
+#include "src/cpp/communication/compression_group_cache.h"
+#include "src/cpp/communication/compression_gzip.h"
+#include "src/cpp/communication/streaming_concatenator.h"
+#include "src/cpp/communication/uncompressed.h"
+#include "src/cpp/concurrent/event_engine_executor.h"
+#include "src/cpp/concurrent/executor.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+// Returns a key/value lookup response for one compression group of about
+// `size` bytes. Keys repeat their structure but not their values, so the data
+// compresses roughly like real responses do.
+std::string MakeCompressionGroup(int64_t size, uint32_t seed) {
+  std::mt19937 random(seed);
+  std::string group = R"({"partitions":[{"id":0,"keyGroupOutputs":[)";
+  for (int i = 0; static_cast<int64_t>(group.size()) < size; ++i) {
+    absl::StrAppend(&group, i == 0 ? "" : ",",
+                    R"({"tags":["custom","keys"],"keyValues":{"ad_render_)", i,
+                    R"(":{"value":"{\"adSize\":)", random() % 1000,
+                    R"(,\"bid\":)", random(), R"(}"}}})");
+  }
+  absl::StrAppend(&group, "]}]}");
+  return group;
+}
+
+std::vector<std::string> MakeCompressionGroups(const benchmark::State& state) {
+  std::vector<std::string> groups;
+  for (int i = 0; i < state.range(1); ++i) {
+    groups.push_back(MakeCompressionGroup(state.range(0), i));
+  }
+  return groups;
+}
+
+// The gzip concatenator and reader on libdeflate, for the benchmark templates.
+class LibdeflateGzipConcatenator : public GzipCompressionGroupConcatenator {
+ public:
+  LibdeflateGzipConcatenator()
+      : GzipCompressionGroupConcatenator(GzipBackend::kLibdeflate) {}
+};
+
+class LibdeflateGzipReader : public GzipCompressionBlobReader {
+ public:
+  explicit LibdeflateGzipReader(std::string_view compressed)
+      : GzipCompressionBlobReader(compressed, GzipBackend::kLibdeflate) {}
+};
+
+template <typename Concatenator>
+std::string BuildBlob(const std::vector<std::string>& groups) {
+  Concatenator concatenator;
+  for (const std::string& group : groups) {
+    concatenator.AddCompressionGroup(group);
+  }
+  return concatenator.Build().value();
+}
+
+template <typename Concatenator>
+void BM_Build(benchmark::State& state) {
+  const std::vector<std::string> groups = MakeCompressionGroups(state);
+  int64_t output_size = 0;
+  for (auto _ : state) {
+    Concatenator concatenator;
+    for (const std::string& group : groups) {
+      concatenator.AddCompressionGroup(group);
+    }
+    auto blob = concatenator.Build();
+    output_size = blob->size();
+    benchmark::DoNotOptimize(blob);
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0) *
+                          state.range(1));
+  state.counters["output_bytes"] = output_size;
+}
+
+// Same as BM_Build, but with a cache that already holds every group, as when
+// the same groups are served to many clients.
+template <typename Concatenator>
+void BM_BuildCached(benchmark::State& state) {
+  const std::vector<std::string> groups = MakeCompressionGroups(state);
+  CompressionGroupCache cache(/*capacity_bytes=*/64 << 20);
+  for (auto _ : state) {
+    Concatenator concatenator;
+    concatenator.set_cache(&cache);
+    for (const std::string& group : groups) {
+      concatenator.AddCompressionGroup(group);
+    }
+    auto blob = concatenator.Build();
+    benchmark::DoNotOptimize(blob);
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0) *
+                          state.range(1));
+  const CompressionGroupCache::Stats stats = cache.stats();
+  state.counters["hit_rate"] =
+      static_cast<double>(stats.hits) / (stats.hits + stats.misses);
+}
+
+template <typename Concatenator, typename Reader>
+void BM_Extract(benchmark::State& state) {
+  const std::string blob =
+      BuildBlob<Concatenator>(MakeCompressionGroups(state));
+  for (auto _ : state) {
+    Reader reader(blob);
+    while (!reader.IsDoneReading()) {
+      auto group = reader.ExtractOneCompressionGroup();
+      if (!group.ok()) {
+        state.SkipWithError("Failed to extract compression group");
+        return;
+      }
+      benchmark::DoNotOptimize(group);
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0) *
+                          state.range(1));
+}
+
+// Same as BM_Extract, but returns views into the blob instead of copies.
+void BM_ExtractUncompressedViews(benchmark::State& state) {
+  const std::string blob =
+      BuildBlob<UncompressedConcatenator>(MakeCompressionGroups(state));
+  for (auto _ : state) {
+    UncompressedBlobReader reader(blob);
+    while (!reader.IsDoneReading()) {
+      auto group = reader.ExtractOneCompressionGroupView();
+      if (!group.ok()) {
+        state.SkipWithError("Failed to extract compression group");
+        return;
+      }
+      benchmark::DoNotOptimize(group);
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0) *
+                          state.range(1));
+}
+
+Executor& GetExecutor() {
+  static Executor* const executor = [] {
+    static GrpcInit grpc_init;
+    return new EventEngineExecutor(
+        grpc_event_engine::experimental::CreateEventEngine());
+  }();
+  return *executor;
+}
+
+// Same as BM_Extract, but decompresses all groups in parallel.
+template <typename Concatenator, typename Reader>
+void BM_ExtractAll(benchmark::State& state) {
+  const std::string blob =
+      BuildBlob<Concatenator>(MakeCompressionGroups(state));
+  Executor& executor = GetExecutor();
+  for (auto _ : state) {
+    Reader reader(blob);
+    auto groups = reader.ExtractAll(executor);
+    if (!groups.ok()) {
+      state.SkipWithError("Failed to extract compression groups");
+      return;
+    }
+    benchmark::DoNotOptimize(groups);
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0) *
+                          state.range(1));
+}
+
+// Same as BM_Build, but compresses every group on the executor as soon as it
+// is added.
+template <typename Concatenator>
+void BM_StreamingBuild(benchmark::State& state) {
+  const std::vector<std::string> groups = MakeCompressionGroups(state);
+  Executor& executor = GetExecutor();
+  for (auto _ : state) {
+    std::string output;
+    StreamingCompressionGroupConcatenator concatenator(
+        std::make_unique<Concatenator>(),
+        [&output](std::string compression_group) {
+          output.append(compression_group);
+        },
+        &executor);
+    for (const std::string& group : groups) {
+      concatenator.AddCompressionGroup(group);
+    }
+    if (!concatenator.Finish().ok()) {
+      state.SkipWithError("Failed to build compression groups");
+      return;
+    }
+    benchmark::DoNotOptimize(output);
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0) *
+                          state.range(1));
+}
+
+// Dictionary trained on groups generated with other seeds than the measured
+// ones.
+std::shared_ptr<const BrotliSharedDictionary> GetDictionary() {
+  static const auto* const dictionary = [] {
+    std::vector<std::string> samples;
+    for (uint32_t seed = 1000; seed < 1100; ++seed) {
+      samples.push_back(MakeCompressionGroup(1 << 10, seed));
+    }
+    std::string data = TrainBrotliDictionary(samples).value();
+    return new std::shared_ptr<const BrotliSharedDictionary>(
+        BrotliSharedDictionary::Create(1, std::move(data)).value());
+  }();
+  return *dictionary;
+}
+
+void BM_BuildBrotliWithDictionary(benchmark::State& state) {
+  const std::vector<std::string> groups = MakeCompressionGroups(state);
+  const std::shared_ptr<const BrotliSharedDictionary> dictionary =
+      GetDictionary();
+  int64_t output_size = 0;
+  for (auto _ : state) {
+    BrotliCompressionGroupConcatenator concatenator(dictionary);
+    for (const std::string& group : groups) {
+      concatenator.AddCompressionGroup(group);
+    }
+    auto blob = concatenator.Build();
+    output_size = blob->size();
+    benchmark::DoNotOptimize(blob);
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0) *
+                          state.range(1));
+  state.counters["output_bytes"] = output_size;
+}
+
+void BM_ExtractBrotliWithDictionary(benchmark::State& state) {
+  const BrotliSharedDictionaries dictionaries = {{1, GetDictionary()}};
+  BrotliCompressionGroupConcatenator concatenator(GetDictionary());
+  for (const std::string& group : MakeCompressionGroups(state)) {
+    concatenator.AddCompressionGroup(group);
+  }
+  const std::string blob = concatenator.Build().value();
+  for (auto _ : state) {
+    BrotliCompressionBlobReader reader(blob, &dictionaries);
+    while (!reader.IsDoneReading()) {
+      auto group = reader.ExtractOneCompressionGroup();
+      if (!group.ok()) {
+        state.SkipWithError("Failed to extract compression group");
+        return;
+      }
+      benchmark::DoNotOptimize(group);
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0) *
+                          state.range(1));
+}
+
+// Group sizes from a single small lookup up to a large one, with one group per
+// response or a group per partition.
+void CompressionArgs(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"group_bytes", "groups"});
+  for (int64_t group_bytes : {1 << 10, 16 << 10, 256 << 10}) {
+    for (int64_t groups : {1, 8}) {
+      benchmark->Args({group_bytes, groups});
+    }
+  }
+}
+
+BENCHMARK_TEMPLATE(BM_Build, UncompressedConcatenator)->Apply(CompressionArgs);
+BENCHMARK_TEMPLATE(BM_Build, BrotliCompressionGroupConcatenator)
+    ->Apply(CompressionArgs);
+BENCHMARK_TEMPLATE(BM_Build, GzipCompressionGroupConcatenator)
+    ->Apply(CompressionArgs);
+BENCHMARK_TEMPLATE(BM_BuildCached, BrotliCompressionGroupConcatenator)
+    ->Apply(CompressionArgs);
+BENCHMARK_TEMPLATE(BM_BuildCached, GzipCompressionGroupConcatenator)
+    ->Apply(CompressionArgs);
+BENCHMARK(BM_BuildBrotliWithDictionary)->Apply(CompressionArgs);
+BENCHMARK_TEMPLATE(BM_Extract, UncompressedConcatenator, UncompressedBlobReader)
+    ->Apply(CompressionArgs);
+BENCHMARK(BM_ExtractUncompressedViews)->Apply(CompressionArgs);
+BENCHMARK_TEMPLATE(BM_Extract, BrotliCompressionGroupConcatenator,
+                   BrotliCompressionBlobReader)
+    ->Apply(CompressionArgs);
+BENCHMARK_TEMPLATE(BM_Extract, GzipCompressionGroupConcatenator,
+                   GzipCompressionBlobReader)
+    ->Apply(CompressionArgs);
+BENCHMARK(BM_ExtractBrotliWithDictionary)->Apply(CompressionArgs);
+
+// The gzip backends on single groups, from tiny to large ones.
+void GzipBackendArgs(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"group_bytes", "groups"});
+  for (int64_t group_bytes = 256; group_bytes <= (256 << 10);
+       group_bytes *= 4) {
+    benchmark->Args({group_bytes, 1});
+  }
+}
+
+BENCHMARK_TEMPLATE(BM_Build, GzipCompressionGroupConcatenator)
+    ->Apply(GzipBackendArgs);
+BENCHMARK_TEMPLATE(BM_Build, LibdeflateGzipConcatenator)
+    ->Apply(GzipBackendArgs);
+BENCHMARK_TEMPLATE(BM_Extract, GzipCompressionGroupConcatenator,
+                   GzipCompressionBlobReader)
+    ->Apply(GzipBackendArgs);
+BENCHMARK_TEMPLATE(BM_Extract, LibdeflateGzipConcatenator,
+                   LibdeflateGzipReader)
+    ->Apply(GzipBackendArgs);
+
+// Sequential and parallel building and extraction of a growing number of
+// groups. Compared by wall time, since the parallel versions spend CPU time on
+// other threads.
+void GroupCountArgs(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"group_bytes", "groups"});
+  for (int64_t groups : {1, 2, 4, 8, 16, 32}) {
+    benchmark->Args({16 << 10, groups});
+  }
+  benchmark->UseRealTime();
+}
+
+BENCHMARK_TEMPLATE(BM_Build, BrotliCompressionGroupConcatenator)
+    ->Apply(GroupCountArgs);
+BENCHMARK_TEMPLATE(BM_StreamingBuild, BrotliCompressionGroupConcatenator)
+    ->Apply(GroupCountArgs);
+BENCHMARK_TEMPLATE(BM_Extract, BrotliCompressionGroupConcatenator,
+                   BrotliCompressionBlobReader)
+    ->Apply(GroupCountArgs);
+BENCHMARK_TEMPLATE(BM_ExtractAll, BrotliCompressionGroupConcatenator,
+                   BrotliCompressionBlobReader)
+    ->Apply(GroupCountArgs);
+BENCHMARK_TEMPLATE(BM_Extract, GzipCompressionGroupConcatenator,
+                   GzipCompressionBlobReader)
+    ->Apply(GroupCountArgs);
+BENCHMARK_TEMPLATE(BM_ExtractAll, GzipCompressionGroupConcatenator,
+                   GzipCompressionBlobReader)
+    ->Apply(GroupCountArgs);
+
+}  // namespace
+}  // namespace privacy_sandbox::server_common
+
+BENCHMARK_MAIN();
@@ -13,14 +13,19 @@
 // limitations under the License.
 #include "src/cpp/communication/compression_brotli.h"
 
+#include <algorithm>
 #include <memory>
+#include <memory_resource>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_join.h"
 #include "brotli/decode.h"
 #include "brotli/encode.h"
+#include "brotli/shared_dictionary.h"
 #include "glog/logging.h"
 #include "quiche/common/quiche_data_writer.h"
 
@@ -28,6 +33,12 @@ namespace privacy_sandbox::server_common {
 
 namespace {
 
+// Plaintext handed out per BrotliCompressionGroupWriter::Next() call.
+constexpr size_t kWriterInputBufferSize = 32 * 1024;
+// Brotli can expand by far more than this, but a size hint only reserves
+// output up to this ratio of the compressed size; larger groups grow as usual.
+constexpr size_t kMaxReservedRatio = 1024;
+
 // Responsible for compressing one compression group.
 absl::StatusOr<std::string> CompressOnePartition(std::string_view partition) {
   VLOG(5) << "Compressing " << partition;
@@ -63,11 +74,59 @@ absl::StatusOr<std::string> CompressOnePartition(std::string_view partition) {
   return partition_output;
 }
 
+// Same as above, but compresses against `dictionary` and prefixes the group
+// with the dictionary ID. The one-shot BrotliEncoderCompress() cannot use a
+// custom dictionary, so this goes through the streaming API.
+absl::StatusOr<std::string> CompressOnePartition(
+    std::string_view partition, const BrotliSharedDictionary& dictionary) {
+  constexpr size_t kHeaderSize = 2 * sizeof(uint32_t);
+  size_t buffer_size = BrotliEncoderMaxCompressedSize(partition.size());
+  std::string partition_output(kHeaderSize + buffer_size, '\0');
+
+  BrotliEncoderState* encoder =
+      BrotliEncoderCreateInstance(/* alloc_func= */ nullptr,
+                                  /* free_func= */ nullptr,
+                                  /* opaque= */ nullptr);
+  if (!encoder) {
+    return absl::InternalError("Brotli encoder cannot be initialized");
+  }
+  BrotliEncoderSetParameter(encoder, BROTLI_PARAM_QUALITY,
+                            BROTLI_DEFAULT_QUALITY);
+  BrotliEncoderSetParameter(encoder, BROTLI_PARAM_SIZE_HINT,
+                            static_cast<uint32_t>(partition.size()));
+  const uint8_t* next_in = reinterpret_cast<const uint8_t*>(partition.data());
+  size_t available_in = partition.size();
+  uint8_t* next_out =
+      reinterpret_cast<uint8_t*>(partition_output.data() + kHeaderSize);
+  size_t available_out = buffer_size;
+  const bool compressed =
+      BrotliEncoderAttachPreparedDictionary(encoder, dictionary.prepared()) &&
+      BrotliEncoderCompressStream(encoder, BROTLI_OPERATION_FINISH,
+                                  &available_in, &next_in, &available_out,
+                                  &next_out, /* total_out= */ nullptr) &&
+      BrotliEncoderIsFinished(encoder);
+  BrotliEncoderDestroyInstance(encoder);
+  if (!compressed) {
+    return absl::InternalError("Brotli failed to compress");
+  }
+
+  buffer_size -= available_out;
+  partition_output.resize(kHeaderSize + buffer_size);
+  quiche::QuicheDataWriter data_writer(kHeaderSize, partition_output.data());
+  data_writer.WriteUInt32(dictionary.id());
+  data_writer.WriteUInt32(buffer_size);
+  VLOG(5) << "partition output size: " << partition_output.size();
+  return partition_output;
+}
+
 class BrotliDecoder {
  public:
   // Owns the decoder memory
   explicit BrotliDecoder(BrotliDecoderState* decoder) : decoder_(decoder) {}
-  static absl::StatusOr<std::unique_ptr<BrotliDecoder>> Create() {
+  // Decodes against `dictionary` if it is not null. The dictionary must
+  // outlive the decoder.
+  static absl::StatusOr<std::unique_ptr<BrotliDecoder>> Create(
+      const BrotliSharedDictionary* dictionary = nullptr) {
     BrotliDecoderState* decoder =
         BrotliDecoderCreateInstance(/* alloc_func= */ nullptr,
                                     /* free_func= */ nullptr,
@@ -75,10 +134,17 @@ class BrotliDecoder {
     if (!decoder) {
       return absl::InternalError("Brotli decoder cannot be initialized");
     }
+    auto brotli_decoder = std::make_unique<BrotliDecoder>(decoder);
 
     BrotliDecoderSetParameter(
         decoder, BROTLI_DECODER_PARAM_DISABLE_RING_BUFFER_REALLOCATION, 1u);
-    return std::make_unique<BrotliDecoder>(decoder);
+    if (dictionary != nullptr &&
+        !BrotliDecoderAttachDictionary(
+            decoder, BROTLI_SHARED_DICTIONARY_RAW, dictionary->data().size(),
+            reinterpret_cast<const uint8_t*>(dictionary->data().data()))) {
+      return absl::InternalError("Brotli dictionary cannot be attached");
+    }
+    return brotli_decoder;
   }
 
   BrotliDecoder(const BrotliDecoder&) = delete;
@@ -90,18 +156,24 @@ class BrotliDecoder {
     decoder_ = nullptr;
   }
 
-  absl::StatusOr<std::string> Decode(quiche::QuicheDataReader& data_reader) {
-    std::vector<std::string> outputs;
-
+  // Appends the decompressed data to `output`, which determines the allocator
+  // of the result. Fails once the output exceeds `max_size`.
+  template <typename String>
+  absl::StatusOr<String> Decode(quiche::QuicheDataReader& data_reader,
+                                String output, size_t max_size) {
     while (true) {
       if (BrotliDecoderHasMoreOutput(decoder_)) {
         // Copy the output to our own buffer. We can't let Brotli directly write
         // to our own buffer because we don't know how big the output size is
         size_t data_size = 0;
         const uint8_t* data = BrotliDecoderTakeOutput(decoder_, &data_size);
-        outputs.push_back(
-            std::string(reinterpret_cast<const char*>(data), data_size));
-        VLOG(5) << "outputs size: " << outputs.size()
+        if (data_size > max_size - output.size()) {
+          return absl::ResourceExhaustedError(absl::StrCat(
+              "Compression group exceeds the decompression limit of ",
+              max_size, " bytes"));
+        }
+        output.append(reinterpret_cast<const char*>(data), data_size);
+        VLOG(5) << "output size: " << output.size()
                 << "new item size: " << data_size;
         continue;
       }
@@ -156,50 +228,228 @@ class BrotliDecoder {
               absl::StrCat("unexpected brotli decoder result: ", result));
       }
     }
-    return absl::StrJoin(outputs, "");
+    return output;
   }
 
  private:
   BrotliDecoderState* decoder_;
 };
 
-}  // namespace
-
-absl::StatusOr<std::string> BrotliCompressionGroupConcatenator::Build() const {
-  std::vector<std::string> compression_groups;
-  // Go through every partition to compress them one by one.
-  for (const auto& partition : Partitions()) {
-    if (auto maybe_partition_output = CompressOnePartition(partition);
-        !maybe_partition_output.ok()) {
-      return maybe_partition_output.status();
-    } else {
-      compression_groups.push_back(std::move(maybe_partition_output).value());
+// Reads one compression group from `data_reader` and decompresses it into
+// `output`, failing past `max_size` bytes. The group is expected to decompress
+// to `size_hint` bytes if it has one, but the hint comes from the peer, so it
+// only sizes the reservation within `max_size` and kMaxReservedRatio. If
+// `dictionaries` is not null, the group starts with the ID of the dictionary
+// it was compressed with.
+template <typename String>
+absl::StatusOr<String> DecodeCompressionGroup(
+    quiche::QuicheDataReader& data_reader,
+    const BrotliSharedDictionaries* dictionaries, String output,
+    std::optional<uint32_t> size_hint, size_t max_size) {
+  const BrotliSharedDictionary* dictionary = nullptr;
+  if (dictionaries != nullptr) {
+    uint32_t dictionary_id = 0;
+    if (!data_reader.ReadUInt32(&dictionary_id)) {
+      return absl::InvalidArgumentError("Failed to read dictionary ID");
+    }
+    const auto it = dictionaries->find(dictionary_id);
+    if (it == dictionaries->end()) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Unknown Brotli dictionary: ", dictionary_id));
     }
+    dictionary = it->second.get();
   }
-  return absl::StrJoin(compression_groups, "");
-}
 
-absl::StatusOr<std::string>
-BrotliCompressionBlobReader::ExtractOneCompressionGroup() {
   uint32_t compression_group_size = 0;
-  if (!data_reader_.ReadUInt32(&compression_group_size)) {
+  if (!data_reader.ReadUInt32(&compression_group_size)) {
     return absl::InvalidArgumentError("Failed to read compression group size");
   }
   VLOG(9) << "compression_group_size: " << compression_group_size;
   std::string_view compressed_data;
-  if (!data_reader_.ReadStringPiece(&compressed_data, compression_group_size)) {
+  if (!data_reader.ReadStringPiece(&compressed_data, compression_group_size)) {
     return absl::InvalidArgumentError("Failed to read compression group");
   }
 
   quiche::QuicheDataReader compression_group_buffer_reader(compressed_data);
 
-  if (auto maybe_brotli_decoder = BrotliDecoder::Create();
+  if (auto maybe_brotli_decoder = BrotliDecoder::Create(dictionary);
       !maybe_brotli_decoder.ok()) {
     return maybe_brotli_decoder.status();
   } else {
+    if (size_hint.has_value()) {
+      output.reserve(std::min({static_cast<size_t>(*size_hint), max_size,
+                               kMaxReservedRatio * compressed_data.size()}));
+    }
     return maybe_brotli_decoder.value()->Decode(
-        compression_group_buffer_reader);
+        compression_group_buffer_reader, std::move(output), max_size);
+  }
+}
+
+}  // namespace
+
+absl::StatusOr<std::shared_ptr<const BrotliSharedDictionary>>
+BrotliSharedDictionary::Create(uint32_t id, std::string data) {
+  if (data.empty()) {
+    return absl::InvalidArgumentError("Brotli dictionary is empty");
+  }
+  if (id == kCompressionGroupReference || id == kCompressionGroupSizeHint) {
+    return absl::InvalidArgumentError(
+        "Brotli dictionary ID is reserved for the compression group framing");
+  }
+  std::shared_ptr<BrotliSharedDictionary> dictionary(
+      new BrotliSharedDictionary(id, std::move(data)));
+  dictionary->prepared_ = BrotliEncoderPrepareDictionary(
+      BROTLI_SHARED_DICTIONARY_RAW, dictionary->data_.size(),
+      reinterpret_cast<const uint8_t*>(dictionary->data_.data()),
+      BROTLI_DEFAULT_QUALITY, /* alloc_func= */ nullptr,
+      /* free_func= */ nullptr, /* opaque= */ nullptr);
+  if (!dictionary->prepared_) {
+    return absl::InternalError("Brotli dictionary cannot be prepared");
+  }
+  return dictionary;
+}
+
+BrotliSharedDictionary::~BrotliSharedDictionary() {
+  if (prepared_) {
+    BrotliEncoderDestroyPreparedDictionary(prepared_);
+  }
+}
+
+absl::StatusOr<std::string> BrotliCompressionGroupConcatenator::Build() const {
+  absl::StatusOr<std::vector<std::string>> compression_groups =
+      BuildCompressionGroups();
+  if (!compression_groups.ok()) {
+    return compression_groups.status();
+  }
+  return absl::StrJoin(*compression_groups, "");
+}
+
+absl::StatusOr<std::string>
+BrotliCompressionGroupConcatenator::BuildCompressionGroup(
+    std::string_view partition) const {
+  return dictionary_ ? CompressOnePartition(partition, *dictionary_)
+                     : CompressOnePartition(partition);
+}
+
+std::string BrotliCompressionGroupConcatenator::CacheKey() const {
+  // Groups compressed against different dictionaries differ, and so do their
+  // framings.
+  return dictionary_ ? absl::StrCat("brotli/q", BROTLI_DEFAULT_QUALITY, "/d",
+                                    dictionary_->id())
+                     : absl::StrCat("brotli/q", BROTLI_DEFAULT_QUALITY);
+}
+
+absl::StatusOr<std::string>
+BrotliCompressionBlobReader::DecompressOneCompressionGroup() {
+  return DecodeCompressionGroup(data_reader_, dictionaries_, std::string(),
+                                size_hint(), max_decompressed_size());
+}
+
+absl::StatusOr<std::pmr::string>
+BrotliCompressionBlobReader::DecompressOneCompressionGroup(
+    std::pmr::memory_resource* resource) {
+  return DecodeCompressionGroup(data_reader_, dictionaries_,
+                                std::pmr::string(resource), size_hint(),
+                                max_decompressed_size());
+}
+
+absl::StatusOr<std::string_view>
+BrotliCompressionBlobReader::SkipOneCompressionGroup() {
+  if (dictionaries_ == nullptr) {
+    return CompressedBlobReader::SkipOneCompressionGroup();
+  }
+  // Skips the dictionary ID in front of the group.
+  const std::string_view remaining = data_reader_.PeekRemainingPayload();
+  if (!data_reader_.Seek(sizeof(uint32_t))) {
+    return absl::InvalidArgumentError("Failed to read dictionary ID");
+  }
+  absl::StatusOr<std::string_view> compression_group =
+      CompressedBlobReader::SkipOneCompressionGroup();
+  if (!compression_group.ok()) {
+    return compression_group.status();
+  }
+  return remaining.substr(0, sizeof(uint32_t) + compression_group->size());
+}
+
+absl::StatusOr<std::unique_ptr<BrotliCompressionGroupWriter>>
+BrotliCompressionGroupWriter::Create() {
+  BrotliEncoderState* encoder =
+      BrotliEncoderCreateInstance(/* alloc_func= */ nullptr,
+                                  /* free_func= */ nullptr,
+                                  /* opaque= */ nullptr);
+  if (!encoder) {
+    return absl::InternalError("Brotli encoder cannot be initialized");
+  }
+  return std::make_unique<BrotliCompressionGroupWriter>(encoder);
+}
+
+BrotliCompressionGroupWriter::BrotliCompressionGroupWriter(
+    BrotliEncoderState* encoder)
+    : encoder_(encoder),
+      input_(kWriterInputBufferSize, '\0'),
+      output_(sizeof(uint32_t), '\0') {}
+
+BrotliCompressionGroupWriter::~BrotliCompressionGroupWriter() {
+  BrotliEncoderDestroyInstance(encoder_);
+}
+
+bool BrotliCompressionGroupWriter::Next(void** data, int* size) {
+  if (failed_ || finished_) {
+    return false;
+  }
+  if (input_size_ == input_.size() && !Compress(BROTLI_OPERATION_PROCESS)) {
+    return false;
+  }
+  *data = input_.data() + input_size_;
+  *size = input_.size() - input_size_;
+  byte_count_ += *size;
+  input_size_ = input_.size();
+  return true;
+}
+
+void BrotliCompressionGroupWriter::BackUp(int count) {
+  input_size_ -= count;
+  byte_count_ -= count;
+}
+
+bool BrotliCompressionGroupWriter::Compress(BrotliEncoderOperation operation) {
+  const uint8_t* next_in = reinterpret_cast<const uint8_t*>(input_.data());
+  size_t available_in = input_size_;
+  while (true) {
+    size_t available_out = 0;
+    if (!BrotliEncoderCompressStream(encoder_, operation, &available_in,
+                                     &next_in, &available_out, nullptr,
+                                     nullptr)) {
+      failed_ = true;
+      return false;
+    }
+    while (BrotliEncoderHasMoreOutput(encoder_)) {
+      size_t data_size = 0;
+      const uint8_t* data = BrotliEncoderTakeOutput(encoder_, &data_size);
+      output_.append(reinterpret_cast<const char*>(data), data_size);
+    }
+    if (operation == BROTLI_OPERATION_FINISH
+            ? BrotliEncoderIsFinished(encoder_)
+            : available_in == 0) {
+      break;
+    }
+  }
+  input_size_ = 0;
+  return true;
+}
+
+absl::StatusOr<std::string> BrotliCompressionGroupWriter::Finish() {
+  if (finished_) {
+    return absl::FailedPreconditionError("Finish() was already called");
+  }
+  finished_ = true;
+  if (failed_ || !Compress(BROTLI_OPERATION_FINISH)) {
+    return absl::InternalError("Brotli failed to compress");
   }
+  quiche::QuicheDataWriter data_writer(sizeof(uint32_t), output_.data());
+  data_writer.WriteUInt32(output_.size() - sizeof(uint32_t));
+  VLOG(5) << "compression group output size: " << output_.size();
+  return std::move(output_);
 }
 
 }  // namespace privacy_sandbox::server_common
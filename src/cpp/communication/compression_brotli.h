@@ -12,16 +12,83 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <utility>
 
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/statusor.h"
+#include "brotli/encode.h"
+#include "google/protobuf/io/zero_copy_stream.h"
 #include "src/cpp/communication/compression.h"
 
 namespace privacy_sandbox::server_common {
 
+// A custom dictionary that the compressing and the decompressing side agree on
+// out of band, e.g. one trained on sample payloads with
+// brotli_dictionary_trainer. Small compression groups that repeat the same
+// JSON keys compress much better against it than against Brotli's built-in
+// dictionary.
+//
+// Preparing the dictionary for the encoder is expensive, so a dictionary should
+// be created once and shared by all requests. Thread-safe.
+class BrotliSharedDictionary {
+ public:
+  // `id` identifies the dictionary in every compression group compressed with
+  // it, and must not be kCompressionGroupReference or
+  // kCompressionGroupSizeHint. `data` is the raw dictionary content.
+  static absl::StatusOr<std::shared_ptr<const BrotliSharedDictionary>> Create(
+      uint32_t id, std::string data);
+
+  ~BrotliSharedDictionary();
+
+  BrotliSharedDictionary(const BrotliSharedDictionary&) = delete;
+  BrotliSharedDictionary& operator=(const BrotliSharedDictionary&) = delete;
+
+  uint32_t id() const { return id_; }
+  std::string_view data() const { return data_; }
+  const BrotliEncoderPreparedDictionary* prepared() const { return prepared_; }
+
+ private:
+  BrotliSharedDictionary(uint32_t id, std::string data)
+      : id_(id), data_(std::move(data)) {}
+
+  const uint32_t id_;
+  const std::string data_;
+  // Refers to `data_`.
+  BrotliEncoderPreparedDictionary* prepared_ = nullptr;
+};
+
+// Dictionaries a reader can select from, by ID.
+using BrotliSharedDictionaries =
+    absl::flat_hash_map<uint32_t,
+                        std::shared_ptr<const BrotliSharedDictionary>>;
+
 // Builds compression groups that are compressed by Brotli.
+//
+// With a shared dictionary, every compression group is prefixed with the
+// 4-byte ID of the dictionary, ahead of its size. Such outputs are sent with
+// CompressionType::kBrotliSharedDictionary and can only be read by a
+// BrotliCompressionBlobReader that knows the dictionary.
 class BrotliCompressionGroupConcatenator : public CompressionGroupConcatenator {
  public:
+  BrotliCompressionGroupConcatenator() = default;
+  explicit BrotliCompressionGroupConcatenator(
+      std::shared_ptr<const BrotliSharedDictionary> dictionary)
+      : dictionary_(std::move(dictionary)) {}
+
   absl::StatusOr<std::string> Build() const override;
+
+ protected:
+  absl::StatusOr<std::string> BuildCompressionGroup(
+      std::string_view partition) const override;
+  std::string CacheKey() const override;
+
+ private:
+  std::shared_ptr<const BrotliSharedDictionary> dictionary_;
 };
 
 // Reads compression groups built with BrotliCompressionGroupConcatenator.
@@ -30,7 +97,67 @@ class BrotliCompressionBlobReader : public CompressedBlobReader {
   explicit BrotliCompressionBlobReader(std::string_view compressed)
       : CompressedBlobReader(compressed) {}
 
-  absl::StatusOr<std::string> ExtractOneCompressionGroup() override;
+  // Reads compression groups compressed with one of `dictionaries`, which
+  // must outlive the reader.
+  BrotliCompressionBlobReader(std::string_view compressed,
+                              const BrotliSharedDictionaries* dictionaries)
+      : CompressedBlobReader(compressed), dictionaries_(dictionaries) {}
+
+ protected:
+  absl::StatusOr<std::string> DecompressOneCompressionGroup() override;
+  absl::StatusOr<std::pmr::string> DecompressOneCompressionGroup(
+      std::pmr::memory_resource* resource) override;
+  absl::StatusOr<std::string_view> SkipOneCompressionGroup() override;
+  std::unique_ptr<CompressedBlobReader> CreateGroupReader(
+      std::string_view compression_group) const override {
+    return std::make_unique<BrotliCompressionBlobReader>(compression_group,
+                                                         dictionaries_);
+  }
+
+ private:
+  const BrotliSharedDictionaries* dictionaries_ = nullptr;
+};
+
+// Compresses one compression group while it is being written, e.g. by
+// ProtoToJson(), instead of compressing a fully materialized plaintext. Finish()
+// returns the group framed like BrotliCompressionGroupConcatenator does, so
+// outputs of several writers can be concatenated and read back with
+// BrotliCompressionBlobReader.
+//
+// Not thread-safe. Cannot be written to after Finish().
+class BrotliCompressionGroupWriter
+    : public google::protobuf::io::ZeroCopyOutputStream {
+ public:
+  static absl::StatusOr<std::unique_ptr<BrotliCompressionGroupWriter>>
+  Create();
+
+  // Owns the encoder memory.
+  explicit BrotliCompressionGroupWriter(BrotliEncoderState* encoder);
+  ~BrotliCompressionGroupWriter() override;
+
+  BrotliCompressionGroupWriter(const BrotliCompressionGroupWriter&) = delete;
+  BrotliCompressionGroupWriter& operator=(const BrotliCompressionGroupWriter&) =
+      delete;
+
+  bool Next(void** data, int* size) override;
+  void BackUp(int count) override;
+  int64_t ByteCount() const override { return byte_count_; }
+
+  // Compresses the remaining input and returns the compression group.
+  absl::StatusOr<std::string> Finish();
+
+ private:
+  // Feeds the buffered input to the encoder and collects its output.
+  bool Compress(BrotliEncoderOperation operation);
+
+  BrotliEncoderState* encoder_;
+  std::string input_;
+  size_t input_size_ = 0;
+  // Starts with room for the compression group size.
+  std::string output_;
+  int64_t byte_count_ = 0;
+  bool failed_ = false;
+  bool finished_ = false;
 };
 
 }  // namespace privacy_sandbox::server_common
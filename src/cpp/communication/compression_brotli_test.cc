@@ -14,17 +14,51 @@
 
 #include "src/cpp/communication/compression_brotli.h"
 
+#include <algorithm>
+#include <cstring>
+#include <memory_resource>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
 
+#include "absl/functional/any_invocable.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
 #include "glog/logging.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "src/cpp/communication/uncompressed.h"
+#include "src/cpp/concurrent/executor.h"
+#include "src/cpp/util/request_arena.h"
 
 namespace privacy_sandbox::server_common {
 namespace {
 
+// Records the largest allocation made through it.
+class MaxAllocationResource : public std::pmr::memory_resource {
+ public:
+  size_t max_allocation() const { return max_allocation_; }
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    max_allocation_ = std::max(max_allocation_, bytes);
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  size_t max_allocation_ = 0;
+};
+
 const std::string_view kTestString = "large message";
 const std::string_view kTestString2 = "large message 2";
 
@@ -91,5 +125,447 @@ TEST(CompressionGroupConcatenatorTest, Success) {
   EXPECT_TRUE(blob_reader.IsDoneReading());
 }
 
+// Writes `data` through the writer's buffers.
+void Write(std::string_view data, BrotliCompressionGroupWriter& writer) {
+  while (!data.empty()) {
+    void* buffer;
+    int size;
+    ASSERT_TRUE(writer.Next(&buffer, &size));
+    const int n = std::min<size_t>(size, data.size());
+    memcpy(buffer, data.data(), n);
+    writer.BackUp(size - n);
+    data.remove_prefix(n);
+  }
+}
+
+TEST(BrotliCompressionGroupWriterTest, ReadableByBlobReader) {
+  // Larger than the writer's input buffer, so it is compressed in several
+  // steps.
+  std::string large_message;
+  for (int i = 0; large_message.size() < 100'000; ++i) {
+    large_message.append(absl::StrCat("message ", i, ";"));
+  }
+
+  std::string blob;
+  for (std::string_view group : {kTestString, std::string_view(large_message)}) {
+    auto writer = BrotliCompressionGroupWriter::Create();
+    ASSERT_TRUE(writer.ok()) << writer.status();
+    Write(group, **writer);
+    EXPECT_EQ((*writer)->ByteCount(), group.size());
+    auto compression_group = (*writer)->Finish();
+    ASSERT_TRUE(compression_group.ok()) << compression_group.status();
+    blob.append(*compression_group);
+  }
+
+  BrotliCompressionBlobReader blob_reader(blob);
+  auto maybe_compression_group = blob_reader.ExtractOneCompressionGroup();
+  ASSERT_TRUE(maybe_compression_group.ok());
+  EXPECT_EQ(*maybe_compression_group, kTestString);
+  maybe_compression_group = blob_reader.ExtractOneCompressionGroup();
+  ASSERT_TRUE(maybe_compression_group.ok());
+  EXPECT_EQ(*maybe_compression_group, large_message);
+  EXPECT_TRUE(blob_reader.IsDoneReading());
+}
+
+TEST(BrotliCompressionGroupWriterTest, EmptyGroup) {
+  auto writer = BrotliCompressionGroupWriter::Create();
+  ASSERT_TRUE(writer.ok());
+  auto compression_group = (*writer)->Finish();
+  ASSERT_TRUE(compression_group.ok());
+
+  BrotliCompressionBlobReader blob_reader(*compression_group);
+  auto maybe_compression_group = blob_reader.ExtractOneCompressionGroup();
+  ASSERT_TRUE(maybe_compression_group.ok());
+  EXPECT_EQ(*maybe_compression_group, "");
+  EXPECT_TRUE(blob_reader.IsDoneReading());
+}
+
+TEST(BrotliCompressionGroupWriterTest, FinishTwiceFails) {
+  auto writer = BrotliCompressionGroupWriter::Create();
+  ASSERT_TRUE(writer.ok());
+  ASSERT_TRUE((*writer)->Finish().ok());
+  EXPECT_TRUE(absl::IsFailedPrecondition((*writer)->Finish().status()));
+  void* buffer;
+  int size;
+  EXPECT_FALSE((*writer)->Next(&buffer, &size));
+}
+
+TEST(CompressionBlobReaderTest, ExtractsIntoArena) {
+  BrotliCompressionGroupConcatenator concatenator;
+  concatenator.AddCompressionGroup(std::string(kTestString));
+  concatenator.AddCompressionGroup(std::string(kTestString2));
+  absl::StatusOr<std::string> maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok());
+
+  BrotliCompressionBlobReader blob_reader(*maybe_output);
+  RequestArena arena;
+  for (const auto& test_string : {kTestString, kTestString2}) {
+    absl::StatusOr<std::pmr::string> maybe_compression_group =
+        blob_reader.ExtractOneCompressionGroup(&arena);
+    ASSERT_TRUE(maybe_compression_group.ok());
+    EXPECT_EQ(std::string_view(*maybe_compression_group), test_string);
+    EXPECT_EQ(maybe_compression_group->get_allocator().resource(), &arena);
+  }
+  EXPECT_TRUE(blob_reader.IsDoneReading());
+}
+
+constexpr uint32_t kDictionaryId = 7;
+
+std::string JsonGroup(int id) {
+  return absl::StrCat(R"({"partitions":[{"id":)", id,
+                      R"(,"compressionGroupId":0,"keyGroupOutputs":)"
+                      R"([{"tags":["custom","keys"],"keyValues":{}}]}]})");
+}
+
+TEST(BrotliSharedDictionaryTest, RoundTrip) {
+  auto dictionary = BrotliSharedDictionary::Create(kDictionaryId, JsonGroup(0));
+  ASSERT_TRUE(dictionary.ok()) << dictionary.status();
+
+  BrotliCompressionGroupConcatenator concatenator(*dictionary);
+  concatenator.AddCompressionGroup(JsonGroup(1));
+  concatenator.AddCompressionGroup(JsonGroup(2));
+  absl::StatusOr<std::string> maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok()) << maybe_output.status();
+
+  const BrotliSharedDictionaries dictionaries = {{kDictionaryId, *dictionary}};
+  BrotliCompressionBlobReader blob_reader(*maybe_output, &dictionaries);
+  for (int id : {1, 2}) {
+    auto maybe_compression_group = blob_reader.ExtractOneCompressionGroup();
+    ASSERT_TRUE(maybe_compression_group.ok())
+        << maybe_compression_group.status();
+    EXPECT_EQ(*maybe_compression_group, JsonGroup(id));
+  }
+  EXPECT_TRUE(blob_reader.IsDoneReading());
+}
+
+TEST(BrotliSharedDictionaryTest, SmallerThanWithoutDictionary) {
+  auto dictionary = BrotliSharedDictionary::Create(kDictionaryId, JsonGroup(0));
+  ASSERT_TRUE(dictionary.ok()) << dictionary.status();
+
+  BrotliCompressionGroupConcatenator with_dictionary(*dictionary);
+  with_dictionary.AddCompressionGroup(JsonGroup(1));
+  BrotliCompressionGroupConcatenator without_dictionary;
+  without_dictionary.AddCompressionGroup(JsonGroup(1));
+  absl::StatusOr<std::string> small = with_dictionary.Build();
+  absl::StatusOr<std::string> large = without_dictionary.Build();
+  ASSERT_TRUE(small.ok());
+  ASSERT_TRUE(large.ok());
+  EXPECT_LT(small->size(), large->size());
+}
+
+TEST(BrotliSharedDictionaryTest, UnknownDictionaryFails) {
+  auto dictionary = BrotliSharedDictionary::Create(kDictionaryId, JsonGroup(0));
+  ASSERT_TRUE(dictionary.ok()) << dictionary.status();
+  BrotliCompressionGroupConcatenator concatenator(*dictionary);
+  concatenator.AddCompressionGroup(JsonGroup(1));
+  absl::StatusOr<std::string> maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok());
+
+  const BrotliSharedDictionaries dictionaries;
+  BrotliCompressionBlobReader blob_reader(*maybe_output, &dictionaries);
+  EXPECT_TRUE(absl::IsInvalidArgument(
+      blob_reader.ExtractOneCompressionGroup().status()));
+}
+
+TEST(BrotliSharedDictionaryTest, EmptyDictionaryFails) {
+  EXPECT_TRUE(absl::IsInvalidArgument(
+      BrotliSharedDictionary::Create(kDictionaryId, "").status()));
+}
+
+// Runs every closure on a thread of its own, joined on destruction.
+class ThreadPerTaskExecutor : public Executor {
+ public:
+  ~ThreadPerTaskExecutor() override {
+    for (std::thread& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  void Run(absl::AnyInvocable<void()> closure) override {
+    threads_.emplace_back(std::move(closure));
+  }
+  TaskId RunAfter(absl::Duration duration,
+                  absl::AnyInvocable<void()> closure) override {
+    ADD_FAILURE() << "Unexpected RunAfter()";
+    return {};
+  }
+  bool Cancel(TaskId task_id) override { return false; }
+
+ private:
+  std::vector<std::thread> threads_;
+};
+
+TEST(CompressionBlobReaderTest, ExtractAllReturnsGroupsInOrder) {
+  BrotliCompressionGroupConcatenator concatenator;
+  for (int i = 0; i < 8; ++i) {
+    concatenator.AddCompressionGroup(JsonGroup(i));
+  }
+  absl::StatusOr<std::string> maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok());
+
+  ThreadPerTaskExecutor executor;
+  BrotliCompressionBlobReader blob_reader(*maybe_output);
+  auto compression_groups = blob_reader.ExtractAll(executor);
+  ASSERT_TRUE(compression_groups.ok()) << compression_groups.status();
+  ASSERT_EQ(compression_groups->size(), 8);
+  for (int i = 0; i < 8; ++i) {
+    ASSERT_TRUE((*compression_groups)[i].ok());
+    EXPECT_EQ(*(*compression_groups)[i], JsonGroup(i));
+  }
+  EXPECT_TRUE(blob_reader.IsDoneReading());
+}
+
+TEST(CompressionBlobReaderTest, ExtractAllReportsErrorsPerGroup) {
+  BrotliCompressionGroupConcatenator concatenator;
+  concatenator.AddCompressionGroup(JsonGroup(0));
+  absl::StatusOr<std::string> valid_group = concatenator.Build();
+  ASSERT_TRUE(valid_group.ok());
+  // Framed correctly, but not Brotli.
+  UncompressedConcatenator corrupted_group;
+  corrupted_group.AddCompressionGroup("not brotli");
+  absl::StatusOr<std::string> invalid_group = corrupted_group.Build();
+  ASSERT_TRUE(invalid_group.ok());
+
+  const std::string blob =
+      absl::StrCat(*valid_group, *invalid_group, *valid_group);
+  ThreadPerTaskExecutor executor;
+  BrotliCompressionBlobReader blob_reader(blob);
+  auto compression_groups = blob_reader.ExtractAll(executor);
+  ASSERT_TRUE(compression_groups.ok()) << compression_groups.status();
+  ASSERT_EQ(compression_groups->size(), 3);
+  EXPECT_TRUE((*compression_groups)[0].ok());
+  EXPECT_FALSE((*compression_groups)[1].ok());
+  EXPECT_TRUE((*compression_groups)[2].ok());
+}
+
+TEST(CompressionBlobReaderTest, ExtractAllFailsOnMalformedFraming) {
+  BrotliCompressionGroupConcatenator concatenator;
+  concatenator.AddCompressionGroup(JsonGroup(0));
+  concatenator.AddCompressionGroup(JsonGroup(1));
+  absl::StatusOr<std::string> maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok());
+  maybe_output->pop_back();
+
+  ThreadPerTaskExecutor executor;
+  BrotliCompressionBlobReader blob_reader(*maybe_output);
+  EXPECT_TRUE(
+      absl::IsInvalidArgument(blob_reader.ExtractAll(executor).status()));
+}
+
+TEST(CompressionBlobReaderTest, ExtractAllWithDictionary) {
+  auto dictionary = BrotliSharedDictionary::Create(kDictionaryId, JsonGroup(0));
+  ASSERT_TRUE(dictionary.ok()) << dictionary.status();
+  BrotliCompressionGroupConcatenator concatenator(*dictionary);
+  concatenator.AddCompressionGroup(JsonGroup(1));
+  concatenator.AddCompressionGroup(JsonGroup(2));
+  absl::StatusOr<std::string> maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok());
+
+  ThreadPerTaskExecutor executor;
+  const BrotliSharedDictionaries dictionaries = {{kDictionaryId, *dictionary}};
+  BrotliCompressionBlobReader blob_reader(*maybe_output, &dictionaries);
+  auto compression_groups = blob_reader.ExtractAll(executor);
+  ASSERT_TRUE(compression_groups.ok()) << compression_groups.status();
+  ASSERT_EQ(compression_groups->size(), 2);
+  EXPECT_EQ((*compression_groups)[0].value(), JsonGroup(1));
+  EXPECT_EQ((*compression_groups)[1].value(), JsonGroup(2));
+}
+
+TEST(CompressionBlobReaderTest, ExtractCompressionGroupFromIndex) {
+  auto dictionary = BrotliSharedDictionary::Create(kDictionaryId, JsonGroup(0));
+  ASSERT_TRUE(dictionary.ok()) << dictionary.status();
+  BrotliCompressionGroupConcatenator concatenator(*dictionary);
+  for (int i = 0; i < 4; ++i) {
+    concatenator.AddCompressionGroup(JsonGroup(i));
+  }
+  absl::StatusOr<std::string> indexed_blob = concatenator.BuildIndexed();
+  ASSERT_TRUE(indexed_blob.ok()) << indexed_blob.status();
+  absl::StatusOr<CompressionGroupIndex> index =
+      CompressionGroupIndex::Parse(*indexed_blob);
+  ASSERT_TRUE(index.ok()) << index.status();
+
+  const BrotliSharedDictionaries dictionaries = {{kDictionaryId, *dictionary}};
+  BrotliCompressionBlobReader blob_reader(index->compression_groups(),
+                                          &dictionaries);
+  for (int i : {3, 1}) {
+    absl::StatusOr<std::string> compression_group =
+        blob_reader.ExtractCompressionGroup(*index, i);
+    ASSERT_TRUE(compression_group.ok()) << compression_group.status();
+    EXPECT_EQ(*compression_group, JsonGroup(i));
+  }
+}
+
+TEST(CompressionBlobReaderTest, ExtractAllCopiesReferencedGroups) {
+  BrotliCompressionGroupConcatenator concatenator;
+  concatenator.set_deduplicate(true);
+  for (int i : {0, 1, 0, 1, 0}) {
+    concatenator.AddCompressionGroup(JsonGroup(i));
+  }
+  absl::StatusOr<std::string> maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok());
+
+  // The first group is read on its own, the others all at once.
+  ThreadPerTaskExecutor executor;
+  BrotliCompressionBlobReader blob_reader(*maybe_output);
+  EXPECT_EQ(*blob_reader.ExtractOneCompressionGroup(), JsonGroup(0));
+  auto compression_groups = blob_reader.ExtractAll(executor);
+  ASSERT_TRUE(compression_groups.ok()) << compression_groups.status();
+  ASSERT_EQ(compression_groups->size(), 4);
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_TRUE((*compression_groups)[i].ok())
+        << (*compression_groups)[i].status();
+    EXPECT_EQ(*(*compression_groups)[i], JsonGroup((i + 1) % 2));
+  }
+}
+
+TEST(BrotliSharedDictionaryTest, DeduplicatesWithDictionary) {
+  auto dictionary = BrotliSharedDictionary::Create(kDictionaryId, JsonGroup(0));
+  ASSERT_TRUE(dictionary.ok()) << dictionary.status();
+  BrotliCompressionGroupConcatenator concatenator(*dictionary);
+  concatenator.set_deduplicate(true);
+  concatenator.AddCompressionGroup(JsonGroup(1));
+  concatenator.AddCompressionGroup(JsonGroup(1));
+  absl::StatusOr<std::string> maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok());
+
+  const BrotliSharedDictionaries dictionaries = {{kDictionaryId, *dictionary}};
+  BrotliCompressionBlobReader blob_reader(*maybe_output, &dictionaries);
+  EXPECT_EQ(*blob_reader.ExtractOneCompressionGroup(), JsonGroup(1));
+  EXPECT_EQ(*blob_reader.ExtractOneCompressionGroup(), JsonGroup(1));
+  EXPECT_TRUE(blob_reader.IsDoneReading());
+}
+
+TEST(BrotliSharedDictionaryTest, ReservedIdFails) {
+  EXPECT_TRUE(absl::IsInvalidArgument(
+      BrotliSharedDictionary::Create(kCompressionGroupReference, JsonGroup(0))
+          .status()));
+}
+
+TEST(CompressionBlobReaderTest, StopsAtGroupLimit) {
+  // Compresses to a few bytes.
+  BrotliCompressionGroupConcatenator concatenator;
+  concatenator.AddCompressionGroup(std::string(16 << 20, 'a'));
+  absl::StatusOr<std::string> maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok());
+
+  DecompressionLimits limits;
+  limits.max_compression_group_size = 1 << 20;
+  BrotliCompressionBlobReader blob_reader(*maybe_output);
+  blob_reader.set_decompression_limits(limits);
+  EXPECT_TRUE(absl::IsResourceExhausted(
+      blob_reader.ExtractOneCompressionGroup().status()));
+}
+
+TEST(CompressionBlobReaderTest, StopsAtBlobLimit) {
+  BrotliCompressionGroupConcatenator concatenator;
+  concatenator.set_deduplicate(true);
+  for (int i : {0, 1, 0}) {
+    concatenator.AddCompressionGroup(JsonGroup(i));
+  }
+  absl::StatusOr<std::string> maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok());
+
+  // Room for two groups, but not for the repeat of the first one.
+  DecompressionLimits limits;
+  limits.max_blob_size = JsonGroup(0).size() + JsonGroup(1).size();
+  BrotliCompressionBlobReader blob_reader(*maybe_output);
+  blob_reader.set_decompression_limits(limits);
+  EXPECT_TRUE(blob_reader.ExtractOneCompressionGroup().ok());
+  EXPECT_TRUE(blob_reader.ExtractOneCompressionGroup().ok());
+  EXPECT_TRUE(absl::IsResourceExhausted(
+      blob_reader.ExtractOneCompressionGroup().status()));
+}
+
+TEST(CompressionBlobReaderTest, RejectsOversizedHintUpFront) {
+  BrotliCompressionGroupConcatenator concatenator;
+  concatenator.set_size_hints(true);
+  concatenator.AddCompressionGroup(JsonGroup(0));
+  concatenator.AddCompressionGroup(JsonGroup(1));
+  absl::StatusOr<std::string> maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok());
+
+  DecompressionLimits limits;
+  limits.max_blob_size = JsonGroup(0).size();
+  ThreadPerTaskExecutor executor;
+  BrotliCompressionBlobReader blob_reader(*maybe_output);
+  blob_reader.set_decompression_limits(limits);
+  EXPECT_TRUE(
+      absl::IsResourceExhausted(blob_reader.ExtractAll(executor).status()));
+}
+
+TEST(CompressionBlobReaderTest, DistrustsSizeHint) {
+  BrotliCompressionGroupConcatenator concatenator;
+  concatenator.set_size_hints(true);
+  concatenator.AddCompressionGroup(JsonGroup(0));
+  absl::StatusOr<std::string> maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok());
+  // Claims almost 4 GiB for a group of a few hundred bytes.
+  maybe_output->replace(4, 4, "\xff\xff\xff\xf0");
+
+  MaxAllocationResource resource;
+  BrotliCompressionBlobReader blob_reader(*maybe_output);
+  EXPECT_TRUE(absl::IsDataLoss(
+      blob_reader.ExtractOneCompressionGroup(&resource).status()));
+  EXPECT_LT(resource.max_allocation(), 1 << 20);
+}
+
+TEST(CompressionBlobReaderTest, ExtractAllSplitsBlobLimit) {
+  // Compresses to a few bytes per group.
+  BrotliCompressionGroupConcatenator concatenator;
+  for (int i = 0; i < 4; ++i) {
+    concatenator.AddCompressionGroup(std::string(1 << 20, 'a'));
+  }
+  absl::StatusOr<std::string> maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok());
+
+  // Every group alone fits, but each only gets a quarter of the limit.
+  DecompressionLimits limits;
+  limits.max_blob_size = 2 << 20;
+  ThreadPerTaskExecutor executor;
+  BrotliCompressionBlobReader blob_reader(*maybe_output);
+  blob_reader.set_decompression_limits(limits);
+  auto compression_groups = blob_reader.ExtractAll(executor);
+  ASSERT_TRUE(compression_groups.ok()) << compression_groups.status();
+  ASSERT_EQ(compression_groups->size(), 4);
+  for (const absl::StatusOr<std::string>& group : *compression_groups) {
+    EXPECT_TRUE(absl::IsResourceExhausted(group.status())) << group.status();
+  }
+
+  limits.max_blob_size = 4 << 20;
+  BrotliCompressionBlobReader fitting_reader(*maybe_output);
+  fitting_reader.set_decompression_limits(limits);
+  compression_groups = fitting_reader.ExtractAll(executor);
+  ASSERT_TRUE(compression_groups.ok()) << compression_groups.status();
+  for (const absl::StatusOr<std::string>& group : *compression_groups) {
+    ASSERT_TRUE(group.ok()) << group.status();
+    EXPECT_EQ(group->size(), 1 << 20);
+  }
+}
+
+TEST(CompressionBlobReaderTest, ExtractsWithSizeHints) {
+  auto dictionary = BrotliSharedDictionary::Create(kDictionaryId, JsonGroup(0));
+  ASSERT_TRUE(dictionary.ok()) << dictionary.status();
+  BrotliCompressionGroupConcatenator concatenator(*dictionary);
+  concatenator.set_size_hints(true);
+  for (int i = 0; i < 4; ++i) {
+    concatenator.AddCompressionGroup(JsonGroup(i));
+  }
+  absl::StatusOr<std::string> maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok());
+
+  const BrotliSharedDictionaries dictionaries = {{kDictionaryId, *dictionary}};
+  BrotliCompressionBlobReader blob_reader(*maybe_output, &dictionaries);
+  EXPECT_EQ(*blob_reader.ExtractOneCompressionGroup(), JsonGroup(0));
+  RequestArena arena;
+  EXPECT_EQ(std::string_view(*blob_reader.ExtractOneCompressionGroup(&arena)),
+            JsonGroup(1));
+  ThreadPerTaskExecutor executor;
+  auto compression_groups = blob_reader.ExtractAll(executor);
+  ASSERT_TRUE(compression_groups.ok()) << compression_groups.status();
+  ASSERT_EQ(compression_groups->size(), 2);
+  EXPECT_EQ((*compression_groups)[0].value(), JsonGroup(2));
+  EXPECT_EQ((*compression_groups)[1].value(), JsonGroup(3));
+}
+
 }  // namespace
 }  // namespace privacy_sandbox::server_common
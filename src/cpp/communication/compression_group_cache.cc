@@ -0,0 +1,118 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/cpp/communication/compression_group_cache.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "absl/hash/hash.h"
+#include "absl/synchronization/mutex.h"
+
+namespace privacy_sandbox::server_common {
+
+namespace {
+
+constexpr size_t kNumShards = 16;
+
+// Rough cost of the bookkeeping of an entry, so that many tiny groups cannot
+// outgrow the capacity.
+constexpr size_t kEntryOverhead = 128;
+
+}  // namespace
+
+size_t CompressionGroupCache::Entry::Size() const {
+  return codec.size() + plaintext.size() + compression_group->size() +
+         kEntryOverhead;
+}
+
+CompressionGroupCache::CompressionGroupCache(size_t capacity_bytes)
+    : shard_capacity_bytes_(capacity_bytes / kNumShards), shards_(kNumShards) {}
+
+size_t CompressionGroupCache::Hash(std::string_view codec,
+                                  std::string_view plaintext) {
+  return absl::Hash<std::pair<std::string_view, std::string_view>>()(
+      {codec, plaintext});
+}
+
+std::shared_ptr<const std::string> CompressionGroupCache::Lookup(
+    std::string_view codec, std::string_view plaintext) {
+  const size_t hash = Hash(codec, plaintext);
+  Shard& shard = GetShard(hash);
+  {
+    absl::MutexLock lock(&shard.mutex);
+    if (const auto it = shard.index.find(hash); it != shard.index.end()) {
+      const Entry& entry = *it->second;
+      if (entry.codec == codec && entry.plaintext == plaintext) {
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return entry.compression_group;
+      }
+    }
+  }
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  return nullptr;
+}
+
+void CompressionGroupCache::Insert(std::string_view codec,
+                                   std::string_view plaintext,
+                                   std::string compression_group) {
+  const size_t hash = Hash(codec, plaintext);
+  Entry entry{
+      hash, std::string(codec), std::string(plaintext),
+      std::make_shared<const std::string>(std::move(compression_group))};
+  const size_t entry_size = entry.Size();
+  if (entry_size > shard_capacity_bytes_) {
+    return;
+  }
+
+  Shard& shard = GetShard(hash);
+  int64_t num_evicted = 0;
+  {
+    absl::MutexLock lock(&shard.mutex);
+    // Replaces the entry with the same hash, be it the same key inserted
+    // concurrently or a collision.
+    if (const auto it = shard.index.find(hash); it != shard.index.end()) {
+      shard.size -= it->second->Size();
+      shard.entries.erase(it->second);
+      shard.index.erase(it);
+    }
+    while (!shard.entries.empty() &&
+           shard.size + entry_size > shard_capacity_bytes_) {
+      const Entry& evicted = shard.entries.back();
+      shard.size -= evicted.Size();
+      shard.index.erase(evicted.hash);
+      shard.entries.pop_back();
+      ++num_evicted;
+    }
+    shard.entries.push_front(std::move(entry));
+    shard.index[hash] = shard.entries.begin();
+    shard.size += entry_size;
+  }
+  insertions_.fetch_add(1, std::memory_order_relaxed);
+  evictions_.fetch_add(num_evicted, std::memory_order_relaxed);
+}
+
+CompressionGroupCache::Stats CompressionGroupCache::stats() const {
+  Stats stats;
+  stats.hits = hits_.load(std::memory_order_relaxed);
+  stats.misses = misses_.load(std::memory_order_relaxed);
+  stats.insertions = insertions_.load(std::memory_order_relaxed);
+  stats.evictions = evictions_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+}  // namespace privacy_sandbox::server_common
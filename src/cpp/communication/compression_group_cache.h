@@ -0,0 +1,106 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_CPP_COMMUNICATION_COMPRESSION_GROUP_CACHE_H_
+#define SRC_CPP_COMMUNICATION_COMPRESSION_GROUP_CACHE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+
+namespace privacy_sandbox::server_common {
+
+// Bounded cache of compressed and framed compression groups, keyed by the
+// codec with its parameters and by the plaintext. Responses often repeat the
+// same compression groups, which the cache spares compressing again. Set on a
+// CompressionGroupConcatenator with set_cache().
+//
+// Entries are looked up by a hash and checked against the full key, so a hash
+// collision is a miss rather than a wrong group. The least recently used
+// entries are evicted once the plaintext and compressed bytes of all entries
+// exceed the capacity.
+//
+// Thread-safe. Meant to be shared by all requests.
+class CompressionGroupCache {
+ public:
+  struct Stats {
+    int64_t hits = 0;
+    int64_t misses = 0;
+    int64_t insertions = 0;
+    int64_t evictions = 0;
+  };
+
+  explicit CompressionGroupCache(size_t capacity_bytes);
+
+  CompressionGroupCache(const CompressionGroupCache&) = delete;
+  CompressionGroupCache& operator=(const CompressionGroupCache&) = delete;
+
+  // Returns the compression group of `plaintext` compressed by `codec`, or
+  // null if it is not cached.
+  std::shared_ptr<const std::string> Lookup(std::string_view codec,
+                                            std::string_view plaintext);
+
+  // Caches `compression_group` as the output of `codec` for `plaintext`.
+  // Groups larger than a shard of the cache are not cached.
+  void Insert(std::string_view codec, std::string_view plaintext,
+              std::string compression_group);
+
+  // Counters since the creation of the cache, e.g. to export as metrics.
+  Stats stats() const;
+
+ private:
+  struct Entry {
+    size_t hash;
+    std::string codec;
+    std::string plaintext;
+    std::shared_ptr<const std::string> compression_group;
+
+    size_t Size() const;
+  };
+
+  // Entries are spread over shards with a lock and an LRU list each, so that
+  // concurrent requests rarely contend.
+  struct Shard {
+    absl::Mutex mutex;
+    // Most recently used first.
+    std::list<Entry> entries ABSL_GUARDED_BY(mutex);
+    absl::flat_hash_map<size_t, std::list<Entry>::iterator> index
+        ABSL_GUARDED_BY(mutex);
+    size_t size ABSL_GUARDED_BY(mutex) = 0;
+  };
+
+  static size_t Hash(std::string_view codec, std::string_view plaintext);
+  Shard& GetShard(size_t hash) { return shards_[hash % shards_.size()]; }
+
+  const size_t shard_capacity_bytes_;
+  std::vector<Shard> shards_;
+  std::atomic<int64_t> hits_ = 0;
+  std::atomic<int64_t> misses_ = 0;
+  std::atomic<int64_t> insertions_ = 0;
+  std::atomic<int64_t> evictions_ = 0;
+};
+
+}  // namespace privacy_sandbox::server_common
+
+#endif  // SRC_CPP_COMMUNICATION_COMPRESSION_GROUP_CACHE_H_
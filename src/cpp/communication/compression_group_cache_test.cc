@@ -0,0 +1,140 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/cpp/communication/compression_group_cache.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+#include "src/cpp/communication/compression_brotli.h"
+#include "src/cpp/communication/compression_gzip.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+TEST(CompressionGroupCacheTest, LookupReturnsInsertedGroup) {
+  CompressionGroupCache cache(1 << 20);
+  EXPECT_EQ(cache.Lookup("codec", "plaintext"), nullptr);
+  cache.Insert("codec", "plaintext", "compressed");
+  std::shared_ptr<const std::string> cached =
+      cache.Lookup("codec", "plaintext");
+  ASSERT_NE(cached, nullptr);
+  EXPECT_EQ(*cached, "compressed");
+
+  const CompressionGroupCache::Stats stats = cache.stats();
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 1);
+  EXPECT_EQ(stats.insertions, 1);
+  EXPECT_EQ(stats.evictions, 0);
+}
+
+TEST(CompressionGroupCacheTest, KeysIncludeCodec) {
+  CompressionGroupCache cache(1 << 20);
+  cache.Insert("codec", "plaintext", "compressed");
+  EXPECT_EQ(cache.Lookup("other codec", "plaintext"), nullptr);
+  EXPECT_EQ(cache.Lookup("codec", "other plaintext"), nullptr);
+}
+
+TEST(CompressionGroupCacheTest, EvictsLeastRecentlyUsed) {
+  // Small enough for a handful of entries per shard.
+  CompressionGroupCache cache(16 * 1024);
+  for (int i = 0; i < 1000; ++i) {
+    cache.Insert("codec", absl::StrCat("plaintext ", i), "compressed");
+  }
+  EXPECT_GT(cache.stats().evictions, 0);
+  EXPECT_EQ(cache.Lookup("codec", "plaintext 0"), nullptr);
+  EXPECT_NE(cache.Lookup("codec", "plaintext 999"), nullptr);
+}
+
+TEST(CompressionGroupCacheTest, SkipsGroupsLargerThanShard) {
+  CompressionGroupCache cache(16 * 1024);
+  cache.Insert("codec", std::string(64 * 1024, 'a'), "compressed");
+  EXPECT_EQ(cache.stats().insertions, 0);
+}
+
+TEST(CompressionGroupCacheTest, ConcurrentLookupsAndInserts) {
+  CompressionGroupCache cache(64 * 1024);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&cache] {
+      for (int i = 0; i < 1000; ++i) {
+        const std::string plaintext = absl::StrCat("plaintext ", i % 100);
+        if (auto cached = cache.Lookup("codec", plaintext)) {
+          EXPECT_EQ(*cached, absl::StrCat("compressed ", i % 100));
+        } else {
+          cache.Insert("codec", plaintext,
+                       absl::StrCat("compressed ", i % 100));
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  const CompressionGroupCache::Stats stats = cache.stats();
+  EXPECT_EQ(stats.hits + stats.misses, 8000);
+  EXPECT_GT(stats.hits, 0);
+}
+
+TEST(CompressionGroupCacheTest, BrotliBuildUsesCache) {
+  CompressionGroupCache cache(1 << 20);
+  const std::string group(1000, 'a');
+  std::string expected;
+  for (int i = 0; i < 2; ++i) {
+    BrotliCompressionGroupConcatenator concatenator;
+    concatenator.set_cache(&cache);
+    concatenator.AddCompressionGroup(group);
+    concatenator.AddCompressionGroup(group);
+    absl::StatusOr<std::string> output = concatenator.Build();
+    ASSERT_TRUE(output.ok());
+    if (i == 0) {
+      expected = *std::move(output);
+    } else {
+      EXPECT_EQ(*output, expected);
+    }
+  }
+  const CompressionGroupCache::Stats stats = cache.stats();
+  EXPECT_EQ(stats.misses, 1);
+  EXPECT_EQ(stats.hits, 3);
+
+  BrotliCompressionGroupConcatenator uncached;
+  uncached.AddCompressionGroup(group);
+  uncached.AddCompressionGroup(group);
+  EXPECT_EQ(*uncached.Build(), expected);
+}
+
+TEST(CompressionGroupCacheTest, CodecsDoNotShareEntries) {
+  CompressionGroupCache cache(1 << 20);
+  BrotliCompressionGroupConcatenator brotli;
+  brotli.set_cache(&cache);
+  brotli.AddCompressionGroup("group");
+  ASSERT_TRUE(brotli.Build().ok());
+
+  GzipCompressionGroupConcatenator gzip;
+  gzip.set_cache(&cache);
+  gzip.AddCompressionGroup("group");
+  absl::StatusOr<std::string> output = gzip.Build();
+  ASSERT_TRUE(output.ok());
+  EXPECT_EQ(cache.stats().hits, 0);
+
+  GzipCompressionBlobReader reader(*output);
+  EXPECT_EQ(*reader.ExtractOneCompressionGroup(), "group");
+}
+
+}  // namespace
+}  // namespace privacy_sandbox::server_common
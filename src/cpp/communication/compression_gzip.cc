@@ -14,13 +14,19 @@
 
 #include "src/cpp/communication/compression_gzip.h"
 
+#include <libdeflate.h>
 #include <zlib.h>
 
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
 #include "glog/logging.h"
@@ -30,6 +36,40 @@ namespace privacy_sandbox::server_common {
 
 namespace {
 
+// Same level as Z_DEFAULT_COMPRESSION.
+constexpr int kLibdeflateCompressionLevel = 6;
+// Deflate cannot compress by more than about 1032:1, so a gzip trailer that
+// claims more is not to be trusted with an allocation.
+constexpr size_t kMaxDeflateRatio = 1032;
+
+struct LibdeflateCompressorDeleter {
+  void operator()(libdeflate_compressor* compressor) const {
+    libdeflate_free_compressor(compressor);
+  }
+};
+
+struct LibdeflateDecompressorDeleter {
+  void operator()(libdeflate_decompressor* decompressor) const {
+    libdeflate_free_decompressor(decompressor);
+  }
+};
+
+// Allocating a compressor costs more than compressing a small group, so every
+// thread keeps one.
+libdeflate_compressor* GetLibdeflateCompressor() {
+  thread_local std::unique_ptr<libdeflate_compressor,
+                               LibdeflateCompressorDeleter>
+      compressor(libdeflate_alloc_compressor(kLibdeflateCompressionLevel));
+  return compressor.get();
+}
+
+libdeflate_decompressor* GetLibdeflateDecompressor() {
+  thread_local std::unique_ptr<libdeflate_decompressor,
+                               LibdeflateDecompressorDeleter>
+      decompressor(libdeflate_alloc_decompressor());
+  return decompressor.get();
+}
+
 // Responsible for compressing one compression group (see compression.h for the
 // compressed partition output format).
 absl::StatusOr<std::string> CompressOnePartition(absl::string_view partition) {
@@ -90,8 +130,56 @@ absl::StatusOr<std::string> CompressOnePartition(absl::string_view partition) {
   return std::string{partition_output_buffer, partition_final_size};
 }
 
-absl::StatusOr<std::string> DecompressString(
-    absl::string_view compressed_string) {
+// Same as above, but compresses the whole group at once with libdeflate.
+absl::StatusOr<std::string> CompressOnePartitionWithLibdeflate(
+    std::string_view partition) {
+  libdeflate_compressor* compressor = GetLibdeflateCompressor();
+  if (compressor == nullptr) {
+    return absl::InternalError("libdeflate compressor cannot be allocated");
+  }
+  const size_t bound =
+      libdeflate_gzip_compress_bound(compressor, partition.size());
+  std::string partition_output(sizeof(uint32_t) + bound, '\0');
+  const size_t compressed_size = libdeflate_gzip_compress(
+      compressor, partition.data(), partition.size(),
+      partition_output.data() + sizeof(uint32_t), bound);
+  if (compressed_size == 0) {
+    return absl::InternalError("libdeflate failed to compress");
+  }
+  partition_output.resize(sizeof(uint32_t) + compressed_size);
+  quiche::QuicheDataWriter data_writer(sizeof(uint32_t),
+                                       partition_output.data());
+  data_writer.WriteUInt32(compressed_size);
+  return partition_output;
+}
+
+// Fails if deflate cannot decompress `compressed_string` to `size_hint` bytes.
+// The hint comes from the peer, so this keeps it from sizing an allocation
+// beyond what the compressed data can expand to.
+absl::Status CheckSizeHint(absl::string_view compressed_string,
+                           std::optional<uint32_t> size_hint) {
+  if (size_hint.has_value() &&
+      *size_hint > kMaxDeflateRatio * compressed_string.size()) {
+    return absl::DataLossError(absl::StrFormat(
+        "Gzip compression group of %d bytes cannot decompress to its size "
+        "hint of %d bytes",
+        compressed_string.size(), *size_hint));
+  }
+  return absl::OkStatus();
+}
+
+// Appends the decompressed data to `decompressed_string`, which determines the
+// allocator of the output. Reserves `size_hint` bytes if it has one, and fails
+// once the output exceeds `max_size`.
+template <typename String>
+absl::StatusOr<String> DecompressString(absl::string_view compressed_string,
+                                        String decompressed_string,
+                                        std::optional<uint32_t> size_hint,
+                                        size_t max_size) {
+  if (absl::Status status = CheckSizeHint(compressed_string, size_hint);
+      !status.ok()) {
+    return status;
+  }
   z_stream zs;
   memset(&zs, 0, sizeof(zs));
   zs.next_in = (Bytef*)compressed_string.data();
@@ -105,8 +193,10 @@ absl::StatusOr<std::string> DecompressString(
                         inflate_init_status));
   }
 
+  if (size_hint.has_value()) {
+    decompressed_string.reserve(std::min<size_t>(*size_hint, max_size));
+  }
   char output_buffer[32768];  // 32 KiB chunks.
-  std::string decompressed_string;
 
   int inflate_status;
   do {
@@ -114,6 +204,12 @@ absl::StatusOr<std::string> DecompressString(
     zs.avail_out = sizeof(output_buffer);
 
     inflate_status = inflate(&zs, Z_NO_FLUSH);
+    if (zs.total_out > max_size) {
+      inflateEnd(&zs);
+      return absl::ResourceExhaustedError(absl::StrFormat(
+          "Compression group exceeds the decompression limit of %d bytes",
+          max_size));
+    }
     // Copy the decompressed output from the buffer to our result string.
     if (decompressed_string.size() < zs.total_out) {
       decompressed_string.append(output_buffer,
@@ -138,36 +234,139 @@ absl::StatusOr<std::string> DecompressString(
   return decompressed_string;
 }
 
-}  // namespace
-
-absl::StatusOr<std::string> GzipCompressionGroupConcatenator::Build() const {
-  std::vector<std::string> compression_groups;
-  for (const auto& partition : Partitions()) {
-    if (auto maybe_partition_output = CompressOnePartition(partition);
-        !maybe_partition_output.ok()) {
-      return maybe_partition_output.status();
-    } else {
-      compression_groups.push_back(std::move(maybe_partition_output).value());
+// Same as above, but decompresses the whole group at once with libdeflate if
+// its size is known up front, from `size_hint` or from the gzip trailer.
+// `decompressed_string` must be empty.
+template <typename String>
+absl::StatusOr<String> DecompressStringWithLibdeflate(
+    absl::string_view compressed_string, String decompressed_string,
+    std::optional<uint32_t> size_hint, size_t max_size) {
+  if (absl::Status status = CheckSizeHint(compressed_string, size_hint);
+      !status.ok()) {
+    return status;
+  }
+  size_t size = 0;
+  if (size_hint.has_value()) {
+    size = *size_hint;
+  } else {
+    // The gzip trailer ends with the decompressed size modulo 2^32, in little
+    // endian.
+    if (compressed_string.size() < sizeof(uint32_t)) {
+      return absl::DataLossError("Gzip compression group is truncated");
     }
+    const auto* trailer = reinterpret_cast<const uint8_t*>(
+        compressed_string.data() + compressed_string.size() - sizeof(uint32_t));
+    size = trailer[0] | trailer[1] << 8 | trailer[2] << 16 |
+           static_cast<uint32_t>(trailer[3]) << 24;
+    if (size > kMaxDeflateRatio * compressed_string.size()) {
+      return DecompressString(compressed_string, std::move(decompressed_string),
+                              size_hint, max_size);
+    }
+  }
+  if (size > max_size) {
+    return absl::ResourceExhaustedError(absl::StrFormat(
+        "Compression group exceeds the decompression limit of %d bytes",
+        max_size));
+  }
+  libdeflate_decompressor* decompressor = GetLibdeflateDecompressor();
+  if (decompressor == nullptr) {
+    return absl::InternalError("libdeflate decompressor cannot be allocated");
   }
 
-  return absl::StrJoin(compression_groups, "");
+  decompressed_string.resize(size);
+  size_t decompressed_size = 0;
+  switch (libdeflate_gzip_decompress(
+      decompressor, compressed_string.data(), compressed_string.size(),
+      decompressed_string.data(), size, &decompressed_size)) {
+    case LIBDEFLATE_SUCCESS:
+      decompressed_string.resize(decompressed_size);
+      return decompressed_string;
+    case LIBDEFLATE_INSUFFICIENT_SPACE:
+      if (size_hint.has_value()) {
+        return absl::DataLossError(
+            "Gzip compression group exceeds its size hint");
+      }
+      // The group is larger than it claims, e.g. 4 GiB larger than the
+      // trailer says. zlib enforces `max_size` as it goes.
+      decompressed_string.clear();
+      return DecompressString(compressed_string, std::move(decompressed_string),
+                              size_hint, max_size);
+    default:
+      return absl::DataLossError("Exception during gzip decompression");
+  }
 }
 
-absl::StatusOr<std::string>
-GzipCompressionBlobReader::ExtractOneCompressionGroup() {
+absl::StatusOr<absl::string_view> ReadCompressionGroup(
+    quiche::QuicheDataReader& data_reader) {
   uint32_t compression_group_size = 0;
-  if (!data_reader_.ReadUInt32(&compression_group_size)) {
+  if (!data_reader.ReadUInt32(&compression_group_size)) {
     return absl::InvalidArgumentError("Failed to read compression group size.");
   }
   VLOG(9) << "compression_group_size: " << compression_group_size;
 
   absl::string_view compressed_data;
-  if (!data_reader_.ReadStringPiece(&compressed_data, compression_group_size)) {
+  if (!data_reader.ReadStringPiece(&compressed_data, compression_group_size)) {
     return absl::InvalidArgumentError("Failed to read compression group.");
   }
+  return compressed_data;
+}
+
+}  // namespace
+
+absl::StatusOr<std::string> GzipCompressionGroupConcatenator::Build() const {
+  absl::StatusOr<std::vector<std::string>> compression_groups =
+      BuildCompressionGroups();
+  if (!compression_groups.ok()) {
+    return compression_groups.status();
+  }
+  return absl::StrJoin(*compression_groups, "");
+}
+
+absl::StatusOr<std::string>
+GzipCompressionGroupConcatenator::BuildCompressionGroup(
+    std::string_view partition) const {
+  return backend_ == GzipBackend::kLibdeflate
+             ? CompressOnePartitionWithLibdeflate(partition)
+             : CompressOnePartition(partition);
+}
+
+std::string GzipCompressionGroupConcatenator::CacheKey() const {
+  // The backends write different, though equally valid, outputs.
+  return backend_ == GzipBackend::kLibdeflate
+             ? absl::StrCat("gzip/libdeflate/l", kLibdeflateCompressionLevel)
+             : absl::StrCat("gzip/l", Z_DEFAULT_COMPRESSION);
+}
+
+absl::StatusOr<std::string>
+GzipCompressionBlobReader::DecompressOneCompressionGroup() {
+  absl::StatusOr<absl::string_view> compressed_data =
+      ReadCompressionGroup(data_reader_);
+  if (!compressed_data.ok()) {
+    return compressed_data.status();
+  }
+  if (backend_ == GzipBackend::kLibdeflate) {
+    return DecompressStringWithLibdeflate(*compressed_data, std::string(),
+                                          size_hint(), max_decompressed_size());
+  }
+  return DecompressString(*compressed_data, std::string(), size_hint(),
+                          max_decompressed_size());
+}
 
-  return DecompressString(compressed_data);
+absl::StatusOr<std::pmr::string>
+GzipCompressionBlobReader::DecompressOneCompressionGroup(
+    std::pmr::memory_resource* resource) {
+  absl::StatusOr<absl::string_view> compressed_data =
+      ReadCompressionGroup(data_reader_);
+  if (!compressed_data.ok()) {
+    return compressed_data.status();
+  }
+  if (backend_ == GzipBackend::kLibdeflate) {
+    return DecompressStringWithLibdeflate(*compressed_data,
+                                          std::pmr::string(resource),
+                                          size_hint(), max_decompressed_size());
+  }
+  return DecompressString(*compressed_data, std::pmr::string(resource),
+                          size_hint(), max_decompressed_size());
 }
 
 }  // namespace privacy_sandbox::server_common
@@ -17,7 +17,10 @@
 #ifndef SRC_CPP_COMMUNICATION_COMPRESSION_GZIP_H_
 #define SRC_CPP_COMMUNICATION_COMPRESSION_GZIP_H_
 
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 
 #include "src/cpp/communication/compression.h"
 
@@ -30,19 +33,55 @@ inline constexpr int kGzipWindowBits = 15 | 16;
 // Default to 8 as per zlib.h's documentation.
 inline constexpr int kDefaultMemLevel = 8;
 
+// Libraries that gzip compression groups can go through. Both write standard
+// gzip, so a reader with either backend reads the output of both.
+enum class GzipBackend {
+  // Streams through zlib.
+  kZlib,
+  // Compresses and decompresses whole groups at once through libdeflate,
+  // which is faster, most of all on small groups. Decompression falls back to
+  // zlib when the decompressed size cannot be known up front, from the size
+  // hint or from the gzip trailer.
+  kLibdeflate,
+};
+
 // Builds compression groups that are compressed by gzip.
 class GzipCompressionGroupConcatenator : public CompressionGroupConcatenator {
  public:
+  explicit GzipCompressionGroupConcatenator(
+      GzipBackend backend = GzipBackend::kZlib)
+      : backend_(backend) {}
+
   absl::StatusOr<std::string> Build() const override;
+
+ protected:
+  absl::StatusOr<std::string> BuildCompressionGroup(
+      std::string_view partition) const override;
+  std::string CacheKey() const override;
+
+ private:
+  GzipBackend backend_;
 };
 
 // Reads compression groups built with GzipCompressionGroupConcatenator.
 class GzipCompressionBlobReader : public CompressedBlobReader {
  public:
-  explicit GzipCompressionBlobReader(absl::string_view compressed)
-      : CompressedBlobReader(compressed) {}
+  explicit GzipCompressionBlobReader(absl::string_view compressed,
+                                     GzipBackend backend = GzipBackend::kZlib)
+      : CompressedBlobReader(compressed), backend_(backend) {}
+
+ protected:
+  absl::StatusOr<std::string> DecompressOneCompressionGroup() override;
+  absl::StatusOr<std::pmr::string> DecompressOneCompressionGroup(
+      std::pmr::memory_resource* resource) override;
+  std::unique_ptr<CompressedBlobReader> CreateGroupReader(
+      std::string_view compression_group) const override {
+    return std::make_unique<GzipCompressionBlobReader>(compression_group,
+                                                       backend_);
+  }
 
-  absl::StatusOr<std::string> ExtractOneCompressionGroup() override;
+ private:
+  GzipBackend backend_;
 };
 
 }  // namespace privacy_sandbox::server_common
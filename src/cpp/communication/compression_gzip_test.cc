@@ -15,6 +15,7 @@
 #include "src/cpp/communication/compression_gzip.h"
 
 #include <algorithm>
+#include <memory_resource>
 #include <string>
 #include <string_view>
 
@@ -22,10 +23,12 @@
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/iostreams/filtering_streambuf.hpp>
 
+#include "absl/strings/str_cat.h"
 #include "glog/logging.h"
 #include "gtest/gtest.h"
 #include "quiche/common/quiche_data_writer.h"
 #include "src/cpp/communication/uncompressed.h"
+#include "src/cpp/util/request_arena.h"
 
 namespace privacy_sandbox::server_common {
 namespace {
@@ -37,6 +40,29 @@ using ::boost::iostreams::gzip_decompressor;
 using ::boost::iostreams::gzip_params;
 using ::boost::iostreams::gzip::best_compression;
 
+// Records the largest allocation made through it.
+class MaxAllocationResource : public std::pmr::memory_resource {
+ public:
+  size_t max_allocation() const { return max_allocation_; }
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    max_allocation_ = std::max(max_allocation_, bytes);
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  size_t max_allocation_ = 0;
+};
+
 std::string BoostCompress(absl::string_view decompressed_string) {
   std::istringstream origin(decompressed_string.data());
 
@@ -108,5 +134,145 @@ TEST(GzipCompressionTests, DecompressWithBoost) {
   ASSERT_EQ(payload, boost_decompress);
 }
 
+TEST(GzipCompressionTests, ExtractsIntoArena) {
+  std::string payload = "hello";
+
+  GzipCompressionGroupConcatenator concatenator;
+  concatenator.AddCompressionGroup(payload);
+  absl::StatusOr<std::string> compressed = concatenator.Build();
+  ASSERT_TRUE(compressed.ok());
+
+  GzipCompressionBlobReader blob_reader(*compressed);
+  RequestArena arena;
+  absl::StatusOr<std::pmr::string> compression_group =
+      blob_reader.ExtractOneCompressionGroup(&arena);
+  ASSERT_TRUE(compression_group.ok());
+  EXPECT_EQ(std::string_view(*compression_group), payload);
+  EXPECT_EQ(compression_group->get_allocator().resource(), &arena);
+}
+
+TEST(GzipCompressionTests, StopsAtDecompressionLimit) {
+  // Compresses to a few hundred bytes.
+  const std::string payload(1 << 20, 'a');
+  GzipCompressionGroupConcatenator concatenator;
+  concatenator.AddCompressionGroup(payload);
+  absl::StatusOr<std::string> compressed = concatenator.Build();
+  ASSERT_TRUE(compressed.ok());
+
+  DecompressionLimits limits;
+  limits.max_compression_group_size = 1000;
+  GzipCompressionBlobReader blob_reader(*compressed);
+  blob_reader.set_decompression_limits(limits);
+  EXPECT_TRUE(absl::IsResourceExhausted(
+      blob_reader.ExtractOneCompressionGroup().status()));
+}
+
+TEST(GzipCompressionTests, ExtractsWithSizeHint) {
+  const std::string payload(1 << 20, 'a');
+  GzipCompressionGroupConcatenator concatenator;
+  concatenator.set_size_hints(true);
+  concatenator.AddCompressionGroup(payload);
+  absl::StatusOr<std::string> compressed = concatenator.Build();
+  ASSERT_TRUE(compressed.ok());
+
+  GzipCompressionBlobReader blob_reader(*compressed);
+  RequestArena arena;
+  absl::StatusOr<std::pmr::string> compression_group =
+      blob_reader.ExtractOneCompressionGroup(&arena);
+  ASSERT_TRUE(compression_group.ok()) << compression_group.status();
+  EXPECT_EQ(std::string_view(*compression_group), payload);
+}
+
+TEST(GzipCompressionTests, DistrustsSizeHint) {
+  GzipCompressionGroupConcatenator concatenator;
+  concatenator.set_size_hints(true);
+  concatenator.AddCompressionGroup("hello");
+  absl::StatusOr<std::string> compressed = concatenator.Build();
+  ASSERT_TRUE(compressed.ok());
+  // Claims almost 4 GiB for a group of a few bytes.
+  compressed->replace(4, 4, "\xff\xff\xff\xf0");
+
+  for (GzipBackend backend : {GzipBackend::kZlib, GzipBackend::kLibdeflate}) {
+    MaxAllocationResource resource;
+    GzipCompressionBlobReader blob_reader(*compressed, backend);
+    EXPECT_TRUE(absl::IsDataLoss(
+        blob_reader.ExtractOneCompressionGroup(&resource).status()));
+    EXPECT_LT(resource.max_allocation(), 1 << 20);
+  }
+}
+
+TEST(GzipCompressionTests, BackendsReadEachOther) {
+  std::string payload;
+  for (int i = 0; i < 1000; ++i) {
+    absl::StrAppend(&payload, "{\"key", i, "\": \"value ", i % 7, "\"}");
+  }
+  for (GzipBackend writer : {GzipBackend::kZlib, GzipBackend::kLibdeflate}) {
+    GzipCompressionGroupConcatenator concatenator(writer);
+    concatenator.AddCompressionGroup(payload);
+    concatenator.AddCompressionGroup("");
+    absl::StatusOr<std::string> compressed = concatenator.Build();
+    ASSERT_TRUE(compressed.ok()) << compressed.status();
+    for (GzipBackend reader : {GzipBackend::kZlib, GzipBackend::kLibdeflate}) {
+      GzipCompressionBlobReader blob_reader(*compressed, reader);
+      EXPECT_EQ(*blob_reader.ExtractOneCompressionGroup(), payload);
+      EXPECT_EQ(*blob_reader.ExtractOneCompressionGroup(), "");
+      EXPECT_TRUE(blob_reader.IsDoneReading());
+    }
+  }
+}
+
+TEST(GzipCompressionTests, LibdeflateOutputIsStandardGzip) {
+  const std::string payload = "hello";
+  GzipCompressionGroupConcatenator concatenator(GzipBackend::kLibdeflate);
+  concatenator.AddCompressionGroup(payload);
+  absl::StatusOr<std::string> compressed = concatenator.Build();
+  ASSERT_TRUE(compressed.ok());
+  EXPECT_EQ(BoostDecompress(compressed->substr(4)), payload);
+}
+
+TEST(GzipCompressionTests, LibdeflateStopsAtDecompressionLimit) {
+  GzipCompressionGroupConcatenator concatenator(GzipBackend::kLibdeflate);
+  concatenator.AddCompressionGroup(std::string(1 << 20, 'a'));
+  absl::StatusOr<std::string> compressed = concatenator.Build();
+  ASSERT_TRUE(compressed.ok());
+
+  DecompressionLimits limits;
+  limits.max_compression_group_size = 1000;
+  GzipCompressionBlobReader blob_reader(*compressed, GzipBackend::kLibdeflate);
+  blob_reader.set_decompression_limits(limits);
+  EXPECT_TRUE(absl::IsResourceExhausted(
+      blob_reader.ExtractOneCompressionGroup().status()));
+}
+
+TEST(GzipCompressionTests, LibdeflateDistrustsTrailer) {
+  GzipCompressionGroupConcatenator concatenator;
+  concatenator.AddCompressionGroup("hello");
+  absl::StatusOr<std::string> compressed = concatenator.Build();
+  ASSERT_TRUE(compressed.ok());
+  // Claims 4 GiB - 1 bytes in the trailer, more than deflate can produce.
+  compressed->replace(compressed->size() - 4, 4, "\xff\xff\xff\xff");
+
+  GzipCompressionBlobReader blob_reader(*compressed, GzipBackend::kLibdeflate);
+  EXPECT_TRUE(
+      absl::IsDataLoss(blob_reader.ExtractOneCompressionGroup().status()));
+}
+
+TEST(GzipCompressionTests, LibdeflateExtractsWithSizeHint) {
+  const std::string payload(1 << 16, 'a');
+  GzipCompressionGroupConcatenator concatenator(GzipBackend::kLibdeflate);
+  concatenator.set_size_hints(true);
+  concatenator.AddCompressionGroup(payload);
+  absl::StatusOr<std::string> compressed = concatenator.Build();
+  ASSERT_TRUE(compressed.ok());
+
+  GzipCompressionBlobReader blob_reader(*compressed, GzipBackend::kLibdeflate);
+  RequestArena arena;
+  absl::StatusOr<std::pmr::string> compression_group =
+      blob_reader.ExtractOneCompressionGroup(&arena);
+  ASSERT_TRUE(compression_group.ok()) << compression_group.status();
+  EXPECT_EQ(std::string_view(*compression_group), payload);
+  EXPECT_EQ(compression_group->get_allocator().resource(), &arena);
+}
+
 }  // namespace
 }  // namespace privacy_sandbox::server_common
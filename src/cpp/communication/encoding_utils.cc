@@ -16,9 +16,17 @@
 
 #include <math.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <limits>
 #include <memory>
+#include <memory_resource>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "absl/container/inlined_vector.h"
+#include "absl/numeric/bits.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_format.h"
@@ -28,9 +36,19 @@
 
 namespace privacy_sandbox::server_common {
 
-absl::StatusOr<std::string> EncodeResponsePayload(
+namespace {
+
+// Packs the framing version and the compression algorithm in one byte.
+uint8_t FirstByte(int framing_version, CompressionType compression_type) {
+  return (framing_version << kNumCompressionTypeBits) |
+         static_cast<int>(compression_type);
+}
+
+// Writes the encoded payload into `output`, which determines the allocator.
+template <typename String>
+absl::StatusOr<String> EncodeResponsePayloadInto(
     CompressionType compression_type, absl::string_view compressed_data,
-    int encoded_data_size) {
+    int encoded_data_size, String output) {
   int min_required_payload_size = kFramingVersionAndCompressionTypeSizeBytes +
                                   kCompressedDataSizeBytes +
                                   compressed_data.size();
@@ -42,17 +60,11 @@ absl::StatusOr<std::string> EncodeResponsePayload(
     return absl::InternalError(error);
   }
 
-  // Re-define encoded_data_size as a const to get a cpplint warning to go away.
-  const int kEncodedDataSize = encoded_data_size;
-  char buffer[kEncodedDataSize];
-  quiche::QuicheDataWriter writer(sizeof(buffer), buffer);
+  output.resize(encoded_data_size);
+  quiche::QuicheDataWriter writer(output.size(), output.data());
 
   // 1. Write the framing version  and compression algorithm in one byte.
-  // framing_version is zero for now but can change in the future.
-  const int framing_version = 0;
-  const uint8_t first_byte =
-      (framing_version << 5) | static_cast<int>(compression_type);
-  writer.WriteUInt8(first_byte);
+  writer.WriteUInt8(FirstByte(kSingleBodyFramingVersion, compression_type));
 
   // 2. Write the length of the compressed data *and* the compressed data.
   writer.WriteUInt32(compressed_data.size());
@@ -61,10 +73,33 @@ absl::StatusOr<std::string> EncodeResponsePayload(
   // 3. Fill the rest of the buffer with padding (e.g. zeroes).
   writer.WritePadding();
 
-  return std::string(buffer, sizeof(buffer));
+  return output;
 }
 
-absl::StatusOr<DecodedRequest> DecodeRequestPayload(absl::string_view payload) {
+// Rounds `size` up to keep only the exponent and as many of the top bits of
+// the size as the exponent takes, e.g. 4 of them for sizes of 2^8 to 2^15.
+uint64_t RoundUpPadme(uint64_t size) {
+  if (size < 2) {
+    return size;
+  }
+  const int exponent = absl::bit_width(size) - 1;
+  const int dropped_bits =
+      exponent - absl::bit_width(static_cast<uint64_t>(exponent));
+  const uint64_t mask = (uint64_t{1} << dropped_bits) - 1;
+  return (size + mask) & ~mask;
+}
+
+// Like DecodedRequest, but pointing into the payload. The compressed data is
+// the concatenation of the chunks, of which there is one unless the payload is
+// chunked.
+struct DecodedRequestView {
+  int framing_version;
+  CompressionType compression_type;
+  absl::InlinedVector<absl::string_view, 1> compressed_data;
+};
+
+absl::StatusOr<DecodedRequestView> ParseRequestPayload(
+    absl::string_view payload) {
   quiche::QuicheDataReader reader(payload);
 
   uint8_t first_byte;
@@ -76,6 +111,27 @@ absl::StatusOr<DecodedRequest> DecodeRequestPayload(absl::string_view payload) {
   const int version_num = first_byte >> kNumCompressionTypeBits;
   const int compression_type =
       first_byte & ((int)pow(2, kNumCompressionTypeBits) - 1);
+  DecodedRequestView view{
+      version_num, static_cast<CompressionType>(compression_type), {}};
+
+  if (version_num == kChunkedFramingVersion) {
+    while (true) {
+      uint32_t chunk_length;
+      if (!reader.ReadUInt32(&chunk_length)) {
+        return absl::InvalidArgumentError("Failed to parse chunk length.");
+      }
+      if (chunk_length == 0) {
+        break;
+      }
+      absl::string_view chunk;
+      if (!reader.ReadStringPiece(&chunk, chunk_length)) {
+        return absl::InvalidArgumentError("Failed to parse chunk.");
+      }
+      view.compressed_data.push_back(chunk);
+    }
+    // The rest of the payload is padding and can be ignored.
+    return view;
+  }
 
   uint32_t compressed_data_length;
   if (!reader.ReadUInt32(&compressed_data_length)) {
@@ -87,14 +143,210 @@ absl::StatusOr<DecodedRequest> DecodeRequestPayload(absl::string_view payload) {
   if (!reader.ReadStringPiece(&compressed_data, compressed_data_length)) {
     return absl::InvalidArgumentError("Failed to parse compressed data.");
   }
+  view.compressed_data.push_back(compressed_data);
 
   // The rest of the payload is padding and can be ignored.
 
+  return view;
+}
+
+// Concatenates the chunks of compressed data into `output`, which determines
+// the allocator.
+template <typename String>
+String JoinCompressedData(const DecodedRequestView& view, String output) {
+  size_t size = 0;
+  for (absl::string_view chunk : view.compressed_data) {
+    size += chunk.size();
+  }
+  output.reserve(size);
+  for (absl::string_view chunk : view.compressed_data) {
+    output.append(chunk.data(), chunk.size());
+  }
+  return output;
+}
+
+}  // namespace
+
+absl::StatusOr<std::string> EncodeResponsePayload(
+    CompressionType compression_type, absl::string_view compressed_data,
+    int encoded_data_size) {
+  return EncodeResponsePayloadInto(compression_type, compressed_data,
+                                   encoded_data_size, std::string());
+}
+
+absl::StatusOr<std::pmr::string> EncodeResponsePayload(
+    CompressionType compression_type, absl::string_view compressed_data,
+    int encoded_data_size, std::pmr::memory_resource* resource) {
+  return EncodeResponsePayloadInto(compression_type, compressed_data,
+                                   encoded_data_size,
+                                   std::pmr::string(resource));
+}
+
+absl::StatusOr<PaddingPolicy> PaddingPolicy::Fixed(int encoded_data_size) {
+  return SizeClasses({encoded_data_size});
+}
+
+PaddingPolicy PaddingPolicy::PowersOfTwo(int min_encoded_data_size) {
+  return PaddingPolicy(Rounding::kPowersOfTwo, min_encoded_data_size, {});
+}
+
+PaddingPolicy PaddingPolicy::Padme(int min_encoded_data_size) {
+  return PaddingPolicy(Rounding::kPadme, min_encoded_data_size, {});
+}
+
+absl::StatusOr<PaddingPolicy> PaddingPolicy::SizeClasses(
+    std::vector<int> size_classes) {
+  if (size_classes.empty()) {
+    return absl::InvalidArgumentError("No size classes given");
+  }
+  std::sort(size_classes.begin(), size_classes.end());
+  if (size_classes.front() <= 0) {
+    return absl::InvalidArgumentError("Size classes must be positive");
+  }
+  return PaddingPolicy(Rounding::kSizeClasses, 0, std::move(size_classes));
+}
+
+absl::StatusOr<int> PaddingPolicy::EncodedDataSize(
+    size_t compressed_data_size) const {
+  const uint64_t min_required_payload_size =
+      kFramingVersionAndCompressionTypeSizeBytes + kCompressedDataSizeBytes +
+      uint64_t{compressed_data_size};
+  uint64_t encoded_data_size = std::max<uint64_t>(
+      min_required_payload_size, std::max(min_encoded_data_size_, 0));
+  switch (rounding_) {
+    case Rounding::kSizeClasses: {
+      const auto it = std::lower_bound(
+          size_classes_.begin(), size_classes_.end(), encoded_data_size,
+          [](int size_class, uint64_t size) {
+            // Size classes are positive.
+            return static_cast<uint64_t>(size_class) < size;
+          });
+      if (it == size_classes_.end()) {
+        return absl::InternalError(absl::StrFormat(
+            "Payload too large for the largest size class: "
+            "(largest size class: %d, minimum size required: %d)",
+            size_classes_.back(), min_required_payload_size));
+      }
+      return *it;
+    }
+    case Rounding::kPowersOfTwo:
+      encoded_data_size = absl::bit_ceil(encoded_data_size);
+      break;
+    case Rounding::kPadme:
+      encoded_data_size = RoundUpPadme(encoded_data_size);
+      break;
+  }
+  if (encoded_data_size > std::numeric_limits<int>::max()) {
+    return absl::InternalError(absl::StrFormat(
+        "Payload too large to be padded: (minimum size required: %d)",
+        min_required_payload_size));
+  }
+  return static_cast<int>(encoded_data_size);
+}
+
+absl::StatusOr<std::string> EncodeResponsePayload(
+    CompressionType compression_type, absl::string_view compressed_data,
+    const PaddingPolicy& padding_policy) {
+  absl::StatusOr<int> encoded_data_size =
+      padding_policy.EncodedDataSize(compressed_data.size());
+  if (!encoded_data_size.ok()) {
+    return encoded_data_size.status();
+  }
+  return EncodeResponsePayloadInto(compression_type, compressed_data,
+                                   *encoded_data_size, std::string());
+}
+
+absl::StatusOr<std::pmr::string> EncodeResponsePayload(
+    CompressionType compression_type, absl::string_view compressed_data,
+    const PaddingPolicy& padding_policy, std::pmr::memory_resource* resource) {
+  absl::StatusOr<int> encoded_data_size =
+      padding_policy.EncodedDataSize(compressed_data.size());
+  if (!encoded_data_size.ok()) {
+    return encoded_data_size.status();
+  }
+  return EncodeResponsePayloadInto(compression_type, compressed_data,
+                                   *encoded_data_size,
+                                   std::pmr::string(resource));
+}
+
+absl::StatusOr<std::string> ChunkedPayloadEncoder::EncodeChunk(
+    absl::string_view compressed_data) {
+  if (finished_) {
+    return absl::FailedPreconditionError(
+        "Cannot encode a chunk after the end of the payload.");
+  }
+  const size_t first_byte_size =
+      started_ ? 0 : kFramingVersionAndCompressionTypeSizeBytes;
+  // An empty chunk would end the payload.
+  const size_t chunk_size = compressed_data.empty()
+                                ? 0
+                                : kCompressedDataSizeBytes +
+                                      compressed_data.size();
+  std::string output(first_byte_size + chunk_size, '\0');
+  quiche::QuicheDataWriter writer(output.size(), output.data());
+  if (!started_) {
+    writer.WriteUInt8(FirstByte(kChunkedFramingVersion, compression_type_));
+    started_ = true;
+  }
+  if (!compressed_data.empty()) {
+    writer.WriteUInt32(compressed_data.size());
+    writer.WriteStringPiece(compressed_data);
+    encoded_size_ += chunk_size;
+  }
+  return output;
+}
+
+absl::StatusOr<std::string> ChunkedPayloadEncoder::Finish(
+    const PaddingPolicy& padding_policy) {
+  if (finished_) {
+    return absl::FailedPreconditionError("The payload is already finished.");
+  }
+  // The sizes of the chunks take the place of the size of the compressed data
+  // in EncodeResponsePayload(), and the end of the chunks the place of its
+  // size field.
+  absl::StatusOr<int> encoded_data_size =
+      padding_policy.EncodedDataSize(encoded_size_);
+  if (!encoded_data_size.ok()) {
+    return encoded_data_size.status();
+  }
+  const size_t first_byte_size =
+      started_ ? 0 : kFramingVersionAndCompressionTypeSizeBytes;
+  std::string output(*encoded_data_size - encoded_size_ -
+                         kFramingVersionAndCompressionTypeSizeBytes +
+                         first_byte_size,
+                     '\0');
+  quiche::QuicheDataWriter writer(output.size(), output.data());
+  if (!started_) {
+    writer.WriteUInt8(FirstByte(kChunkedFramingVersion, compression_type_));
+    started_ = true;
+  }
+  writer.WriteUInt32(0);
+  writer.WritePadding();
+  finished_ = true;
+  return output;
+}
+
+absl::StatusOr<DecodedRequest> DecodeRequestPayload(absl::string_view payload) {
+  absl::StatusOr<DecodedRequestView> view = ParseRequestPayload(payload);
+  if (!view.ok()) {
+    return view.status();
+  }
   DecodedRequest req;
-  req.framing_version = version_num;
-  req.compression_type = static_cast<CompressionType>(compression_type);
-  req.compressed_data = std::string(compressed_data);
+  req.framing_version = view->framing_version;
+  req.compression_type = view->compression_type;
+  req.compressed_data = JoinCompressedData(*view, std::string());
   return req;
 }
 
+absl::StatusOr<PmrDecodedRequest> DecodeRequestPayload(
+    absl::string_view payload, std::pmr::memory_resource* resource) {
+  absl::StatusOr<DecodedRequestView> view = ParseRequestPayload(payload);
+  if (!view.ok()) {
+    return view.status();
+  }
+  return PmrDecodedRequest{
+      view->framing_version, view->compression_type,
+      JoinCompressedData(*view, std::pmr::string(resource))};
+}
+
 }  // namespace privacy_sandbox::server_common
@@ -17,7 +17,11 @@
 #ifndef SRC_CPP_COMMUNICATION_ENCODING_UTILS_H_
 #define SRC_CPP_COMMUNICATION_ENCODING_UTILS_H_
 
+#include <cstddef>
+#include <memory_resource>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
@@ -33,14 +37,34 @@ inline constexpr int kNumCompressionTypeBits = 8 - kNumFramingVersionBits;
 inline constexpr int kFramingVersionAndCompressionTypeSizeBytes = 1;
 inline constexpr int kCompressedDataSizeBytes = 4;
 
-enum class CompressionType { kUncompressed = 0, kBrotli, kGzip = 2 };
+// Framing versions of encoded payloads: version 0 holds the compressed data in
+// one piece (see EncodeResponsePayload()), version 1 in chunks (see
+// ChunkedPayloadEncoder).
+inline constexpr int kSingleBodyFramingVersion = 0;
+inline constexpr int kChunkedFramingVersion = 1;
 
-struct DecodedRequest {
+// kBrotliSharedDictionary groups are compressed by Brotli against a custom
+// dictionary, which is identified in every group (see
+// BrotliCompressionGroupConcatenator).
+enum class CompressionType {
+  kUncompressed = 0,
+  kBrotli,
+  kGzip = 2,
+  kBrotliSharedDictionary = 3
+};
+
+template <typename String>
+struct BasicDecodedRequest {
   int framing_version;
   CompressionType compression_type;
-  std::string compressed_data;
+  String compressed_data;
 };
 
+using DecodedRequest = BasicDecodedRequest<std::string>;
+// A DecodedRequest allocated from a std::pmr::memory_resource, e.g. a
+// RequestArena.
+using PmrDecodedRequest = BasicDecodedRequest<std::pmr::string>;
+
 // Encodes a response payload according to the following format:
 // - 1 byte containing:
 //   - 3 bits for the framing version (the format/structure of the payload)
@@ -56,8 +80,101 @@ absl::StatusOr<std::string> EncodeResponsePayload(
     CompressionType compression_type, absl::string_view compressed_data,
     int encoded_data_size);
 
+// Same as above, but allocates the output from `resource`.
+absl::StatusOr<std::pmr::string> EncodeResponsePayload(
+    CompressionType compression_type, absl::string_view compressed_data,
+    int encoded_data_size, std::pmr::memory_resource* resource);
+
+// Chooses the size that EncodeResponsePayload() pads an encoded payload to.
+// Padding every payload to one fixed size hides its size entirely, but wastes
+// bandwidth and encryption work on small payloads. Size classes only reveal
+// the class a payload falls in. Cheap to copy.
+class PaddingPolicy {
+ public:
+  // Pads every payload to `encoded_data_size`, which must be positive.
+  static absl::StatusOr<PaddingPolicy> Fixed(int encoded_data_size);
+
+  // Pads to the next power of two, and to at least `min_encoded_data_size`.
+  // Adds at most the size of the payload again.
+  static PaddingPolicy PowersOfTwo(int min_encoded_data_size = 0);
+
+  // Pads with Padmé, which keeps the exponent of the size and only as many of
+  // its top bits as the exponent itself takes, and to at least
+  // `min_encoded_data_size`. Adds at most 12% for payloads of 8 bytes or more,
+  // and leaks O(log log size) bits of the size.
+  static PaddingPolicy Padme(int min_encoded_data_size = 0);
+
+  // Pads to the smallest of `size_classes` that fits. Payloads larger than all
+  // of them fail to encode.
+  static absl::StatusOr<PaddingPolicy> SizeClasses(
+      std::vector<int> size_classes);
+
+  // Returns the size of the encoded payload, padding included, for
+  // `compressed_data_size` bytes of compressed data.
+  absl::StatusOr<int> EncodedDataSize(size_t compressed_data_size) const;
+
+ private:
+  enum class Rounding { kSizeClasses, kPowersOfTwo, kPadme };
+
+  PaddingPolicy(Rounding rounding, int min_encoded_data_size,
+                std::vector<int> size_classes)
+      : rounding_(rounding),
+        min_encoded_data_size_(min_encoded_data_size),
+        size_classes_(std::move(size_classes)) {}
+
+  Rounding rounding_;
+  int min_encoded_data_size_;
+  // Sorted. Only for kSizeClasses.
+  std::vector<int> size_classes_;
+};
+
+// Same as EncodeResponsePayload() above, but pads to the size chosen by
+// `padding_policy`, which is computed once before encoding.
+absl::StatusOr<std::string> EncodeResponsePayload(
+    CompressionType compression_type, absl::string_view compressed_data,
+    const PaddingPolicy& padding_policy);
+
+// Same as above, but allocates the output from `resource`.
+absl::StatusOr<std::pmr::string> EncodeResponsePayload(
+    CompressionType compression_type, absl::string_view compressed_data,
+    const PaddingPolicy& padding_policy, std::pmr::memory_resource* resource);
+
+// Encodes a payload with kChunkedFramingVersion, chunk by chunk as the
+// compressed data becomes available, so that the start of a large payload can
+// be encrypted and sent before the rest is compressed. The format is:
+// - 1 byte for the framing version and the compression algorithm, as in
+//   EncodeResponsePayload()
+// - for every chunk, 4 bytes for the size of the chunk followed by the chunk
+// - 4 bytes of zeroes
+// - Y bytes of padding
+// The compressed data is the concatenation of the chunks.
+//
+// Not thread-safe.
+class ChunkedPayloadEncoder {
+ public:
+  explicit ChunkedPayloadEncoder(CompressionType compression_type)
+      : compression_type_(compression_type) {}
+
+  // Returns the encoding of the next chunk of compressed data, preceded by the
+  // first byte of the payload on the first call. Fails once Finish() succeeded.
+  absl::StatusOr<std::string> EncodeChunk(absl::string_view compressed_data);
+
+  // Returns the end of the payload, with enough padding to bring the whole
+  // payload to the size chosen by `padding_policy`. Fails if it already
+  // succeeded once.
+  absl::StatusOr<std::string> Finish(const PaddingPolicy& padding_policy);
+
+ private:
+  CompressionType compression_type_;
+  bool started_ = false;
+  bool finished_ = false;
+  // Chunks and sizes written so far, first byte excluded.
+  size_t encoded_size_ = 0;
+};
+
 // Parses an encoded request payload and returns the compressed payload.
-// See EncodeResponsePayload() for the expected encoded input. The input should
+// See EncodeResponsePayload() and ChunkedPayloadEncoder for the expected
+// encoded input. The input should
 // be a byte string (Base64 encoded). Any issues reading the encoded payloads
 // are returned as InvalidArgument errors because they're assumed to be from the
 // payloads not having enough data to be read.
@@ -66,6 +183,11 @@ absl::StatusOr<std::string> EncodeResponsePayload(
 // output of this method should be the input to decompression.
 absl::StatusOr<DecodedRequest> DecodeRequestPayload(absl::string_view payload);
 
+// Same as above, but copies the compressed payload into memory allocated from
+// `resource`, so that the buffers of a request can be released at once.
+absl::StatusOr<PmrDecodedRequest> DecodeRequestPayload(
+    absl::string_view payload, std::pmr::memory_resource* resource);
+
 }  // namespace privacy_sandbox::server_common
 
 #endif  // SRC_CPP_COMMUNICATION_ENCODING_UTILS_H_
@@ -0,0 +1,75 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures framing and unframing payloads of different sizes.
+//
+// Run with:
+//   bazel run -c opt //src/cpp/communication:encoding_utils_benchmark -- \
+//     --benchmark_format=json
+
+#include <string>
+
+#include "benchmark/benchmark.h"
+#include "src/cpp/communication/encoding_utils.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+// Encoded payloads are padded up to twice the size of the compressed data.
+void BM_EncodeResponsePayload(benchmark::State& state) {
+  const std::string compressed_data(state.range(0), 'q');
+  const int encoded_data_size = 2 * compressed_data.size();
+  for (auto _ : state) {
+    auto encoded = EncodeResponsePayload(CompressionType::kBrotli,
+                                         compressed_data, encoded_data_size);
+    benchmark::DoNotOptimize(encoded);
+  }
+  state.SetBytesProcessed(state.iterations() * encoded_data_size);
+}
+
+// Encoded payloads are padded with Padmé, which adds at most 12%.
+void BM_EncodeResponsePayloadPadme(benchmark::State& state) {
+  const std::string compressed_data(state.range(0), 'q');
+  const PaddingPolicy padding_policy = PaddingPolicy::Padme();
+  for (auto _ : state) {
+    auto encoded = EncodeResponsePayload(CompressionType::kBrotli,
+                                         compressed_data, padding_policy);
+    benchmark::DoNotOptimize(encoded);
+  }
+  state.SetBytesProcessed(
+      state.iterations() *
+      padding_policy.EncodedDataSize(compressed_data.size()).value());
+}
+
+void BM_DecodeRequestPayload(benchmark::State& state) {
+  const std::string payload =
+      EncodeResponsePayload(CompressionType::kBrotli,
+                            std::string(state.range(0), 'q'),
+                            2 * state.range(0))
+          .value();
+  for (auto _ : state) {
+    auto decoded = DecodeRequestPayload(payload);
+    benchmark::DoNotOptimize(decoded);
+  }
+  state.SetBytesProcessed(state.iterations() * payload.size());
+}
+
+BENCHMARK(BM_EncodeResponsePayload)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_EncodeResponsePayloadPadme)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_DecodeRequestPayload)->Range(1 << 10, 1 << 20);
+
+}  // namespace
+}  // namespace privacy_sandbox::server_common
+
+BENCHMARK_MAIN();
@@ -15,10 +15,12 @@
 #include "src/cpp/communication/encoding_utils.h"
 
 #include <string>
+#include <string_view>
 
 #include "absl/status/statusor.h"
 #include "absl/strings/escaping.h"
 #include "gtest/gtest.h"
+#include "src/cpp/util/request_arena.h"
 
 namespace privacy_sandbox::server_common {
 namespace {
@@ -97,5 +99,182 @@ TEST(EncodingUtilsTest, DecodeRequestPayloadFailure_MalformedPayload) {
   ASSERT_TRUE(absl::IsInvalidArgument(decoded_payload.status()));
 }
 
+TEST(EncodingUtilsTest, EncodeResponsePayloadIntoArena) {
+  RequestArena arena;
+  const absl::StatusOr<std::pmr::string> actual = EncodeResponsePayload(
+      CompressionType::kBrotli, "payload", 128, &arena);
+
+  const std::string expected = "01000000077061796c6f6164";
+  ASSERT_TRUE(actual.ok());
+  EXPECT_EQ(absl::BytesToHexString(*actual).substr(0, expected.length()),
+            expected);
+  EXPECT_EQ(actual->size(), 128);
+  EXPECT_EQ(actual->get_allocator().resource(), &arena);
+}
+
+TEST(EncodingUtilsTest, DecodeRequestPayloadIntoArena) {
+  RequestArena arena;
+  const absl::StatusOr<PmrDecodedRequest> decoded_payload =
+      DecodeRequestPayload(
+          absl::HexStringToBytes("01000000077061796c6f61640000"), &arena);
+
+  ASSERT_TRUE(decoded_payload.ok());
+  EXPECT_EQ(decoded_payload->framing_version, 0);
+  EXPECT_EQ(decoded_payload->compression_type, CompressionType::kBrotli);
+  EXPECT_EQ(std::string_view(decoded_payload->compressed_data), "payload");
+  EXPECT_EQ(decoded_payload->compressed_data.get_allocator().resource(),
+            &arena);
+}
+
+TEST(PaddingPolicyTest, Fixed) {
+  const absl::StatusOr<PaddingPolicy> policy = PaddingPolicy::Fixed(128);
+  ASSERT_TRUE(policy.ok()) << policy.status();
+  EXPECT_EQ(*policy->EncodedDataSize(0), 128);
+  EXPECT_EQ(*policy->EncodedDataSize(123), 128);
+  EXPECT_FALSE(policy->EncodedDataSize(124).ok());
+}
+
+TEST(PaddingPolicyTest, RejectsInvalidFixedSize) {
+  EXPECT_TRUE(absl::IsInvalidArgument(PaddingPolicy::Fixed(0).status()));
+  EXPECT_TRUE(absl::IsInvalidArgument(PaddingPolicy::Fixed(-128).status()));
+}
+
+TEST(PaddingPolicyTest, PowersOfTwo) {
+  const PaddingPolicy policy = PaddingPolicy::PowersOfTwo();
+  // 5 bytes of framing come on top of the compressed data.
+  EXPECT_EQ(*policy.EncodedDataSize(0), 8);
+  EXPECT_EQ(*policy.EncodedDataSize(3), 8);
+  EXPECT_EQ(*policy.EncodedDataSize(4), 16);
+  EXPECT_EQ(*policy.EncodedDataSize(1000), 1024);
+  EXPECT_EQ(*policy.EncodedDataSize(1020), 2048);
+  EXPECT_EQ(*PaddingPolicy::PowersOfTwo(512).EncodedDataSize(7), 512);
+}
+
+TEST(PaddingPolicyTest, Padme) {
+  const PaddingPolicy policy = PaddingPolicy::Padme();
+  EXPECT_EQ(*policy.EncodedDataSize(4), 10);
+  EXPECT_EQ(*policy.EncodedDataSize(95), 104);
+  EXPECT_EQ(*policy.EncodedDataSize(99), 104);
+  EXPECT_EQ(*policy.EncodedDataSize(100), 112);
+  EXPECT_EQ(*PaddingPolicy::Padme(512).EncodedDataSize(7), 512);
+  for (size_t size = 3; size < 100000; size = size * 3 / 2) {
+    const absl::StatusOr<int> encoded_data_size = policy.EncodedDataSize(size);
+    ASSERT_TRUE(encoded_data_size.ok());
+    EXPECT_GE(*encoded_data_size, size + 5);
+    EXPECT_LE(*encoded_data_size, (size + 5) * 1.12);
+  }
+}
+
+TEST(PaddingPolicyTest, SizeClasses) {
+  const absl::StatusOr<PaddingPolicy> policy =
+      PaddingPolicy::SizeClasses({4096, 256, 1024});
+  ASSERT_TRUE(policy.ok());
+  EXPECT_EQ(*policy->EncodedDataSize(0), 256);
+  EXPECT_EQ(*policy->EncodedDataSize(251), 256);
+  EXPECT_EQ(*policy->EncodedDataSize(252), 1024);
+  EXPECT_EQ(*policy->EncodedDataSize(4091), 4096);
+  EXPECT_FALSE(policy->EncodedDataSize(4092).ok());
+}
+
+TEST(PaddingPolicyTest, RejectsInvalidSizeClasses) {
+  EXPECT_FALSE(PaddingPolicy::SizeClasses({}).ok());
+  EXPECT_FALSE(PaddingPolicy::SizeClasses({0, 128}).ok());
+}
+
+TEST(EncodingUtilsTest, EncodeResponsePayloadWithPaddingPolicy) {
+  const absl::StatusOr<std::string> actual = EncodeResponsePayload(
+      CompressionType::kBrotli, "payload", PaddingPolicy::PowersOfTwo());
+
+  const std::string expected = "01000000077061796c6f6164";
+  ASSERT_TRUE(actual.ok());
+  EXPECT_EQ(absl::BytesToHexString(*actual).substr(0, expected.length()),
+            expected);
+  EXPECT_EQ(actual->size(), 16);
+
+  RequestArena arena;
+  const absl::StatusOr<std::pmr::string> in_arena = EncodeResponsePayload(
+      CompressionType::kBrotli, "payload", PaddingPolicy::PowersOfTwo(),
+      &arena);
+  ASSERT_TRUE(in_arena.ok());
+  EXPECT_EQ(std::string_view(*in_arena), *actual);
+  EXPECT_EQ(in_arena->get_allocator().resource(), &arena);
+}
+
+TEST(ChunkedPayloadEncoderTest, EncodesChunks) {
+  ChunkedPayloadEncoder encoder(CompressionType::kBrotli);
+  absl::StatusOr<std::string> chunk = encoder.EncodeChunk("pay");
+  ASSERT_TRUE(chunk.ok()) << chunk.status();
+  // version/compression - chunk length - data
+  // 21                  - 00000003     - 706179
+  EXPECT_EQ(absl::BytesToHexString(*chunk), "2100000003706179");
+  std::string payload = *std::move(chunk);
+  for (absl::string_view data : {"", "load"}) {
+    chunk = encoder.EncodeChunk(data);
+    ASSERT_TRUE(chunk.ok()) << chunk.status();
+    payload += *chunk;
+  }
+  absl::StatusOr<std::string> end =
+      encoder.Finish(PaddingPolicy::PowersOfTwo());
+  ASSERT_TRUE(end.ok()) << end.status();
+  payload += *end;
+  EXPECT_EQ(payload.size(), 32);
+  EXPECT_EQ(absl::BytesToHexString(payload),
+            "2100000003706179000000046c6f616400000000"
+            "000000000000000000000000");
+
+  const absl::StatusOr<DecodedRequest> decoded = DecodeRequestPayload(payload);
+  ASSERT_TRUE(decoded.ok()) << decoded.status();
+  EXPECT_EQ(decoded->framing_version, kChunkedFramingVersion);
+  EXPECT_EQ(decoded->compression_type, CompressionType::kBrotli);
+  EXPECT_EQ(decoded->compressed_data, "payload");
+
+  RequestArena arena;
+  const absl::StatusOr<PmrDecodedRequest> in_arena =
+      DecodeRequestPayload(payload, &arena);
+  ASSERT_TRUE(in_arena.ok()) << in_arena.status();
+  EXPECT_EQ(std::string_view(in_arena->compressed_data), "payload");
+}
+
+TEST(ChunkedPayloadEncoderTest, EncodesEmptyPayload) {
+  ChunkedPayloadEncoder encoder(CompressionType::kGzip);
+  absl::StatusOr<std::string> payload =
+      encoder.Finish(*PaddingPolicy::Fixed(8));
+  ASSERT_TRUE(payload.ok()) << payload.status();
+  EXPECT_EQ(absl::BytesToHexString(*payload), "2200000000000000");
+
+  const absl::StatusOr<DecodedRequest> decoded =
+      DecodeRequestPayload(*payload);
+  ASSERT_TRUE(decoded.ok()) << decoded.status();
+  EXPECT_EQ(decoded->compression_type, CompressionType::kGzip);
+  EXPECT_EQ(decoded->compressed_data, "");
+}
+
+TEST(ChunkedPayloadEncoderTest, FailsIfPaddingPolicyTooSmall) {
+  ChunkedPayloadEncoder encoder(CompressionType::kBrotli);
+  ASSERT_TRUE(encoder.EncodeChunk("payload").ok());
+  EXPECT_FALSE(encoder.Finish(*PaddingPolicy::Fixed(15)).ok());
+}
+
+TEST(ChunkedPayloadEncoderTest, FailsAfterFinish) {
+  ChunkedPayloadEncoder encoder(CompressionType::kBrotli);
+  ASSERT_TRUE(encoder.EncodeChunk("payload").ok());
+  ASSERT_TRUE(encoder.Finish(PaddingPolicy::PowersOfTwo()).ok());
+
+  EXPECT_TRUE(absl::IsFailedPrecondition(
+      encoder.EncodeChunk("more payload").status()));
+  EXPECT_TRUE(absl::IsFailedPrecondition(
+      encoder.Finish(PaddingPolicy::PowersOfTwo()).status()));
+}
+
+TEST(EncodingUtilsTest, DecodeRequestPayloadFailure_TruncatedChunks) {
+  // Misses the end of the chunks.
+  EXPECT_TRUE(absl::IsInvalidArgument(
+      DecodeRequestPayload(absl::HexStringToBytes("2100000003706179"))
+          .status()));
+  // The chunk is shorter than its length.
+  EXPECT_TRUE(absl::IsInvalidArgument(
+      DecodeRequestPayload(absl::HexStringToBytes("21000000037061")).status()));
+}
+
 }  // namespace
 }  // namespace privacy_sandbox::server_common
@@ -0,0 +1,120 @@
+# Copyright 2023 Google LLC
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Generates type-specialized JSON codecs for proto3 messages."""
+
+load("@rules_cc//cc:defs.bzl", "cc_library")
+
+def _json_codec_gen_impl(ctx):
+    proto_info = ctx.attr.proto[ProtoInfo]
+    srcs = []
+    for src in proto_info.direct_sources:
+        if src.owner.package != ctx.label.package:
+            fail("%s must be in package %s" % (src.short_path, ctx.label.package))
+        base = src.basename[:-len(".proto")]
+        srcs.append(ctx.actions.declare_file(base + ".json.cc"))
+
+    out_dir = ctx.bin_dir.path
+    if ctx.label.workspace_root:
+        out_dir += "/" + ctx.label.workspace_root
+
+    args = ctx.actions.args()
+    args.add("--plugin=protoc-gen-json_codec=" + ctx.executable._plugin.path)
+    args.add("--json_codec_out=" + out_dir)
+    args.add_joined(
+        "--descriptor_set_in",
+        proto_info.transitive_descriptor_sets,
+        join_with = ctx.configuration.host_path_separator,
+    )
+    args.add_all(proto_info.direct_sources, map_each = _import_path)
+
+    ctx.actions.run(
+        executable = ctx.executable._protoc,
+        arguments = [args],
+        inputs = proto_info.transitive_descriptor_sets,
+        tools = [ctx.executable._plugin],
+        outputs = srcs,
+        mnemonic = "JsonCodecGen",
+        progress_message = "Generating JSON codecs for %s" % ctx.attr.proto.label,
+    )
+    return [DefaultInfo(files = depset(srcs))]
+
+def _import_path(src):
+    # protoc resolves files in --descriptor_set_in by their import path.
+    path = src.short_path
+    if path.startswith("../"):
+        path = path.split("/", 2)[2]
+    return path
+
+_json_codec_gen = rule(
+    implementation = _json_codec_gen_impl,
+    attrs = {
+        "proto": attr.label(mandatory = True, providers = [ProtoInfo]),
+        "_plugin": attr.label(
+            default = "//src/cpp/communication:json_codec_generator",
+            executable = True,
+            cfg = "exec",
+        ),
+        "_protoc": attr.label(
+            default = "@com_google_protobuf//:protoc",
+            executable = True,
+            cfg = "exec",
+        ),
+    },
+)
+
+def cc_json_codec_library(name, proto, cc_proto, **kwargs):
+    """Generates JSON codecs for the messages in `proto`.
+
+    For every `foo.proto` in `proto`, this generates `foo.json.cc`, which
+    registers a codec for each message defined in `foo.proto`. Once this
+    library is linked into a binary, JsonToProto() and ProtoToJson() from
+    json_utils.h use the generated code for those messages instead of
+    reflection, in every translation unit. There is no header to include.
+
+    Only proto3 files are supported. Fields whose type is defined in another
+    file, or is a well-known type, are still converted with reflection.
+
+    Args:
+      name: Name of the cc_library.
+      proto: The proto_library to generate codecs for. Must be in the same
+        package.
+      cc_proto: The cc_proto_library for `proto`.
+      **kwargs: Passed on to the cc_library, e.g. testonly or visibility.
+    """
+    _json_codec_gen(
+        name = name + "_gen",
+        proto = proto,
+        testonly = kwargs.get("testonly"),
+        visibility = ["//visibility:private"],
+    )
+    cc_library(
+        name = name,
+        srcs = [":" + name + "_gen"],
+        # Nothing refers to the generated codecs; they register themselves.
+        alwayslink = True,
+        deps = [
+            cc_proto,
+            "//src/cpp/communication:json_codec",
+            "//src/cpp/communication:json_proto_parser",
+            "//src/cpp/communication:json_proto_printer",
+            "//src/cpp/communication:json_reader",
+            "//src/cpp/communication:json_writer",
+            "@com_google_absl//absl/container:flat_hash_set",
+            "@com_google_absl//absl/status",
+            "@com_google_absl//absl/strings",
+            "@com_google_protobuf//:protobuf",
+        ],
+        **kwargs
+    )
@@ -0,0 +1,57 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/cpp/communication/json_codec.h"
+
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+// Process-wide map of message names to generated codecs.
+struct Registry {
+  absl::Mutex mutex;
+  absl::flat_hash_map<std::string, GeneratedJsonCodec> codecs
+      ABSL_GUARDED_BY(mutex);
+};
+
+Registry& GetRegistry() {
+  static auto* const registry = new Registry();
+  return *registry;
+}
+
+}  // namespace
+
+bool RegisterGeneratedJsonCodec(absl::string_view full_name,
+                                GeneratedJsonCodec codec) {
+  Registry& registry = GetRegistry();
+  absl::MutexLock l(&registry.mutex);
+  return registry.codecs.emplace(full_name, codec).second;
+}
+
+std::optional<GeneratedJsonCodec> FindGeneratedJsonCodec(
+    absl::string_view full_name) {
+  Registry& registry = GetRegistry();
+  absl::MutexLock l(&registry.mutex);
+  if (const auto it = registry.codecs.find(full_name);
+      it != registry.codecs.end()) {
+    return it->second;
+  }
+  return std::nullopt;
+}
+
+}  // namespace privacy_sandbox::server_common
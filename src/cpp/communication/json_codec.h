@@ -0,0 +1,92 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_CPP_COMMUNICATION_JSON_CODEC_H_
+#define SRC_CPP_COMMUNICATION_JSON_CODEC_H_
+
+#include <optional>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+#include "google/protobuf/message.h"
+#include "src/cpp/communication/json_proto_parser.h"
+#include "src/cpp/communication/json_proto_printer.h"
+
+namespace privacy_sandbox::server_common {
+
+// Decoder and encoder of one message type, generated by
+// cc_json_codec_library() in json_codec.bzl. They are only ever called with
+// messages of the type they are registered for.
+struct GeneratedJsonCodec {
+  absl::Status (*decode)(absl::string_view json,
+                         google::protobuf::Message* message,
+                         bool ignore_unknown_fields);
+  absl::Status (*encode)(const google::protobuf::Message& message,
+                         google::protobuf::io::ZeroCopyOutputStream* output);
+};
+
+// Registers `codec` for the messages named `full_name`, e.g. "pkg.Request".
+// Called by generated code during static initialization. Returns false, and
+// keeps the codec registered first, if there already is one.
+bool RegisterGeneratedJsonCodec(absl::string_view full_name,
+                                GeneratedJsonCodec codec);
+
+// Returns the codec registered for the messages named `full_name`, if any.
+std::optional<GeneratedJsonCodec> FindGeneratedJsonCodec(
+    absl::string_view full_name);
+
+// Converts messages of type ProtoMessage from and to JSON on behalf of
+// JsonToProto() and ProtoToJson().
+//
+// Messages whose codec is generated by cc_json_codec_library() use it as soon
+// as that library is linked in; all others go through reflection. The codec
+// is looked up once per message type, so there is a single definition of this
+// template for every translation unit, whatever it includes.
+template <typename ProtoMessage>
+struct JsonCodec {
+  // Merges `json` into `message`. See ParseJsonToProto().
+  static absl::Status Decode(absl::string_view json, ProtoMessage* message,
+                             bool ignore_unknown_fields) {
+    if (const std::optional<GeneratedJsonCodec>& codec = Generated();
+        codec.has_value()) {
+      return codec->decode(json, message, ignore_unknown_fields);
+    }
+    return ParseJsonToProto(json, message, ignore_unknown_fields);
+  }
+
+  // Writes the JSON of `message` to `output`. See PrintProtoAsJson().
+  static absl::Status Encode(
+      const ProtoMessage& message,
+      google::protobuf::io::ZeroCopyOutputStream* output) {
+    if (const std::optional<GeneratedJsonCodec>& codec = Generated();
+        codec.has_value()) {
+      return codec->encode(message, output);
+    }
+    return PrintProtoAsJson(message, output);
+  }
+
+ private:
+  static const std::optional<GeneratedJsonCodec>& Generated() {
+    static const std::optional<GeneratedJsonCodec> codec =
+        FindGeneratedJsonCodec(ProtoMessage::descriptor()->full_name());
+    return codec;
+  }
+};
+
+}  // namespace privacy_sandbox::server_common
+
+#endif  // SRC_CPP_COMMUNICATION_JSON_CODEC_H_
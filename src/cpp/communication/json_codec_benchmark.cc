@@ -0,0 +1,113 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compares the codecs generated by cc_json_codec_library() against the
+// reflection-based ParseJsonToProto() and PrintProtoAsJson().
+//
+// Run with:
+//   bazel run -c opt //src/cpp/communication:json_codec_benchmark
+
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "src/cpp/communication/json_proto_parser.h"
+#include "src/cpp/communication/json_proto_printer.h"
+#include "src/cpp/communication/json_utils.h"
+#include "src/cpp/communication/test_request.pb.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+using json_test::TestRequest;
+
+// Builds a request with `num_partitions` partitions, each looking up a handful
+// of keys.
+TestRequest MakeRequest(int num_partitions) {
+  TestRequest request;
+  request.set_client_version("Bna.PA.Buyer.20231017");
+  (*request.mutable_metadata())["hostname"] = "www.example.com";
+  (*request.mutable_metadata())["experimentGroupId"] = "1234";
+  for (int i = 0; i < num_partitions; ++i) {
+    auto* partition = request.add_partitions();
+    partition->set_id(i);
+    partition->set_compression_group_id(i % 4);
+    auto* argument = partition->add_arguments();
+    argument->add_tags("structured");
+    argument->add_tags("groupNames");
+    argument->add_data(absl::StrCat("interest_group_", i));
+    argument = partition->add_arguments();
+    argument->add_tags("custom");
+    argument->add_tags("keys");
+    for (int j = 0; j < 8; ++j) {
+      argument->add_data(absl::StrCat("ad_render_id_", i, "_", j));
+    }
+  }
+  return request;
+}
+
+void BM_Decode_Reflection(benchmark::State& state) {
+  const std::string json = ProtoToJson(MakeRequest(state.range(0))).value();
+  for (auto _ : state) {
+    TestRequest request;
+    auto status =
+        ParseJsonToProto(json, &request, /*ignore_unknown_fields=*/true);
+    benchmark::DoNotOptimize(status);
+    benchmark::DoNotOptimize(request);
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+
+void BM_Decode_Generated(benchmark::State& state) {
+  const std::string json = ProtoToJson(MakeRequest(state.range(0))).value();
+  for (auto _ : state) {
+    auto request = JsonToProto<TestRequest>(json);
+    benchmark::DoNotOptimize(request);
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+
+void BM_Encode_Reflection(benchmark::State& state) {
+  const TestRequest request = MakeRequest(state.range(0));
+  std::string json;
+  for (auto _ : state) {
+    json.clear();
+    google::protobuf::io::StringOutputStream stream(&json);
+    auto status = PrintProtoAsJson(request, &stream);
+    benchmark::DoNotOptimize(status);
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+
+void BM_Encode_Generated(benchmark::State& state) {
+  const TestRequest request = MakeRequest(state.range(0));
+  std::string json;
+  for (auto _ : state) {
+    json.clear();
+    auto status = ProtoToJson(request, &json);
+    benchmark::DoNotOptimize(status);
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+
+BENCHMARK(BM_Decode_Reflection)->Range(1, 256);
+BENCHMARK(BM_Decode_Generated)->Range(1, 256);
+BENCHMARK(BM_Encode_Reflection)->Range(1, 256);
+BENCHMARK(BM_Encode_Generated)->Range(1, 256);
+
+}  // namespace
+}  // namespace privacy_sandbox::server_common
+
+BENCHMARK_MAIN();
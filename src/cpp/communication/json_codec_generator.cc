@@ -0,0 +1,788 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// protoc plugin generating JSON codecs for the messages of a proto3 file.
+// Invoked through cc_json_codec_library() in json_codec.bzl.
+//
+// For foo/bar.proto, it generates foo/bar.json.cc with one decoder and one
+// encoder function per message, which it registers with JsonCodec.
+// Decoders dispatch on the member name with a switch on its length followed by
+// string comparisons, and read values with the typed JsonReader calls; encoders
+// call the generated accessors and JsonWriter directly. Neither touches the
+// descriptors or reflection at run time. Message fields whose type is defined
+// in another file, and well-known types, are converted by reflection.
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_replace.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "absl/strings/substitute.h"
+#include "google/protobuf/compiler/code_generator.h"
+#include "google/protobuf/compiler/plugin.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+using google::protobuf::Descriptor;
+using google::protobuf::EnumDescriptor;
+using google::protobuf::FieldDescriptor;
+using google::protobuf::FileDescriptor;
+using google::protobuf::compiler::GeneratorContext;
+
+// Appends lines of C++ at the current indentation. Lines are formatted with
+// absl::Substitute().
+class CodeWriter {
+ public:
+  template <typename... Args>
+  void Line(absl::string_view format, const Args&... args) {
+    if (!format.empty()) {
+      out_.append(2 * indent_, ' ');
+      absl::StrAppend(&out_, absl::Substitute(format, args...));
+    }
+    out_.push_back('\n');
+  }
+  void Indent() { ++indent_; }
+  void Outdent() { --indent_; }
+
+  const std::string& str() const { return out_; }
+
+ private:
+  std::string out_;
+  int indent_ = 0;
+};
+
+std::string StripProto(absl::string_view file_name) {
+  return std::string(absl::StripSuffix(file_name, ".proto"));
+}
+
+// Name of a message or enum relative to its package, as protoc's C++
+// generator spells it, e.g. Outer_Inner.
+template <typename DescriptorType>
+std::string RelativeClassName(const DescriptorType* descriptor) {
+  if (descriptor->containing_type() == nullptr) {
+    return descriptor->name();
+  }
+  return absl::StrCat(RelativeClassName(descriptor->containing_type()), "_",
+                      descriptor->name());
+}
+
+template <typename DescriptorType>
+std::string QualifiedClassName(const DescriptorType* descriptor) {
+  const std::string& package = descriptor->file()->package();
+  if (package.empty()) {
+    return absl::StrCat("::", RelativeClassName(descriptor));
+  }
+  return absl::StrCat("::", absl::StrReplaceAll(package, {{".", "::"}}),
+                      "::", RelativeClassName(descriptor));
+}
+
+// Name of the generated accessors of `field`. protoc's C++ generator appends
+// an underscore to names that are C++ keywords.
+std::string AccessorName(const FieldDescriptor* field) {
+  static const auto* const kKeywords = new absl::flat_hash_set<std::string>({
+      "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor",
+      "bool", "break", "case", "catch", "char", "class", "compl", "const",
+      "constexpr", "const_cast", "continue", "decltype", "default", "delete",
+      "do", "double", "dynamic_cast", "else", "enum", "explicit", "export",
+      "extern", "false", "float", "for", "friend", "goto", "if", "inline",
+      "int", "long", "mutable", "namespace", "new", "noexcept", "not", "not_eq",
+      "nullptr", "operator", "or", "or_eq", "private", "protected", "public",
+      "register", "reinterpret_cast", "return", "short", "signed", "sizeof",
+      "static", "static_assert", "static_cast", "struct", "switch", "template",
+      "this", "thread_local", "throw", "true", "try", "typedef", "typeid",
+      "typename", "union", "unsigned", "using", "virtual", "void", "volatile",
+      "wchar_t", "while", "xor", "xor_eq"});
+  std::string name = absl::AsciiStrToLower(field->name());
+  if (kKeywords->contains(name)) {
+    name.push_back('_');
+  }
+  return name;
+}
+
+bool IsWellKnownType(const Descriptor* descriptor) {
+  return descriptor->well_known_type() !=
+         Descriptor::WELLKNOWNTYPE_UNSPECIFIED;
+}
+
+bool IsValueMessage(const FieldDescriptor* field) {
+  return field->cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE &&
+         field->message_type()->well_known_type() ==
+             Descriptor::WELLKNOWNTYPE_VALUE;
+}
+
+bool IsNullValueEnum(const FieldDescriptor* field) {
+  return field->cpp_type() == FieldDescriptor::CPPTYPE_ENUM &&
+         field->enum_type()->full_name() == "google.protobuf.NullValue";
+}
+
+// JSON strings can't hold arbitrary names, but proto names and json_name
+// options only contain characters that need no escaping in a C++ literal.
+std::string QuotedKey(const FieldDescriptor* field) {
+  return absl::StrCat(R"("\")", field->json_name(), R"(\":")");
+}
+
+class FileGenerator {
+ public:
+  explicit FileGenerator(const FileDescriptor* file) : file_(file) {
+    for (int i = 0; i < file->message_type_count(); ++i) {
+      CollectMessages(file->message_type(i));
+    }
+  }
+
+  std::string GenerateSource() const {
+    CodeWriter out;
+    out.Line("// Generated by json_codec_generator from $0. DO NOT EDIT.",
+             file_->name());
+    out.Line("");
+    out.Line("#include <cmath>");
+    out.Line("#include <cstdint>");
+    out.Line("#include <string>");
+    out.Line("");
+    out.Line(R"(#include "absl/container/flat_hash_set.h")");
+    out.Line(R"(#include "absl/status/status.h")");
+    out.Line(R"(#include "absl/strings/str_cat.h")");
+    out.Line(R"(#include "absl/strings/string_view.h")");
+    out.Line(R"(#include "google/protobuf/io/zero_copy_stream.h")");
+    out.Line(R"(#include "google/protobuf/io/zero_copy_stream_impl_lite.h")");
+    out.Line(R"(#include "google/protobuf/message.h")");
+    out.Line(R"(#include "$0.pb.h")", StripProto(file_->name()));
+    out.Line(R"(#include "src/cpp/communication/json_codec.h")");
+    out.Line(R"(#include "src/cpp/communication/json_proto_parser.h")");
+    out.Line(R"(#include "src/cpp/communication/json_proto_printer.h")");
+    out.Line(R"(#include "src/cpp/communication/json_reader.h")");
+    out.Line(R"(#include "src/cpp/communication/json_writer.h")");
+    out.Line("");
+    out.Line("namespace privacy_sandbox::server_common {");
+    out.Line("namespace {");
+    out.Line("");
+    GenerateReflectionFallbacks(out);
+    for (const Descriptor* message : messages_) {
+      out.Line("absl::Status Decode$0(JsonReader& reader, $1* message, "
+               "int depth,",
+               RelativeClassName(message), QualifiedClassName(message));
+      out.Line("    bool ignore_unknown_fields);");
+      out.Line("absl::Status Encode$0(const $1& message, JsonWriter& writer);",
+               RelativeClassName(message), QualifiedClassName(message));
+    }
+    for (const Descriptor* message : messages_) {
+      out.Line("");
+      GenerateDecoder(message, out);
+      out.Line("");
+      GenerateEncoder(message, out);
+    }
+    for (const Descriptor* message : messages_) {
+      GenerateRegistration(message, out);
+    }
+    out.Line("");
+    out.Line("}  // namespace");
+    out.Line("}  // namespace privacy_sandbox::server_common");
+    return out.str();
+  }
+
+ private:
+  void CollectMessages(const Descriptor* message) {
+    if (message->options().map_entry() || IsWellKnownType(message)) {
+      return;
+    }
+    messages_.push_back(message);
+    for (int i = 0; i < message->nested_type_count(); ++i) {
+      CollectMessages(message->nested_type(i));
+    }
+  }
+
+  // Messages of this file get a generated codec; all others go through
+  // reflection.
+  bool HasGeneratedCodec(const Descriptor* message) const {
+    return message->file() == file_ && !IsWellKnownType(message) &&
+           !message->options().map_entry();
+  }
+
+  void GenerateReflectionFallbacks(CodeWriter& out) const {
+    out.Line("// Converts messages without a generated codec by reflection.");
+    out.Line("[[maybe_unused]] absl::Status DecodeWithReflection(");
+    out.Line("    JsonReader& reader, google::protobuf::Message* message, "
+             "int depth,");
+    out.Line("    bool ignore_unknown_fields) {");
+    out.Line("  absl::string_view json;");
+    out.Line("  if (absl::Status s = reader.ReadRawValue(&json, depth); "
+             "!s.ok()) {");
+    out.Line("    return s;");
+    out.Line("  }");
+    out.Line("  return ParseJsonToProto(json, message, "
+             "ignore_unknown_fields);");
+    out.Line("}");
+    out.Line("");
+    out.Line("[[maybe_unused]] absl::Status EncodeWithReflection(");
+    out.Line("    const google::protobuf::Message& message, "
+             "JsonWriter& writer) {");
+    out.Line("  std::string json;");
+    out.Line("  google::protobuf::io::StringOutputStream stream(&json);");
+    out.Line("  if (absl::Status s = PrintProtoAsJson(message, &stream); "
+             "!s.ok()) {");
+    out.Line("    return s;");
+    out.Line("  }");
+    out.Line("  writer.Write(json);");
+    out.Line("  return absl::OkStatus();");
+    out.Line("}");
+    out.Line("");
+  }
+
+  void GenerateDecoder(const Descriptor* message, CodeWriter& out) const {
+    out.Line("absl::Status Decode$0(JsonReader& reader, $1* message, "
+             "int depth,",
+             RelativeClassName(message), QualifiedClassName(message));
+    out.Line("    bool ignore_unknown_fields) {");
+    out.Indent();
+    out.Line("if (depth > JsonReader::kMaxRecursionDepth) {");
+    out.Line(R"(  return reader.Error("Message too deep");)");
+    out.Line("}");
+    out.Line("if (reader.Peek() != '{') {");
+    out.Line(R"(  return reader.Error("Expected an object for $0");)",
+             message->full_name());
+    out.Line("}");
+    if (message->field_count() > 0) {
+      out.Line("bool field_seen[$0] = {};", message->field_count());
+    }
+    if (message->real_oneof_decl_count() > 0) {
+      out.Line("bool oneof_seen[$0] = {};", message->real_oneof_decl_count());
+    }
+    out.Line("return reader.ReadObject([&](absl::string_view name) -> "
+             "absl::Status {");
+    out.Indent();
+    out.Line("int field_number = 0;");
+    GenerateNameDispatch(message, out);
+    out.Line("switch (field_number) {");
+    out.Indent();
+    for (int i = 0; i < message->field_count(); ++i) {
+      GenerateFieldDecoder(message->field(i), out);
+    }
+    out.Line("default:");
+    out.Line("  if (!ignore_unknown_fields) {");
+    out.Line(R"(    return reader.Error()"
+             R"(absl::StrCat("Cannot find field: ", name,)");
+    out.Line(R"(                                     " in message $0"));)",
+             message->full_name());
+    out.Line("  }");
+    out.Line("  return reader.SkipValue(depth + 1);");
+    out.Outdent();
+    out.Line("}");
+    out.Outdent();
+    out.Line("});");
+    out.Outdent();
+    out.Line("}");
+  }
+
+  // Maps the member name to a field number, accepting both the proto name and
+  // the JSON name. Proto names take precedence, as in ParseJsonToProto().
+  void GenerateNameDispatch(const Descriptor* message, CodeWriter& out) const {
+    std::vector<std::pair<std::string, int>> names;
+    absl::flat_hash_set<std::string> seen;
+    for (int i = 0; i < message->field_count(); ++i) {
+      if (seen.insert(message->field(i)->name()).second) {
+        names.emplace_back(message->field(i)->name(),
+                           message->field(i)->number());
+      }
+    }
+    for (int i = 0; i < message->field_count(); ++i) {
+      if (seen.insert(message->field(i)->json_name()).second) {
+        names.emplace_back(message->field(i)->json_name(),
+                           message->field(i)->number());
+      }
+    }
+    if (names.empty()) {
+      return;
+    }
+    std::vector<size_t> lengths;
+    for (const auto& [name, number] : names) {
+      if (std::find(lengths.begin(), lengths.end(), name.size()) ==
+          lengths.end()) {
+        lengths.push_back(name.size());
+      }
+    }
+    std::sort(lengths.begin(), lengths.end());
+
+    out.Line("switch (name.size()) {");
+    out.Indent();
+    for (size_t length : lengths) {
+      out.Line("case $0:", length);
+      out.Indent();
+      bool first = true;
+      for (const auto& [name, number] : names) {
+        if (name.size() != length) {
+          continue;
+        }
+        out.Line(R"($0if (name == "$1") {)", first ? "" : "} else ", name);
+        out.Line("  field_number = $0;", number);
+        first = false;
+      }
+      out.Line("}");
+      out.Line("break;");
+      out.Outdent();
+    }
+    out.Outdent();
+    out.Line("}");
+  }
+
+  void GenerateFieldDecoder(const FieldDescriptor* field,
+                            CodeWriter& out) const {
+    const std::string accessor = AccessorName(field);
+    out.Line("case $0: {", field->number());
+    out.Indent();
+    out.Line(R"(if (!reader.PeekLiteral("null")) {)");
+    out.Line("  if (field_seen[$0]) {", field->index());
+    out.Line(R"(    return reader.Error("Duplicate field $0");)", field->name());
+    out.Line("  }");
+    out.Line("  field_seen[$0] = true;", field->index());
+    out.Line("}");
+    if (field->real_containing_oneof() != nullptr) {
+      const int index = field->real_containing_oneof()->index();
+      out.Line(R"(if (!reader.PeekLiteral("null")) {)");
+      out.Line("  if (oneof_seen[$0]) {", index);
+      out.Line("    return reader.Error(");
+      out.Line(R"(        "Multiple oneof fields set for oneof $0");)",
+               field->real_containing_oneof()->full_name());
+      out.Line("  }");
+      out.Line("  oneof_seen[$0] = true;", index);
+      out.Line("}");
+    }
+    if (!IsValueMessage(field)) {
+      // null is the default value for every field.
+      out.Line(R"(if (reader.ConsumeLiteral("null")) {)");
+      if (IsNullValueEnum(field) && !field->is_repeated()) {
+        out.Line("  message->set_$0(static_cast<$1>(0));", accessor,
+                 QualifiedClassName(field->enum_type()));
+      }
+      out.Line("  return absl::OkStatus();");
+      out.Line("}");
+    }
+
+    if (field->is_map()) {
+      const FieldDescriptor* key = field->message_type()->map_key();
+      const FieldDescriptor* value = field->message_type()->map_value();
+      out.Line("if (reader.Peek() != '{') {");
+      out.Line(R"(  return reader.Error("Expected an object for map $0");)",
+               field->name());
+      out.Line("}");
+      out.Line("absl::flat_hash_set<$0> keys_seen;",
+               key->cpp_type() == FieldDescriptor::CPPTYPE_STRING
+                   ? "std::string"
+                   : ScalarType(key));
+      out.Line("return reader.ReadObject([&](absl::string_view key) -> "
+               "absl::Status {");
+      out.Indent();
+      std::string key_expr = "std::string(key)";
+      if (key->cpp_type() == FieldDescriptor::CPPTYPE_BOOL) {
+        out.Line(R"(if (key != "true" && key != "false") {)");
+        out.Line(R"(  return reader.Error()"
+                 R"(absl::StrCat("Invalid map key: ", key));)");
+        out.Line("}");
+        key_expr = R"(key == "true")";
+      } else if (key->cpp_type() != FieldDescriptor::CPPTYPE_STRING) {
+        out.Line("$0 map_key;", ScalarType(key));
+        out.Line("if (!JsonReader::ParseInteger(key, &map_key)) {");
+        out.Line(R"(  return reader.Error()"
+                 R"(absl::StrCat("Invalid map key: ", key));)");
+        out.Line("}");
+        key_expr = "map_key";
+      }
+      if (!IsValueMessage(value)) {
+        out.Line(R"(if (reader.PeekLiteral("null")) {)");
+        out.Line("  return reader.Error(");
+        out.Line(R"(      "null is not allowed as a map value in $0");)",
+                 field->name());
+        out.Line("}");
+      }
+      out.Line("const auto [key_it, inserted] = keys_seen.emplace($0);",
+               key_expr);
+      out.Line("if (!inserted) {");
+      out.Line("  return reader.Error(");
+      out.Line(R"(      absl::StrCat("Duplicate map key: ", key));)");
+      out.Line("}");
+      out.Line("auto& entry = (*message->mutable_$0())[*key_it];", accessor);
+      GenerateValueDecoder(value, "&entry", "entry = value;", out);
+      out.Outdent();
+      out.Line("});");
+    } else if (field->is_repeated()) {
+      out.Line("if (reader.Peek() != '[') {");
+      out.Line(R"(  return reader.Error("Expected an array for $0");)",
+               field->name());
+      out.Line("}");
+      out.Line("return reader.ReadArray([&]() -> absl::Status {");
+      out.Indent();
+      if (!IsValueMessage(field)) {
+        out.Line(R"(if (reader.PeekLiteral("null")) {)");
+        out.Line("  return reader.Error(");
+        out.Line(R"(      "null is not allowed in repeated field $0");)",
+                 field->name());
+        out.Line("}");
+      }
+      GenerateValueDecoder(field, absl::StrCat("message->add_", accessor, "()"),
+                           absl::StrCat("message->add_", accessor, "(value);"),
+                           out);
+      out.Outdent();
+      out.Line("});");
+    } else {
+      GenerateValueDecoder(
+          field, absl::StrCat("message->mutable_", accessor, "()"),
+          absl::StrCat("message->set_", accessor, "(value);"), out);
+    }
+    out.Outdent();
+    out.Line("}");
+  }
+
+  // Reads one non-null value of `field`. Strings and messages are read into
+  // `pointer`; scalars into a local `value` that `assign` stores. Every path
+  // returns.
+  void GenerateValueDecoder(const FieldDescriptor* field,
+                            absl::string_view pointer,
+                            absl::string_view assign, CodeWriter& out) const {
+    switch (field->cpp_type()) {
+      case FieldDescriptor::CPPTYPE_MESSAGE:
+        out.Line("return $0(reader, $1, depth + 1, ignore_unknown_fields);",
+                 HasGeneratedCodec(field->message_type())
+                     ? absl::StrCat("Decode",
+                                    RelativeClassName(field->message_type()))
+                     : "DecodeWithReflection",
+                 pointer);
+        return;
+      case FieldDescriptor::CPPTYPE_STRING:
+        out.Line("return reader.$0($1);",
+                 field->type() == FieldDescriptor::TYPE_BYTES ? "ReadBytes"
+                                                              : "ReadString",
+                 pointer);
+        return;
+      case FieldDescriptor::CPPTYPE_ENUM: {
+        const std::string type = QualifiedClassName(field->enum_type());
+        out.Line("if (reader.Peek() == '\"') {");
+        out.Indent();
+        out.Line("absl::string_view enum_name;");
+        out.Line("std::string scratch;");
+        out.Line("if (absl::Status s = reader.ReadString(&enum_name, "
+                 "&scratch);");
+        out.Line("    !s.ok()) {");
+        out.Line("  return s;");
+        out.Line("}");
+        out.Line("$0 value;", type);
+        out.Line("if (!$0_Parse(enum_name, &value)) {", type);
+        out.Line("  if (ignore_unknown_fields) {");
+        out.Line("    return absl::OkStatus();");
+        out.Line("  }");
+        out.Line(R"(  return reader.Error(absl::StrCat()");
+        out.Line(R"(      "Invalid enum value ", enum_name, " for $0"));)",
+                 field->name());
+        out.Line("}");
+        out.Line("$0", assign);
+        out.Line("return absl::OkStatus();");
+        out.Outdent();
+        out.Line("}");
+        out.Line("int number;");
+        out.Line("if (absl::Status s = reader.ReadInteger(&number); "
+                 "!s.ok()) {");
+        out.Line("  return s;");
+        out.Line("}");
+        out.Line("const $0 value = static_cast<$0>(number);", type);
+        out.Line("$0", assign);
+        out.Line("return absl::OkStatus();");
+        return;
+      }
+      default:
+        out.Line("$0 value;", ScalarType(field));
+        out.Line("if (absl::Status s = reader.$0(&value); !s.ok()) {",
+                 ScalarReader(field));
+        out.Line("  return s;");
+        out.Line("}");
+        out.Line("$0", assign);
+        out.Line("return absl::OkStatus();");
+        return;
+    }
+  }
+
+  void GenerateEncoder(const Descriptor* message, CodeWriter& out) const {
+    out.Line("absl::Status Encode$0(const $1& message, JsonWriter& writer) {",
+             RelativeClassName(message), QualifiedClassName(message));
+    out.Indent();
+    out.Line("writer.WriteChar('{');");
+    // Fields are written in field number order, like the reflection printer.
+    std::vector<const FieldDescriptor*> fields;
+    for (int i = 0; i < message->field_count(); ++i) {
+      fields.push_back(message->field(i));
+    }
+    std::sort(fields.begin(), fields.end(),
+              [](const FieldDescriptor* a, const FieldDescriptor* b) {
+                return a->number() < b->number();
+              });
+    if (!fields.empty()) {
+      out.Line("bool first = true;");
+    }
+    for (const FieldDescriptor* field : fields) {
+      const std::string accessor = AccessorName(field);
+      out.Line("if ($0) {", PresenceCondition(field));
+      out.Indent();
+      out.Line(R"(writer.WriteKey(&first, $0);)", QuotedKey(field));
+      if (field->is_map()) {
+        const FieldDescriptor* key = field->message_type()->map_key();
+        out.Line("writer.WriteChar('{');");
+        out.Line("bool first_entry = true;");
+        out.Line("for (const auto& [key, value] : message.$0()) {", accessor);
+        out.Indent();
+        out.Line("writer.WriteSeparator(&first_entry);");
+        switch (key->cpp_type()) {
+          case FieldDescriptor::CPPTYPE_STRING:
+            out.Line("writer.WriteString(key);");
+            break;
+          case FieldDescriptor::CPPTYPE_BOOL:
+            out.Line(R"(writer.WriteQuoted(key ? "true" : "false");)");
+            break;
+          case FieldDescriptor::CPPTYPE_INT64:
+            out.Line("writer.WriteInt64(key);");
+            break;
+          case FieldDescriptor::CPPTYPE_UINT64:
+            out.Line("writer.WriteUInt64(key);");
+            break;
+          default:
+            out.Line("writer.WriteQuoted(absl::AlphaNum(key).Piece());");
+            break;
+        }
+        out.Line("writer.WriteChar(':');");
+        GenerateValueEncoder(field->message_type()->map_value(), "value", out);
+        out.Outdent();
+        out.Line("}");
+        out.Line("writer.WriteChar('}');");
+      } else if (field->is_repeated()) {
+        out.Line("writer.WriteChar('[');");
+        out.Line("for (int i = 0; i < message.$0_size(); ++i) {", accessor);
+        out.Indent();
+        out.Line("if (i > 0) {");
+        out.Line("  writer.WriteChar(',');");
+        out.Line("}");
+        GenerateValueEncoder(field, absl::StrCat("message.", accessor, "(i)"),
+                             out);
+        out.Outdent();
+        out.Line("}");
+        out.Line("writer.WriteChar(']');");
+      } else {
+        GenerateValueEncoder(field, absl::StrCat("message.", accessor, "()"),
+                             out);
+      }
+      out.Outdent();
+      out.Line("}");
+    }
+    out.Line("writer.WriteChar('}');");
+    out.Line("return absl::OkStatus();");
+    out.Outdent();
+    out.Line("}");
+  }
+
+  // Mirrors which fields Reflection::ListFields() returns.
+  std::string PresenceCondition(const FieldDescriptor* field) const {
+    const std::string accessor = AccessorName(field);
+    if (field->is_repeated()) {
+      return absl::StrCat("message.", accessor, "_size() > 0");
+    }
+    if (field->has_presence()) {
+      return absl::StrCat("message.has_", accessor, "()");
+    }
+    switch (field->cpp_type()) {
+      case FieldDescriptor::CPPTYPE_STRING:
+        return absl::StrCat("!message.", accessor, "().empty()");
+      case FieldDescriptor::CPPTYPE_BOOL:
+        return absl::StrCat("message.", accessor, "()");
+      case FieldDescriptor::CPPTYPE_DOUBLE:
+      case FieldDescriptor::CPPTYPE_FLOAT:
+        // -0.0 is not the default value.
+        return absl::Substitute(
+            "message.$0() != 0 || std::signbit(message.$0())", accessor);
+      default:
+        return absl::StrCat("message.", accessor, "() != 0");
+    }
+  }
+
+  void GenerateValueEncoder(const FieldDescriptor* field,
+                            absl::string_view value, CodeWriter& out) const {
+    switch (field->cpp_type()) {
+      case FieldDescriptor::CPPTYPE_MESSAGE:
+        out.Line("if (absl::Status s = $0($1, writer); !s.ok()) {",
+                 HasGeneratedCodec(field->message_type())
+                     ? absl::StrCat("Encode",
+                                    RelativeClassName(field->message_type()))
+                     : "EncodeWithReflection",
+                 value);
+        out.Line("  return s;");
+        out.Line("}");
+        return;
+      case FieldDescriptor::CPPTYPE_STRING:
+        out.Line("writer.$0($1);",
+                 field->type() == FieldDescriptor::TYPE_BYTES ? "WriteBytes"
+                                                              : "WriteString",
+                 value);
+        return;
+      case FieldDescriptor::CPPTYPE_ENUM:
+        if (IsNullValueEnum(field)) {
+          out.Line(R"(writer.Write("null");)");
+          return;
+        }
+        // Values unknown to the enum are written as numbers.
+        out.Line("if (const auto& name = $0_Name($1); !name.empty()) {",
+                 QualifiedClassName(field->enum_type()), value);
+        out.Line("  writer.WriteQuoted(name);");
+        out.Line("} else {");
+        out.Line("  writer.WriteInt32($0);", value);
+        out.Line("}");
+        return;
+      default:
+        out.Line("writer.$0($1);", ScalarWriter(field), value);
+        return;
+    }
+  }
+
+  // Registers the codec of `message` with JsonCodec, see json_codec.h.
+  void GenerateRegistration(const Descriptor* message, CodeWriter& out) const {
+    const std::string name = RelativeClassName(message);
+    const std::string type = QualifiedClassName(message);
+    out.Line("");
+    out.Line("const bool k$0Registered = RegisterGeneratedJsonCodec(", name);
+    out.Line("    \"$0\",", message->full_name());
+    out.Line("    {[](absl::string_view json, "
+             "google::protobuf::Message* message,");
+    out.Line("        bool ignore_unknown_fields) -> absl::Status {");
+    out.Line("       JsonReader reader(json);");
+    out.Line("       reader.SkipWhitespace();");
+    out.Line("       if (absl::Status s = Decode$0(", name);
+    out.Line("               reader, static_cast<$0*>(message), /*depth=*/0,",
+             type);
+    out.Line("               ignore_unknown_fields);");
+    out.Line("           !s.ok()) {");
+    out.Line("         return s;");
+    out.Line("       }");
+    out.Line("       return reader.ExpectEnd();");
+    out.Line("     },");
+    out.Line("     [](const google::protobuf::Message& message,");
+    out.Line("        google::protobuf::io::ZeroCopyOutputStream* output)");
+    out.Line("         -> absl::Status {");
+    out.Line("       JsonWriter writer(output);");
+    out.Line("       if (absl::Status s = Encode$0(", name);
+    out.Line("               static_cast<const $0&>(message), writer);", type);
+    out.Line("           !s.ok()) {");
+    out.Line("         return s;");
+    out.Line("       }");
+    out.Line("       return writer.status();");
+    out.Line("     }});");
+  }
+
+  static std::string ScalarType(const FieldDescriptor* field) {
+    switch (field->cpp_type()) {
+      case FieldDescriptor::CPPTYPE_INT32:
+        return "int32_t";
+      case FieldDescriptor::CPPTYPE_INT64:
+        return "int64_t";
+      case FieldDescriptor::CPPTYPE_UINT32:
+        return "uint32_t";
+      case FieldDescriptor::CPPTYPE_UINT64:
+        return "uint64_t";
+      case FieldDescriptor::CPPTYPE_DOUBLE:
+        return "double";
+      case FieldDescriptor::CPPTYPE_FLOAT:
+        return "float";
+      default:
+        return "bool";
+    }
+  }
+
+  static std::string ScalarReader(const FieldDescriptor* field) {
+    switch (field->cpp_type()) {
+      case FieldDescriptor::CPPTYPE_DOUBLE:
+        return "ReadDouble";
+      case FieldDescriptor::CPPTYPE_FLOAT:
+        return "ReadFloat";
+      case FieldDescriptor::CPPTYPE_BOOL:
+        return "ReadBool";
+      default:
+        return "ReadInteger";
+    }
+  }
+
+  static std::string ScalarWriter(const FieldDescriptor* field) {
+    switch (field->cpp_type()) {
+      case FieldDescriptor::CPPTYPE_INT32:
+        return "WriteInt32";
+      case FieldDescriptor::CPPTYPE_INT64:
+        return "WriteInt64";
+      case FieldDescriptor::CPPTYPE_UINT32:
+        return "WriteUInt32";
+      case FieldDescriptor::CPPTYPE_UINT64:
+        return "WriteUInt64";
+      case FieldDescriptor::CPPTYPE_DOUBLE:
+        return "WriteDouble";
+      case FieldDescriptor::CPPTYPE_FLOAT:
+        return "WriteFloat";
+      default:
+        return "WriteBool";
+    }
+  }
+
+  const FileDescriptor* file_;
+  std::vector<const Descriptor*> messages_;
+};
+
+bool WriteFile(GeneratorContext* context, const std::string& name,
+               const std::string& contents) {
+  std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> output(
+      context->Open(name));
+  google::protobuf::io::CodedOutputStream coded_output(output.get());
+  coded_output.WriteRaw(contents.data(), contents.size());
+  return !coded_output.HadError();
+}
+
+class JsonCodecGenerator : public google::protobuf::compiler::CodeGenerator {
+ public:
+  bool Generate(const FileDescriptor* file, const std::string& parameter,
+                GeneratorContext* context, std::string* error) const override {
+    if (file->syntax() != FileDescriptor::SYNTAX_PROTO3) {
+      *error = absl::StrCat(file->name(),
+                            ": JSON codecs are only generated for proto3");
+      return false;
+    }
+    const FileGenerator generator(file);
+    const std::string base = StripProto(file->name());
+    if (!WriteFile(context, absl::StrCat(base, ".json.cc"),
+                   generator.GenerateSource())) {
+      *error = absl::StrCat(file->name(), ": failed to write JSON codec");
+      return false;
+    }
+    return true;
+  }
+
+  uint64_t GetSupportedFeatures() const override {
+    return FEATURE_PROTO3_OPTIONAL;
+  }
+};
+
+}  // namespace
+}  // namespace privacy_sandbox::server_common
+
+int main(int argc, char* argv[]) {
+  privacy_sandbox::server_common::JsonCodecGenerator generator;
+  return google::protobuf::compiler::PluginMain(argc, argv, &generator);
+}
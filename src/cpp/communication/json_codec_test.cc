@@ -0,0 +1,236 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/text_format.h"
+#include "google/protobuf/util/message_differencer.h"
+#include "gtest/gtest.h"
+#include "src/cpp/communication/json_proto_parser.h"
+#include "src/cpp/communication/json_proto_printer.h"
+#include "src/cpp/communication/json_utils.h"
+#include "src/cpp/communication/test_request.pb.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+using google::protobuf::util::MessageDifferencer;
+using json_test::TestAllTypes;
+using json_test::TestNestedRequest;
+using json_test::TestRequest;
+
+// Decodes `json` with both the generated codec and reflection and expects the
+// same result.
+template <typename ProtoMessage>
+void ExpectSameDecoding(absl::string_view json) {
+  ProtoMessage expected;
+  const absl::Status expected_status =
+      ParseJsonToProto(json, &expected, /*ignore_unknown_fields=*/true);
+  ASSERT_TRUE(expected_status.ok()) << expected_status << " for " << json;
+
+  ProtoMessage actual;
+  const absl::Status status = JsonCodec<ProtoMessage>::Decode(
+      json, &actual, /*ignore_unknown_fields=*/true);
+  ASSERT_TRUE(status.ok()) << status << " for " << json;
+  EXPECT_TRUE(MessageDifferencer::Equals(expected, actual))
+      << "expected: " << expected.DebugString()
+      << "actual: " << actual.DebugString();
+}
+
+// Encodes `message` with both the generated codec and reflection and expects
+// the same JSON.
+template <typename ProtoMessage>
+void ExpectSameEncoding(const ProtoMessage& message) {
+  std::string expected;
+  {
+    google::protobuf::io::StringOutputStream stream(&expected);
+    ASSERT_TRUE(PrintProtoAsJson(message, &stream).ok());
+  }
+  std::string actual;
+  {
+    google::protobuf::io::StringOutputStream stream(&actual);
+    ASSERT_TRUE(JsonCodec<ProtoMessage>::Encode(message, &stream).ok());
+  }
+  EXPECT_EQ(actual, expected);
+}
+
+TEST(JsonCodecTest, RegistersGeneratedCodecs) {
+  for (absl::string_view name : {TestRequest::descriptor()->full_name(),
+                                 TestNestedRequest::descriptor()->full_name(),
+                                 TestAllTypes::descriptor()->full_name()}) {
+    EXPECT_TRUE(FindGeneratedJsonCodec(name).has_value()) << name;
+  }
+}
+
+TEST(JsonCodecTest, DecodesLikeReflection) {
+  ExpectSameDecoding<TestRequest>(R"json(
+    {
+      "clientVersion": "v1",
+      "metadata": {"hostname": "example.com", "lang": "en"},
+      "partitions": [
+        {"id": "1", "compression_group_id": 7, "arguments": [
+          {"tags": ["structured", "groupNames"], "data": ["a", "b\n"]},
+          {"tags": ["custom", "keys"], "data": ["k1", "k2", "k3"]}
+        ]},
+        {"id": 2, "arguments": null},
+        {}
+      ],
+      "unknown": {"a": [1, {"b": "\"}"}]}
+    })json");
+
+  ExpectSameDecoding<TestAllTypes>(R"json(
+    {
+      "int32Value": -12,
+      "int64_value": "-9223372036854775808",
+      "uint32Value": 4294967295,
+      "uint64Value": "18446744073709551615",
+      "sint32Value": 1e3,
+      "sfixed64Value": 5,
+      "doubleValue": 1.5e-3,
+      "floatValue": "Infinity",
+      "boolValue": true,
+      "stringValue": "tab\there \"quoted\" é",
+      "bytesValue": "aGVsbG8=",
+      "enumValue": "TEST_ENUM_BAR",
+      "messageValue": {"tags": ["x"]},
+      "repeatedInt32": [1, 2, 3],
+      "repeatedEnum": ["TEST_ENUM_FOO", 2, "UNKNOWN"],
+      "repeatedMessage": [{"data": ["d"]}, {}],
+      "int32KeyedMap": {"1": "one", "-2": "minus two"},
+      "boolKeyedMap": {"true": {"tags": ["t"]}},
+      "choiceInt32": 3,
+      "optionalInt32": 0,
+      "customName": 9,
+      "structValue": {"nested": {"list": [1, "two", null, false]}},
+      "timestampValue": "2023-01-01T00:00:00Z",
+      "value": null
+    })json");
+}
+
+TEST(JsonCodecTest, EncodesLikeReflection) {
+  TestAllTypes message;
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(
+      R"pb(
+        int32_value: -12
+        int64_value: -9223372036854775808
+        uint64_value: 18446744073709551615
+        double_value: -0.0
+        float_value: 3.4
+        bool_value: true
+        string_value: "tab\there \"quoted\" <b> \303\251"
+        bytes_value: "\000\377hello"
+        enum_value: TEST_ENUM_BAR
+        message_value { tags: "x" }
+        repeated_int32: [ 1, 2, 3 ]
+        repeated_enum: [ TEST_ENUM_FOO, TEST_ENUM_BAR ]
+        repeated_message {}
+        repeated_message { data: "d" }
+        int32_keyed_map { key: -2 value: "minus two" }
+        bool_keyed_map {
+          key: true
+          value { tags: "t" }
+        }
+        choice_string: "chosen"
+        optional_int32: 0
+        renamed_value: 9
+        struct_value {
+          fields {
+            key: "list"
+            value { list_value { values { number_value: 1 } } }
+          }
+        }
+        timestamp_value { seconds: 1672531200 }
+      )pb",
+      &message));
+  message.add_repeated_enum(static_cast<json_test::TestEnum>(42));
+  ExpectSameEncoding(message);
+  ExpectSameEncoding(TestAllTypes());
+}
+
+TEST(JsonCodecTest, RoundTripsNestedMessages) {
+  TestNestedRequest request;
+  TestNestedRequest* current = &request;
+  for (int i = 0; i < 10; ++i) {
+    current->add_arguments()->add_data(absl::StrCat("level_", i));
+    current = current->mutable_child();
+  }
+  ExpectSameEncoding(request);
+
+  const std::string json = ProtoToJson(request).value();
+  const auto decoded = JsonToProto<TestNestedRequest>(json);
+  ASSERT_TRUE(decoded.ok()) << decoded.status();
+  EXPECT_TRUE(MessageDifferencer::Equals(request, *decoded));
+}
+
+// Decodes `json` with both the generated codec and reflection and expects both
+// to reject it.
+template <typename ProtoMessage>
+void ExpectBothReject(absl::string_view json,
+                      bool ignore_unknown_fields = true) {
+  ProtoMessage expected;
+  EXPECT_TRUE(absl::IsInvalidArgument(
+      ParseJsonToProto(json, &expected, ignore_unknown_fields)))
+      << "reflection accepted " << json;
+  ProtoMessage actual;
+  EXPECT_TRUE(absl::IsInvalidArgument(
+      JsonCodec<ProtoMessage>::Decode(json, &actual, ignore_unknown_fields)))
+      << "generated codec accepted " << json;
+}
+
+TEST(JsonCodecTest, RejectsWhatReflectionRejects) {
+  for (absl::string_view json : {
+           R"json()json",
+           R"json({"int32Value": 1}})json",
+           R"json({"int32Value": 2147483648})json",
+           R"json({"int32Value": 1.5})json",
+           R"json({"uint32Value": -1})json",
+           R"json({"boolValue": "true"})json",
+           R"json({"stringValue": 1})json",
+           R"json({"bytesValue": "not base64!"})json",
+           R"json({"repeatedInt32": [null]})json",
+           R"json({"repeatedInt32": {}})json",
+           R"json({"int32KeyedMap": {"a": "b"}})json",
+           R"json({"boolKeyedMap": {"yes": {}}})json",
+           R"json({"choiceString": "a", "choiceInt32": 1})json",
+           R"json({"timestampValue": "yesterday"})json",
+           R"json({"int32Value": " 1"})json",
+           R"json({"int32Value": 1, "int32_value": 2})json",
+           R"json({"repeatedInt32": [1], "repeatedInt32": [2]})json",
+           R"json({"int32KeyedMap": {"1": "a", "1": "b"}})json",
+           R"json({"int32KeyedMap": {"1": "a", "1e0": "b"}})json",
+           R"json({"boolKeyedMap": {"true": {}, "true": {}}})json",
+           "{\"stringValue\": \"\xff\"}",
+       }) {
+    ExpectBothReject<TestAllTypes>(json);
+  }
+  ExpectBothReject<TestRequest>(
+      R"json({"metadata": {"a": "1", "a": "2"}})json");
+  ExpectBothReject<TestRequest>(R"json({"unknown": 1})json",
+                                /*ignore_unknown_fields=*/false);
+}
+
+TEST(JsonCodecTest, AcceptsMapKeysAlreadyInTheMessage) {
+  TestRequest request;
+  (*request.mutable_metadata())["a"] = "1";
+  ASSERT_TRUE(JsonCodec<TestRequest>::Decode(
+                  R"json({"metadata": {"a": "2"}})json", &request,
+                  /*ignore_unknown_fields=*/true)
+                  .ok());
+  EXPECT_EQ(request.metadata().at("a"), "2");
+}
+
+}  // namespace
+}  // namespace privacy_sandbox::server_common
@@ -0,0 +1,445 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/cpp/communication/json_proto_parser.h"
+
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/container/inlined_vector.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/message.h"
+#include "google/protobuf/util/json_util.h"
+#include "src/cpp/communication/json_reader.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+using google::protobuf::Descriptor;
+using google::protobuf::EnumValueDescriptor;
+using google::protobuf::FieldDescriptor;
+using google::protobuf::Message;
+using google::protobuf::OneofDescriptor;
+using google::protobuf::Reflection;
+
+// Types whose JSON form is not a plain object of fields. These are handed to
+// the protobuf library as-is.
+bool HasSpecialJsonMapping(const Descriptor* descriptor) {
+  return descriptor->well_known_type() !=
+         Descriptor::WELLKNOWNTYPE_UNSPECIFIED;
+}
+
+bool IsNullValueEnum(const FieldDescriptor* field) {
+  return field->cpp_type() == FieldDescriptor::CPPTYPE_ENUM &&
+         field->enum_type()->full_name() == "google.protobuf.NullValue";
+}
+
+bool IsValueMessage(const FieldDescriptor* field) {
+  return field->cpp_type() == FieldDescriptor::CPPTYPE_MESSAGE &&
+         field->message_type()->well_known_type() ==
+             Descriptor::WELLKNOWNTYPE_VALUE;
+}
+
+// Formats the key of a map entry so that equal keys have equal text, however
+// they were spelled in the JSON.
+std::string MapKeyText(const Message& entry, const FieldDescriptor* key_field) {
+  const Reflection* reflection = entry.GetReflection();
+  switch (key_field->cpp_type()) {
+    case FieldDescriptor::CPPTYPE_BOOL:
+      return reflection->GetBool(entry, key_field) ? "true" : "false";
+    case FieldDescriptor::CPPTYPE_INT32:
+      return absl::StrCat(reflection->GetInt32(entry, key_field));
+    case FieldDescriptor::CPPTYPE_INT64:
+      return absl::StrCat(reflection->GetInt64(entry, key_field));
+    case FieldDescriptor::CPPTYPE_UINT32:
+      return absl::StrCat(reflection->GetUInt32(entry, key_field));
+    case FieldDescriptor::CPPTYPE_UINT64:
+      return absl::StrCat(reflection->GetUInt64(entry, key_field));
+    default:
+      return reflection->GetString(entry, key_field);
+  }
+}
+
+// Looks a field up by its proto name and then by its JSON name.
+const FieldDescriptor* FindField(const Descriptor* descriptor,
+                                 absl::string_view name) {
+  if (const FieldDescriptor* field = descriptor->FindFieldByName(name);
+      field != nullptr) {
+    return field;
+  }
+  if (const FieldDescriptor* field = descriptor->FindFieldByCamelcaseName(name);
+      field != nullptr && field->json_name() == name) {
+    return field;
+  }
+  // Custom json_name options don't map to the camelcase index.
+  for (int i = 0; i < descriptor->field_count(); ++i) {
+    if (descriptor->field(i)->json_name() == name) {
+      return descriptor->field(i);
+    }
+  }
+  return nullptr;
+}
+
+// Single-pass recursive descent parser. Not thread-safe; one instance per
+// input.
+class JsonProtoParser {
+ public:
+  JsonProtoParser(absl::string_view json, bool ignore_unknown_fields)
+      : reader_(json), ignore_unknown_fields_(ignore_unknown_fields) {}
+
+  absl::Status Parse(Message* message) {
+    reader_.SkipWhitespace();
+    if (absl::Status s = ParseMessage(message, /*depth=*/0); !s.ok()) {
+      return s;
+    }
+    return reader_.ExpectEnd();
+  }
+
+ private:
+  absl::Status ParseMessage(Message* message, int depth) {
+    if (depth > JsonReader::kMaxRecursionDepth) {
+      return reader_.Error("Message too deep");
+    }
+    const Descriptor* descriptor = message->GetDescriptor();
+    if (HasSpecialJsonMapping(descriptor)) {
+      return ParseWithProtobufLibrary(message, depth);
+    }
+    if (reader_.Peek() != '{') {
+      return reader_.Error(
+          absl::StrCat("Expected an object for ", descriptor->full_name()));
+    }
+
+    // Indexed by FieldDescriptor::index(). A field may only be given once,
+    // under either of its names.
+    absl::InlinedVector<bool, 32> fields_seen(descriptor->field_count());
+    absl::InlinedVector<const OneofDescriptor*, 4> oneofs_seen;
+    return reader_.ReadObject([&](absl::string_view name) -> absl::Status {
+      const FieldDescriptor* field = FindField(descriptor, name);
+      if (field == nullptr) {
+        if (!ignore_unknown_fields_) {
+          return reader_.Error(absl::StrCat("Cannot find field: ", name,
+                                            " in message ",
+                                            descriptor->full_name()));
+        }
+        return reader_.SkipValue(depth + 1);
+      }
+      if (!reader_.PeekLiteral("null")) {
+        if (fields_seen[field->index()]) {
+          return reader_.Error(
+              absl::StrCat("Duplicate field ", field->name()));
+        }
+        fields_seen[field->index()] = true;
+      }
+      if (const OneofDescriptor* oneof = field->real_containing_oneof();
+          oneof != nullptr && !reader_.PeekLiteral("null")) {
+        for (const OneofDescriptor* seen : oneofs_seen) {
+          if (seen == oneof) {
+            return reader_.Error(absl::StrCat(
+                "Multiple oneof fields set for oneof ", oneof->full_name()));
+          }
+        }
+        oneofs_seen.push_back(oneof);
+      }
+      return ParseField(message, field, depth);
+    });
+  }
+
+  absl::Status ParseField(Message* message, const FieldDescriptor* field,
+                          int depth) {
+    if (!IsValueMessage(field) && reader_.ConsumeLiteral("null")) {
+      // null is the default value for every field.
+      if (IsNullValueEnum(field) && !field->is_repeated()) {
+        message->GetReflection()->SetEnumValue(message, field, 0);
+      }
+      return absl::OkStatus();
+    }
+    if (field->is_map()) {
+      return ParseMap(message, field, depth);
+    }
+    if (field->is_repeated()) {
+      return ParseRepeated(message, field, depth);
+    }
+    return ParseValue(message, field, /*repeated=*/false, depth);
+  }
+
+  absl::Status ParseRepeated(Message* message, const FieldDescriptor* field,
+                             int depth) {
+    if (reader_.Peek() != '[') {
+      return reader_.Error(
+          absl::StrCat("Expected an array for ", field->name()));
+    }
+    return reader_.ReadArray([&]() -> absl::Status {
+      if (reader_.PeekLiteral("null") && !IsValueMessage(field)) {
+        return reader_.Error(absl::StrCat(
+            "null is not allowed in repeated field ", field->name()));
+      }
+      return ParseValue(message, field, /*repeated=*/true, depth);
+    });
+  }
+
+  absl::Status ParseMap(Message* message, const FieldDescriptor* field,
+                        int depth) {
+    if (reader_.Peek() != '{') {
+      return reader_.Error(
+          absl::StrCat("Expected an object for map ", field->name()));
+    }
+    const FieldDescriptor* key_field = field->message_type()->map_key();
+    const FieldDescriptor* value_field = field->message_type()->map_value();
+    absl::flat_hash_set<std::string> keys_seen;
+    return reader_.ReadObject([&](absl::string_view key) -> absl::Status {
+      Message* entry = message->GetReflection()->AddMessage(message, field);
+      if (absl::Status s = SetMapKey(entry, key_field, key); !s.ok()) {
+        return s;
+      }
+      if (!keys_seen.insert(MapKeyText(*entry, key_field)).second) {
+        return reader_.Error(absl::StrCat("Duplicate map key: ", key));
+      }
+      if (reader_.PeekLiteral("null") && !IsValueMessage(value_field)) {
+        return reader_.Error(absl::StrCat(
+            "null is not allowed as a map value in ", field->name()));
+      }
+      return ParseValue(entry, value_field, /*repeated=*/false, depth + 1);
+    });
+  }
+
+  absl::Status SetMapKey(Message* entry, const FieldDescriptor* key_field,
+                         absl::string_view key) {
+    const Reflection* reflection = entry->GetReflection();
+    switch (key_field->cpp_type()) {
+      case FieldDescriptor::CPPTYPE_STRING:
+        reflection->SetString(entry, key_field, std::string(key));
+        return absl::OkStatus();
+      case FieldDescriptor::CPPTYPE_BOOL:
+        if (key == "true" || key == "false") {
+          reflection->SetBool(entry, key_field, key == "true");
+          return absl::OkStatus();
+        }
+        break;
+      case FieldDescriptor::CPPTYPE_INT32:
+        if (int32_t v; JsonReader::ParseInteger(key, &v)) {
+          reflection->SetInt32(entry, key_field, v);
+          return absl::OkStatus();
+        }
+        break;
+      case FieldDescriptor::CPPTYPE_INT64:
+        if (int64_t v; JsonReader::ParseInteger(key, &v)) {
+          reflection->SetInt64(entry, key_field, v);
+          return absl::OkStatus();
+        }
+        break;
+      case FieldDescriptor::CPPTYPE_UINT32:
+        if (uint32_t v; JsonReader::ParseInteger(key, &v)) {
+          reflection->SetUInt32(entry, key_field, v);
+          return absl::OkStatus();
+        }
+        break;
+      case FieldDescriptor::CPPTYPE_UINT64:
+        if (uint64_t v; JsonReader::ParseInteger(key, &v)) {
+          reflection->SetUInt64(entry, key_field, v);
+          return absl::OkStatus();
+        }
+        break;
+      default:
+        break;
+    }
+    return reader_.Error(absl::StrCat("Invalid map key: ", key));
+  }
+
+  // Parses one (non-null) value into `field`, appending to it if `repeated`.
+  absl::Status ParseValue(Message* message, const FieldDescriptor* field,
+                          bool repeated, int depth) {
+    const Reflection* reflection = message->GetReflection();
+    switch (field->cpp_type()) {
+      case FieldDescriptor::CPPTYPE_MESSAGE: {
+        Message* sub_message = repeated
+                                   ? reflection->AddMessage(message, field)
+                                   : reflection->MutableMessage(message, field);
+        return ParseMessage(sub_message, depth + 1);
+      }
+      case FieldDescriptor::CPPTYPE_STRING: {
+        if (reader_.Peek() != '"') {
+          return reader_.Error(
+              absl::StrCat("Expected a string for ", field->name()));
+        }
+        std::string value;
+        if (absl::Status s = field->type() == FieldDescriptor::TYPE_BYTES
+                                 ? reader_.ReadBytes(&value)
+                                 : reader_.ReadString(&value);
+            !s.ok()) {
+          return s;
+        }
+        if (repeated) {
+          reflection->AddString(message, field, std::move(value));
+        } else {
+          reflection->SetString(message, field, std::move(value));
+        }
+        return absl::OkStatus();
+      }
+      case FieldDescriptor::CPPTYPE_BOOL: {
+        bool value;
+        if (absl::Status s = reader_.ReadBool(&value); !s.ok()) {
+          return s;
+        }
+        if (repeated) {
+          reflection->AddBool(message, field, value);
+        } else {
+          reflection->SetBool(message, field, value);
+        }
+        return absl::OkStatus();
+      }
+      case FieldDescriptor::CPPTYPE_ENUM:
+        return ParseEnum(message, field, repeated);
+      default:
+        return ParseNumber(message, field, repeated);
+    }
+  }
+
+  absl::Status ParseEnum(Message* message, const FieldDescriptor* field,
+                         bool repeated) {
+    const Reflection* reflection = message->GetReflection();
+    int number;
+    if (reader_.Peek() == '"') {
+      absl::string_view name;
+      if (absl::Status s = reader_.ReadString(&name, &value_scratch_);
+          !s.ok()) {
+        return s;
+      }
+      const EnumValueDescriptor* value =
+          field->enum_type()->FindValueByName(name);
+      if (value == nullptr) {
+        if (ignore_unknown_fields_) {
+          return absl::OkStatus();
+        }
+        return reader_.Error(absl::StrCat("Invalid enum value ", name, " for ",
+                                          field->name()));
+      }
+      number = value->number();
+    } else {
+      absl::string_view text;
+      if (absl::Status s = reader_.ReadNumberToken(&text); !s.ok()) {
+        return s;
+      }
+      if (!JsonReader::ParseInteger(text, &number)) {
+        return reader_.Error(absl::StrCat("Invalid enum value ", text, " for ",
+                                          field->name()));
+      }
+      if (field->legacy_enum_field_treated_as_closed() &&
+          field->enum_type()->FindValueByNumber(number) == nullptr) {
+        if (ignore_unknown_fields_) {
+          return absl::OkStatus();
+        }
+        return reader_.Error(absl::StrCat("Invalid enum value ", text, " for ",
+                                          field->name()));
+      }
+    }
+    if (repeated) {
+      reflection->AddEnumValue(message, field, number);
+    } else {
+      reflection->SetEnumValue(message, field, number);
+    }
+    return absl::OkStatus();
+  }
+
+  // Numbers may be given either as JSON numbers or as strings.
+  absl::Status ParseNumber(Message* message, const FieldDescriptor* field,
+                           bool repeated) {
+    absl::string_view text;
+    if (absl::Status s = reader_.ReadNumberText(&text); !s.ok()) {
+      return s;
+    }
+
+    const Reflection* reflection = message->GetReflection();
+    bool parsed = false;
+    switch (field->cpp_type()) {
+      case FieldDescriptor::CPPTYPE_INT32:
+        if (int32_t v; (parsed = JsonReader::ParseInteger(text, &v))) {
+          repeated ? reflection->AddInt32(message, field, v)
+                   : reflection->SetInt32(message, field, v);
+        }
+        break;
+      case FieldDescriptor::CPPTYPE_INT64:
+        if (int64_t v; (parsed = JsonReader::ParseInteger(text, &v))) {
+          repeated ? reflection->AddInt64(message, field, v)
+                   : reflection->SetInt64(message, field, v);
+        }
+        break;
+      case FieldDescriptor::CPPTYPE_UINT32:
+        if (uint32_t v; (parsed = JsonReader::ParseInteger(text, &v))) {
+          repeated ? reflection->AddUInt32(message, field, v)
+                   : reflection->SetUInt32(message, field, v);
+        }
+        break;
+      case FieldDescriptor::CPPTYPE_UINT64:
+        if (uint64_t v; (parsed = JsonReader::ParseInteger(text, &v))) {
+          repeated ? reflection->AddUInt64(message, field, v)
+                   : reflection->SetUInt64(message, field, v);
+        }
+        break;
+      case FieldDescriptor::CPPTYPE_DOUBLE:
+        if (double v; (parsed = JsonReader::ParseDouble(text, &v))) {
+          repeated ? reflection->AddDouble(message, field, v)
+                   : reflection->SetDouble(message, field, v);
+        }
+        break;
+      case FieldDescriptor::CPPTYPE_FLOAT:
+        if (float v; (parsed = JsonReader::ParseFloat(text, &v))) {
+          repeated ? reflection->AddFloat(message, field, v)
+                   : reflection->SetFloat(message, field, v);
+        }
+        break;
+      default:
+        break;
+    }
+    if (!parsed) {
+      return reader_.Error(
+          absl::StrCat("Invalid value ", text, " for field ", field->name()));
+    }
+    return absl::OkStatus();
+  }
+
+  // Hands the raw JSON of the next value to the protobuf library. Used for
+  // types with a special JSON mapping.
+  absl::Status ParseWithProtobufLibrary(Message* message, int depth) {
+    absl::string_view json;
+    if (absl::Status s = reader_.ReadRawValue(&json, depth); !s.ok()) {
+      return s;
+    }
+    google::protobuf::util::JsonParseOptions options;
+    options.ignore_unknown_fields = ignore_unknown_fields_;
+    if (const auto s =
+            google::protobuf::util::JsonStringToMessage(json, message, options);
+        !s.ok()) {
+      return absl::InvalidArgumentError(s.message());
+    }
+    return absl::OkStatus();
+  }
+
+  JsonReader reader_;
+  const bool ignore_unknown_fields_;
+  std::string value_scratch_;
+};
+
+}  // namespace
+
+absl::Status ParseJsonToProto(absl::string_view json,
+                              google::protobuf::Message* message,
+                              bool ignore_unknown_fields) {
+  return JsonProtoParser(json, ignore_unknown_fields).Parse(message);
+}
+
+}  // namespace privacy_sandbox::server_common
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_CPP_COMMUNICATION_JSON_PROTO_PARSER_H_
+#define SRC_CPP_COMMUNICATION_JSON_PROTO_PARSER_H_
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "google/protobuf/message.h"
+
+namespace privacy_sandbox::server_common {
+
+// Parses `json` into `message` following the proto3 JSON mapping.
+//
+// Unlike google::protobuf::util::JsonStringToMessage(), which converts the
+// input to a token stream and routes it through a TypeResolver and a
+// ProtoStreamObjectWriter, this parser tokenizes the input in a single pass and
+// sets fields directly through the message's reflection. Strings without
+// escape sequences are copied straight out of the input.
+//
+// Well-known types with a special JSON representation (Struct, Value, Any,
+// Timestamp, wrappers, ...) are delegated to JsonStringToMessage(), so the
+// accepted input is the same as the one accepted by the protobuf library.
+//
+// Fields are merged into `message`; callers wanting a fresh message should
+// pass a cleared one. Returns InvalidArgumentError if the JSON is malformed or
+// cannot be converted to `message`'s type. If `ignore_unknown_fields` is true,
+// fields and enum values not known to the message descriptor are skipped.
+absl::Status ParseJsonToProto(absl::string_view json,
+                              google::protobuf::Message* message,
+                              bool ignore_unknown_fields);
+
+}  // namespace privacy_sandbox::server_common
+
+#endif  // SRC_CPP_COMMUNICATION_JSON_PROTO_PARSER_H_
@@ -0,0 +1,247 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/cpp/communication/json_proto_parser.h"
+
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "google/protobuf/util/json_util.h"
+#include "google/protobuf/util/message_differencer.h"
+#include "gtest/gtest.h"
+#include "src/cpp/communication/test_request.pb.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+using google::protobuf::util::MessageDifferencer;
+using json_test::TestAllTypes;
+using json_test::TestRequest;
+
+// Parses `json` with both this parser and the protobuf library and expects the
+// same result.
+template <typename ProtoMessage>
+void ExpectSameAsProtobufLibrary(absl::string_view json) {
+  google::protobuf::util::JsonParseOptions options;
+  options.ignore_unknown_fields = true;
+  ProtoMessage expected;
+  ASSERT_TRUE(
+      google::protobuf::util::JsonStringToMessage(json, &expected, options)
+          .ok())
+      << json;
+
+  ProtoMessage actual;
+  const absl::Status status =
+      ParseJsonToProto(json, &actual, /*ignore_unknown_fields=*/true);
+  ASSERT_TRUE(status.ok()) << status << " for " << json;
+  EXPECT_TRUE(MessageDifferencer::Equals(expected, actual))
+      << "expected: " << expected.DebugString()
+      << "actual: " << actual.DebugString();
+}
+
+// Expects both this parser and the protobuf library to reject `json`.
+template <typename ProtoMessage>
+void ExpectRejectedLikeProtobufLibrary(absl::string_view json) {
+  google::protobuf::util::JsonParseOptions options;
+  options.ignore_unknown_fields = true;
+  ProtoMessage expected;
+  EXPECT_FALSE(
+      google::protobuf::util::JsonStringToMessage(json, &expected, options)
+          .ok())
+      << json;
+
+  ProtoMessage actual;
+  EXPECT_TRUE(absl::IsInvalidArgument(
+      ParseJsonToProto(json, &actual, /*ignore_unknown_fields=*/true)))
+      << json;
+}
+
+TEST(JsonProtoParserTest, MatchesProtobufLibraryForRequest) {
+  ExpectSameAsProtobufLibrary<TestRequest>(R"json(
+    {
+      "clientVersion": "v1",
+      "metadata": {"hostname": "example.com", "lang": "en"},
+      "partitions": [
+        {"id": "1", "compressionGroupId": 7, "arguments": [
+          {"tags": ["structured", "groupNames"], "data": ["a", "b"]},
+          {"tags": ["custom", "keys"], "data": ["k1", "k2", "k3"]}
+        ]},
+        {"id": 2, "arguments": []}
+      ]
+    })json");
+}
+
+TEST(JsonProtoParserTest, MatchesProtobufLibraryForAllTypes) {
+  ExpectSameAsProtobufLibrary<TestAllTypes>(R"json(
+    {
+      "int32Value": -12,
+      "int64_value": "-9223372036854775808",
+      "uint32Value": 4294967295,
+      "uint64Value": "18446744073709551615",
+      "sint32Value": 1e3,
+      "sfixed64Value": 5,
+      "doubleValue": 1.5e-3,
+      "floatValue": "Infinity",
+      "boolValue": true,
+      "stringValue": "tab\there \"quoted\" é 😀",
+      "bytesValue": "aGVsbG8=",
+      "enumValue": "TEST_ENUM_BAR",
+      "messageValue": {"tags": ["x"]},
+      "repeatedInt32": [1, 2, 3],
+      "repeatedEnum": ["TEST_ENUM_FOO", 2],
+      "repeatedMessage": [{"data": ["d"]}, {}],
+      "int32KeyedMap": {"1": "one", "-2": "minus two"},
+      "boolKeyedMap": {"true": {"tags": ["t"]}},
+      "choiceInt32": 3,
+      "optionalInt32": 0,
+      "customName": 9,
+      "structValue": {"nested": {"list": [1, "two", null, false]}},
+      "timestampValue": "2023-01-01T00:00:00Z",
+      "value": null
+    })json");
+}
+
+TEST(JsonProtoParserTest, NullIsTreatedAsDefault) {
+  ExpectSameAsProtobufLibrary<TestAllTypes>(
+      R"json({"int32Value": null, "messageValue": null,
+              "repeatedInt32": null, "int32KeyedMap": null})json");
+}
+
+TEST(JsonProtoParserTest, IgnoresUnknownFields) {
+  ExpectSameAsProtobufLibrary<TestRequest>(
+      R"json({"unknown": {"a": [1, {"b": "\"}"}]}, "clientVersion": "v2",
+              "unknownScalar": -1.0e5})json");
+}
+
+TEST(JsonProtoParserTest, IgnoresUnknownEnumValues) {
+  ExpectSameAsProtobufLibrary<TestAllTypes>(
+      R"json({"enumValue": "TEST_ENUM_NEW", "repeatedEnum": ["BAZ", 1]})json");
+}
+
+TEST(JsonProtoParserTest, RejectsUnknownFieldsWhenNotIgnored) {
+  TestRequest request;
+  EXPECT_TRUE(absl::IsInvalidArgument(ParseJsonToProto(
+      R"json({"unknown": 1})json", &request, /*ignore_unknown_fields=*/false)));
+}
+
+TEST(JsonProtoParserTest, MergesIntoExistingMessage) {
+  TestRequest request;
+  request.set_client_version("v1");
+  ASSERT_TRUE(ParseJsonToProto(R"json({"partitions": [{"id": 1}]})json",
+                               &request, /*ignore_unknown_fields=*/true)
+                  .ok());
+  EXPECT_EQ(request.client_version(), "v1");
+  EXPECT_EQ(request.partitions_size(), 1);
+}
+
+TEST(JsonProtoParserTest, RejectsMalformedJson) {
+  for (absl::string_view json : {
+           R"json()json",
+           R"json({"clientVersion": "v1"}}})json",
+           R"json({"clientVersion": "v1",})json",
+           R"json({"clientVersion" "v1"})json",
+           R"json({"clientVersion": "unterminated})json",
+           R"json({"clientVersion": 1})json",
+           R"json({"partitions": {}})json",
+           R"json({"partitions": [null]})json",
+           R"json([])json",
+       }) {
+    TestRequest request;
+    EXPECT_TRUE(absl::IsInvalidArgument(
+        ParseJsonToProto(json, &request, /*ignore_unknown_fields=*/true)))
+        << json;
+  }
+}
+
+TEST(JsonProtoParserTest, RejectsInvalidValues) {
+  for (absl::string_view json : {
+           R"json({"int32Value": 2147483648})json",
+           R"json({"int32Value": 1.5})json",
+           R"json({"uint32Value": -1})json",
+           R"json({"int64Value": 01})json",
+           R"json({"floatValue": 1e39})json",
+           R"json({"boolValue": "true"})json",
+           R"json({"bytesValue": "not base64!"})json",
+           R"json({"stringValue": "\ud83d"})json",
+           R"json({"choiceString": "a", "choiceInt32": 1})json",
+           R"json({"timestampValue": "yesterday"})json",
+       }) {
+    TestAllTypes message;
+    EXPECT_TRUE(absl::IsInvalidArgument(
+        ParseJsonToProto(json, &message, /*ignore_unknown_fields=*/true)))
+        << json;
+  }
+}
+
+TEST(JsonProtoParserTest, RejectsInvalidUtf8LikeProtobufLibrary) {
+  for (absl::string_view json : {
+           "{\"stringValue\": \"\xff\"}",
+           "{\"stringValue\": \"truncated \xc3\"}",
+           "{\"stringValue\": \"overlong \xc0\xaf\"}",
+           "{\"stringValue\": \"surrogate \xed\xa0\x80\"}",
+           "{\"stringValue\": \"escaped\\n\xff\"}",
+           "{\"int32KeyedMap\": {\"1\": \"\xfe\"}}",
+       }) {
+    ExpectRejectedLikeProtobufLibrary<TestAllTypes>(json);
+  }
+}
+
+TEST(JsonProtoParserTest, RejectsWhitespaceInQuotedNumbersLikeProtobufLibrary) {
+  for (absl::string_view json : {
+           R"json({"int32Value": " 1"})json",
+           R"json({"int64Value": "1 "})json",
+           R"json({"uint64Value": "\t1"})json",
+           R"json({"doubleValue": " 1.5"})json",
+           R"json({"int32KeyedMap": {" 1": "a"}})json",
+       }) {
+    ExpectRejectedLikeProtobufLibrary<TestAllTypes>(json);
+  }
+}
+
+TEST(JsonProtoParserTest, AcceptsSignedQuotedNumbersLikeProtobufLibrary) {
+  ExpectSameAsProtobufLibrary<TestAllTypes>(
+      R"json({"int32Value": "+1", "int64Value": "-2", "doubleValue": "+1.5",
+              "int32KeyedMap": {"+3": "a"}})json");
+}
+
+TEST(JsonProtoParserTest, RejectsDuplicateFields) {
+  for (absl::string_view json : {
+           R"json({"int32Value": 1, "int32Value": 2})json",
+           R"json({"int32Value": 1, "int32_value": 2})json",
+           R"json({"messageValue": {}, "messageValue": {}})json",
+           R"json({"repeatedInt32": [1], "repeatedInt32": [2]})json",
+           R"json({"int32KeyedMap": {}, "int32_keyed_map": {}})json",
+           R"json({"choiceString": "a", "choiceString": "b"})json",
+       }) {
+    TestAllTypes message;
+    EXPECT_TRUE(absl::IsInvalidArgument(
+        ParseJsonToProto(json, &message, /*ignore_unknown_fields=*/true)))
+        << json;
+  }
+  // null leaves the field unset, so it may be given alongside a value.
+  ExpectSameAsProtobufLibrary<TestAllTypes>(
+      R"json({"int32Value": null, "int32Value": 1})json");
+}
+
+TEST(JsonProtoParserTest, RejectsTooDeepNesting) {
+  const std::string json = absl::StrCat(R"json({"unknown": )json",
+                                        std::string(200, '['),
+                                        std::string(200, ']'), "}");
+  TestRequest request;
+  EXPECT_TRUE(absl::IsInvalidArgument(
+      ParseJsonToProto(json, &request, /*ignore_unknown_fields=*/true)));
+}
+
+}  // namespace
+}  // namespace privacy_sandbox::server_common
@@ -0,0 +1,248 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/cpp/communication/json_proto_printer.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/message.h"
+#include "google/protobuf/util/json_util.h"
+#include "src/cpp/communication/json_writer.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+using google::protobuf::Descriptor;
+using google::protobuf::EnumValueDescriptor;
+using google::protobuf::FieldDescriptor;
+using google::protobuf::Message;
+using google::protobuf::Reflection;
+
+// Not thread-safe; one instance per output.
+class JsonProtoPrinter {
+ public:
+  explicit JsonProtoPrinter(google::protobuf::io::ZeroCopyOutputStream* output)
+      : writer_(output) {}
+
+  absl::Status Print(const Message& message) {
+    if (absl::Status s = PrintMessage(message); !s.ok()) {
+      return s;
+    }
+    return writer_.status();
+  }
+
+ private:
+  absl::Status PrintMessage(const Message& message) {
+    const Descriptor* descriptor = message.GetDescriptor();
+    if (descriptor->well_known_type() !=
+        Descriptor::WELLKNOWNTYPE_UNSPECIFIED) {
+      return PrintWithProtobufLibrary(message);
+    }
+
+    const Reflection* reflection = message.GetReflection();
+    std::vector<const FieldDescriptor*> fields;
+    reflection->ListFields(message, &fields);
+
+    writer_.WriteChar('{');
+    bool first = true;
+    for (const FieldDescriptor* field : fields) {
+      writer_.WriteSeparator(&first);
+      if (field->is_extension()) {
+        writer_.WriteString(absl::StrCat("[", field->full_name(), "]"));
+      } else {
+        writer_.WriteString(field->json_name());
+      }
+      writer_.WriteChar(':');
+      if (absl::Status s = PrintField(message, field); !s.ok()) {
+        return s;
+      }
+    }
+    writer_.WriteChar('}');
+    return absl::OkStatus();
+  }
+
+  absl::Status PrintField(const Message& message,
+                          const FieldDescriptor* field) {
+    const Reflection* reflection = message.GetReflection();
+    if (field->is_map()) {
+      const FieldDescriptor* key_field = field->message_type()->map_key();
+      const FieldDescriptor* value_field = field->message_type()->map_value();
+      writer_.WriteChar('{');
+      bool first = true;
+      for (int i = 0; i < reflection->FieldSize(message, field); ++i) {
+        const Message& entry =
+            reflection->GetRepeatedMessage(message, field, i);
+        writer_.WriteSeparator(&first);
+        PrintMapKey(entry, key_field);
+        writer_.WriteChar(':');
+        if (absl::Status s = PrintValue(entry, value_field, /*index=*/-1);
+            !s.ok()) {
+          return s;
+        }
+      }
+      writer_.WriteChar('}');
+      return absl::OkStatus();
+    }
+    if (field->is_repeated()) {
+      writer_.WriteChar('[');
+      bool first = true;
+      for (int i = 0; i < reflection->FieldSize(message, field); ++i) {
+        writer_.WriteSeparator(&first);
+        if (absl::Status s = PrintValue(message, field, i); !s.ok()) {
+          return s;
+        }
+      }
+      writer_.WriteChar(']');
+      return absl::OkStatus();
+    }
+    return PrintValue(message, field, /*index=*/-1);
+  }
+
+  // Map keys are always strings in JSON.
+  void PrintMapKey(const Message& entry, const FieldDescriptor* key_field) {
+    const Reflection* reflection = entry.GetReflection();
+    switch (key_field->cpp_type()) {
+      case FieldDescriptor::CPPTYPE_STRING:
+        writer_.WriteString(reflection->GetString(entry, key_field));
+        return;
+      case FieldDescriptor::CPPTYPE_BOOL:
+        writer_.WriteQuoted(reflection->GetBool(entry, key_field) ? "true"
+                                                                  : "false");
+        return;
+      case FieldDescriptor::CPPTYPE_INT32:
+        writer_.WriteQuoted(
+            absl::AlphaNum(reflection->GetInt32(entry, key_field)).Piece());
+        return;
+      case FieldDescriptor::CPPTYPE_INT64:
+        writer_.WriteInt64(reflection->GetInt64(entry, key_field));
+        return;
+      case FieldDescriptor::CPPTYPE_UINT32:
+        writer_.WriteQuoted(
+            absl::AlphaNum(reflection->GetUInt32(entry, key_field)).Piece());
+        return;
+      case FieldDescriptor::CPPTYPE_UINT64:
+        writer_.WriteUInt64(reflection->GetUInt64(entry, key_field));
+        return;
+      default:
+        return;
+    }
+  }
+
+  // Prints element `index` of a repeated field, or the singular field if
+  // `index` is negative.
+  absl::Status PrintValue(const Message& message, const FieldDescriptor* field,
+                          int index) {
+    const Reflection* reflection = message.GetReflection();
+    const bool repeated = index >= 0;
+    switch (field->cpp_type()) {
+      case FieldDescriptor::CPPTYPE_MESSAGE:
+        return PrintMessage(
+            repeated ? reflection->GetRepeatedMessage(message, field, index)
+                     : reflection->GetMessage(message, field));
+      case FieldDescriptor::CPPTYPE_STRING: {
+        std::string scratch;
+        const std::string& value =
+            repeated ? reflection->GetRepeatedStringReference(message, field,
+                                                              index, &scratch)
+                     : reflection->GetStringReference(message, field, &scratch);
+        if (field->type() == FieldDescriptor::TYPE_BYTES) {
+          writer_.WriteBytes(value);
+        } else {
+          writer_.WriteString(value);
+        }
+        break;
+      }
+      case FieldDescriptor::CPPTYPE_BOOL:
+        writer_.WriteBool(
+            repeated ? reflection->GetRepeatedBool(message, field, index)
+                     : reflection->GetBool(message, field));
+        break;
+      case FieldDescriptor::CPPTYPE_ENUM: {
+        const int number =
+            repeated ? reflection->GetRepeatedEnumValue(message, field, index)
+                     : reflection->GetEnumValue(message, field);
+        if (field->enum_type()->full_name() == "google.protobuf.NullValue") {
+          writer_.Write("null");
+        } else if (const EnumValueDescriptor* value =
+                       field->enum_type()->FindValueByNumber(number);
+                   value != nullptr) {
+          writer_.WriteString(value->name());
+        } else {
+          writer_.WriteInt32(number);
+        }
+        break;
+      }
+      case FieldDescriptor::CPPTYPE_INT32:
+        writer_.WriteInt32(
+            repeated ? reflection->GetRepeatedInt32(message, field, index)
+                     : reflection->GetInt32(message, field));
+        break;
+      case FieldDescriptor::CPPTYPE_UINT32:
+        writer_.WriteUInt32(
+            repeated ? reflection->GetRepeatedUInt32(message, field, index)
+                     : reflection->GetUInt32(message, field));
+        break;
+      case FieldDescriptor::CPPTYPE_INT64:
+        writer_.WriteInt64(
+            repeated ? reflection->GetRepeatedInt64(message, field, index)
+                     : reflection->GetInt64(message, field));
+        break;
+      case FieldDescriptor::CPPTYPE_UINT64:
+        writer_.WriteUInt64(
+            repeated ? reflection->GetRepeatedUInt64(message, field, index)
+                     : reflection->GetUInt64(message, field));
+        break;
+      case FieldDescriptor::CPPTYPE_DOUBLE:
+        writer_.WriteDouble(
+            repeated ? reflection->GetRepeatedDouble(message, field, index)
+                     : reflection->GetDouble(message, field));
+        break;
+      case FieldDescriptor::CPPTYPE_FLOAT:
+        writer_.WriteFloat(
+            repeated ? reflection->GetRepeatedFloat(message, field, index)
+                     : reflection->GetFloat(message, field));
+        break;
+    }
+    return absl::OkStatus();
+  }
+
+  absl::Status PrintWithProtobufLibrary(const Message& message) {
+    std::string json;
+    google::protobuf::util::JsonPrintOptions options;
+    options.add_whitespace = false;
+    if (const auto s = google::protobuf::util::MessageToJsonString(
+            message, &json, options);
+        !s.ok()) {
+      return absl::InternalError(s.message());
+    }
+    writer_.Write(json);
+    return absl::OkStatus();
+  }
+
+  JsonWriter writer_;
+};
+
+}  // namespace
+
+absl::Status PrintProtoAsJson(
+    const google::protobuf::Message& message,
+    google::protobuf::io::ZeroCopyOutputStream* output) {
+  return JsonProtoPrinter(output).Print(message);
+}
+
+}  // namespace privacy_sandbox::server_common
@@ -0,0 +1,42 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_CPP_COMMUNICATION_JSON_PROTO_PRINTER_H_
+#define SRC_CPP_COMMUNICATION_JSON_PROTO_PRINTER_H_
+
+#include "absl/status/status.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+#include "google/protobuf/message.h"
+
+namespace privacy_sandbox::server_common {
+
+// Writes the proto3 JSON representation of `message` to `output`, without
+// whitespace and omitting fields that are not set.
+//
+// The JSON is written straight into the buffers handed out by `output`, so no
+// intermediate string is built: `output` can be a StringOutputStream appending
+// to a reused buffer, or a stream feeding a compressor. Well-known types with a
+// special JSON mapping are printed by google::protobuf::util.
+//
+// Returns InternalError if `output` stops accepting data or a well-known type
+// cannot be printed. `output` may then contain a partial JSON document.
+absl::Status PrintProtoAsJson(
+    const google::protobuf::Message& message,
+    google::protobuf::io::ZeroCopyOutputStream* output);
+
+}  // namespace privacy_sandbox::server_common
+
+#endif  // SRC_CPP_COMMUNICATION_JSON_PROTO_PRINTER_H_
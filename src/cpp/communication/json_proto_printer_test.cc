@@ -0,0 +1,157 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/cpp/communication/json_proto_printer.h"
+
+#include <limits>
+#include <string>
+
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "google/protobuf/text_format.h"
+#include "google/protobuf/util/json_util.h"
+#include "google/protobuf/util/message_differencer.h"
+#include "gtest/gtest.h"
+#include "src/cpp/communication/json_proto_parser.h"
+#include "src/cpp/communication/test_request.pb.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+using google::protobuf::util::MessageDifferencer;
+using json_test::TestAllTypes;
+using json_test::TestRequest;
+
+std::string Print(const google::protobuf::Message& message) {
+  std::string json;
+  google::protobuf::io::StringOutputStream stream(&json);
+  EXPECT_TRUE(PrintProtoAsJson(message, &stream).ok());
+  return json;
+}
+
+// Prints `message`, parses the JSON back and expects the original message.
+template <typename ProtoMessage>
+void ExpectRoundTrip(const ProtoMessage& message) {
+  const std::string json = Print(message);
+  ProtoMessage parsed;
+  const absl::Status status =
+      ParseJsonToProto(json, &parsed, /*ignore_unknown_fields=*/false);
+  ASSERT_TRUE(status.ok()) << status << " for " << json;
+  EXPECT_TRUE(MessageDifferencer::Equals(message, parsed))
+      << "json: " << json << " parsed: " << parsed.DebugString();
+}
+
+TEST(JsonProtoPrinterTest, MatchesProtobufLibrary) {
+  TestAllTypes message;
+  ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(
+      R"pb(
+        int32_value: -12
+        int64_value: -9223372036854775808
+        uint64_value: 18446744073709551615
+        double_value: 0.1
+        float_value: 3.4
+        bool_value: true
+        string_value: "tab\there \"quoted\" <b> \303\251"
+        bytes_value: "\000\377hello"
+        enum_value: TEST_ENUM_BAR
+        message_value { tags: "x" }
+        repeated_int32: [ 1, 2, 3 ]
+        repeated_enum: [ TEST_ENUM_FOO, TEST_ENUM_BAR ]
+        repeated_message {}
+        repeated_message { data: "d" }
+        choice_int32: 3
+        optional_int32: 0
+        renamed_value: 9
+        struct_value {
+          fields {
+            key: "list"
+            value { list_value { values { number_value: 1 } } }
+          }
+        }
+        timestamp_value { seconds: 1672531200 }
+      )pb",
+      &message));
+
+  std::string expected;
+  ASSERT_TRUE(
+      google::protobuf::util::MessageToJsonString(message, &expected).ok());
+  EXPECT_EQ(Print(message), expected);
+}
+
+TEST(JsonProtoPrinterTest, RoundTripsRequest) {
+  TestRequest request;
+  request.set_client_version("v1");
+  (*request.mutable_metadata())["hostname"] = "example.com";
+  (*request.mutable_metadata())["lang"] = "en";
+  auto* partition = request.add_partitions();
+  partition->set_id(1);
+  partition->set_compression_group_id(7);
+  auto* argument = partition->add_arguments();
+  argument->add_tags("structured");
+  argument->add_data("a");
+  request.add_partitions()->set_id(2);
+  ExpectRoundTrip(request);
+}
+
+TEST(JsonProtoPrinterTest, RoundTripsMapsAndSpecialValues) {
+  TestAllTypes message;
+  message.set_double_value(std::numeric_limits<double>::infinity());
+  message.set_float_value(std::numeric_limits<float>::quiet_NaN());
+  message.set_string_value("\x01\xe2\x80\xa8 control");
+  (*message.mutable_int32_keyed_map())[-2] = "minus two";
+  (*message.mutable_bool_keyed_map())[true].add_tags("t");
+  message.set_enum_value(static_cast<json_test::TestEnum>(42));
+  const std::string json = Print(message);
+  EXPECT_NE(json.find(R"("doubleValue":"Infinity")"), std::string::npos);
+  EXPECT_NE(json.find(R"("floatValue":"NaN")"), std::string::npos);
+  EXPECT_NE(json.find(R"("enumValue":42)"), std::string::npos);
+  EXPECT_NE(json.find(R"("\u0001\u2028 control")"), std::string::npos);
+
+  // NaN never compares equal, so round trip the rest.
+  message.clear_float_value();
+  ExpectRoundTrip(message);
+}
+
+TEST(JsonProtoPrinterTest, EmptyMessage) {
+  EXPECT_EQ(Print(TestRequest()), "{}");
+}
+
+TEST(JsonProtoPrinterTest, WritesAcrossSmallBuffers) {
+  TestRequest request;
+  for (int i = 0; i < 100; ++i) {
+    request.add_partitions()->add_arguments()->add_data(
+        std::string(i, 'a' + i % 26));
+  }
+  std::string json;
+  {
+    // An ArrayOutputStream with a tiny block size forces every token to span
+    // several buffers.
+    std::string buffer(1 << 16, '\0');
+    google::protobuf::io::ArrayOutputStream stream(buffer.data(), buffer.size(),
+                                                   /*block_size=*/7);
+    ASSERT_TRUE(PrintProtoAsJson(request, &stream).ok());
+    json = buffer.substr(0, stream.ByteCount());
+  }
+  EXPECT_EQ(json, Print(request));
+}
+
+TEST(JsonProtoPrinterTest, FailsWhenOutputIsFull) {
+  TestRequest request;
+  request.set_client_version(std::string(100, 'v'));
+  char buffer[16];
+  google::protobuf::io::ArrayOutputStream stream(buffer, sizeof(buffer));
+  EXPECT_TRUE(absl::IsInternal(PrintProtoAsJson(request, &stream)));
+}
+
+}  // namespace
+}  // namespace privacy_sandbox::server_common
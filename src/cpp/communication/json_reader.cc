@@ -0,0 +1,423 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/cpp/communication/json_reader.h"
+
+#include <cmath>
+#include <limits>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+void AppendUtf8(uint32_t code_point, std::string* out) {
+  if (code_point < 0x80) {
+    out->push_back(static_cast<char>(code_point));
+  } else if (code_point < 0x800) {
+    out->push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else if (code_point < 0x10000) {
+    out->push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+    out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  } else {
+    out->push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+    out->push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+  }
+}
+
+// Checks for well-formed UTF-8: no overlong encodings, surrogates or code
+// points above U+10FFFF.
+bool IsValidUtf8(absl::string_view text) {
+  const auto* p = reinterpret_cast<const unsigned char*>(text.data());
+  const auto* end = p + text.size();
+  while (p < end) {
+    if (*p < 0x80) {
+      ++p;
+      continue;
+    }
+    int length;
+    unsigned char min = 0x80;
+    unsigned char max = 0xBF;
+    if (*p >= 0xC2 && *p <= 0xDF) {
+      length = 2;
+    } else if (*p >= 0xE0 && *p <= 0xEF) {
+      length = 3;
+      if (*p == 0xE0) {
+        min = 0xA0;
+      } else if (*p == 0xED) {
+        max = 0x9F;
+      }
+    } else if (*p >= 0xF0 && *p <= 0xF4) {
+      length = 4;
+      if (*p == 0xF0) {
+        min = 0x90;
+      } else if (*p == 0xF4) {
+        max = 0x8F;
+      }
+    } else {
+      return false;
+    }
+    if (end - p < length || p[1] < min || p[1] > max) {
+      return false;
+    }
+    for (int i = 2; i < length; ++i) {
+      if (p[i] < 0x80 || p[i] > 0xBF) {
+        return false;
+      }
+    }
+    p += length;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool JsonReader::ParseDouble(absl::string_view text, double* out) {
+  if (text == "NaN") {
+    *out = std::numeric_limits<double>::quiet_NaN();
+    return true;
+  }
+  if (text == "Infinity") {
+    *out = std::numeric_limits<double>::infinity();
+    return true;
+  }
+  if (text == "-Infinity") {
+    *out = -std::numeric_limits<double>::infinity();
+    return true;
+  }
+  if (HasWhitespace(text)) {
+    return false;
+  }
+  // SimpleAtod() saturates to infinity on overflow; treat that as an error.
+  return absl::SimpleAtod(text, out) && std::isfinite(*out);
+}
+
+bool JsonReader::ParseFloat(absl::string_view text, float* out) {
+  double value;
+  if (!ParseDouble(text, &value)) {
+    return false;
+  }
+  if (std::isfinite(value) &&
+      std::fabs(value) > std::numeric_limits<float>::max()) {
+    return false;
+  }
+  *out = static_cast<float>(value);
+  return true;
+}
+
+absl::Status JsonReader::ExpectEnd() {
+  SkipWhitespace();
+  if (pos_ != json_.size()) {
+    return Error("Unexpected trailing characters");
+  }
+  return absl::OkStatus();
+}
+
+void JsonReader::SkipWhitespace() {
+  while (pos_ < json_.size()) {
+    const char c = json_[pos_];
+    if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+      return;
+    }
+    ++pos_;
+  }
+}
+
+bool JsonReader::Consume(char c) {
+  if (Peek() != c) {
+    return false;
+  }
+  ++pos_;
+  return true;
+}
+
+bool JsonReader::ConsumeLiteral(absl::string_view literal) {
+  if (!PeekLiteral(literal)) {
+    return false;
+  }
+  pos_ += literal.size();
+  return true;
+}
+
+absl::Status JsonReader::ReadString(absl::string_view* out,
+                                    std::string* scratch) {
+  if (!Consume('"')) {
+    return Error("Expected a string");
+  }
+  const size_t start = pos_;
+  while (pos_ < json_.size()) {
+    const char c = json_[pos_];
+    if (c == '"') {
+      *out = json_.substr(start, pos_ - start);
+      if (!IsValidUtf8(*out)) {
+        return Error("Invalid UTF-8 in string");
+      }
+      ++pos_;
+      return absl::OkStatus();
+    }
+    if (c == '\\') {
+      break;
+    }
+    if (static_cast<unsigned char>(c) < 0x20) {
+      return Error("Control character in string");
+    }
+    ++pos_;
+  }
+
+  // Slow path: unescape into the scratch buffer.
+  scratch->assign(json_.data() + start, pos_ - start);
+  while (pos_ < json_.size()) {
+    const char c = json_[pos_++];
+    if (c == '"') {
+      // Escapes always append valid UTF-8, so this only catches raw bytes.
+      if (!IsValidUtf8(*scratch)) {
+        return Error("Invalid UTF-8 in string");
+      }
+      *out = *scratch;
+      return absl::OkStatus();
+    }
+    if (static_cast<unsigned char>(c) < 0x20) {
+      return Error("Control character in string");
+    }
+    if (c != '\\') {
+      scratch->push_back(c);
+      continue;
+    }
+    if (pos_ >= json_.size()) {
+      break;
+    }
+    switch (json_[pos_++]) {
+      case '"':
+        scratch->push_back('"');
+        break;
+      case '\\':
+        scratch->push_back('\\');
+        break;
+      case '/':
+        scratch->push_back('/');
+        break;
+      case 'b':
+        scratch->push_back('\b');
+        break;
+      case 'f':
+        scratch->push_back('\f');
+        break;
+      case 'n':
+        scratch->push_back('\n');
+        break;
+      case 'r':
+        scratch->push_back('\r');
+        break;
+      case 't':
+        scratch->push_back('\t');
+        break;
+      case 'u': {
+        uint32_t code_point;
+        if (absl::Status s = ReadUnicodeEscape(&code_point); !s.ok()) {
+          return s;
+        }
+        AppendUtf8(code_point, scratch);
+        break;
+      }
+      default:
+        return Error("Invalid escape sequence");
+    }
+  }
+  return Error("Unterminated string");
+}
+
+absl::Status JsonReader::ReadUnicodeEscape(uint32_t* code_point) {
+  if (!ReadHex4(code_point)) {
+    return Error("Invalid \\u escape");
+  }
+  if (*code_point >= 0xDC00 && *code_point <= 0xDFFF) {
+    return Error("Unpaired low surrogate");
+  }
+  if (*code_point >= 0xD800 && *code_point <= 0xDBFF) {
+    uint32_t low;
+    if (!ConsumeLiteral("\\u")) {
+      return Error("Unpaired high surrogate");
+    }
+    if (!ReadHex4(&low) || low < 0xDC00 || low > 0xDFFF) {
+      return Error("Invalid low surrogate");
+    }
+    *code_point = 0x10000 + ((*code_point - 0xD800) << 10) + (low - 0xDC00);
+  }
+  return absl::OkStatus();
+}
+
+bool JsonReader::ReadHex4(uint32_t* out) {
+  if (json_.size() - pos_ < 4) {
+    return false;
+  }
+  uint32_t value = 0;
+  for (int i = 0; i < 4; ++i) {
+    const char c = json_[pos_ + i];
+    value <<= 4;
+    if (c >= '0' && c <= '9') {
+      value |= c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      value |= c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      value |= c - 'A' + 10;
+    } else {
+      return false;
+    }
+  }
+  pos_ += 4;
+  *out = value;
+  return true;
+}
+
+absl::Status JsonReader::ReadNumberToken(absl::string_view* out) {
+  const size_t start = pos_;
+  Consume('-');
+  if (Consume('0')) {
+    // No leading zeros.
+  } else if (!ConsumeDigits()) {
+    return Error("Expected a value");
+  }
+  if (Consume('.') && !ConsumeDigits()) {
+    return Error("Invalid number");
+  }
+  if (Consume('e') || Consume('E')) {
+    if (!Consume('+')) {
+      Consume('-');
+    }
+    if (!ConsumeDigits()) {
+      return Error("Invalid number");
+    }
+  }
+  *out = json_.substr(start, pos_ - start);
+  return absl::OkStatus();
+}
+
+absl::Status JsonReader::ReadNumberText(absl::string_view* out) {
+  if (Peek() == '"') {
+    return ReadString(out, &value_scratch_);
+  }
+  return ReadNumberToken(out);
+}
+
+bool JsonReader::ConsumeDigits() {
+  const size_t start = pos_;
+  while (pos_ < json_.size() && json_[pos_] >= '0' && json_[pos_] <= '9') {
+    ++pos_;
+  }
+  return pos_ != start;
+}
+
+absl::Status JsonReader::SkipValue(int depth) {
+  if (depth > kMaxRecursionDepth) {
+    return Error("Message too deep");
+  }
+  switch (Peek()) {
+    case '{':
+      return ReadObject(
+          [this, depth](absl::string_view) { return SkipValue(depth + 1); });
+    case '[':
+      return ReadArray([this, depth]() { return SkipValue(depth + 1); });
+    case '"': {
+      absl::string_view unused;
+      return ReadString(&unused, &value_scratch_);
+    }
+    case 't':
+    case 'f':
+    case 'n':
+      for (absl::string_view literal : {"true", "false", "null"}) {
+        if (ConsumeLiteral(literal)) {
+          return absl::OkStatus();
+        }
+      }
+      return Error("Invalid literal");
+    default: {
+      absl::string_view unused;
+      return ReadNumberToken(&unused);
+    }
+  }
+}
+
+absl::Status JsonReader::ReadRawValue(absl::string_view* out, int depth) {
+  const size_t start = pos_;
+  if (absl::Status s = SkipValue(depth); !s.ok()) {
+    return s;
+  }
+  *out = json_.substr(start, pos_ - start);
+  return absl::OkStatus();
+}
+
+absl::Status JsonReader::ReadDouble(double* out) {
+  absl::string_view text;
+  if (absl::Status s = ReadNumberText(&text); !s.ok()) {
+    return s;
+  }
+  if (!ParseDouble(text, out)) {
+    return Error(absl::StrCat("Invalid double ", text));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status JsonReader::ReadFloat(float* out) {
+  absl::string_view text;
+  if (absl::Status s = ReadNumberText(&text); !s.ok()) {
+    return s;
+  }
+  if (!ParseFloat(text, out)) {
+    return Error(absl::StrCat("Invalid float ", text));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status JsonReader::ReadBool(bool* out) {
+  if (ConsumeLiteral("true")) {
+    *out = true;
+  } else if (ConsumeLiteral("false")) {
+    *out = false;
+  } else {
+    return Error("Expected a boolean");
+  }
+  return absl::OkStatus();
+}
+
+absl::Status JsonReader::ReadString(std::string* out) {
+  absl::string_view text;
+  if (absl::Status s = ReadString(&text, &value_scratch_); !s.ok()) {
+    return s;
+  }
+  out->assign(text.data(), text.size());
+  return absl::OkStatus();
+}
+
+absl::Status JsonReader::ReadBytes(std::string* out) {
+  absl::string_view text;
+  if (absl::Status s = ReadString(&text, &value_scratch_); !s.ok()) {
+    return s;
+  }
+  if (!absl::Base64Unescape(text, out) &&
+      !absl::WebSafeBase64Unescape(text, out)) {
+    return Error("Invalid base64");
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace privacy_sandbox::server_common
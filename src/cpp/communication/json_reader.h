@@ -0,0 +1,229 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_CPP_COMMUNICATION_JSON_READER_H_
+#define SRC_CPP_COMMUNICATION_JSON_READER_H_
+
+#include <cmath>
+#include <limits>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+
+namespace privacy_sandbox::server_common {
+
+// Single-pass tokenizer over a JSON document held in memory. Used by
+// ParseJsonToProto() and by the codecs generated by cc_json_codec_library().
+//
+// Values are read following the proto3 JSON mapping: numbers may be quoted,
+// 64 bit integers may be written in exponent notation and floating point
+// fields accept "NaN" and "Infinity". Errors are InvalidArgumentError and
+// carry the offset into the input.
+//
+// Not thread-safe; one instance per input.
+class JsonReader {
+ public:
+  // Same nesting limit as the protobuf JSON parser.
+  static constexpr int kMaxRecursionDepth = 100;
+
+  explicit JsonReader(absl::string_view json) : json_(json) {}
+
+  // Returns an error unless only whitespace is left.
+  absl::Status ExpectEnd();
+
+  void SkipWhitespace();
+  char Peek() const { return pos_ < json_.size() ? json_[pos_] : '\0'; }
+  bool Consume(char c);
+  bool PeekLiteral(absl::string_view literal) const {
+    return json_.substr(pos_, literal.size()) == literal;
+  }
+  // Consumes `literal` if the input continues with it.
+  bool ConsumeLiteral(absl::string_view literal);
+
+  // Reads a JSON string, which has to be valid UTF-8. `out` points into the
+  // input when the string has no escape sequences and into `scratch`
+  // otherwise, and is only valid until the next read into the same `scratch`.
+  absl::Status ReadString(absl::string_view* out, std::string* scratch);
+
+  // Reads a token matching the JSON number grammar.
+  absl::Status ReadNumberToken(absl::string_view* out);
+
+  // Reads a number given either as a JSON number or as a string. `out` is
+  // valid until the next read.
+  absl::Status ReadNumberText(absl::string_view* out);
+
+  // Skips one value of any type, including nested objects and arrays.
+  absl::Status SkipValue(int depth);
+
+  // Skips one value and returns its raw JSON, which points into the input.
+  absl::Status ReadRawValue(absl::string_view* out, int depth);
+
+  // Typed reads of one (non-null) value.
+  template <typename Int>
+  absl::Status ReadInteger(Int* out);
+  absl::Status ReadDouble(double* out);
+  absl::Status ReadFloat(float* out);
+  absl::Status ReadBool(bool* out);
+  absl::Status ReadString(std::string* out);
+  // Reads standard or web-safe base64.
+  absl::Status ReadBytes(std::string* out);
+
+  // Reads an object, calling `on_member(absl::string_view name)` with the
+  // reader positioned at the value of each member. `on_member` has to consume
+  // that value and returns an absl::Status. `name` is only valid until the
+  // value is read.
+  template <typename MemberFn>
+  absl::Status ReadObject(MemberFn on_member);
+
+  // Reads an array, calling `on_element()` with the reader positioned at each
+  // element. `on_element` has to consume the element and returns an
+  // absl::Status.
+  template <typename ElementFn>
+  absl::Status ReadArray(ElementFn on_element);
+
+  absl::Status Error(absl::string_view message) const {
+    return absl::InvalidArgumentError(
+        absl::StrCat(message, " at offset ", pos_));
+  }
+
+  // Conversions of the text of a number or a map key. Unlike SimpleAtoi() and
+  // SimpleAtod(), these reject text with whitespace.
+  template <typename Int>
+  static bool ParseInteger(absl::string_view text, Int* out);
+  static bool ParseDouble(absl::string_view text, double* out);
+  static bool ParseFloat(absl::string_view text, float* out);
+
+ private:
+  static bool HasWhitespace(absl::string_view text);
+
+  // Reads the XXXX of a \uXXXX escape (already past the 'u'), combining
+  // surrogate pairs.
+  absl::Status ReadUnicodeEscape(uint32_t* code_point);
+  bool ReadHex4(uint32_t* out);
+  bool ConsumeDigits();
+
+  absl::string_view json_;
+  size_t pos_ = 0;
+  std::string key_scratch_;
+  std::string value_scratch_;
+};
+
+template <typename Int>
+bool JsonReader::ParseInteger(absl::string_view text, Int* out) {
+  if (HasWhitespace(text)) {
+    return false;
+  }
+  if (absl::SimpleAtoi(text, out)) {
+    return true;
+  }
+  // Integral values are also accepted in exponent/fraction notation, e.g. 1e3.
+  double value;
+  if (!absl::SimpleAtod(text, &value) || value != std::floor(value) ||
+      value < static_cast<double>(std::numeric_limits<Int>::min()) ||
+      value >= static_cast<double>(std::numeric_limits<Int>::max()) + 1.0) {
+    return false;
+  }
+  *out = static_cast<Int>(value);
+  return true;
+}
+
+inline bool JsonReader::HasWhitespace(absl::string_view text) {
+  for (char c : text) {
+    if (absl::ascii_isspace(static_cast<unsigned char>(c))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename Int>
+absl::Status JsonReader::ReadInteger(Int* out) {
+  absl::string_view text;
+  if (absl::Status s = ReadNumberText(&text); !s.ok()) {
+    return s;
+  }
+  if (!ParseInteger(text, out)) {
+    return Error(absl::StrCat("Invalid integer ", text));
+  }
+  return absl::OkStatus();
+}
+
+template <typename MemberFn>
+absl::Status JsonReader::ReadObject(MemberFn on_member) {
+  if (!Consume('{')) {
+    return Error("Expected an object");
+  }
+  SkipWhitespace();
+  if (Consume('}')) {
+    return absl::OkStatus();
+  }
+  while (true) {
+    SkipWhitespace();
+    absl::string_view name;
+    if (absl::Status s = ReadString(&name, &key_scratch_); !s.ok()) {
+      return s;
+    }
+    SkipWhitespace();
+    if (!Consume(':')) {
+      return Error("Expected ':'");
+    }
+    SkipWhitespace();
+    if (absl::Status s = on_member(name); !s.ok()) {
+      return s;
+    }
+    SkipWhitespace();
+    if (Consume(',')) {
+      continue;
+    }
+    if (Consume('}')) {
+      return absl::OkStatus();
+    }
+    return Error("Expected ',' or '}'");
+  }
+}
+
+template <typename ElementFn>
+absl::Status JsonReader::ReadArray(ElementFn on_element) {
+  if (!Consume('[')) {
+    return Error("Expected an array");
+  }
+  SkipWhitespace();
+  if (Consume(']')) {
+    return absl::OkStatus();
+  }
+  while (true) {
+    SkipWhitespace();
+    if (absl::Status s = on_element(); !s.ok()) {
+      return s;
+    }
+    SkipWhitespace();
+    if (Consume(',')) {
+      continue;
+    }
+    if (Consume(']')) {
+      return absl::OkStatus();
+    }
+    return Error("Expected ',' or ']'");
+  }
+}
+
+}  // namespace privacy_sandbox::server_common
+
+#endif  // SRC_CPP_COMMUNICATION_JSON_READER_H_
@@ -21,7 +21,10 @@
 
 #include "absl/status/statusor.h"
 #include "glog/logging.h"
-#include "google/protobuf/util/json_util.h"
+#include "google/protobuf/arena.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "src/cpp/communication/json_codec.h"
 
 namespace privacy_sandbox::server_common {
 
@@ -30,34 +33,87 @@ namespace privacy_sandbox::server_common {
 //
 // InvalidArgumentError will be returned if the JSON is malformed or cannot be
 // converted to the specified proto, implying the client sent bad request.
+// Unknown fields are ignored. See ParseJsonToProto() for details on the parser,
+// and JsonCodec for plugging in a generated codec.
 template <typename ProtoMessage>
 absl::StatusOr<ProtoMessage> JsonToProto(absl::string_view json) {
   static_assert(std::is_base_of<google::protobuf::Message, ProtoMessage>::value,
                 "JsonToProto only decodes to protobuf messages.");
 
   ProtoMessage result;
-  google::protobuf::util::JsonParseOptions options;
-  options.ignore_unknown_fields = true;
-  if (const auto s =
-          google::protobuf::util::JsonStringToMessage(json, &result, options);
+  if (const auto s = JsonCodec<ProtoMessage>::Decode(
+          json, &result, /*ignore_unknown_fields=*/true);
       !s.ok()) {
     return s;
   }
   return result;
 }
 
-// Converts a proto to a JSON string.
+// Same as above, but parses into `message`, merging with any fields already
+// set. Lets callers reuse a message or parse into one they allocated on an
+// arena themselves.
 template <typename ProtoMessage>
-absl::StatusOr<std::string> ProtoToJson(const ProtoMessage& proto) {
+absl::Status JsonToProto(absl::string_view json, ProtoMessage* message) {
+  static_assert(std::is_base_of<google::protobuf::Message, ProtoMessage>::value,
+                "JsonToProto only decodes to protobuf messages.");
+
+  return JsonCodec<ProtoMessage>::Decode(json, message,
+                                         /*ignore_unknown_fields=*/true);
+}
+
+// Same as above, but allocates the result on `arena`. All nested messages and
+// strings of the result are allocated on the arena too, so a request-scoped
+// arena frees the whole request tree at once. The returned message is owned by
+// the arena and must not be deleted; on error it is left on the arena. With a
+// null `arena` the message is allocated on the heap and owned by the caller,
+// and freed here on error.
+template <typename ProtoMessage>
+absl::StatusOr<ProtoMessage*> JsonToProto(absl::string_view json,
+                                          google::protobuf::Arena* arena) {
+  static_assert(std::is_base_of<google::protobuf::Message, ProtoMessage>::value,
+                "JsonToProto only decodes to protobuf messages.");
+
+  ProtoMessage* result =
+      google::protobuf::Arena::CreateMessage<ProtoMessage>(arena);
+  if (const auto s = JsonCodec<ProtoMessage>::Decode(
+          json, result, /*ignore_unknown_fields=*/true);
+      !s.ok()) {
+    if (arena == nullptr) {
+      delete result;
+    }
+    return s;
+  }
+  return result;
+}
+
+// Appends the JSON representation of a proto to `output`. Callers serializing
+// many protos can reuse one buffer, keeping its capacity across calls.
+template <typename ProtoMessage>
+absl::Status ProtoToJson(const ProtoMessage& proto, std::string* output) {
   static_assert(std::is_base_of<google::protobuf::Message, ProtoMessage>::value,
                 "ProtoToJson only encodes from protobuf messages.");
 
+  google::protobuf::io::StringOutputStream stream(output);
+  return JsonCodec<ProtoMessage>::Encode(proto, &stream);
+}
+
+// Writes the JSON representation of a proto to `output` without materializing
+// it first. With an output stream feeding a compressor, e.g.
+// BrotliCompressionGroupWriter, serialization and compression overlap.
+template <typename ProtoMessage>
+absl::Status ProtoToJson(const ProtoMessage& proto,
+                         google::protobuf::io::ZeroCopyOutputStream* output) {
+  static_assert(std::is_base_of<google::protobuf::Message, ProtoMessage>::value,
+                "ProtoToJson only encodes from protobuf messages.");
+
+  return JsonCodec<ProtoMessage>::Encode(proto, output);
+}
+
+// Converts a proto to a JSON string.
+template <typename ProtoMessage>
+absl::StatusOr<std::string> ProtoToJson(const ProtoMessage& proto) {
   std::string body;
-  google::protobuf::util::JsonOptions options;
-  options.add_whitespace = false;
-  if (const auto s =
-          google::protobuf::util::MessageToJsonString(proto, &body, options);
-      !s.ok()) {
+  if (const auto s = ProtoToJson(proto, &body); !s.ok()) {
     return s;
   }
   return body;
@@ -0,0 +1,170 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compares JsonToProto() against the protobuf library's JsonStringToMessage(),
+// heap against arena allocated results, and ProtoToJson() into a fresh string
+// against one into a reused buffer.
+//
+// Run with:
+//   bazel run -c opt //src/cpp/communication:json_utils_benchmark
+
+#include <string>
+
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "google/protobuf/util/json_util.h"
+#include "src/cpp/communication/json_utils.h"
+#include "src/cpp/communication/test_request.pb.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+using json_test::TestNestedRequest;
+using json_test::TestRequest;
+
+// Builds a request with `num_partitions` partitions, each looking up a handful
+// of keys, and returns its JSON form.
+std::string MakeRequestJson(int num_partitions) {
+  TestRequest request;
+  request.set_client_version("Bna.PA.Buyer.20231017");
+  (*request.mutable_metadata())["hostname"] = "www.example.com";
+  (*request.mutable_metadata())["experimentGroupId"] = "1234";
+  for (int i = 0; i < num_partitions; ++i) {
+    auto* partition = request.add_partitions();
+    partition->set_id(i);
+    partition->set_compression_group_id(i % 4);
+    auto* argument = partition->add_arguments();
+    argument->add_tags("structured");
+    argument->add_tags("groupNames");
+    argument->add_data(absl::StrCat("interest_group_", i));
+    argument = partition->add_arguments();
+    argument->add_tags("custom");
+    argument->add_tags("keys");
+    for (int j = 0; j < 8; ++j) {
+      argument->add_data(absl::StrCat("ad_render_id_", i, "_", j));
+    }
+  }
+  std::string json;
+  google::protobuf::util::JsonPrintOptions options;
+  options.add_whitespace = false;
+  (void)google::protobuf::util::MessageToJsonString(request, &json, options);
+  return json;
+}
+
+// Returns the JSON of a request nested `depth` levels deep.
+std::string MakeNestedRequestJson(int depth) {
+  TestNestedRequest request;
+  TestNestedRequest* current = &request;
+  for (int i = 0; i < depth; ++i) {
+    auto* argument = current->add_arguments();
+    argument->add_tags(absl::StrCat("level_", i));
+    argument->add_data("a string long enough to not fit into SSO");
+    current = current->mutable_child();
+  }
+  std::string json;
+  google::protobuf::util::JsonPrintOptions options;
+  options.add_whitespace = false;
+  (void)google::protobuf::util::MessageToJsonString(request, &json, options);
+  return json;
+}
+
+void BM_JsonStringToMessage(benchmark::State& state) {
+  const std::string json = MakeRequestJson(state.range(0));
+  google::protobuf::util::JsonParseOptions options;
+  options.ignore_unknown_fields = true;
+  for (auto _ : state) {
+    TestRequest request;
+    auto status =
+        google::protobuf::util::JsonStringToMessage(json, &request, options);
+    benchmark::DoNotOptimize(status);
+    benchmark::DoNotOptimize(request);
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+
+void BM_JsonToProto(benchmark::State& state) {
+  const std::string json = MakeRequestJson(state.range(0));
+  for (auto _ : state) {
+    auto request = JsonToProto<TestRequest>(json);
+    benchmark::DoNotOptimize(request);
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+
+void BM_JsonToProto_Nested(benchmark::State& state) {
+  const std::string json = MakeNestedRequestJson(state.range(0));
+  for (auto _ : state) {
+    auto request = JsonToProto<TestNestedRequest>(json);
+    benchmark::DoNotOptimize(request);
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+
+// Every nested message comes from one arena which is reset per request instead
+// of freeing each allocation separately. The arena reuses one initial block
+// across requests, like a request-scoped arena backed by a per-thread buffer.
+void BM_JsonToProtoOnArena_Nested(benchmark::State& state) {
+  const std::string json = MakeNestedRequestJson(state.range(0));
+  std::string initial_block(1 << 16, '\0');
+  google::protobuf::ArenaOptions options;
+  options.initial_block = initial_block.data();
+  options.initial_block_size = initial_block.size();
+  google::protobuf::Arena arena(options);
+  for (auto _ : state) {
+    auto request = JsonToProto<TestNestedRequest>(json, &arena);
+    benchmark::DoNotOptimize(request);
+    arena.Reset();
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+
+void BM_MessageToJsonString(benchmark::State& state) {
+  TestRequest request;
+  (void)JsonToProto(MakeRequestJson(state.range(0)), &request);
+  google::protobuf::util::JsonPrintOptions options;
+  options.add_whitespace = false;
+  for (auto _ : state) {
+    std::string json;
+    auto status =
+        google::protobuf::util::MessageToJsonString(request, &json, options);
+    benchmark::DoNotOptimize(status);
+    benchmark::DoNotOptimize(json);
+  }
+}
+
+// Serializes into one buffer which keeps its capacity across iterations.
+void BM_ProtoToJson_ReusedBuffer(benchmark::State& state) {
+  TestRequest request;
+  (void)JsonToProto(MakeRequestJson(state.range(0)), &request);
+  std::string json;
+  for (auto _ : state) {
+    json.clear();
+    auto status = ProtoToJson(request, &json);
+    benchmark::DoNotOptimize(status);
+    benchmark::DoNotOptimize(json);
+  }
+  state.SetBytesProcessed(state.iterations() * json.size());
+}
+
+BENCHMARK(BM_JsonStringToMessage)->Range(1, 256);
+BENCHMARK(BM_JsonToProto)->Range(1, 256);
+BENCHMARK(BM_JsonToProto_Nested)->Range(8, 64);
+BENCHMARK(BM_JsonToProtoOnArena_Nested)->Range(8, 64);
+BENCHMARK(BM_MessageToJsonString)->Range(1, 256);
+BENCHMARK(BM_ProtoToJson_ReusedBuffer)->Range(1, 256);
+
+}  // namespace
+}  // namespace privacy_sandbox::server_common
+
+BENCHMARK_MAIN();
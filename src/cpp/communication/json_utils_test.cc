@@ -14,11 +14,14 @@
 
 #include "src/cpp/communication/json_utils.h"
 
+#include <memory>
 #include <string>
 
 #include "google/protobuf/struct.pb.h"
 #include "google/protobuf/text_format.h"
 #include "gtest/gtest.h"
+#include "src/cpp/communication/compression_brotli.h"
+#include "src/cpp/communication/test_request.pb.h"
 
 namespace privacy_sandbox::server_common {
 namespace {
@@ -37,6 +40,56 @@ TEST(BinaryHttpTest, JsonToProto_MalformedJson) {
   ASSERT_TRUE(absl::IsInvalidArgument(maybe_proto.status()));
 }
 
+TEST(BinaryHttpTest, JsonToProtoIntoExistingMessage) {
+  Struct struct_proto;
+  (*struct_proto.mutable_fields())["existing"].set_bool_value(true);
+
+  ASSERT_TRUE(JsonToProto(R"({"key": "value"})", &struct_proto).ok());
+  EXPECT_EQ(struct_proto.fields().at("key").string_value(), "value");
+}
+
+TEST(BinaryHttpTest, JsonToProtoOnArena) {
+  google::protobuf::Arena arena;
+  const auto maybe_proto =
+      JsonToProto<Struct>(R"({"key": {"nested": ["value"]}})", &arena);
+  ASSERT_TRUE(maybe_proto.ok());
+  EXPECT_EQ((*maybe_proto)->GetArena(), &arena);
+  EXPECT_EQ((*maybe_proto)
+                ->fields()
+                .at("key")
+                .struct_value()
+                .fields()
+                .at("nested")
+                .list_value()
+                .values(0)
+                .string_value(),
+            "value");
+}
+
+TEST(BinaryHttpTest, JsonToProtoOnArena_MalformedJson) {
+  google::protobuf::Arena arena;
+  const auto maybe_proto =
+      JsonToProto<Struct>(R"({"key": "value"}}}})", &arena);
+  ASSERT_TRUE(absl::IsInvalidArgument(maybe_proto.status()));
+}
+
+TEST(BinaryHttpTest, JsonToProtoWithoutArena) {
+  google::protobuf::Arena* const no_arena = nullptr;
+  const auto maybe_proto = JsonToProto<Struct>(R"({"key": "value"})", no_arena);
+  ASSERT_TRUE(maybe_proto.ok());
+  const std::unique_ptr<Struct> proto(*maybe_proto);
+  EXPECT_EQ(proto->GetArena(), nullptr);
+  EXPECT_EQ(proto->fields().at("key").string_value(), "value");
+}
+
+TEST(BinaryHttpTest, JsonToProtoWithoutArena_MalformedJson) {
+  // The message allocated on the heap is freed; leak checkers catch it if not.
+  google::protobuf::Arena* const no_arena = nullptr;
+  const auto maybe_proto =
+      JsonToProto<Struct>(R"({"key": "value"}}}})", no_arena);
+  ASSERT_TRUE(absl::IsInvalidArgument(maybe_proto.status()));
+}
+
 TEST(BinaryHttpTest, ProtoToJsonSuccess) {
   Struct struct_proto;
   (*struct_proto.mutable_fields())["key"].set_string_value("value");
@@ -45,5 +98,38 @@ TEST(BinaryHttpTest, ProtoToJsonSuccess) {
   ASSERT_TRUE(maybe_json.ok());
 }
 
+TEST(BinaryHttpTest, ProtoToJsonAppendsToBuffer) {
+  json_test::TestRequest request;
+  request.set_client_version("v1");
+  request.add_partitions()->set_id(1);
+
+  std::string json = "[";
+  ASSERT_TRUE(ProtoToJson(request, &json).ok());
+  json.append(",");
+  ASSERT_TRUE(ProtoToJson(request, &json).ok());
+  json.append("]");
+  EXPECT_EQ(json,
+            R"([{"clientVersion":"v1","partitions":[{"id":"1"}]},)"
+            R"({"clientVersion":"v1","partitions":[{"id":"1"}]}])");
+}
+
+TEST(BinaryHttpTest, ProtoToJsonIntoCompressionGroup) {
+  json_test::TestRequest request;
+  request.set_client_version("v1");
+  for (int i = 0; i < 1000; ++i) {
+    request.add_partitions()->set_id(i);
+  }
+  auto writer = BrotliCompressionGroupWriter::Create();
+  ASSERT_TRUE(writer.ok());
+  ASSERT_TRUE(ProtoToJson(request, writer->get()).ok());
+  auto compression_group = (*writer)->Finish();
+  ASSERT_TRUE(compression_group.ok());
+
+  BrotliCompressionBlobReader blob_reader(*compression_group);
+  auto json = blob_reader.ExtractOneCompressionGroup();
+  ASSERT_TRUE(json.ok()) << json.status();
+  EXPECT_EQ(*json, ProtoToJson(request).value());
+}
+
 }  // namespace
 }  // namespace privacy_sandbox::server_common
@@ -0,0 +1,207 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/cpp/communication/json_writer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+// Formats `value` with the fewest digits that still round-trip, the same way
+// the protobuf library does. Returns the length written to `buffer`.
+int FormatDouble(double value, char (&buffer)[32]) {
+  int length = snprintf(buffer, sizeof(buffer), "%.15g", value);
+  if (strtod(buffer, nullptr) != value) {
+    length = snprintf(buffer, sizeof(buffer), "%.17g", value);
+  }
+  return length;
+}
+
+int FormatFloat(float value, char (&buffer)[32]) {
+  int length = snprintf(buffer, sizeof(buffer), "%.6g", value);
+  if (strtof(buffer, nullptr) != value) {
+    length = snprintf(buffer, sizeof(buffer), "%.9g", value);
+  }
+  return length;
+}
+
+}  // namespace
+
+JsonWriter::~JsonWriter() {
+  if (available_ > 0) {
+    output_->BackUp(available_);
+  }
+}
+
+absl::Status JsonWriter::status() const {
+  if (failed_) {
+    return absl::InternalError("Output stream failed while writing JSON");
+  }
+  return absl::OkStatus();
+}
+
+void JsonWriter::Write(absl::string_view data) {
+  while (!data.empty()) {
+    if (available_ == 0 && !NextBuffer()) {
+      return;
+    }
+    const size_t n = std::min(data.size(), static_cast<size_t>(available_));
+    memcpy(buffer_, data.data(), n);
+    buffer_ += n;
+    available_ -= n;
+    data.remove_prefix(n);
+  }
+}
+
+bool JsonWriter::NextBuffer() {
+  if (failed_) {
+    return false;
+  }
+  void* data;
+  int size;
+  do {
+    if (!output_->Next(&data, &size)) {
+      failed_ = true;
+      return false;
+    }
+  } while (size == 0);
+  buffer_ = static_cast<char*>(data);
+  available_ = size;
+  return true;
+}
+
+// Besides what JSON requires, '<', '>', DEL and the U+2028/U+2029 line
+// separators are escaped so the output can be embedded in HTML and JavaScript,
+// matching the protobuf library.
+void JsonWriter::WriteString(absl::string_view value) {
+  WriteChar('"');
+  size_t unescaped_start = 0;
+  for (size_t i = 0; i < value.size(); ++i) {
+    const unsigned char c = value[i];
+    absl::string_view escape;
+    char unicode_escape[7];
+    size_t escaped_length = 1;
+    switch (c) {
+      case '"':
+        escape = R"(\")";
+        break;
+      case '\\':
+        escape = R"(\\)";
+        break;
+      case '\b':
+        escape = R"(\b)";
+        break;
+      case '\f':
+        escape = R"(\f)";
+        break;
+      case '\n':
+        escape = R"(\n)";
+        break;
+      case '\r':
+        escape = R"(\r)";
+        break;
+      case '\t':
+        escape = R"(\t)";
+        break;
+      case 0xE2:
+        // U+2028 and U+2029 are encoded as E2 80 A8 and E2 80 A9.
+        if (i + 2 < value.size() &&
+            static_cast<unsigned char>(value[i + 1]) == 0x80 &&
+            (static_cast<unsigned char>(value[i + 2]) == 0xA8 ||
+             static_cast<unsigned char>(value[i + 2]) == 0xA9)) {
+          escape = static_cast<unsigned char>(value[i + 2]) == 0xA8
+                       ? R"(\u2028)"
+                       : R"(\u2029)";
+          escaped_length = 3;
+        }
+        break;
+      default:
+        if (c < 0x20 || c == '<' || c == '>' || c == 0x7F) {
+          snprintf(unicode_escape, sizeof(unicode_escape), "\\u%04x", c);
+          escape = unicode_escape;
+        }
+        break;
+    }
+    if (escape.empty()) {
+      continue;
+    }
+    Write(value.substr(unescaped_start, i - unescaped_start));
+    Write(escape);
+    i += escaped_length - 1;
+    unescaped_start = i + 1;
+  }
+  Write(value.substr(unescaped_start));
+  WriteChar('"');
+}
+
+void JsonWriter::WriteQuoted(absl::string_view value) {
+  WriteChar('"');
+  Write(value);
+  WriteChar('"');
+}
+
+void JsonWriter::WriteBytes(absl::string_view value) {
+  WriteQuoted(absl::Base64Escape(value));
+}
+
+void JsonWriter::WriteInt32(int32_t value) {
+  Write(absl::AlphaNum(value).Piece());
+}
+
+void JsonWriter::WriteUInt32(uint32_t value) {
+  Write(absl::AlphaNum(value).Piece());
+}
+
+void JsonWriter::WriteInt64(int64_t value) {
+  WriteQuoted(absl::AlphaNum(value).Piece());
+}
+
+void JsonWriter::WriteUInt64(uint64_t value) {
+  WriteQuoted(absl::AlphaNum(value).Piece());
+}
+
+void JsonWriter::WriteDouble(double value) {
+  if (std::isnan(value)) {
+    Write(R"("NaN")");
+  } else if (std::isinf(value)) {
+    Write(value > 0 ? R"("Infinity")" : R"("-Infinity")");
+  } else {
+    char buffer[32];
+    Write(absl::string_view(buffer, FormatDouble(value, buffer)));
+  }
+}
+
+void JsonWriter::WriteFloat(float value) {
+  if (std::isnan(value)) {
+    Write(R"("NaN")");
+  } else if (std::isinf(value)) {
+    Write(value > 0 ? R"("Infinity")" : R"("-Infinity")");
+  } else {
+    char buffer[32];
+    Write(absl::string_view(buffer, FormatFloat(value, buffer)));
+  }
+}
+
+}  // namespace privacy_sandbox::server_common
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_CPP_COMMUNICATION_JSON_WRITER_H_
+#define SRC_CPP_COMMUNICATION_JSON_WRITER_H_
+
+#include <cstdint>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+
+namespace privacy_sandbox::server_common {
+
+// Writes JSON tokens straight into the buffers handed out by a
+// ZeroCopyOutputStream. Used by PrintProtoAsJson() and by the codecs generated
+// by cc_json_codec_library(). Values are formatted following the proto3 JSON
+// mapping, the same way google::protobuf::util::MessageToJsonString() does.
+//
+// Write errors are sticky and reported by status(). The unused part of the last
+// buffer is returned to the stream on destruction.
+//
+// Not thread-safe; one instance per output.
+class JsonWriter {
+ public:
+  explicit JsonWriter(google::protobuf::io::ZeroCopyOutputStream* output)
+      : output_(output) {}
+  ~JsonWriter();
+
+  JsonWriter(const JsonWriter&) = delete;
+  JsonWriter& operator=(const JsonWriter&) = delete;
+
+  // Returns InternalError if the stream stopped accepting data.
+  absl::Status status() const;
+
+  // Writes `data` as-is.
+  void Write(absl::string_view data);
+  void WriteChar(char c);
+
+  // Writes `value` as a quoted and escaped JSON string.
+  void WriteString(absl::string_view value);
+  // Writes `value` in quotes without escaping it.
+  void WriteQuoted(absl::string_view value);
+  void WriteBytes(absl::string_view value);
+  void WriteBool(bool value) { Write(value ? "true" : "false"); }
+  void WriteInt32(int32_t value);
+  void WriteUInt32(uint32_t value);
+  // 64 bit integers are quoted since JSON numbers are doubles.
+  void WriteInt64(int64_t value);
+  void WriteUInt64(uint64_t value);
+  void WriteDouble(double value);
+  void WriteFloat(float value);
+
+  // Writes the separator if needed, followed by `key`, which already has to be
+  // quoted and end with ':'. `first` tracks whether the current object or
+  // array is still empty.
+  void WriteKey(bool* first, absl::string_view key) {
+    WriteSeparator(first);
+    Write(key);
+  }
+  // Writes ',' unless `*first`, then clears `*first`.
+  void WriteSeparator(bool* first) {
+    if (!*first) {
+      WriteChar(',');
+    }
+    *first = false;
+  }
+
+ private:
+  bool NextBuffer();
+
+  google::protobuf::io::ZeroCopyOutputStream* output_;
+  char* buffer_ = nullptr;
+  int available_ = 0;
+  bool failed_ = false;
+};
+
+inline void JsonWriter::WriteChar(char c) {
+  if (available_ == 0 && !NextBuffer()) {
+    return;
+  }
+  *buffer_++ = c;
+  --available_;
+}
+
+}  // namespace privacy_sandbox::server_common
+
+#endif  // SRC_CPP_COMMUNICATION_JSON_WRITER_H_
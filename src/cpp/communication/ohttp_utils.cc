@@ -19,11 +19,18 @@
 #include <limits>
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "absl/status/statusor.h"
+#include "absl/strings/escaping.h"
 #include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "quiche/common/quiche_data_reader.h"
+#include "quiche/common/quiche_data_writer.h"
 #include "quiche/oblivious_http/buffers/oblivious_http_request.h"
+#include "quiche/oblivious_http/buffers/oblivious_http_response.h"
 #include "quiche/oblivious_http/common/oblivious_http_header_key_config.h"
+#include "quiche/oblivious_http/oblivious_http_client.h"
 #include "quiche/oblivious_http/oblivious_http_gateway.h"
 #include "src/cpp/encryption/key_fetcher/interface/private_key_fetcher_interface.h"
 
@@ -51,6 +58,37 @@ absl::StatusOr<uint8_t> ToIntKeyId(absl::string_view key_id) {
   return val;
 }
 
+// Sizes (in bytes) of the fields that frame a chunk, and that precede its data
+// in the plaintext of the chunk.
+inline constexpr int kChunkSizeBytes = 4;
+inline constexpr int kChunkPositionSizeBytes = 4;
+inline constexpr int kChunkIsLastSizeBytes = 1;
+
+// Creates the gateway that encrypts responses with `private_key`.
+absl::StatusOr<quiche::ObliviousHttpGateway> CreateGateway(
+    const PrivateKey& private_key) {
+  const auto key_id = ToIntKeyId(private_key.key_id);
+  if (!key_id.ok()) {
+    return absl::Status(absl::StatusCode::kInternal, key_id.status().message());
+  }
+
+  const auto config = quiche::ObliviousHttpHeaderKeyConfig::Create(
+      key_id.value(), kX25519HkdfSha256KemId, kHkdfSha256Id, kAes256GcmAeadId);
+  if (!config.ok()) {
+    const std::string error = absl::StrCat(
+        "Failed to build OHTTP header config: ", config.status().message());
+    return absl::Status(absl::StatusCode::kInternal, error);
+  }
+
+  auto gateway =
+      quiche::ObliviousHttpGateway::Create(private_key.private_key, *config);
+  if (!gateway.ok()) {
+    return absl::Status(absl::StatusCode::kInternal,
+                        gateway.status().message());
+  }
+  return gateway;
+}
+
 }  // namespace
 
 absl::StatusOr<uint8_t> ParseKeyId(
@@ -109,13 +147,65 @@ absl::StatusOr<quiche::ObliviousHttpRequest> DecryptEncapsulatedRequest(
 }
 
 absl::StatusOr<std::string> EncryptAndEncapsulateResponse(
-    const std::string plaintext_data, const PrivateKey& private_key,
+    std::string plaintext_data, const PrivateKey& private_key,
     quiche::ObliviousHttpRequest::Context& context) {
-  const auto key_id = ToIntKeyId(private_key.key_id);
+  const auto gateway = CreateGateway(private_key);
+  if (!gateway.ok()) {
+    return gateway.status();
+  }
+
+  const auto oblivious_response =
+      gateway->CreateObliviousHttpResponse(std::move(plaintext_data), context);
+  if (!oblivious_response.ok()) {
+    const std::string error =
+        absl::StrCat("Failed to create OHTTP response: ",
+                     oblivious_response.status().message());
+    return absl::Status(absl::StatusCode::kInternal, error);
+  }
+
+  return oblivious_response.value().EncapsulateAndSerialize();
+}
+
+absl::StatusOr<quiche::ObliviousHttpRequest>
+ObliviousHttpClientCache::EncapsulateRequest(
+    std::string plaintext_data,
+    const google::cmrt::sdk::public_key_service::v1::PublicKey& public_key) {
+  const absl::StatusOr<std::shared_ptr<const Client>> client =
+      GetClient(public_key);
+  if (!client.ok()) {
+    return client.status();
+  }
+  absl::StatusOr<quiche::ObliviousHttpRequest> request =
+      (*client)->client.CreateObliviousHttpRequest(std::move(plaintext_data));
+  if (!request.ok()) {
+    const std::string error = absl::StrCat("Failed to create OHTTP request: ",
+                                           request.status().message());
+    return absl::Status(absl::StatusCode::kInternal, error);
+  }
+  return request;
+}
+
+absl::StatusOr<std::shared_ptr<const ObliviousHttpClientCache::Client>>
+ObliviousHttpClientCache::GetClient(
+    const google::cmrt::sdk::public_key_service::v1::PublicKey& public_key) {
+  const auto key_id = ToIntKeyId(public_key.key_id());
   if (!key_id.ok()) {
     return absl::Status(absl::StatusCode::kInternal, key_id.status().message());
   }
+  {
+    absl::ReaderMutexLock lock(&mutex_);
+    if (const auto it = clients_.find(*key_id);
+        it != clients_.end() &&
+        it->second->public_key == public_key.public_key()) {
+      return it->second;
+    }
+  }
 
+  std::string public_key_bytes;
+  if (!absl::Base64Unescape(public_key.public_key(), &public_key_bytes)) {
+    return absl::InternalError(absl::StrCat(
+        "Public key ", public_key.key_id(), " is not base64 encoded"));
+  }
   const auto config = quiche::ObliviousHttpHeaderKeyConfig::Create(
       key_id.value(), kX25519HkdfSha256KemId, kHkdfSha256Id, kAes256GcmAeadId);
   if (!config.ok()) {
@@ -123,24 +213,131 @@ absl::StatusOr<std::string> EncryptAndEncapsulateResponse(
         "Failed to build OHTTP header config: ", config.status().message());
     return absl::Status(absl::StatusCode::kInternal, error);
   }
+  auto http_client = quiche::ObliviousHttpClient::Create(public_key_bytes,
+                                                         *config);
+  if (!http_client.ok()) {
+    return absl::Status(absl::StatusCode::kInternal,
+                        http_client.status().message());
+  }
+  auto client = std::make_shared<const Client>(
+      Client{public_key.public_key(), *std::move(http_client)});
 
-  const auto gateway =
-      quiche::ObliviousHttpGateway::Create(private_key.private_key, *config);
+  absl::MutexLock lock(&mutex_);
+  // Another request may have created the same client meanwhile; either one
+  // does.
+  clients_[*key_id] = client;
+  return client;
+}
+
+absl::StatusOr<std::string> DecryptResponse(
+    std::string encapsulated_response,
+    quiche::ObliviousHttpRequest::Context& context) {
+  auto response = quiche::ObliviousHttpResponse::CreateClientObliviousResponse(
+      std::move(encapsulated_response), context);
+  if (!response.ok()) {
+    const std::string error = absl::StrCat("Unable to decrypt response: ",
+                                           response.status().message());
+    return absl::Status(absl::StatusCode::kInvalidArgument, error);
+  }
+  return std::string(response->GetPlaintextData());
+}
+
+absl::StatusOr<ChunkedResponseEncrypter> ChunkedResponseEncrypter::Create(
+    const PrivateKey& private_key,
+    quiche::ObliviousHttpRequest::Context context) {
+  absl::StatusOr<quiche::ObliviousHttpGateway> gateway =
+      CreateGateway(private_key);
   if (!gateway.ok()) {
-    return absl::Status(absl::StatusCode::kInternal,
-                        gateway.status().message());
+    return gateway.status();
   }
+  return ChunkedResponseEncrypter(*std::move(gateway), std::move(context));
+}
 
-  const auto oblivious_response =
-      gateway->CreateObliviousHttpResponse(std::move(plaintext_data), context);
+absl::StatusOr<std::string> ChunkedResponseEncrypter::EncryptChunk(
+    absl::string_view plaintext, bool is_last) {
+  if (done_) {
+    return absl::FailedPreconditionError("The last chunk was already sent");
+  }
+  std::string chunk_plaintext(
+      kChunkPositionSizeBytes + kChunkIsLastSizeBytes + plaintext.size(), '\0');
+  quiche::QuicheDataWriter plaintext_writer(chunk_plaintext.size(),
+                                            chunk_plaintext.data());
+  plaintext_writer.WriteUInt32(num_chunks_);
+  plaintext_writer.WriteUInt8(is_last ? 1 : 0);
+  plaintext_writer.WriteStringPiece(plaintext);
+
+  const auto oblivious_response = gateway_.CreateObliviousHttpResponse(
+      std::move(chunk_plaintext), context_);
   if (!oblivious_response.ok()) {
     const std::string error =
-        absl::StrCat("Failed to create OHTTP response: ",
+        absl::StrCat("Failed to create OHTTP response chunk: ",
                      oblivious_response.status().message());
     return absl::Status(absl::StatusCode::kInternal, error);
   }
+  const std::string encapsulated =
+      oblivious_response->EncapsulateAndSerialize();
 
-  return oblivious_response.value().EncapsulateAndSerialize();
+  std::string output(kChunkSizeBytes + encapsulated.size(), '\0');
+  quiche::QuicheDataWriter writer(output.size(), output.data());
+  writer.WriteUInt32(encapsulated.size());
+  writer.WriteStringPiece(encapsulated);
+  ++num_chunks_;
+  done_ = is_last;
+  return output;
+}
+
+absl::StatusOr<std::string> ChunkedResponseDecrypter::Decrypt(
+    absl::string_view data) {
+  buffer_.append(data.data(), data.size());
+  quiche::QuicheDataReader reader(buffer_);
+  std::string output;
+  while (!reader.IsDoneReading()) {
+    if (done_) {
+      return absl::InvalidArgumentError("Data after the last chunk");
+    }
+    quiche::QuicheDataReader peek_reader(reader.PeekRemainingPayload());
+    uint32_t chunk_size = 0;
+    absl::string_view encapsulated;
+    if (!peek_reader.ReadUInt32(&chunk_size)) {
+      // Waits for the rest of the chunk size.
+      break;
+    }
+    if (chunk_size > max_chunk_size_) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Response chunk of ", chunk_size,
+                       " bytes exceeds the maximum of ", max_chunk_size_));
+    }
+    if (!peek_reader.ReadStringPiece(&encapsulated, chunk_size)) {
+      // Waits for the rest of the chunk.
+      break;
+    }
+    reader.Seek(kChunkSizeBytes + chunk_size);
+
+    auto chunk = quiche::ObliviousHttpResponse::CreateClientObliviousResponse(
+        std::string(encapsulated), context_);
+    if (!chunk.ok()) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Failed to decrypt OHTTP response chunk: ",
+                       chunk.status().message()));
+    }
+    quiche::QuicheDataReader chunk_reader(chunk->GetPlaintextData());
+    uint32_t position = 0;
+    uint8_t is_last = 0;
+    if (!chunk_reader.ReadUInt32(&position) ||
+        !chunk_reader.ReadUInt8(&is_last)) {
+      return absl::InvalidArgumentError("Failed to parse response chunk");
+    }
+    if (position != num_chunks_) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Expected response chunk ", num_chunks_, ", got ", position));
+    }
+    absl::string_view chunk_data = chunk_reader.PeekRemainingPayload();
+    output.append(chunk_data.data(), chunk_data.size());
+    ++num_chunks_;
+    done_ = is_last != 0;
+  }
+  buffer_.erase(0, buffer_.size() - reader.BytesRemaining());
+  return output;
 }
 
 }  // namespace privacy_sandbox::server_common
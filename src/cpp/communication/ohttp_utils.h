@@ -21,19 +21,23 @@
 #include <string>
 #include <utility>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
 #include "glog/logging.h"
 #include "quiche/oblivious_http/buffers/oblivious_http_request.h"
 #include "quiche/oblivious_http/common/oblivious_http_header_key_config.h"
+#include "quiche/oblivious_http/oblivious_http_client.h"
 #include "quiche/oblivious_http/oblivious_http_gateway.h"
 #include "src/cpp/encryption/key_fetcher/interface/private_key_fetcher_interface.h"
+#include "src/cpp/encryption/key_fetcher/interface/public_key_fetcher_interface.h"
 
 // ohttp_utils.h contains functions for converting an encapsulated OHTTP request
-// to a proto and the reverse. If any individual step in the decryption/
-// deserialization process fails, the methods appropriately return
-// InternalError or InvalidArgument statuses, depending on whether the error
-// is caused by malformed input or a server side error.
+// to a proto and the reverse, on the server and on the client side. If any
+// individual step in the decryption/deserialization process fails, the methods
+// appropriately return InternalError or InvalidArgument statuses, depending on
+// whether the error is caused by malformed input or a server side error.
 namespace privacy_sandbox::server_common {
 
 // Reads the key ID from the first 8 bits of an encapsulated OHTTP request.
@@ -49,11 +53,122 @@ absl::StatusOr<quiche::ObliviousHttpRequest> DecryptEncapsulatedRequest(
 
 // Encrypts and encapsulates data in OHTTP format. The OHTTP context returned
 // from DecryptEncapsulatedRequest() is a required input to create the response.
-// Clients should use std::move() to pass in the plaintext data.
+// Clients should use std::move() to pass in the plaintext data, which is then
+// moved all the way into the encryption instead of copied.
 absl::StatusOr<std::string> EncryptAndEncapsulateResponse(
     std::string plaintext_data, const PrivateKey& private_key,
     quiche::ObliviousHttpRequest::Context& context);
 
+// Encrypts and encapsulates requests to other services on the client side,
+// with their public keys, e.g. from PublicKeyFetcherInterface::GetKey(). Keeps
+// the decoded key config and ObliviousHttpClient of every public key ID, so
+// that a request only pays for the HPKE seal. A key ID whose public key
+// changed, e.g. after PublicKeyFetcherInterface::Refresh(), gets a new client
+// on its next request. OHTTP key IDs take one byte, which bounds the number of
+// clients.
+//
+// Thread-safe. Meant to be shared by all outgoing requests.
+class ObliviousHttpClientCache {
+ public:
+  // Encrypts and encapsulates `plaintext_data` with `public_key`, whose value
+  // is base64 encoded. Send EncapsulateAndSerialize() of the returned request,
+  // and keep its ReleaseContext() to decrypt the response with
+  // DecryptResponse().
+  absl::StatusOr<quiche::ObliviousHttpRequest> EncapsulateRequest(
+      std::string plaintext_data,
+      const google::cmrt::sdk::public_key_service::v1::PublicKey& public_key);
+
+ private:
+  struct Client {
+    // Base64 encoded, as returned by the public key service.
+    std::string public_key;
+    quiche::ObliviousHttpClient client;
+  };
+
+  // Returns the client of `public_key`, creating it if needed.
+  absl::StatusOr<std::shared_ptr<const Client>> GetClient(
+      const google::cmrt::sdk::public_key_service::v1::PublicKey& public_key);
+
+  absl::Mutex mutex_;
+  absl::flat_hash_map<uint8_t, std::shared_ptr<const Client>> clients_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+// Decrypts the response to a request encapsulated by
+// ObliviousHttpClientCache::EncapsulateRequest(), with the context of that
+// request. Returns InvalidArgument if the response cannot be decrypted.
+absl::StatusOr<std::string> DecryptResponse(
+    std::string encapsulated_response,
+    quiche::ObliviousHttpRequest::Context& context);
+
+// Encrypts and encapsulates a response in chunks that are sealed one by one,
+// so that the start of a large response goes out before the rest is built.
+// Every chunk is an OHTTP response of its own to the same request, framed as:
+// - 4 bytes for the size of the encapsulated chunk
+// - the encapsulated chunk, whose plaintext is:
+//   - 4 bytes for the position of the chunk, starting at 0
+//   - 1 byte, 1 for the last chunk and 0 for the others
+//   - the data of the chunk
+// The position and the last-chunk flag are sealed with the data, so that
+// ChunkedResponseDecrypter detects chunks that were reordered, dropped or
+// cut off.
+//
+// Not thread-safe.
+class ChunkedResponseEncrypter {
+ public:
+  // `context` is the one of the request, as returned by
+  // DecryptEncapsulatedRequest().
+  static absl::StatusOr<ChunkedResponseEncrypter> Create(
+      const PrivateKey& private_key,
+      quiche::ObliviousHttpRequest::Context context);
+
+  // Encrypts and frames the next chunk of the response. The last chunk must
+  // set `is_last`, and is the last one accepted.
+  absl::StatusOr<std::string> EncryptChunk(absl::string_view plaintext,
+                                           bool is_last);
+
+ private:
+  ChunkedResponseEncrypter(quiche::ObliviousHttpGateway gateway,
+                           quiche::ObliviousHttpRequest::Context context)
+      : gateway_(std::move(gateway)), context_(std::move(context)) {}
+
+  quiche::ObliviousHttpGateway gateway_;
+  quiche::ObliviousHttpRequest::Context context_;
+  uint32_t num_chunks_ = 0;
+  bool done_ = false;
+};
+
+// Decrypts a response encrypted by ChunkedResponseEncrypter, on the client
+// side, as its bytes arrive. Not thread-safe.
+class ChunkedResponseDecrypter {
+ public:
+  static constexpr uint32_t kDefaultMaxChunkSize = 16 << 20;
+
+  // `context` is the one of the request, and must outlive this object.
+  // Encapsulated chunks larger than `max_chunk_size` are rejected as soon as
+  // their size is read, instead of being buffered.
+  explicit ChunkedResponseDecrypter(
+      quiche::ObliviousHttpRequest::Context& context,
+      uint32_t max_chunk_size = kDefaultMaxChunkSize)
+      : context_(context), max_chunk_size_(max_chunk_size) {}
+
+  // Takes the next bytes of the response, of any size, and returns the
+  // plaintext of the chunks that they complete.
+  absl::StatusOr<std::string> Decrypt(absl::string_view data);
+
+  // Returns true once the last chunk is decrypted. A response that ends before
+  // was cut off.
+  bool IsDone() const { return done_; }
+
+ private:
+  quiche::ObliviousHttpRequest::Context& context_;
+  const uint32_t max_chunk_size_;
+  // Bytes of the next chunks, not complete yet.
+  std::string buffer_;
+  uint32_t num_chunks_ = 0;
+  bool done_ = false;
+};
+
 }  // namespace privacy_sandbox::server_common
 
 #endif  // SRC_CPP_COMMUNICATION_OHTTP_UTILS_H_
@@ -14,6 +14,10 @@
 
 #include "src/cpp/communication/ohttp_utils.h"
 
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "absl/strings/escaping.h"
 #include "absl/strings/match.h"
 #include "gtest/gtest.h"
@@ -118,5 +122,176 @@ TEST(OhttpUtilsTest, EncryptAndEncapsulateResponseSuccess) {
   EXPECT_EQ(response->GetPlaintextData(), response_payload);
 }
 
+google::cmrt::sdk::public_key_service::v1::PublicKey GetPublicKey(
+    uint8_t key_id) {
+  google::cmrt::sdk::public_key_service::v1::PublicKey public_key;
+  public_key.set_key_id(std::to_string(key_id));
+  public_key.set_public_key(absl::Base64Escape(GetHpkePublicKey()));
+  return public_key;
+}
+
+TEST(OhttpUtilsTest, EncapsulateRequestAndDecryptResponseSuccess) {
+  const uint8_t test_key_id = 5;
+  PrivateKey private_key;
+  private_key.key_id = std::to_string(test_key_id);
+  private_key.private_key = GetHpkePrivateKey();
+
+  ObliviousHttpClientCache client_cache;
+  // The second request reuses the client of the first one.
+  for (const std::string plaintext_payload : {"first", "second"}) {
+    auto request = client_cache.EncapsulateRequest(plaintext_payload,
+                                                   GetPublicKey(test_key_id));
+    ASSERT_TRUE(request.ok()) << request.status();
+    auto decrypted_request = DecryptEncapsulatedRequest(
+        private_key, request->EncapsulateAndSerialize());
+    ASSERT_TRUE(decrypted_request.ok()) << decrypted_request.status();
+    EXPECT_EQ(decrypted_request->GetPlaintextData(), plaintext_payload);
+
+    auto server_context = std::move(decrypted_request.value()).ReleaseContext();
+    auto encapsulated_response = EncryptAndEncapsulateResponse(
+        "response_payload", private_key, server_context);
+    ASSERT_TRUE(encapsulated_response.ok());
+    auto client_context = std::move(request.value()).ReleaseContext();
+    auto response =
+        DecryptResponse(*std::move(encapsulated_response), client_context);
+    ASSERT_TRUE(response.ok()) << response.status();
+    EXPECT_EQ(*response, "response_payload");
+  }
+}
+
+TEST(OhttpUtilsTest, EncapsulateRequestRejectsInvalidPublicKey) {
+  ObliviousHttpClientCache client_cache;
+  auto public_key = GetPublicKey(5);
+  public_key.set_public_key("not base64!");
+  EXPECT_TRUE(absl::IsInternal(
+      client_cache.EncapsulateRequest("payload", public_key).status()));
+
+  public_key = GetPublicKey(5);
+  public_key.set_key_id("not a key ID");
+  EXPECT_TRUE(absl::IsInternal(
+      client_cache.EncapsulateRequest("payload", public_key).status()));
+}
+
+TEST(OhttpUtilsTest, DecryptResponseRejectsMalformedResponse) {
+  ObliviousHttpClientCache client_cache;
+  auto request = client_cache.EncapsulateRequest("payload", GetPublicKey(5));
+  ASSERT_TRUE(request.ok()) << request.status();
+  auto context = std::move(request.value()).ReleaseContext();
+  EXPECT_TRUE(IsInvalidArgument(DecryptResponse("garbage", context).status()));
+}
+
+// A client request and the contexts that the client and the server keep for
+// it.
+struct ChunkedResponseTestRequest {
+  PrivateKey private_key;
+  quiche::ObliviousHttpRequest::Context client_context;
+  quiche::ObliviousHttpRequest::Context server_context;
+};
+
+ChunkedResponseTestRequest CreateChunkedResponseTestRequest() {
+  const uint8_t test_key_id = 5;
+  const auto config =
+      GetOhttpKeyConfig(test_key_id, EVP_HPKE_DHKEM_X25519_HKDF_SHA256,
+                        EVP_HPKE_HKDF_SHA256, EVP_HPKE_AES_256_GCM);
+  PrivateKey private_key;
+  private_key.key_id = std::to_string(test_key_id);
+  private_key.private_key = GetHpkePrivateKey();
+
+  const auto http_client =
+      quiche::ObliviousHttpClient::Create(GetHpkePublicKey(), config);
+  auto request = http_client->CreateObliviousHttpRequest("plaintext_payload");
+  auto decrypted_request = DecryptEncapsulatedRequest(
+      private_key, request->EncapsulateAndSerialize());
+  EXPECT_TRUE(decrypted_request.ok()) << decrypted_request.status();
+  return ChunkedResponseTestRequest{
+      private_key, std::move(request.value()).ReleaseContext(),
+      std::move(decrypted_request.value()).ReleaseContext()};
+}
+
+// Encrypts every chunk of `plaintext`, the last one as such.
+std::vector<std::string> EncryptChunks(
+    ChunkedResponseTestRequest& request,
+    const std::vector<std::string>& plaintext) {
+  auto encrypter = ChunkedResponseEncrypter::Create(
+      request.private_key, std::move(request.server_context));
+  EXPECT_TRUE(encrypter.ok()) << encrypter.status();
+  std::vector<std::string> chunks;
+  for (size_t i = 0; i < plaintext.size(); ++i) {
+    auto chunk =
+        encrypter->EncryptChunk(plaintext[i], i + 1 == plaintext.size());
+    EXPECT_TRUE(chunk.ok()) << chunk.status();
+    chunks.push_back(*std::move(chunk));
+  }
+  return chunks;
+}
+
+TEST(OhttpUtilsTest, ChunkedResponseSuccess) {
+  ChunkedResponseTestRequest request = CreateChunkedResponseTestRequest();
+  const std::vector<std::string> chunks =
+      EncryptChunks(request, {"response", "_", "payload"});
+
+  // Feeds the response one byte at a time, as a slow network could.
+  ChunkedResponseDecrypter decrypter(request.client_context);
+  std::string response;
+  for (const std::string& chunk : chunks) {
+    EXPECT_FALSE(decrypter.IsDone());
+    for (char c : chunk) {
+      auto plaintext = decrypter.Decrypt(std::string(1, c));
+      ASSERT_TRUE(plaintext.ok()) << plaintext.status();
+      response += *plaintext;
+    }
+  }
+  EXPECT_TRUE(decrypter.IsDone());
+  EXPECT_EQ(response, "response_payload");
+}
+
+TEST(OhttpUtilsTest, ChunkedResponseRejectsReorderedChunks) {
+  ChunkedResponseTestRequest request = CreateChunkedResponseTestRequest();
+  const std::vector<std::string> chunks =
+      EncryptChunks(request, {"first", "second", "last"});
+
+  ChunkedResponseDecrypter decrypter(request.client_context);
+  ASSERT_TRUE(decrypter.Decrypt(chunks[0]).ok());
+  EXPECT_TRUE(IsInvalidArgument(decrypter.Decrypt(chunks[2]).status()));
+}
+
+TEST(OhttpUtilsTest, ChunkedResponseDetectsTruncation) {
+  ChunkedResponseTestRequest request = CreateChunkedResponseTestRequest();
+  const std::vector<std::string> chunks =
+      EncryptChunks(request, {"first", "last"});
+
+  ChunkedResponseDecrypter decrypter(request.client_context);
+  EXPECT_EQ(*decrypter.Decrypt(chunks[0]), "first");
+  EXPECT_FALSE(decrypter.IsDone());
+  EXPECT_EQ(*decrypter.Decrypt(chunks[1]), "last");
+  EXPECT_TRUE(decrypter.IsDone());
+  EXPECT_TRUE(IsInvalidArgument(decrypter.Decrypt(chunks[1]).status()));
+}
+
+TEST(OhttpUtilsTest, ChunkedResponseRejectsOversizedChunks) {
+  ChunkedResponseTestRequest request = CreateChunkedResponseTestRequest();
+  const std::vector<std::string> chunks = EncryptChunks(request, {"last"});
+
+  // Rejected from the size alone, before the rest of the chunk arrives.
+  ChunkedResponseDecrypter decrypter(request.client_context,
+                                     /*max_chunk_size=*/chunks[0].size() - 5);
+  EXPECT_TRUE(
+      IsInvalidArgument(decrypter.Decrypt(chunks[0].substr(0, 4)).status()));
+
+  ChunkedResponseDecrypter default_decrypter(request.client_context);
+  EXPECT_TRUE(IsInvalidArgument(
+      default_decrypter.Decrypt(std::string(4, '\xff')).status()));
+}
+
+TEST(OhttpUtilsTest, ChunkedResponseRejectsChunksAfterLast) {
+  ChunkedResponseTestRequest request = CreateChunkedResponseTestRequest();
+  auto encrypter = ChunkedResponseEncrypter::Create(
+      request.private_key, std::move(request.server_context));
+  ASSERT_TRUE(encrypter.ok()) << encrypter.status();
+  ASSERT_TRUE(encrypter->EncryptChunk("last", /*is_last=*/true).ok());
+  EXPECT_TRUE(absl::IsFailedPrecondition(
+      encrypter->EncryptChunk("more", /*is_last=*/false).status()));
+}
+
 }  // namespace
 }  // namespace privacy_sandbox::server_common
@@ -0,0 +1,89 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/cpp/communication/streaming_concatenator.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+
+namespace privacy_sandbox::server_common {
+
+StreamingCompressionGroupConcatenator::StreamingCompressionGroupConcatenator(
+    std::unique_ptr<CompressionGroupConcatenator> concatenator, Sink sink,
+    Executor* executor)
+    : concatenator_(std::move(concatenator)),
+      executor_(executor),
+      sink_(std::move(sink)) {}
+
+StreamingCompressionGroupConcatenator::
+    ~StreamingCompressionGroupConcatenator() {
+  Finish().IgnoreError();
+}
+
+void StreamingCompressionGroupConcatenator::AddCompressionGroup(
+    std::string plaintext_compression_group) {
+  const size_t index = num_added_++;
+  {
+    absl::MutexLock lock(&mutex_);
+    outputs_.emplace_back();
+    ++num_pending_;
+  }
+  auto compress = [this, index,
+                   input = std::move(plaintext_compression_group)]() mutable {
+    absl::StatusOr<std::string> compression_group =
+        concatenator_->BuildFramedCompressionGroup(input);
+    // The executor may destroy the closure later on.
+    std::string().swap(input);
+    Complete(index, std::move(compression_group));
+  };
+  if (executor_ == nullptr) {
+    compress();
+  } else {
+    executor_->Run(std::move(compress));
+  }
+}
+
+absl::Status StreamingCompressionGroupConcatenator::Finish() {
+  absl::MutexLock lock(&mutex_);
+  mutex_.Await(absl::Condition(
+      +[](size_t* num_pending) { return *num_pending == 0; }, &num_pending_));
+  return status_;
+}
+
+void StreamingCompressionGroupConcatenator::Complete(
+    size_t index, absl::StatusOr<std::string> compression_group) {
+  absl::MutexLock lock(&mutex_);
+  outputs_[index - num_emitted_] = std::move(compression_group);
+  while (!outputs_.empty() && outputs_.front().has_value()) {
+    absl::StatusOr<std::string> output = *std::move(outputs_.front());
+    outputs_.pop_front();
+    ++num_emitted_;
+    if (!status_.ok()) {
+      continue;
+    }
+    if (!output.ok()) {
+      status_ = output.status();
+      continue;
+    }
+    sink_(*std::move(output));
+  }
+  --num_pending_;
+}
+
+}  // namespace privacy_sandbox::server_common
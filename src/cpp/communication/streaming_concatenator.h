@@ -0,0 +1,95 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_CPP_COMMUNICATION_STREAMING_CONCATENATOR_H_
+#define SRC_CPP_COMMUNICATION_STREAMING_CONCATENATOR_H_
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "absl/functional/any_invocable.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
+#include "src/cpp/communication/compression.h"
+#include "src/cpp/concurrent/executor.h"
+
+namespace privacy_sandbox::server_common {
+
+// Compresses every compression group as soon as it is added, instead of
+// holding all of them until Build(), and passes the framed groups to a sink in
+// the order they were added. The plaintext of a group is released once it is
+// compressed, and the concatenated output of the sink is the same as the
+// output of Build() of the underlying concatenator.
+//
+// Should not be reused across requests. AddCompressionGroup() and Finish() must
+// be called from one thread at a time.
+class StreamingCompressionGroupConcatenator {
+ public:
+  // Receives the framed compression groups, one at a time and in order. Called
+  // on the thread that completes a group, with an internal lock held, so it
+  // must not call back into the concatenator.
+  using Sink = absl::AnyInvocable<void(std::string compression_group)>;
+
+  // Compresses the groups the way `concatenator` does; groups added to
+  // `concatenator` itself are ignored. With an `executor`, which must outlive
+  // this object, groups are compressed on it in parallel with the caller
+  // producing the next group. Otherwise, they are compressed within
+  // AddCompressionGroup().
+  StreamingCompressionGroupConcatenator(
+      std::unique_ptr<CompressionGroupConcatenator> concatenator, Sink sink,
+      Executor* executor = nullptr);
+
+  // Waits for the groups still being compressed.
+  ~StreamingCompressionGroupConcatenator();
+
+  StreamingCompressionGroupConcatenator(
+      const StreamingCompressionGroupConcatenator&) = delete;
+  StreamingCompressionGroupConcatenator& operator=(
+      const StreamingCompressionGroupConcatenator&) = delete;
+
+  void AddCompressionGroup(std::string plaintext_compression_group);
+
+  // Waits until every group has been compressed and passed to the sink, and
+  // returns the first compression error. The sink receives no group after the
+  // one that failed.
+  absl::Status Finish();
+
+ private:
+  // Stores the output of group `index` and passes every group that is next in
+  // line to the sink.
+  void Complete(size_t index, absl::StatusOr<std::string> compression_group);
+
+  std::unique_ptr<CompressionGroupConcatenator> concatenator_;
+  Executor* executor_;
+
+  absl::Mutex mutex_;
+  Sink sink_ ABSL_GUARDED_BY(mutex_);
+  size_t num_added_ = 0;
+  // Outputs of the groups from `num_emitted_` on, if they are compressed.
+  std::deque<std::optional<absl::StatusOr<std::string>>> outputs_
+      ABSL_GUARDED_BY(mutex_);
+  size_t num_emitted_ ABSL_GUARDED_BY(mutex_) = 0;
+  size_t num_pending_ ABSL_GUARDED_BY(mutex_) = 0;
+  absl::Status status_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace privacy_sandbox::server_common
+
+#endif  // SRC_CPP_COMMUNICATION_STREAMING_CONCATENATOR_H_
@@ -0,0 +1,154 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/cpp/communication/streaming_concatenator.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/functional/any_invocable.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+#include "src/cpp/communication/compression_brotli.h"
+#include "src/cpp/communication/uncompressed.h"
+#include "src/cpp/concurrent/executor.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+// Runs every closure on a thread of its own, joined on destruction.
+class ThreadPerTaskExecutor : public Executor {
+ public:
+  ~ThreadPerTaskExecutor() override {
+    for (std::thread& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  void Run(absl::AnyInvocable<void()> closure) override {
+    threads_.emplace_back(std::move(closure));
+  }
+  TaskId RunAfter(absl::Duration duration,
+                  absl::AnyInvocable<void()> closure) override {
+    ADD_FAILURE() << "Unexpected RunAfter()";
+    return {};
+  }
+  bool Cancel(TaskId task_id) override { return false; }
+
+ private:
+  std::vector<std::thread> threads_;
+};
+
+// Fails to compress the groups that read "fail".
+class FailingConcatenator : public UncompressedConcatenator {
+ protected:
+  absl::StatusOr<std::string> BuildCompressionGroup(
+      std::string_view partition) const override {
+    if (partition == "fail") {
+      return absl::InternalError("Failed to compress");
+    }
+    return UncompressedConcatenator::BuildCompressionGroup(partition);
+  }
+};
+
+// Groups of different sizes, so that they take different times to compress.
+std::vector<std::string> MakeCompressionGroups() {
+  std::vector<std::string> groups;
+  for (int i = 0; i < 16; ++i) {
+    std::string group;
+    for (int j = 0; j < (i % 4 + 1) * 1000; ++j) {
+      absl::StrAppend(&group, "group ", i, " item ", j, ";");
+    }
+    groups.push_back(std::move(group));
+  }
+  return groups;
+}
+
+std::string BuildAll(const std::vector<std::string>& groups) {
+  BrotliCompressionGroupConcatenator concatenator;
+  for (const std::string& group : groups) {
+    concatenator.AddCompressionGroup(group);
+  }
+  return concatenator.Build().value();
+}
+
+TEST(StreamingCompressionGroupConcatenatorTest, EmitsEachGroupWhenAdded) {
+  std::vector<std::string> outputs;
+  StreamingCompressionGroupConcatenator concatenator(
+      std::make_unique<UncompressedConcatenator>(),
+      [&outputs](std::string compression_group) {
+        outputs.push_back(std::move(compression_group));
+      });
+  concatenator.AddCompressionGroup("first");
+  EXPECT_EQ(outputs.size(), 1);
+  concatenator.AddCompressionGroup("second");
+  EXPECT_EQ(outputs.size(), 2);
+  ASSERT_TRUE(concatenator.Finish().ok());
+
+  UncompressedConcatenator expected;
+  expected.AddCompressionGroup("first");
+  expected.AddCompressionGroup("second");
+  EXPECT_EQ(absl::StrCat(outputs[0], outputs[1]), *expected.Build());
+}
+
+TEST(StreamingCompressionGroupConcatenatorTest, MatchesBuildWithExecutor) {
+  const std::vector<std::string> groups = MakeCompressionGroups();
+  std::string output;
+  int num_groups = 0;
+  {
+    ThreadPerTaskExecutor executor;
+    StreamingCompressionGroupConcatenator concatenator(
+        std::make_unique<BrotliCompressionGroupConcatenator>(),
+        [&output, &num_groups](std::string compression_group) {
+          output.append(compression_group);
+          ++num_groups;
+        },
+        &executor);
+    for (const std::string& group : groups) {
+      concatenator.AddCompressionGroup(group);
+    }
+    ASSERT_TRUE(concatenator.Finish().ok());
+  }
+  EXPECT_EQ(num_groups, groups.size());
+  EXPECT_EQ(output, BuildAll(groups));
+}
+
+TEST(StreamingCompressionGroupConcatenatorTest, StopsAtFirstError) {
+  std::vector<std::string> outputs;
+  ThreadPerTaskExecutor executor;
+  StreamingCompressionGroupConcatenator concatenator(
+      std::make_unique<FailingConcatenator>(),
+      [&outputs](std::string compression_group) {
+        outputs.push_back(std::move(compression_group));
+      },
+      &executor);
+  concatenator.AddCompressionGroup("first");
+  concatenator.AddCompressionGroup("fail");
+  concatenator.AddCompressionGroup("third");
+  EXPECT_TRUE(absl::IsInternal(concatenator.Finish()));
+  ASSERT_EQ(outputs.size(), 1);
+
+  UncompressedBlobReader blob_reader(outputs[0]);
+  EXPECT_EQ(*blob_reader.ExtractOneCompressionGroup(), "first");
+}
+
+}  // namespace
+}  // namespace privacy_sandbox::server_common
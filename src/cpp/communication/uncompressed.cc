@@ -13,42 +13,113 @@
 // limitations under the License.
 #include "src/cpp/communication/uncompressed.h"
 
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
+#include "absl/strings/str_cat.h"
 #include "glog/logging.h"
 #include "quiche/common/quiche_data_writer.h"
 
 namespace privacy_sandbox::server_common {
 
-absl::StatusOr<std::string> UncompressedConcatenator::Build() const {
-  std::string output;
-  int output_size = sizeof(u_int32_t) * Partitions().size();
-  for (const auto& partition : Partitions()) {
-    output_size += partition.size();
+namespace {
+
+absl::StatusOr<std::string_view> ReadCompressionGroup(
+    quiche::QuicheDataReader& data_reader) {
+  uint32_t compression_group_size = 0;
+  if (!data_reader.ReadUInt32(&compression_group_size)) {
+    return absl::InvalidArgumentError("Failed to read compression group size");
+  }
+  VLOG(9) << "compression_group_size: " << compression_group_size;
+  std::string_view output;
+  if (!data_reader.ReadStringPiece(&output, compression_group_size)) {
+    return absl::InvalidArgumentError("Failed to read compression group");
   }
+  VLOG(9) << "compression group: " << output;
+  return output;
+}
+
+}  // namespace
 
-  output.resize(output_size);
+absl::StatusOr<std::string> UncompressedConcatenator::Build() const {
+  // Writes the framing and the partitions, which were moved in by
+  // AddCompressionGroup(), straight into the output: each byte is copied once,
+  // into a single allocation. This also holds with size hints and references.
+  const std::vector<std::string>& partitions = Partitions();
+  const std::vector<std::optional<uint32_t>> earlier_occurrences =
+      EarlierOccurrences();
+  const size_t size_hint_size = size_hints() ? 2 * sizeof(uint32_t) : 0;
+  size_t output_size = 0;
+  for (size_t i = 0; i < partitions.size(); ++i) {
+    output_size += earlier_occurrences[i].has_value()
+                       ? 2 * sizeof(uint32_t)
+                       : size_hint_size + sizeof(uint32_t) +
+                             partitions[i].size();
+  }
+  std::string output(output_size, '\0');
   quiche::QuicheDataWriter data_writer(output.size(), output.data());
-  for (const auto& partition : Partitions()) {
-    data_writer.WriteUInt32(partition.size());
-    data_writer.WriteStringPiece(partition);
+  for (size_t i = 0; i < partitions.size(); ++i) {
+    if (earlier_occurrences[i].has_value()) {
+      data_writer.WriteUInt32(kCompressionGroupReference);
+      data_writer.WriteUInt32(*earlier_occurrences[i]);
+      continue;
+    }
+    if (size_hints()) {
+      data_writer.WriteUInt32(kCompressionGroupSizeHint);
+      data_writer.WriteUInt32(partitions[i].size());
+    }
+    data_writer.WriteUInt32(partitions[i].size());
+    data_writer.WriteStringPiece(partitions[i]);
   }
   return output;
 }
 
+absl::StatusOr<std::string> UncompressedConcatenator::BuildCompressionGroup(
+    std::string_view partition) const {
+  std::string output(sizeof(uint32_t) + partition.size(), '\0');
+  quiche::QuicheDataWriter data_writer(output.size(), output.data());
+  data_writer.WriteUInt32(partition.size());
+  data_writer.WriteStringPiece(partition);
+  return output;
+}
+
+absl::StatusOr<std::string_view>
+UncompressedBlobReader::ExtractOneCompressionGroupView() {
+  return CompressedBlobReader::ExtractOneCompressionGroupView(
+      ReadCompressionGroup);
+}
+
 absl::StatusOr<std::string>
-UncompressedBlobReader::ExtractOneCompressionGroup() {
-  uint32_t compression_group_size = 0;
-  if (!data_reader_.ReadUInt32(&compression_group_size)) {
-    return absl::InvalidArgumentError("Failed to read compression group size");
+UncompressedBlobReader::DecompressOneCompressionGroup() {
+  absl::StatusOr<std::string_view> output = ReadCompressionGroup(data_reader_);
+  if (!output.ok()) {
+    return output.status();
   }
-  VLOG(9) << "compression_group_size: " << compression_group_size;
-  std::string_view output;
-  if (!data_reader_.ReadStringPiece(&output, compression_group_size)) {
-    return absl::InvalidArgumentError("Failed to read compression group");
+  if (output->size() > max_decompressed_size()) {
+    return absl::ResourceExhaustedError(absl::StrCat(
+        "Compression group exceeds the decompression limit of ",
+        max_decompressed_size(), " bytes"));
   }
-  VLOG(9) << "compression group: " << output;
-  return std::string(output);
+  return std::string(*output);
+}
+
+absl::StatusOr<std::pmr::string>
+UncompressedBlobReader::DecompressOneCompressionGroup(
+    std::pmr::memory_resource* resource) {
+  absl::StatusOr<std::string_view> output = ReadCompressionGroup(data_reader_);
+  if (!output.ok()) {
+    return output.status();
+  }
+  if (output->size() > max_decompressed_size()) {
+    return absl::ResourceExhaustedError(absl::StrCat(
+        "Compression group exceeds the decompression limit of ",
+        max_decompressed_size(), " bytes"));
+  }
+  return std::pmr::string(*output, resource);
 }
 
 }  // namespace privacy_sandbox::server_common
@@ -11,6 +11,8 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
+#include <memory>
+#include <memory_resource>
 #include <string>
 #include <string_view>
 
@@ -23,6 +25,10 @@ namespace privacy_sandbox::server_common {
 class UncompressedConcatenator : public CompressionGroupConcatenator {
  public:
   absl::StatusOr<std::string> Build() const override;
+
+ protected:
+  absl::StatusOr<std::string> BuildCompressionGroup(
+      std::string_view partition) const override;
 };
 
 // Reads compression groups built with UncompressedConcatenator.
@@ -31,7 +37,18 @@ class UncompressedBlobReader : public CompressedBlobReader {
   explicit UncompressedBlobReader(std::string_view compressed)
       : CompressedBlobReader(compressed) {}
 
-  absl::StatusOr<std::string> ExtractOneCompressionGroup() override;
+  // Same as ExtractOneCompressionGroup(), but returns a view into the blob
+  // instead of a copy. Valid as long as the blob is.
+  absl::StatusOr<std::string_view> ExtractOneCompressionGroupView();
+
+ protected:
+  absl::StatusOr<std::string> DecompressOneCompressionGroup() override;
+  absl::StatusOr<std::pmr::string> DecompressOneCompressionGroup(
+      std::pmr::memory_resource* resource) override;
+  std::unique_ptr<CompressedBlobReader> CreateGroupReader(
+      std::string_view compression_group) const override {
+    return std::make_unique<UncompressedBlobReader>(compression_group);
+  }
 };
 
 }  // namespace privacy_sandbox::server_common
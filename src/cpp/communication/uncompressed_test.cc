@@ -12,11 +12,15 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <string>
 #include <string_view>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "quiche/common/quiche_data_writer.h"
 #include "src/cpp/communication/compression.h"
+#include "src/cpp/communication/uncompressed.h"
+#include "src/cpp/util/request_arena.h"
 
 namespace privacy_sandbox::server_common {
 namespace {
@@ -70,5 +74,304 @@ TEST(CompressionBlobReaderTest, Success) {
   EXPECT_TRUE(blob_reader->IsDoneReading());
 }
 
+TEST(CompressionBlobReaderTest, ExtractsIntoArena) {
+  auto concatenator = CompressionGroupConcatenator::Create(
+      CompressionGroupConcatenator::CompressionType::kUncompressed);
+  concatenator->AddCompressionGroup(std::string(kTestString));
+  absl::StatusOr<std::string> maybe_output = concatenator->Build();
+  ASSERT_TRUE(maybe_output.ok());
+
+  auto blob_reader = CompressedBlobReader::Create(
+      CompressionGroupConcatenator::CompressionType::kUncompressed,
+      *maybe_output);
+  RequestArena arena;
+  absl::StatusOr<std::pmr::string> maybe_compression_group =
+      blob_reader->ExtractOneCompressionGroup(&arena);
+  ASSERT_TRUE(maybe_compression_group.ok());
+  EXPECT_EQ(std::string_view(*maybe_compression_group), kTestString);
+  EXPECT_EQ(maybe_compression_group->get_allocator().resource(), &arena);
+  EXPECT_TRUE(blob_reader->IsDoneReading());
+}
+
+TEST(CompressionGroupIndexTest, ReachesEveryGroup) {
+  auto concatenator = CompressionGroupConcatenator::Create(
+      CompressionGroupConcatenator::CompressionType::kUncompressed);
+  concatenator->AddCompressionGroup(std::string(kTestString));
+  concatenator->AddCompressionGroup("");
+  concatenator->AddCompressionGroup(std::string(kTestString2));
+  absl::StatusOr<std::string> indexed_blob = concatenator->BuildIndexed();
+  ASSERT_TRUE(indexed_blob.ok());
+
+  absl::StatusOr<CompressionGroupIndex> index =
+      CompressionGroupIndex::Parse(*indexed_blob);
+  ASSERT_TRUE(index.ok()) << index.status();
+  ASSERT_EQ(index->num_compression_groups(), 3);
+  // The groups are framed as by Build().
+  EXPECT_EQ(index->compression_groups(), *concatenator->Build());
+
+  auto blob_reader = CompressedBlobReader::Create(
+      CompressionGroupConcatenator::CompressionType::kUncompressed,
+      index->compression_groups());
+  EXPECT_EQ(*blob_reader->ExtractCompressionGroup(*index, 2), kTestString2);
+  EXPECT_EQ(*blob_reader->ExtractCompressionGroup(*index, 1), "");
+  EXPECT_EQ(*blob_reader->ExtractCompressionGroup(*index, 0), kTestString);
+  EXPECT_TRUE(absl::IsOutOfRange(
+      blob_reader->ExtractCompressionGroup(*index, 3).status()));
+  // Random access leaves the sequential reading alone.
+  EXPECT_EQ(*blob_reader->ExtractOneCompressionGroup(), kTestString);
+}
+
+TEST(CompressionGroupIndexTest, GetsFramedGroup) {
+  UncompressedConcatenator concatenator;
+  concatenator.AddCompressionGroup(std::string(kTestString));
+  concatenator.AddCompressionGroup(std::string(kTestString2));
+  absl::StatusOr<std::string> indexed_blob = concatenator.BuildIndexed();
+  ASSERT_TRUE(indexed_blob.ok());
+  absl::StatusOr<CompressionGroupIndex> index =
+      CompressionGroupIndex::Parse(*indexed_blob);
+  ASSERT_TRUE(index.ok()) << index.status();
+
+  absl::StatusOr<std::string_view> compression_group =
+      index->GetCompressionGroup(1);
+  ASSERT_TRUE(compression_group.ok());
+  UncompressedBlobReader blob_reader(*compression_group);
+  EXPECT_EQ(*blob_reader.ExtractOneCompressionGroup(), kTestString2);
+  EXPECT_TRUE(blob_reader.IsDoneReading());
+}
+
+TEST(CompressionGroupIndexTest, RejectsMalformedIndex) {
+  UncompressedConcatenator concatenator;
+  concatenator.AddCompressionGroup(std::string(kTestString));
+  absl::StatusOr<std::string> indexed_blob = concatenator.BuildIndexed();
+  ASSERT_TRUE(indexed_blob.ok());
+
+  // Truncated groups.
+  EXPECT_TRUE(absl::IsInvalidArgument(
+      CompressionGroupIndex::Parse(
+          std::string_view(*indexed_blob).substr(0, indexed_blob->size() - 1))
+          .status()));
+  // Truncated table.
+  EXPECT_TRUE(absl::IsInvalidArgument(
+      CompressionGroupIndex::Parse(std::string_view(*indexed_blob).substr(0, 6))
+          .status()));
+  // Not indexed.
+  EXPECT_TRUE(absl::IsInvalidArgument(
+      CompressionGroupIndex::Parse(*concatenator.Build()).status()));
+}
+
+TEST(CompressionGroupConcatenatorTest, DeduplicatesIdenticalGroups) {
+  UncompressedConcatenator concatenator;
+  concatenator.set_deduplicate(true);
+  for (const auto& test_string :
+       {kTestString, kTestString2, kTestString, kTestString}) {
+    concatenator.AddCompressionGroup(std::string(test_string));
+  }
+  absl::StatusOr<std::string> maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok());
+
+  // Two groups, then two references of 8 bytes to the first one.
+  EXPECT_EQ(maybe_output->size(), 2 * sizeof(uint32_t) + kTestString.size() +
+                                      kTestString2.size() +
+                                      2 * 2 * sizeof(uint32_t));
+  UncompressedBlobReader blob_reader(*maybe_output);
+  for (const auto& test_string :
+       {kTestString, kTestString2, kTestString, kTestString}) {
+    absl::StatusOr<std::string> group =
+        blob_reader.ExtractOneCompressionGroup();
+    ASSERT_TRUE(group.ok()) << group.status();
+    EXPECT_EQ(*group, test_string);
+  }
+  EXPECT_TRUE(blob_reader.IsDoneReading());
+}
+
+TEST(CompressionGroupConcatenatorTest, FramesSizeHintsAndReferences) {
+  UncompressedConcatenator concatenator;
+  concatenator.set_deduplicate(true);
+  concatenator.set_size_hints(true);
+  for (const auto& test_string : {kTestString, kTestString2, kTestString}) {
+    concatenator.AddCompressionGroup(std::string(test_string));
+  }
+  absl::StatusOr<std::string> maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok());
+
+  // Two groups with their size hints, then a reference to the first one.
+  EXPECT_EQ(maybe_output->size(), 2 * 3 * sizeof(uint32_t) +
+                                      kTestString.size() +
+                                      kTestString2.size() +
+                                      2 * sizeof(uint32_t));
+  // Same groups as the ones built one by one for the index.
+  absl::StatusOr<std::string> indexed_blob = concatenator.BuildIndexed();
+  ASSERT_TRUE(indexed_blob.ok());
+  absl::StatusOr<CompressionGroupIndex> index =
+      CompressionGroupIndex::Parse(*indexed_blob);
+  ASSERT_TRUE(index.ok()) << index.status();
+  EXPECT_EQ(index->compression_groups(), *maybe_output);
+  UncompressedBlobReader blob_reader(*maybe_output);
+  for (const auto& test_string : {kTestString, kTestString2, kTestString}) {
+    absl::StatusOr<std::string> group =
+        blob_reader.ExtractOneCompressionGroup();
+    ASSERT_TRUE(group.ok()) << group.status();
+    EXPECT_EQ(*group, test_string);
+  }
+  EXPECT_TRUE(blob_reader.IsDoneReading());
+}
+
+TEST(CompressionGroupConcatenatorTest, DoesNotDeduplicateByDefault) {
+  UncompressedConcatenator concatenator;
+  concatenator.AddCompressionGroup(std::string(kTestString));
+  concatenator.AddCompressionGroup(std::string(kTestString));
+  absl::StatusOr<std::string> maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok());
+  EXPECT_EQ(maybe_output->size(), 2 * (sizeof(uint32_t) + kTestString.size()));
+}
+
+TEST(CompressionBlobReaderTest, RejectsForwardReference) {
+  std::string blob(2 * sizeof(uint32_t), '\0');
+  quiche::QuicheDataWriter data_writer(blob.size(), blob.data());
+  data_writer.WriteUInt32(kCompressionGroupReference);
+  data_writer.WriteUInt32(0);
+  UncompressedBlobReader blob_reader(blob);
+  EXPECT_TRUE(absl::IsInvalidArgument(
+      blob_reader.ExtractOneCompressionGroup().status()));
+}
+
+TEST(CompressionGroupIndexTest, FollowsReferences) {
+  UncompressedConcatenator concatenator;
+  concatenator.set_deduplicate(true);
+  concatenator.AddCompressionGroup(std::string(kTestString));
+  concatenator.AddCompressionGroup(std::string(kTestString2));
+  concatenator.AddCompressionGroup(std::string(kTestString));
+  absl::StatusOr<std::string> indexed_blob = concatenator.BuildIndexed();
+  ASSERT_TRUE(indexed_blob.ok());
+  absl::StatusOr<CompressionGroupIndex> index =
+      CompressionGroupIndex::Parse(*indexed_blob);
+  ASSERT_TRUE(index.ok()) << index.status();
+  EXPECT_EQ(index->compression_groups(), *concatenator.Build());
+
+  UncompressedBlobReader blob_reader(index->compression_groups());
+  EXPECT_EQ(*blob_reader.ExtractCompressionGroup(*index, 2), kTestString);
+}
+
+TEST(CompressionGroupIndexTest, RejectsReferencesToReferences) {
+  UncompressedConcatenator concatenator;
+  concatenator.set_deduplicate(true);
+  concatenator.AddCompressionGroup(std::string(kTestString));
+  concatenator.AddCompressionGroup(std::string(kTestString2));
+  concatenator.AddCompressionGroup(std::string(kTestString));
+  concatenator.AddCompressionGroup(std::string(kTestString));
+  absl::StatusOr<std::string> indexed_blob = concatenator.BuildIndexed();
+  ASSERT_TRUE(indexed_blob.ok());
+
+  // Points the last group, a reference to group 0, at `k` instead.
+  auto extract_last_group_referring_to = [&](uint32_t k) {
+    std::string blob = *indexed_blob;
+    quiche::QuicheDataWriter data_writer(
+        sizeof(uint32_t), blob.data() + blob.size() - sizeof(uint32_t));
+    data_writer.WriteUInt32(k);
+    absl::StatusOr<CompressionGroupIndex> index =
+        CompressionGroupIndex::Parse(blob);
+    EXPECT_TRUE(index.ok()) << index.status();
+    UncompressedBlobReader blob_reader(index->compression_groups());
+    return blob_reader.ExtractCompressionGroup(*index, 3);
+  };
+  EXPECT_EQ(*extract_last_group_referring_to(0), kTestString);
+  // Group 2 is a reference to group 0.
+  EXPECT_TRUE(absl::IsInvalidArgument(
+      extract_last_group_referring_to(2).status()));
+  EXPECT_TRUE(absl::IsInvalidArgument(
+      extract_last_group_referring_to(3).status()));
+}
+
+TEST(CompressionBlobReaderTest, RejectsWrongSizeHint) {
+  UncompressedConcatenator concatenator;
+  concatenator.set_size_hints(true);
+  concatenator.AddCompressionGroup(std::string(kTestString));
+  absl::StatusOr<std::string> maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok());
+
+  // Claims one byte less than the group holds.
+  quiche::QuicheDataWriter data_writer(2 * sizeof(uint32_t),
+                                       maybe_output->data());
+  data_writer.WriteUInt32(kCompressionGroupSizeHint);
+  data_writer.WriteUInt32(kTestString.size() - 1);
+  UncompressedBlobReader blob_reader(*maybe_output);
+  EXPECT_FALSE(blob_reader.ExtractOneCompressionGroup().ok());
+}
+
+TEST(CompressionGroupIndexTest, ReadsSizeHints) {
+  UncompressedConcatenator concatenator;
+  concatenator.set_size_hints(true);
+  concatenator.AddCompressionGroup(std::string(kTestString));
+  concatenator.AddCompressionGroup(std::string(kTestString2));
+  absl::StatusOr<std::string> indexed_blob = concatenator.BuildIndexed();
+  ASSERT_TRUE(indexed_blob.ok());
+  absl::StatusOr<CompressionGroupIndex> index =
+      CompressionGroupIndex::Parse(*indexed_blob);
+  ASSERT_TRUE(index.ok()) << index.status();
+
+  UncompressedBlobReader blob_reader(index->compression_groups());
+  EXPECT_EQ(*blob_reader.ExtractCompressionGroup(*index, 1), kTestString2);
+  EXPECT_EQ(*blob_reader.ExtractOneCompressionGroup(), kTestString);
+}
+
+TEST(CompressionBlobReaderTest, ExtractsViewsIntoBlob) {
+  UncompressedConcatenator concatenator;
+  concatenator.AddCompressionGroup(std::string(kTestString));
+  concatenator.AddCompressionGroup(std::string(kTestString2));
+  absl::StatusOr<std::string> maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok());
+
+  UncompressedBlobReader blob_reader(*maybe_output);
+  for (const auto& test_string : {kTestString, kTestString2}) {
+    absl::StatusOr<std::string_view> group =
+        blob_reader.ExtractOneCompressionGroupView();
+    ASSERT_TRUE(group.ok()) << group.status();
+    EXPECT_EQ(*group, test_string);
+    EXPECT_GE(group->data(), maybe_output->data());
+    EXPECT_LE(group->data() + group->size(),
+              maybe_output->data() + maybe_output->size());
+  }
+  EXPECT_TRUE(blob_reader.IsDoneReading());
+}
+
+TEST(CompressionBlobReaderTest, ExtractsViewsOfReferencesAndSizeHints) {
+  UncompressedConcatenator concatenator;
+  concatenator.set_deduplicate(true);
+  concatenator.set_size_hints(true);
+  concatenator.AddCompressionGroup(std::string(kTestString));
+  concatenator.AddCompressionGroup(std::string(kTestString2));
+  concatenator.AddCompressionGroup(std::string(kTestString));
+  absl::StatusOr<std::string> maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok());
+
+  UncompressedBlobReader blob_reader(*maybe_output);
+  absl::StatusOr<std::string_view> first =
+      blob_reader.ExtractOneCompressionGroupView();
+  ASSERT_TRUE(first.ok()) << first.status();
+  EXPECT_EQ(*first, kTestString);
+  EXPECT_EQ(*blob_reader.ExtractOneCompressionGroupView(), kTestString2);
+  absl::StatusOr<std::string_view> reference =
+      blob_reader.ExtractOneCompressionGroupView();
+  ASSERT_TRUE(reference.ok()) << reference.status();
+  // The reference is a view of the earlier group itself.
+  EXPECT_EQ(reference->data(), first->data());
+  EXPECT_EQ(*reference, kTestString);
+  EXPECT_TRUE(blob_reader.IsDoneReading());
+}
+
+TEST(CompressionBlobReaderTest, ViewsRespectDecompressionLimits) {
+  UncompressedConcatenator concatenator;
+  concatenator.AddCompressionGroup(std::string(kTestString));
+  absl::StatusOr<std::string> maybe_output = concatenator.Build();
+  ASSERT_TRUE(maybe_output.ok());
+
+  UncompressedBlobReader blob_reader(*maybe_output);
+  DecompressionLimits limits;
+  limits.max_compression_group_size = kTestString.size() - 1;
+  blob_reader.set_decompression_limits(limits);
+  EXPECT_TRUE(absl::IsResourceExhausted(
+      blob_reader.ExtractOneCompressionGroupView().status()));
+}
+
 }  // namespace
 }  // namespace privacy_sandbox::server_common
@@ -18,8 +18,11 @@
 #define SRC_CPP_ENCRYPTION_KEY_FETCHER_INTERFACE_KEY_FETCHER_MANAGER_INTERFACE_H_
 
 #include <memory>
+#include <vector>
 
 #include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "cc/public/cpio/interface/private_key_client/type_def.h"
 #include "cc/public/cpio/interface/public_key_client/public_key_client_interface.h"
 #include "cc/public/cpio/interface/type_def.h"
 #include "src/cpp/concurrent/executor.h"
@@ -49,9 +52,29 @@ class KeyFetcherManagerInterface {
   virtual void Start() noexcept = 0;
 };
 
+// Coordinator endpoints and timings that determine which keys a
+// KeyFetcherManager fetches.
+struct KeyFetcherConfig {
+  std::vector<google::scp::cpio::PublicKeyVendingServiceEndpoint>
+      public_key_endpoints;
+  google::scp::cpio::PrivateKeyVendingEndpoint primary_private_key_endpoint;
+  std::vector<google::scp::cpio::PrivateKeyVendingEndpoint>
+      secondary_private_key_endpoints;
+  // How long fetched private keys stay cached.
+  absl::Duration private_key_ttl;
+  // How often the key refresh flow is run.
+  absl::Duration key_refresh_period;
+};
+
 // Factory to create KeyFetcherManager.
 class KeyFetcherManagerFactory {
  public:
+  // Creates a KeyFetcherManager for `config`. Managers created with an equal
+  // config share their key fetchers, refresh loop and cached keys for as long
+  // as any of them is alive. See SharedKeyFetcherManager.
+  static std::unique_ptr<KeyFetcherManagerInterface> Create(
+      const KeyFetcherConfig& config, std::shared_ptr<Executor> executor);
+
   // Creates a KeyFetcherManager given the Public and Private Key Fetchers and
   // an executor on which to run the periodic background key refresh job.
   static std::unique_ptr<KeyFetcherManagerInterface> Create(
@@ -25,6 +25,7 @@
 #include "absl/status/status.h"
 #include "cc/public/cpio/interface/private_key_client/private_key_client_interface.h"
 #include "cc/public/cpio/interface/private_key_client/type_def.h"
+#include "src/cpp/concurrent/executor.h"
 
 namespace privacy_sandbox::server_common {
 
@@ -55,6 +56,9 @@ class PrivateKeyFetcherInterface {
   // Returns the corresponding PrivateKey, if present.
   virtual std::optional<PrivateKey> GetKey(
       const google::scp::cpio::PublicPrivateKeyPairId& key_id) noexcept = 0;
+
+  // Returns all of the cached private keys.
+  virtual std::vector<PrivateKey> GetKeys() noexcept = 0;
 };
 
 // Factory to create PrivateKeyFetcher.
@@ -67,6 +71,16 @@ class PrivateKeyFetcherFactory {
       const std::vector<google::scp::cpio::PrivateKeyVendingEndpoint>&
           secondary_endpoints,
       absl::Duration key_ttl);
+
+  // Creates a PrivateKeyFetcher that hedges every fetch across `replicas`, in
+  // order of preference. Each entry configures a complete set of coordinators
+  // that can serve the keys on its own. A replica is also queried once the
+  // previous one has not answered within `hedge_delay`, and the first answer
+  // wins. Hedging timers run on `executor`.
+  static std::unique_ptr<PrivateKeyFetcherInterface> Create(
+      const std::vector<google::scp::cpio::PrivateKeyClientOptions>& replicas,
+      absl::Duration key_ttl, absl::Duration hedge_delay,
+      std::shared_ptr<Executor> executor);
 };
 
 }  // namespace privacy_sandbox::server_common
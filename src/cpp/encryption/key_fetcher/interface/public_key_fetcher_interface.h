@@ -42,6 +42,10 @@ class PublicKeyFetcherInterface {
   // Returns the IDs of the cached public keys.
   virtual std::vector<google::scp::cpio::PublicPrivateKeyPairId>
   GetKeyIds() noexcept = 0;
+
+  // Returns all of the cached public keys.
+  virtual std::vector<google::cmrt::sdk::public_key_service::v1::PublicKey>
+  GetKeys() noexcept = 0;
 };
 
 // Factory to create PublicKeyFetcher.
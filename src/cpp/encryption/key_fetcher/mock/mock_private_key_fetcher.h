@@ -35,6 +35,8 @@ class MockPrivateKeyFetcher : public PrivateKeyFetcherInterface {
 
   MOCK_METHOD(std::optional<PrivateKey>, GetKey,
               (const google::scp::cpio::PublicPrivateKeyPairId&), (noexcept));
+
+  MOCK_METHOD(std::vector<PrivateKey>, GetKeys, (), (noexcept));
 };
 
 }  // namespace privacy_sandbox::server_common
@@ -38,6 +38,10 @@ class MockPublicKeyFetcher : public PublicKeyFetcherInterface {
   MOCK_METHOD(
       absl::StatusOr<google::cmrt::sdk::public_key_service::v1::PublicKey>,
       GetKey, (), (noexcept));
+
+  MOCK_METHOD(
+      std::vector<google::cmrt::sdk::public_key_service::v1::PublicKey>,
+      GetKeys, (), (noexcept));
 };
 
 }  // namespace privacy_sandbox::server_common
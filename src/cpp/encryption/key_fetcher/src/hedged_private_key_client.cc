@@ -0,0 +1,229 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/cpp/encryption/key_fetcher/src/hedged_private_key_client.h"
+
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "cc/core/interface/errors.h"
+#include "cc/public/core/interface/execution_result.h"
+#include "glog/logging.h"
+
+using google::cmrt::sdk::private_key_service::v1::ListPrivateKeysRequest;
+using google::cmrt::sdk::private_key_service::v1::ListPrivateKeysResponse;
+using google::scp::core::ExecutionResult;
+using google::scp::core::FailureExecutionResult;
+using google::scp::core::SuccessExecutionResult;
+using google::scp::core::errors::GetErrorMessage;
+using ::google::scp::cpio::Callback;
+using ::google::scp::cpio::PrivateKeyClientInterface;
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+// Calls `method` on every client and returns the first failure, if any.
+ExecutionResult ForEachClient(
+    const std::vector<std::unique_ptr<PrivateKeyClientInterface>>& clients,
+    ExecutionResult (PrivateKeyClientInterface::*method)() noexcept) {
+  ExecutionResult result = SuccessExecutionResult();
+  for (const auto& client : clients) {
+    ExecutionResult client_result = (client.get()->*method)();
+    if (!client_result.Successful()) {
+      VLOG(1) << "Private key client replica failed: "
+              << GetErrorMessage(client_result.status_code);
+      if (result.Successful()) {
+        result = client_result;
+      }
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+// State of a single hedged ListPrivateKeys() call.
+struct HedgedPrivateKeyClient::HedgedCall {
+  std::weak_ptr<const Replicas> replicas;
+  size_t num_replicas;
+  absl::Duration hedge_delay;
+  std::shared_ptr<Executor> executor;
+  ListPrivateKeysRequest request;
+
+  absl::Mutex mutex;
+  Callback<ListPrivateKeysResponse> callback ABSL_GUARDED_BY(mutex);
+  // Set once the callback has been handed off.
+  bool done ABSL_GUARDED_BY(mutex) = false;
+  // Index of the next replica to query.
+  size_t next_replica ABSL_GUARDED_BY(mutex) = 0;
+  // Replicas that were queried and have not answered yet.
+  size_t outstanding ABSL_GUARDED_BY(mutex) = 0;
+  // Whether each replica has answered. A replica may both invoke the callback
+  // and return a failure, which must only count once.
+  std::vector<bool> answered ABSL_GUARDED_BY(mutex);
+  std::vector<TaskId> hedge_tasks ABSL_GUARDED_BY(mutex);
+  // Latest failure of a replica, reported if the client is destroyed before
+  // the call completes.
+  ExecutionResult last_failure ABSL_GUARDED_BY(mutex) =
+      FailureExecutionResult(google::scp::core::errors::SC_UNKNOWN);
+};
+
+HedgedPrivateKeyClient::HedgedPrivateKeyClient(
+    std::vector<std::unique_ptr<PrivateKeyClientInterface>> clients,
+    absl::Duration hedge_delay, std::shared_ptr<Executor> executor)
+    : replicas_(std::make_shared<const Replicas>(std::move(clients))),
+      hedge_delay_(hedge_delay),
+      executor_(std::move(executor)) {}
+
+ExecutionResult HedgedPrivateKeyClient::Init() noexcept {
+  return ForEachClient(*replicas_, &PrivateKeyClientInterface::Init);
+}
+
+ExecutionResult HedgedPrivateKeyClient::Run() noexcept {
+  return ForEachClient(*replicas_, &PrivateKeyClientInterface::Run);
+}
+
+ExecutionResult HedgedPrivateKeyClient::Stop() noexcept {
+  return ForEachClient(*replicas_, &PrivateKeyClientInterface::Stop);
+}
+
+ExecutionResult HedgedPrivateKeyClient::ListPrivateKeys(
+    ListPrivateKeysRequest request,
+    Callback<ListPrivateKeysResponse> callback) noexcept {
+  if (replicas_->empty()) {
+    return FailureExecutionResult(google::scp::core::errors::SC_UNKNOWN);
+  }
+  auto call = std::make_shared<HedgedCall>();
+  call->replicas = replicas_;
+  call->num_replicas = replicas_->size();
+  call->hedge_delay = hedge_delay_;
+  call->executor = executor_;
+  call->request = std::move(request);
+  {
+    absl::MutexLock l(&call->mutex);
+    call->callback = std::move(callback);
+    call->answered.resize(call->num_replicas, false);
+  }
+  // Every failure is reported through the callback, so the call as a whole is
+  // always accepted.
+  StartReplica(call, 0);
+  return SuccessExecutionResult();
+}
+
+void HedgedPrivateKeyClient::StartReplica(
+    const std::shared_ptr<HedgedCall>& call, size_t index) {
+  std::shared_ptr<const Replicas> replicas = call->replicas.lock();
+  if (replicas == nullptr) {
+    VLOG(3) << "Hedged private key client destroyed; not querying replica "
+            << index;
+    // The replicas went with the client, so nothing else completes the call.
+    Callback<ListPrivateKeysResponse> callback;
+    std::vector<TaskId> hedge_tasks;
+    ExecutionResult result;
+    {
+      absl::MutexLock l(&call->mutex);
+      if (call->done) {
+        return;
+      }
+      call->done = true;
+      callback = std::move(call->callback);
+      hedge_tasks = std::move(call->hedge_tasks);
+      result = call->last_failure;
+    }
+    for (TaskId& task_id : hedge_tasks) {
+      call->executor->Cancel(std::move(task_id));
+    }
+    callback(result, ListPrivateKeysResponse());
+    return;
+  }
+  {
+    absl::MutexLock l(&call->mutex);
+    // A failure may already have started this replica ahead of its timer.
+    if (call->done || call->next_replica != index) {
+      return;
+    }
+    ++call->next_replica;
+    ++call->outstanding;
+  }
+  if (index + 1 < call->num_replicas) {
+    TaskId task_id = call->executor->RunAfter(
+        call->hedge_delay, [call, index]() { StartReplica(call, index + 1); });
+    absl::MutexLock l(&call->mutex);
+    call->hedge_tasks.push_back(task_id);
+  }
+
+  VLOG(3) << "Querying private key client replica " << index;
+  // Replicas may answer synchronously, so they are never called with the
+  // mutex held.
+  ExecutionResult result = (*replicas)[index]->ListPrivateKeys(
+      call->request,
+      [call, index](const ExecutionResult& result,
+                    ListPrivateKeysResponse response) {
+        OnReplicaResponse(call, index, result, std::move(response));
+      });
+  if (!result.Successful()) {
+    OnReplicaResponse(call, index, result, ListPrivateKeysResponse());
+  }
+}
+
+void HedgedPrivateKeyClient::OnReplicaResponse(
+    const std::shared_ptr<HedgedCall>& call, size_t index,
+    const ExecutionResult& result, ListPrivateKeysResponse response) {
+  Callback<ListPrivateKeysResponse> callback;
+  std::vector<TaskId> hedge_tasks;
+  std::optional<size_t> replica_to_start;
+  {
+    absl::MutexLock l(&call->mutex);
+    if (call->answered[index]) {
+      return;
+    }
+    call->answered[index] = true;
+    --call->outstanding;
+    if (call->done) {
+      return;
+    }
+    if (!result.Successful()) {
+      VLOG(1) << "Private key client replica " << index
+              << " failed: " << GetErrorMessage(result.status_code);
+      call->last_failure = result;
+      if (call->next_replica < call->num_replicas) {
+        // Hedge right away instead of waiting out the delay.
+        replica_to_start = call->next_replica;
+      } else if (call->outstanding > 0) {
+        // Wait for the replicas that are still in flight.
+        return;
+      }
+    }
+    if (!replica_to_start.has_value()) {
+      call->done = true;
+      callback = std::move(call->callback);
+      hedge_tasks = std::move(call->hedge_tasks);
+    }
+  }
+
+  if (replica_to_start.has_value()) {
+    StartReplica(call, *replica_to_start);
+    return;
+  }
+
+  for (TaskId& task_id : hedge_tasks) {
+    call->executor->Cancel(std::move(task_id));
+  }
+  callback(result, std::move(response));
+}
+
+}  // namespace privacy_sandbox::server_common
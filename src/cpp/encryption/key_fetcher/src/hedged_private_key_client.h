@@ -0,0 +1,88 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_CPP_ENCRYPTION_KEY_FETCHER_HEDGED_PRIVATE_KEY_CLIENT_H_
+#define SRC_CPP_ENCRYPTION_KEY_FETCHER_HEDGED_PRIVATE_KEY_CLIENT_H_
+
+#include <memory>
+#include <vector>
+
+#include "absl/time/time.h"
+#include "cc/public/cpio/interface/private_key_client/private_key_client_interface.h"
+#include "src/cpp/concurrent/executor.h"
+
+namespace privacy_sandbox::server_common {
+
+// PrivateKeyClientInterface that hedges ListPrivateKeys() across replica
+// clients. Each replica must be able to serve the whole request on its own,
+// i.e. talk to a complete set of key vending coordinators.
+//
+// The first replica is queried immediately. If it has not answered after
+// `hedge_delay`, the next replica is queried as well, and so on. A replica
+// that fails starts the next one without waiting for the delay. The callback
+// receives the first successful response, or the last failure if every
+// replica failed, and is invoked exactly once.
+class HedgedPrivateKeyClient
+    : public google::scp::cpio::PrivateKeyClientInterface {
+ public:
+  // `clients` are ordered by preference. Hedging timers are queued on
+  // `executor`.
+  HedgedPrivateKeyClient(
+      std::vector<std::unique_ptr<google::scp::cpio::PrivateKeyClientInterface>>
+          clients,
+      absl::Duration hedge_delay, std::shared_ptr<Executor> executor);
+
+  // Init(), Run() and Stop() are forwarded to every replica. The first
+  // failure, if any, is returned.
+  google::scp::core::ExecutionResult Init() noexcept override;
+  google::scp::core::ExecutionResult Run() noexcept override;
+  google::scp::core::ExecutionResult Stop() noexcept override;
+
+  google::scp::core::ExecutionResult ListPrivateKeys(
+      google::cmrt::sdk::private_key_service::v1::ListPrivateKeysRequest
+          request,
+      google::scp::cpio::Callback<
+          google::cmrt::sdk::private_key_service::v1::ListPrivateKeysResponse>
+          callback) noexcept override;
+
+ private:
+  using Replicas = std::vector<
+      std::unique_ptr<google::scp::cpio::PrivateKeyClientInterface>>;
+  struct HedgedCall;
+
+  // Queries replica `index` of `call` unless it was already started or the
+  // call has completed.
+  static void StartReplica(const std::shared_ptr<HedgedCall>& call,
+                           size_t index);
+
+  // Records the answer of replica `index` and completes `call` if it is the
+  // first success or the last outstanding failure.
+  static void OnReplicaResponse(
+      const std::shared_ptr<HedgedCall>& call, size_t index,
+      const google::scp::core::ExecutionResult& result,
+      google::cmrt::sdk::private_key_service::v1::ListPrivateKeysResponse
+          response);
+
+  // In-flight calls only hold a weak reference, so hedging timers that fire
+  // after this client is destroyed do nothing.
+  std::shared_ptr<const Replicas> replicas_;
+  absl::Duration hedge_delay_;
+  std::shared_ptr<Executor> executor_;
+};
+
+}  // namespace privacy_sandbox::server_common
+
+#endif  // SRC_CPP_ENCRYPTION_KEY_FETCHER_HEDGED_PRIVATE_KEY_CLIENT_H_
@@ -23,6 +23,7 @@
 #include "glog/logging.h"
 #include "src/cpp/encryption/key_fetcher/interface/private_key_fetcher_interface.h"
 #include "src/cpp/encryption/key_fetcher/interface/public_key_fetcher_interface.h"
+#include "src/cpp/encryption/key_fetcher/src/shared_key_fetcher_manager.h"
 
 namespace privacy_sandbox::server_common {
 
@@ -35,14 +36,17 @@ using ::privacy_sandbox::server_common::PublicKeyFetcherInterface;
 // @public_key_fetcher client for interacting with the Public Key Service
 // @private_key_fetcher client for interacting with the Private Key Service
 // @executor executor on which the key refresh tasks will run.
+// @snapshot_writer optional shared-memory segment to publish the keys to.
 KeyFetcherManager::KeyFetcherManager(
     absl::Duration key_refresh_period,
     std::unique_ptr<PublicKeyFetcherInterface> public_key_fetcher,
     std::unique_ptr<PrivateKeyFetcherInterface> private_key_fetcher,
-    std::shared_ptr<privacy_sandbox::server_common::Executor> executor)
+    std::shared_ptr<privacy_sandbox::server_common::Executor> executor,
+    std::unique_ptr<SharedMemoryKeySnapshotWriter> snapshot_writer)
     : key_refresh_period_(key_refresh_period),
       public_key_fetcher_(std::move(public_key_fetcher)),
       private_key_fetcher_(std::move(private_key_fetcher)),
+      snapshot_writer_(std::move(snapshot_writer)),
       executor_(std::move(executor)) {}
 
 KeyFetcherManager::~KeyFetcherManager() {
@@ -72,6 +76,14 @@ void KeyFetcherManager::RunPeriodicKeyRefresh() {
       VLOG_IF(1, !private_key_refresh_status.ok())
           << "Private key refresh failed: "
           << private_key_refresh_status.message();
+      if (private_key_refresh_status.ok() && snapshot_writer_ != nullptr) {
+        KeySnapshot snapshot = {public_key_fetcher_->GetKeys(),
+                                private_key_fetcher_->GetKeys()};
+        absl::Status publish_status = snapshot_writer_->Publish(snapshot);
+        VLOG_IF(1, !publish_status.ok())
+            << "Publishing the key snapshot failed: "
+            << publish_status.message();
+      }
     }
   } else {
     VLOG(3) << "Shutdown requested; skipping run of KeyFetcherManager's key "
@@ -98,4 +110,9 @@ std::unique_ptr<KeyFetcherManagerInterface> KeyFetcherManagerFactory::Create(
       std::move(private_key_fetcher), std::move(executor));
 }
 
+std::unique_ptr<KeyFetcherManagerInterface> KeyFetcherManagerFactory::Create(
+    const KeyFetcherConfig& config, std::shared_ptr<Executor> executor) {
+  return SharedKeyFetcherManager::Create(config, std::move(executor));
+}
+
 }  // namespace privacy_sandbox::server_common
@@ -27,6 +27,7 @@
 #include "src/cpp/encryption/key_fetcher/interface/key_fetcher_manager_interface.h"
 #include "src/cpp/encryption/key_fetcher/interface/private_key_fetcher_interface.h"
 #include "src/cpp/encryption/key_fetcher/interface/public_key_fetcher_interface.h"
+#include "src/cpp/encryption/key_fetcher/src/shared_memory_key_snapshot.h"
 
 namespace privacy_sandbox::server_common {
 
@@ -35,6 +36,9 @@ namespace privacy_sandbox::server_common {
 // keys through its public and private key fetchers.
 class KeyFetcherManager : public KeyFetcherManagerInterface {
  public:
+  // If `snapshot_writer` is set, every successful key refresh also publishes
+  // the fetched keys to it, so that sibling processes can serve them through a
+  // SharedMemoryKeyFetcherManager instead of fetching them again.
   KeyFetcherManager(
       absl::Duration key_refresh_period,
       std::unique_ptr<privacy_sandbox::server_common::PublicKeyFetcherInterface>
@@ -42,7 +46,9 @@ class KeyFetcherManager : public KeyFetcherManagerInterface {
       std::unique_ptr<
           privacy_sandbox::server_common::PrivateKeyFetcherInterface>
           private_key_fetcher,
-      std::shared_ptr<privacy_sandbox::server_common::Executor> executor);
+      std::shared_ptr<privacy_sandbox::server_common::Executor> executor,
+      std::unique_ptr<SharedMemoryKeySnapshotWriter> snapshot_writer =
+          nullptr);
 
   // Waits for any in-flight key fetch flows to complete, cancels the next
   // queued key fetch flow run, and cleans up the key service clients.
@@ -74,6 +80,9 @@ class KeyFetcherManager : public KeyFetcherManagerInterface {
   std::unique_ptr<privacy_sandbox::server_common::PrivateKeyFetcherInterface>
       private_key_fetcher_;
 
+  // Optional destination for the keys fetched by each refresh.
+  std::unique_ptr<SharedMemoryKeySnapshotWriter> snapshot_writer_;
+
   // Synchronizes the status of shutdown for destructor and execution loop.
   absl::Notification shutdown_requested_;
 
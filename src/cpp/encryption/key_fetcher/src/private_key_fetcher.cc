@@ -30,6 +30,7 @@
 #include "glog/logging.h"
 #include "proto/hpke.pb.h"
 #include "proto/tink.pb.h"
+#include "src/cpp/encryption/key_fetcher/src/hedged_private_key_client.h"
 #include "src/cpp/encryption/key_fetcher/src/key_fetcher_utils.h"
 
 using google::scp::core::ExecutionResult;
@@ -70,6 +71,18 @@ absl::Time ProtoToAbslDuration(const google::protobuf::Timestamp& timestamp) {
          absl::Nanoseconds(timestamp.nanos());
 }
 
+void StartPrivateKeyClient(PrivateKeyClientInterface& private_key_client) {
+  ExecutionResult init_result = private_key_client.Init();
+  if (!init_result.Successful()) {
+    VLOG(1) << "Failed to initialize private key client.";
+  }
+
+  ExecutionResult run_result = private_key_client.Run();
+  if (!run_result.Successful()) {
+    VLOG(1) << "Failed to run private key client.";
+  }
+}
+
 }  // namespace
 
 PrivateKeyFetcher::PrivateKeyFetcher(
@@ -172,6 +185,17 @@ std::optional<PrivateKey> PrivateKeyFetcher::GetKey(
   return std::nullopt;
 }
 
+std::vector<PrivateKey> PrivateKeyFetcher::GetKeys() noexcept
+    ABSL_LOCKS_EXCLUDED(mutex_) {
+  absl::MutexLock l(&mutex_);
+  std::vector<PrivateKey> keys;
+  keys.reserve(private_keys_map_.size());
+  for (const auto& [key_id, key] : private_keys_map_) {
+    keys.push_back(key);
+  }
+  return keys;
+}
+
 std::unique_ptr<PrivateKeyFetcherInterface> PrivateKeyFetcherFactory::Create(
     const PrivateKeyVendingEndpoint& primary_endpoint,
     const std::vector<PrivateKeyVendingEndpoint>& secondary_endpoints,
@@ -182,17 +206,27 @@ std::unique_ptr<PrivateKeyFetcherInterface> PrivateKeyFetcherFactory::Create(
 
   std::unique_ptr<PrivateKeyClientInterface> private_key_client =
       google::scp::cpio::PrivateKeyClientFactory::Create(options);
+  StartPrivateKeyClient(*private_key_client);
 
-  ExecutionResult init_result = private_key_client->Init();
-  if (!init_result.Successful()) {
-    VLOG(1) << "Failed to initialize private key client.";
-  }
+  return std::make_unique<PrivateKeyFetcher>(std::move(private_key_client),
+                                             key_ttl);
+}
 
-  ExecutionResult run_result = private_key_client->Run();
-  if (!run_result.Successful()) {
-    VLOG(1) << "Failed to run private key client.";
+std::unique_ptr<PrivateKeyFetcherInterface> PrivateKeyFetcherFactory::Create(
+    const std::vector<PrivateKeyClientOptions>& replicas,
+    absl::Duration key_ttl, absl::Duration hedge_delay,
+    std::shared_ptr<Executor> executor) {
+  std::vector<std::unique_ptr<PrivateKeyClientInterface>> clients;
+  clients.reserve(replicas.size());
+  for (const PrivateKeyClientOptions& options : replicas) {
+    clients.push_back(
+        google::scp::cpio::PrivateKeyClientFactory::Create(options));
   }
 
+  auto private_key_client = std::make_unique<HedgedPrivateKeyClient>(
+      std::move(clients), hedge_delay, std::move(executor));
+  StartPrivateKeyClient(*private_key_client);
+
   return std::make_unique<PrivateKeyFetcher>(std::move(private_key_client),
                                              key_ttl);
 }
@@ -55,6 +55,9 @@ class PrivateKeyFetcher : public PrivateKeyFetcherInterface {
       const google::scp::cpio::PublicPrivateKeyPairId& public_key_id) noexcept
       override;
 
+  // Returns all of the cached private keys.
+  std::vector<PrivateKey> GetKeys() noexcept override;
+
  private:
   // PrivateKeyClient for fetching private keys from the Private Key Service.
   std::unique_ptr<google::scp::cpio::PrivateKeyClientInterface>
@@ -135,6 +135,12 @@ std::vector<PublicPrivateKeyPairId> PublicKeyFetcher::GetKeyIds() noexcept
   return key_pair_ids;
 }
 
+std::vector<PublicKey> PublicKeyFetcher::GetKeys() noexcept
+    ABSL_LOCKS_EXCLUDED(mutex_) {
+  absl::MutexLock l(&mutex_);
+  return public_keys_;
+}
+
 std::unique_ptr<PublicKeyFetcherInterface> PublicKeyFetcherFactory::Create(
     const std::vector<google::scp::cpio::PublicKeyVendingServiceEndpoint>&
         endpoints) {
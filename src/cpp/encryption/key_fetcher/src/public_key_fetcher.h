@@ -57,6 +57,10 @@ class PublicKeyFetcher : public PublicKeyFetcherInterface {
   std::vector<google::scp::cpio::PublicPrivateKeyPairId> GetKeyIds() noexcept
       override;
 
+  // Returns all of the cached public keys.
+  std::vector<google::cmrt::sdk::public_key_service::v1::PublicKey>
+  GetKeys() noexcept override;
+
  private:
   // PublicKeyClient for fetching public keys from the Public Key Service.
   std::unique_ptr<google::scp::cpio::PublicKeyClientInterface>
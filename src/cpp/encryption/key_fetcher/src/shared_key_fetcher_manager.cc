@@ -0,0 +1,314 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/cpp/encryption/key_fetcher/src/shared_key_fetcher_manager.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "glog/logging.h"
+
+namespace privacy_sandbox::server_common {
+
+using ::google::cmrt::sdk::public_key_service::v1::PublicKey;
+using ::google::scp::cpio::PrivateKeyVendingEndpoint;
+using ::google::scp::cpio::PublicPrivateKeyPairId;
+
+namespace {
+
+// Appends `field` length-prefixed, so that distinct sequences of fields never
+// produce the same key.
+void AppendField(absl::string_view field, std::string* key) {
+  absl::StrAppend(key, field.size(), ":", field, ",");
+}
+
+void AppendEndpoint(const PrivateKeyVendingEndpoint& endpoint,
+                    std::string* key) {
+  AppendField(endpoint.account_identity, key);
+  AppendField(endpoint.gcp_wip_provider, key);
+  AppendField(endpoint.service_region, key);
+  AppendField(endpoint.private_key_vending_service_endpoint, key);
+}
+
+// Returns the registry key of `config`. Two configs get the same key iff they
+// fetch from the same endpoints with the same timings.
+std::string ConfigKey(const KeyFetcherConfig& config) {
+  std::string key =
+      absl::StrCat("public=", config.public_key_endpoints.size(), ";");
+  for (const auto& endpoint : config.public_key_endpoints) {
+    AppendField(endpoint, &key);
+  }
+  absl::StrAppend(&key, ";private=",
+                  config.secondary_private_key_endpoints.size() + 1, ";");
+  AppendEndpoint(config.primary_private_key_endpoint, &key);
+  for (const PrivateKeyVendingEndpoint& endpoint :
+       config.secondary_private_key_endpoints) {
+    AppendEndpoint(endpoint, &key);
+  }
+  absl::StrAppend(&key, ";ttl=", absl::FormatDuration(config.private_key_ttl),
+                  ";refresh=", absl::FormatDuration(config.key_refresh_period));
+  return key;
+}
+
+}  // namespace
+
+// Key fetchers and refresh loop shared by every handle with an equal config.
+class SharedKeyFetcherManager::Cache
+    : public std::enable_shared_from_this<Cache> {
+ public:
+  Cache(std::string config_key, absl::Duration key_refresh_period,
+        std::unique_ptr<PublicKeyFetcherInterface> public_key_fetcher,
+        std::unique_ptr<PrivateKeyFetcherInterface> private_key_fetcher,
+        std::shared_ptr<Executor> executor)
+      : config_key_(std::move(config_key)),
+        key_refresh_period_(key_refresh_period),
+        public_key_fetcher_(std::move(public_key_fetcher)),
+        private_key_fetcher_(std::move(private_key_fetcher)),
+        executor_(std::move(executor)) {}
+
+  // Only runs once the last handle is gone, so no refresh is in flight.
+  ~Cache();
+
+  // Returns the live cache registered for `config`, creating and registering
+  // one with the given arguments if there is none.
+  static std::shared_ptr<Cache> GetOrCreate(
+      const KeyFetcherConfig& config,
+      absl::FunctionRef<std::unique_ptr<PublicKeyFetcherInterface>()>
+          create_public_key_fetcher,
+      absl::FunctionRef<std::unique_ptr<PrivateKeyFetcherInterface>()>
+          create_private_key_fetcher,
+      std::shared_ptr<Executor> executor);
+
+  void Start() ABSL_LOCKS_EXCLUDED(mutex_) {
+    {
+      absl::MutexLock l(&mutex_);
+      if (started_) {
+        return;
+      }
+      started_ = true;
+    }
+    RunPeriodicKeyRefresh();
+  }
+
+  absl::StatusOr<PublicKey> GetPublicKey() {
+    return public_key_fetcher_->GetKey();
+  }
+
+  std::optional<PrivateKey> GetPrivateKey(
+      const PublicPrivateKeyPairId& key_id) {
+    return private_key_fetcher_->GetKey(key_id);
+  }
+
+  absl::Status Refresh() ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  // Process-wide map of config keys, as returned by ConfigKey(), to live
+  // caches.
+  struct Registry {
+    absl::Mutex mutex;
+    absl::flat_hash_map<std::string, std::weak_ptr<Cache>> caches
+        ABSL_GUARDED_BY(mutex);
+  };
+
+  static Registry& GetRegistry() {
+    static auto* const registry = new Registry();
+    return *registry;
+  }
+
+  // A refresh that concurrent callers wait on instead of fetching again.
+  struct Flight {
+    absl::Notification done;
+    absl::Status status;
+  };
+
+  void RunPeriodicKeyRefresh() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Runs the key refresh flow of KeyFetcherManager once.
+  absl::Status RefreshKeys();
+
+  const std::string config_key_;
+  const absl::Duration key_refresh_period_;
+  std::unique_ptr<PublicKeyFetcherInterface> public_key_fetcher_;
+  std::unique_ptr<PrivateKeyFetcherInterface> private_key_fetcher_;
+  std::shared_ptr<Executor> executor_;
+
+  absl::Mutex mutex_;
+  bool started_ ABSL_GUARDED_BY(mutex_) = false;
+  std::optional<TaskId> task_id_ ABSL_GUARDED_BY(mutex_);
+  std::shared_ptr<Flight> in_flight_ ABSL_GUARDED_BY(mutex_);
+};
+
+SharedKeyFetcherManager::Cache::~Cache() {
+  {
+    Registry& registry = GetRegistry();
+    absl::MutexLock l(&registry.mutex);
+    // The entry may already point at a newer cache for the same config.
+    if (auto it = registry.caches.find(config_key_);
+        it != registry.caches.end() && it->second.expired()) {
+      registry.caches.erase(it);
+    }
+  }
+
+  absl::MutexLock l(&mutex_);
+  if (task_id_.has_value()) {
+    executor_->Cancel(std::move(*task_id_));
+  }
+}
+
+std::shared_ptr<SharedKeyFetcherManager::Cache>
+SharedKeyFetcherManager::Cache::GetOrCreate(
+    const KeyFetcherConfig& config,
+    absl::FunctionRef<std::unique_ptr<PublicKeyFetcherInterface>()>
+        create_public_key_fetcher,
+    absl::FunctionRef<std::unique_ptr<PrivateKeyFetcherInterface>()>
+        create_private_key_fetcher,
+    std::shared_ptr<Executor> executor) {
+  std::string config_key = ConfigKey(config);
+  Registry& registry = GetRegistry();
+  {
+    absl::MutexLock l(&registry.mutex);
+    if (auto it = registry.caches.find(config_key);
+        it != registry.caches.end()) {
+      if (std::shared_ptr<Cache> cache = it->second.lock()) {
+        return cache;
+      }
+    }
+  }
+
+  // The factories may block, e.g. on setting up cloud clients, so they run
+  // without the registry lock.
+  VLOG(3) << "Creating shared key cache for " << config_key;
+  auto cache = std::make_shared<Cache>(
+      config_key, config.key_refresh_period, create_public_key_fetcher(),
+      create_private_key_fetcher(), std::move(executor));
+  absl::MutexLock l(&registry.mutex);
+  std::weak_ptr<Cache>& entry = registry.caches[config_key];
+  if (std::shared_ptr<Cache> existing = entry.lock()) {
+    // Another caller registered a cache meanwhile. Ours is destroyed once
+    // the lock is released, since ~Cache() takes it too.
+    VLOG(3) << "Dropping duplicate shared key cache for " << config_key;
+    return existing;
+  }
+  entry = cache;
+  return cache;
+}
+
+absl::Status SharedKeyFetcherManager::Cache::Refresh() {
+  std::shared_ptr<Flight> flight;
+  bool is_leader = false;
+  {
+    absl::MutexLock l(&mutex_);
+    if (in_flight_ == nullptr) {
+      in_flight_ = std::make_shared<Flight>();
+      is_leader = true;
+    }
+    flight = in_flight_;
+  }
+
+  if (!is_leader) {
+    VLOG(3) << "Joining in-flight key refresh for " << config_key_;
+    flight->done.WaitForNotification();
+    return flight->status;
+  }
+
+  flight->status = RefreshKeys();
+  {
+    absl::MutexLock l(&mutex_);
+    in_flight_.reset();
+  }
+  flight->done.Notify();
+  return flight->status;
+}
+
+void SharedKeyFetcherManager::Cache::RunPeriodicKeyRefresh() {
+  {
+    // Queue up another key refresh task. It only holds a weak reference so
+    // that a queued task does not keep the cache alive.
+    absl::MutexLock l(&mutex_);
+    task_id_ = executor_->RunAfter(
+        key_refresh_period_, [cache = weak_from_this()]() {
+          if (std::shared_ptr<Cache> locked = cache.lock()) {
+            locked->RunPeriodicKeyRefresh();
+          }
+        });
+  }
+  if (absl::Status status = Refresh(); !status.ok()) {
+    VLOG(1) << "Shared key refresh failed for " << config_key_ << ": "
+            << status.message();
+  }
+}
+
+absl::Status SharedKeyFetcherManager::Cache::RefreshKeys() {
+  if (absl::Status status = public_key_fetcher_->Refresh(); !status.ok()) {
+    VLOG(1) << "Public key refresh failed: " << status.message();
+    return status;
+  }
+  absl::Status status = private_key_fetcher_->Refresh();
+  VLOG_IF(1, !status.ok()) << "Private key refresh failed: "
+                           << status.message();
+  return status;
+}
+
+std::unique_ptr<SharedKeyFetcherManager> SharedKeyFetcherManager::Create(
+    const KeyFetcherConfig& config, std::shared_ptr<Executor> executor) {
+  return Create(
+      config,
+      [&config]() {
+        return PublicKeyFetcherFactory::Create(config.public_key_endpoints);
+      },
+      [&config]() {
+        return PrivateKeyFetcherFactory::Create(
+            config.primary_private_key_endpoint,
+            config.secondary_private_key_endpoints, config.private_key_ttl);
+      },
+      std::move(executor));
+}
+
+std::unique_ptr<SharedKeyFetcherManager> SharedKeyFetcherManager::Create(
+    const KeyFetcherConfig& config,
+    absl::FunctionRef<std::unique_ptr<PublicKeyFetcherInterface>()>
+        create_public_key_fetcher,
+    absl::FunctionRef<std::unique_ptr<PrivateKeyFetcherInterface>()>
+        create_private_key_fetcher,
+    std::shared_ptr<Executor> executor) {
+  return absl::WrapUnique(new SharedKeyFetcherManager(
+      Cache::GetOrCreate(config, create_public_key_fetcher,
+                         create_private_key_fetcher, std::move(executor))));
+}
+
+SharedKeyFetcherManager::SharedKeyFetcherManager(std::shared_ptr<Cache> cache)
+    : cache_(std::move(cache)) {}
+
+void SharedKeyFetcherManager::Start() noexcept { cache_->Start(); }
+
+absl::StatusOr<PublicKey> SharedKeyFetcherManager::GetPublicKey() noexcept {
+  return cache_->GetPublicKey();
+}
+
+std::optional<PrivateKey> SharedKeyFetcherManager::GetPrivateKey(
+    const PublicPrivateKeyPairId& key_id) noexcept {
+  return cache_->GetPrivateKey(key_id);
+}
+
+absl::Status SharedKeyFetcherManager::Refresh() noexcept {
+  return cache_->Refresh();
+}
+
+}  // namespace privacy_sandbox::server_common
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_CPP_ENCRYPTION_KEY_FETCHER_SHARED_KEY_FETCHER_MANAGER_H_
+#define SRC_CPP_ENCRYPTION_KEY_FETCHER_SHARED_KEY_FETCHER_MANAGER_H_
+
+#include <memory>
+#include <optional>
+
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "src/cpp/concurrent/executor.h"
+#include "src/cpp/encryption/key_fetcher/interface/key_fetcher_manager_interface.h"
+#include "src/cpp/encryption/key_fetcher/interface/private_key_fetcher_interface.h"
+#include "src/cpp/encryption/key_fetcher/interface/public_key_fetcher_interface.h"
+
+namespace privacy_sandbox::server_common {
+
+// Handle to a process-wide, reference-counted key cache. Every handle created
+// with an equal KeyFetcherConfig shares one pair of key fetchers, one periodic
+// refresh loop and one in-memory key set. The cache is torn down once the last
+// handle is destroyed.
+class SharedKeyFetcherManager : public KeyFetcherManagerInterface {
+ public:
+  // Returns a handle to the cache for `config`, creating the cache and its
+  // key fetchers if needed. `executor` is only used when the cache is created.
+  static std::unique_ptr<SharedKeyFetcherManager> Create(
+      const KeyFetcherConfig& config, std::shared_ptr<Executor> executor);
+
+  // As above, but creates the key fetchers of a new cache with the given
+  // factories instead of from the endpoints in `config`.
+  static std::unique_ptr<SharedKeyFetcherManager> Create(
+      const KeyFetcherConfig& config,
+      absl::FunctionRef<std::unique_ptr<PublicKeyFetcherInterface>()>
+          create_public_key_fetcher,
+      absl::FunctionRef<std::unique_ptr<PrivateKeyFetcherInterface>()>
+          create_private_key_fetcher,
+      std::shared_ptr<Executor> executor);
+
+  // Starts the shared refresh loop unless another handle already started it.
+  void Start() noexcept override;
+
+  // Fetches a public key used for encrypting outgoing requests.
+  absl::StatusOr<google::cmrt::sdk::public_key_service::v1::PublicKey>
+  GetPublicKey() noexcept override;
+
+  // Fetches the corresponding private key for a given key ID.
+  std::optional<PrivateKey> GetPrivateKey(
+      const google::scp::cpio::PublicPrivateKeyPairId& key_id) noexcept
+      override;
+
+  // Blocking.
+  // Refreshes the public and then the private keys. Concurrent calls, from any
+  // handle or the refresh loop, share a single fetch and its result.
+  absl::Status Refresh() noexcept;
+
+ private:
+  class Cache;
+
+  explicit SharedKeyFetcherManager(std::shared_ptr<Cache> cache);
+
+  std::shared_ptr<Cache> cache_;
+};
+
+}  // namespace privacy_sandbox::server_common
+
+#endif  // SRC_CPP_ENCRYPTION_KEY_FETCHER_SHARED_KEY_FETCHER_MANAGER_H_
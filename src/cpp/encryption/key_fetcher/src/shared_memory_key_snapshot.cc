@@ -0,0 +1,557 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/cpp/encryption/key_fetcher/src/shared_memory_key_snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "absl/functional/function_ref.h"
+#include "absl/memory/memory.h"
+#include "absl/random/distributions.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "glog/logging.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+using ::google::cmrt::sdk::public_key_service::v1::PublicKey;
+using ::google::scp::cpio::PublicPrivateKeyPairId;
+
+// "KEYSNAPS"
+constexpr uint64_t kMagic = 0x4b4559534e415053;
+constexpr uint32_t kFormatVersion = 2;
+// Readers give up after this many attempts to get a consistent view, e.g. if
+// the writer died halfway through a publication.
+constexpr int kMaxReadAttempts = 100;
+// How often readers of a retired segment try to re-open its name.
+constexpr absl::Duration kReopenInterval = absl::Milliseconds(100);
+
+static constexpr absl::string_view kMalformedSnapshotMessage =
+    "Malformed key snapshot.";
+
+// Laid out at the start of the segment and followed by `capacity` bytes of
+// payload. The payload is:
+//   [uint32 number of private keys][uint32 number of public keys]
+//   per private key: [bytes key ID][bytes private key][int64 creation nanos]
+//   per public key: [bytes serialized PublicKey proto]
+// where bytes are a uint32 length followed by the data. Integers use the byte
+// order of the host, which all processes mapping the segment share.
+struct SegmentHeader {
+  uint64_t magic;
+  uint32_t format_version;
+  // Set once the segment has been replaced or unlinked by its writer. It is
+  // never published to again.
+  std::atomic<uint32_t> retired;
+  uint64_t capacity;
+  // Odd while a snapshot is being written.
+  std::atomic<uint64_t> sequence;
+  std::atomic<uint64_t> payload_size;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+                  std::atomic<uint32_t>::is_always_lock_free,
+              "Atomics in shared memory must be lock-free.");
+
+SegmentHeader& Header(void* mapping) {
+  return *static_cast<SegmentHeader*>(mapping);
+}
+
+const SegmentHeader& Header(const void* mapping) {
+  return *static_cast<const SegmentHeader*>(mapping);
+}
+
+char* Payload(void* mapping) {
+  return static_cast<char*>(mapping) + sizeof(SegmentHeader);
+}
+
+const char* Payload(const void* mapping) {
+  return static_cast<const char*>(mapping) + sizeof(SegmentHeader);
+}
+
+absl::Status ErrnoError(absl::string_view call, absl::string_view name) {
+  return absl::InternalError(
+      absl::StrCat(call, " failed for ", name, ": ", std::strerror(errno)));
+}
+
+// Fails unless the segment `name` described by `segment_stat` belongs to the
+// current user. If `private_only`, it must also not be accessible to anyone
+// else, since it holds private keys.
+absl::Status CheckSegmentOwner(const struct stat& segment_stat,
+                               absl::string_view name, bool private_only) {
+  if (segment_stat.st_uid != geteuid()) {
+    return absl::PermissionDeniedError(absl::StrCat(
+        "Shared memory segment ", name, " belongs to another user."));
+  }
+  if (private_only && (segment_stat.st_mode & (S_IRWXG | S_IRWXO)) != 0) {
+    return absl::PermissionDeniedError(absl::StrCat(
+        "Shared memory segment ", name, " is accessible to other users."));
+  }
+  return absl::OkStatus();
+}
+
+// Marks the segment left under `name` by a previous writer as retired, so that
+// its readers re-open `name`, and unlinks it. The segment is not resized or
+// otherwise modified, since readers may still map it.
+absl::Status RetireSegment(const std::string& name) {
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    return errno == ENOENT ? absl::OkStatus() : ErrnoError("shm_open", name);
+  }
+  struct stat segment_stat;
+  if (fstat(fd, &segment_stat) != 0) {
+    absl::Status status = ErrnoError("fstat", name);
+    close(fd);
+    return status;
+  }
+  if (absl::Status status =
+          CheckSegmentOwner(segment_stat, name, /*private_only=*/false);
+      !status.ok()) {
+    close(fd);
+    return status;
+  }
+  if (static_cast<size_t>(segment_stat.st_size) >= sizeof(SegmentHeader)) {
+    void* mapping = mmap(nullptr, sizeof(SegmentHeader),
+                         PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping != MAP_FAILED) {
+      SegmentHeader& header = Header(mapping);
+      if (header.magic == kMagic && header.format_version == kFormatVersion) {
+        header.retired.store(1, std::memory_order_release);
+      }
+      munmap(mapping, sizeof(SegmentHeader));
+    }
+  }
+  close(fd);
+  if (shm_unlink(name.c_str()) != 0 && errno != ENOENT) {
+    return ErrnoError("shm_unlink", name);
+  }
+  VLOG(1) << "Retired the key snapshot segment of a previous writer of "
+          << name;
+  return absl::OkStatus();
+}
+
+// Whether `name` still refers to the segment identified by `device` and
+// `inode`, rather than to one created by a newer writer.
+bool NameRefersToSegment(const std::string& name, dev_t device, ino_t inode) {
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat segment_stat;
+  const bool same = fstat(fd, &segment_stat) == 0 &&
+                    segment_stat.st_dev == device &&
+                    segment_stat.st_ino == inode;
+  close(fd);
+  return same;
+}
+
+template <typename T>
+void AppendInteger(T value, std::string& out) {
+  out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void AppendBytes(absl::string_view bytes, std::string& out) {
+  AppendInteger(static_cast<uint32_t>(bytes.size()), out);
+  out.append(bytes.data(), bytes.size());
+}
+
+std::string SerializeSnapshot(const KeySnapshot& snapshot) {
+  std::string out;
+  AppendInteger(static_cast<uint32_t>(snapshot.private_keys.size()), out);
+  AppendInteger(static_cast<uint32_t>(snapshot.public_keys.size()), out);
+  for (const PrivateKey& key : snapshot.private_keys) {
+    AppendBytes(key.key_id, out);
+    AppendBytes(key.private_key, out);
+    AppendInteger(absl::ToUnixNanos(key.creation_time), out);
+  }
+  for (const PublicKey& key : snapshot.public_keys) {
+    AppendBytes(key.SerializeAsString(), out);
+  }
+  return out;
+}
+
+// Bounds-checked reader over a payload that the writer may be overwriting.
+// Whatever it returns is only trusted once the sequence number is confirmed
+// unchanged.
+class PayloadCursor {
+ public:
+  PayloadCursor(const char* data, size_t size) : data_(data), size_(size) {}
+
+  template <typename T>
+  bool ReadInteger(T& out) {
+    if (size_ - position_ < sizeof(T)) {
+      return false;
+    }
+    std::memcpy(&out, data_ + position_, sizeof(T));
+    position_ += sizeof(T);
+    return true;
+  }
+
+  bool ReadBytes(absl::string_view& out) {
+    uint32_t length;
+    if (!ReadInteger(length) || size_ - position_ < length) {
+      return false;
+    }
+    out = absl::string_view(data_ + position_, length);
+    position_ += length;
+    return true;
+  }
+
+  bool ReadPrivateKey(absl::string_view& key_id, absl::string_view& value,
+                      int64_t& creation_nanos) {
+    return ReadBytes(key_id) && ReadBytes(value) && ReadInteger(creation_nanos);
+  }
+
+ private:
+  const char* const data_;
+  const size_t size_;
+  size_t position_ = 0;
+};
+
+// Runs `read` over a consistent view of the published payload, retrying while
+// the writer is in the middle of a publication.
+template <typename T>
+absl::StatusOr<T> ReadConsistent(
+    const void* mapping,
+    absl::FunctionRef<absl::StatusOr<T>(PayloadCursor&)> read) {
+  const SegmentHeader& header = Header(mapping);
+  for (int attempt = 0; attempt < kMaxReadAttempts; ++attempt) {
+    const uint64_t sequence = header.sequence.load(std::memory_order_acquire);
+    if (sequence % 2 == 1) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (sequence == 0) {
+      return absl::FailedPreconditionError(
+          "No key snapshot has been published yet.");
+    }
+    PayloadCursor cursor(
+        Payload(mapping),
+        std::min(header.payload_size.load(std::memory_order_relaxed),
+                 header.capacity));
+    absl::StatusOr<T> result = read(cursor);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header.sequence.load(std::memory_order_relaxed) == sequence) {
+      return result;
+    }
+  }
+  return absl::UnavailableError(
+      "Key snapshot kept changing while it was being read.");
+}
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<SharedMemoryKeySnapshotWriter>>
+SharedMemoryKeySnapshotWriter::Create(absl::string_view name,
+                                      size_t capacity) {
+  const std::string segment_name(name);
+  const size_t mapping_size = sizeof(SegmentHeader) + capacity;
+  if (absl::Status status = RetireSegment(segment_name); !status.ok()) {
+    return status;
+  }
+  // O_EXCL guarantees a fresh segment that no reader has mapped yet, so it can
+  // be sized and initialized safely.
+  int fd = shm_open(segment_name.c_str(), O_CREAT | O_EXCL | O_RDWR,
+                    S_IRUSR | S_IWUSR);
+  if (fd < 0) {
+    return ErrnoError("shm_open", name);
+  }
+  if (ftruncate(fd, mapping_size) != 0) {
+    absl::Status status = ErrnoError("ftruncate", name);
+    close(fd);
+    shm_unlink(segment_name.c_str());
+    return status;
+  }
+  struct stat segment_stat;
+  if (fstat(fd, &segment_stat) != 0) {
+    absl::Status status = ErrnoError("fstat", name);
+    close(fd);
+    shm_unlink(segment_name.c_str());
+    return status;
+  }
+  void* mapping =
+      mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    absl::Status status = ErrnoError("mmap", name);
+    shm_unlink(segment_name.c_str());
+    return status;
+  }
+
+  SegmentHeader& header = *new (mapping) SegmentHeader();
+  header.magic = kMagic;
+  header.format_version = kFormatVersion;
+  header.capacity = capacity;
+
+  return absl::WrapUnique(new SharedMemoryKeySnapshotWriter(
+      std::move(segment_name), mapping, mapping_size, segment_stat.st_dev,
+      segment_stat.st_ino));
+}
+
+SharedMemoryKeySnapshotWriter::SharedMemoryKeySnapshotWriter(
+    std::string name, void* mapping, size_t mapping_size, dev_t device,
+    ino_t inode)
+    : name_(std::move(name)),
+      mapping_(mapping),
+      mapping_size_(mapping_size),
+      device_(device),
+      inode_(inode) {}
+
+SharedMemoryKeySnapshotWriter::~SharedMemoryKeySnapshotWriter() {
+  // A newer writer that already retired this segment owns the name now. One
+  // that is retiring it concurrently may not have flagged it yet, so the name
+  // is only unlinked while it still refers to this segment.
+  const bool replaced =
+      Header(mapping_).retired.exchange(1, std::memory_order_acq_rel) != 0;
+  munmap(mapping_, mapping_size_);
+  if (!replaced && NameRefersToSegment(name_, device_, inode_)) {
+    shm_unlink(name_.c_str());
+  }
+}
+
+absl::Status SharedMemoryKeySnapshotWriter::Publish(
+    const KeySnapshot& snapshot) {
+  const std::string payload = SerializeSnapshot(snapshot);
+  SegmentHeader& header = Header(mapping_);
+  if (payload.size() > header.capacity) {
+    return absl::ResourceExhaustedError(
+        absl::StrCat("Key snapshot of ", payload.size(),
+                     " bytes does not fit in ", header.capacity, " bytes."));
+  }
+
+  absl::MutexLock l(&mutex_);
+  if (header.retired.load(std::memory_order_acquire) != 0) {
+    return absl::FailedPreconditionError(absl::StrCat(
+        "Key snapshot segment ", name_, " was replaced by another writer."));
+  }
+  const uint64_t sequence = header.sequence.load(std::memory_order_relaxed);
+  header.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(Payload(mapping_), payload.data(), payload.size());
+  header.payload_size.store(payload.size(), std::memory_order_relaxed);
+  header.sequence.store(sequence + 2, std::memory_order_release);
+  VLOG(3) << "Published key snapshot " << sequence + 2 << " to " << name_;
+  return absl::OkStatus();
+}
+
+class SharedMemoryKeyFetcherManager::Segment {
+ public:
+  // Maps the segment `name` read-only after checking that it holds a key
+  // snapshot and is private to the current user.
+  static absl::StatusOr<std::shared_ptr<const Segment>> Open(
+      absl::string_view name);
+
+  Segment(const void* mapping, size_t mapping_size)
+      : mapping_(mapping), mapping_size_(mapping_size) {}
+
+  ~Segment() { munmap(const_cast<void*>(mapping_), mapping_size_); }
+
+  Segment(const Segment&) = delete;
+  Segment& operator=(const Segment&) = delete;
+
+  const void* mapping() const { return mapping_; }
+
+  bool retired() const {
+    return Header(mapping_).retired.load(std::memory_order_acquire) != 0;
+  }
+
+ private:
+  const void* const mapping_;
+  const size_t mapping_size_;
+};
+
+absl::StatusOr<std::shared_ptr<const SharedMemoryKeyFetcherManager::Segment>>
+SharedMemoryKeyFetcherManager::Segment::Open(absl::string_view name) {
+  const std::string segment_name(name);
+  int fd = shm_open(segment_name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return ErrnoError("shm_open", name);
+  }
+  struct stat segment_stat;
+  if (fstat(fd, &segment_stat) != 0) {
+    absl::Status status = ErrnoError("fstat", name);
+    close(fd);
+    return status;
+  }
+  if (absl::Status status =
+          CheckSegmentOwner(segment_stat, name, /*private_only=*/true);
+      !status.ok()) {
+    close(fd);
+    return status;
+  }
+  const size_t mapping_size = segment_stat.st_size;
+  if (mapping_size < sizeof(SegmentHeader)) {
+    close(fd);
+    return absl::FailedPreconditionError(
+        absl::StrCat("Shared memory segment ", name, " is too small."));
+  }
+  void* mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    return ErrnoError("mmap", name);
+  }
+
+  const SegmentHeader& header = Header(static_cast<const void*>(mapping));
+  if (header.magic != kMagic || header.format_version != kFormatVersion ||
+      header.capacity > mapping_size - sizeof(SegmentHeader)) {
+    munmap(mapping, mapping_size);
+    return absl::FailedPreconditionError(absl::StrCat(
+        "Shared memory segment ", name, " does not hold a key snapshot."));
+  }
+  return std::make_shared<const Segment>(mapping, mapping_size);
+}
+
+absl::StatusOr<std::unique_ptr<SharedMemoryKeyFetcherManager>>
+SharedMemoryKeyFetcherManager::Open(absl::string_view name) {
+  absl::StatusOr<std::shared_ptr<const Segment>> segment = Segment::Open(name);
+  if (!segment.ok()) {
+    return segment.status();
+  }
+  return absl::WrapUnique(new SharedMemoryKeyFetcherManager(
+      std::string(name), *std::move(segment)));
+}
+
+SharedMemoryKeyFetcherManager::SharedMemoryKeyFetcherManager(
+    std::string name, std::shared_ptr<const Segment> segment)
+    : name_(std::move(name)), segment_(std::move(segment)) {}
+
+SharedMemoryKeyFetcherManager::~SharedMemoryKeyFetcherManager() = default;
+
+std::shared_ptr<const SharedMemoryKeyFetcherManager::Segment>
+SharedMemoryKeyFetcherManager::CurrentSegment() {
+  {
+    absl::ReaderMutexLock l(&segment_mutex_);
+    if (!segment_->retired() || absl::Now() < next_reopen_) {
+      return segment_;
+    }
+  }
+
+  absl::MutexLock l(&segment_mutex_);
+  if (!segment_->retired() || absl::Now() < next_reopen_) {
+    return segment_;
+  }
+  next_reopen_ = absl::Now() + kReopenInterval;
+  absl::StatusOr<std::shared_ptr<const Segment>> segment = Segment::Open(name_);
+  if (!segment.ok()) {
+    // Keep serving the last snapshot until a new writer shows up.
+    VLOG(1) << "Re-opening key snapshot segment " << name_
+            << " failed: " << segment.status().message();
+  } else if (!(*segment)->retired()) {
+    VLOG(1) << "Switched to the key snapshot segment of a new writer of "
+            << name_;
+    segment_ = *std::move(segment);
+  }
+  return segment_;
+}
+
+absl::StatusOr<PublicKey> SharedMemoryKeyFetcherManager::GetPublicKey() noexcept
+    ABSL_LOCKS_EXCLUDED(mutex_) {
+  uint32_t draw;
+  {
+    absl::MutexLock l(&mutex_);
+    draw = absl::Uniform<uint32_t>(bitgen_);
+  }
+  std::shared_ptr<const Segment> segment = CurrentSegment();
+  absl::StatusOr<std::string> serialized_key = ReadConsistent<std::string>(
+      segment->mapping(),
+      [draw](PayloadCursor& cursor) -> absl::StatusOr<std::string> {
+        uint32_t num_private_keys;
+        uint32_t num_public_keys;
+        if (!cursor.ReadInteger(num_private_keys) ||
+            !cursor.ReadInteger(num_public_keys)) {
+          return absl::DataLossError(kMalformedSnapshotMessage);
+        }
+        if (num_public_keys == 0) {
+          return absl::FailedPreconditionError("No public keys to return.");
+        }
+        absl::string_view key_id;
+        absl::string_view value;
+        int64_t creation_nanos;
+        for (uint32_t i = 0; i < num_private_keys; ++i) {
+          if (!cursor.ReadPrivateKey(key_id, value, creation_nanos)) {
+            return absl::DataLossError(kMalformedSnapshotMessage);
+          }
+        }
+        absl::string_view serialized;
+        for (uint32_t i = 0; i <= draw % num_public_keys; ++i) {
+          if (!cursor.ReadBytes(serialized)) {
+            return absl::DataLossError(kMalformedSnapshotMessage);
+          }
+        }
+        return std::string(serialized);
+      });
+  if (!serialized_key.ok()) {
+    return serialized_key.status();
+  }
+  PublicKey public_key;
+  if (!public_key.ParseFromString(*serialized_key)) {
+    return absl::DataLossError(kMalformedSnapshotMessage);
+  }
+  return public_key;
+}
+
+std::optional<PrivateKey> SharedMemoryKeyFetcherManager::GetPrivateKey(
+    const PublicPrivateKeyPairId& key_id) noexcept {
+  std::shared_ptr<const Segment> segment = CurrentSegment();
+  absl::StatusOr<PrivateKey> private_key = ReadConsistent<PrivateKey>(
+      segment->mapping(),
+      [&key_id](PayloadCursor& cursor) -> absl::StatusOr<PrivateKey> {
+        uint32_t num_private_keys;
+        uint32_t num_public_keys;
+        if (!cursor.ReadInteger(num_private_keys) ||
+            !cursor.ReadInteger(num_public_keys)) {
+          return absl::DataLossError(kMalformedSnapshotMessage);
+        }
+        absl::string_view id;
+        absl::string_view value;
+        int64_t creation_nanos;
+        for (uint32_t i = 0; i < num_private_keys; ++i) {
+          if (!cursor.ReadPrivateKey(id, value, creation_nanos)) {
+            return absl::DataLossError(kMalformedSnapshotMessage);
+          }
+          if (id == key_id) {
+            return PrivateKey{std::string(id), std::string(value),
+                              absl::FromUnixNanos(creation_nanos)};
+          }
+        }
+        return absl::NotFoundError("No private key with the given ID.");
+      });
+  if (!private_key.ok()) {
+    VLOG_IF(1, !absl::IsNotFound(private_key.status()))
+        << "Reading the key snapshot failed: "
+        << private_key.status().message();
+    return std::nullopt;
+  }
+  return *std::move(private_key);
+}
+
+uint64_t SharedMemoryKeyFetcherManager::GetVersion() {
+  std::shared_ptr<const Segment> segment = CurrentSegment();
+  return Header(segment->mapping()).sequence.load(std::memory_order_acquire) &
+         ~1ULL;
+}
+
+}  // namespace privacy_sandbox::server_common
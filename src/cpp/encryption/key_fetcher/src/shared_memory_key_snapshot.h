@@ -0,0 +1,155 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_CPP_ENCRYPTION_KEY_FETCHER_SHARED_MEMORY_KEY_SNAPSHOT_H_
+#define SRC_CPP_ENCRYPTION_KEY_FETCHER_SHARED_MEMORY_KEY_SNAPSHOT_H_
+
+#include <sys/types.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/random/random.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "cc/public/cpio/interface/public_key_client/public_key_client_interface.h"
+#include "cc/public/cpio/interface/type_def.h"
+#include "src/cpp/encryption/key_fetcher/interface/key_fetcher_manager_interface.h"
+#include "src/cpp/encryption/key_fetcher/interface/private_key_fetcher_interface.h"
+
+namespace privacy_sandbox::server_common {
+
+// Parsed keys published to sibling processes on the same host.
+struct KeySnapshot {
+  std::vector<google::cmrt::sdk::public_key_service::v1::PublicKey>
+      public_keys;
+  std::vector<PrivateKey> private_keys;
+};
+
+// Publishes key snapshots into a POSIX shared-memory segment. The segment
+// holds a header with a format version and a sequence number, followed by the
+// serialized snapshot. The sequence number is odd while a snapshot is being
+// written, so that readers can detect and retry torn reads (seqlock).
+//
+// There must be a single writer per segment name. The segment is only
+// accessible to the user of the writer process. A segment that readers may
+// have mapped is never resized or reinitialized: a restarted writer instead
+// retires the segment of its predecessor and creates a fresh one under the
+// same name, and readers re-open the name once they see their segment retired.
+// The segment is retired and unlinked when the writer is destroyed; readers
+// keep serving its last snapshot until a new writer replaces it.
+class SharedMemoryKeySnapshotWriter {
+ public:
+  // Creates the segment `name`, e.g. "/kv_keys", with room for `capacity`
+  // bytes of serialized snapshot. A segment left under `name` by a previous
+  // writer of the same user is retired and replaced.
+  static absl::StatusOr<std::unique_ptr<SharedMemoryKeySnapshotWriter>> Create(
+      absl::string_view name, size_t capacity);
+
+  ~SharedMemoryKeySnapshotWriter();
+
+  SharedMemoryKeySnapshotWriter(const SharedMemoryKeySnapshotWriter&) = delete;
+  SharedMemoryKeySnapshotWriter& operator=(
+      const SharedMemoryKeySnapshotWriter&) = delete;
+
+  // Replaces the published snapshot. Fails if the serialized snapshot does not
+  // fit in the segment.
+  absl::Status Publish(const KeySnapshot& snapshot);
+
+ private:
+  SharedMemoryKeySnapshotWriter(std::string name, void* mapping,
+                                size_t mapping_size, dev_t device,
+                                ino_t inode);
+
+  const std::string name_;
+  void* const mapping_;
+  const size_t mapping_size_;
+  // Identify the segment created under `name_`, which a newer writer may have
+  // replaced with its own.
+  const dev_t device_;
+  const ino_t inode_;
+  // Serializes Publish() calls from different threads of the writer process.
+  absl::Mutex mutex_;
+};
+
+// KeyFetcherManagerInterface that serves keys straight out of a segment
+// published by a SharedMemoryKeySnapshotWriter in another process. The segment
+// is mapped read-only and lookups only copy the key they return. Keys are
+// refreshed by the writer, so Start() does nothing.
+class SharedMemoryKeyFetcherManager : public KeyFetcherManagerInterface {
+ public:
+  // Maps the segment `name` created by a SharedMemoryKeySnapshotWriter. Fails
+  // unless the segment belongs to the current user and is not accessible to
+  // anyone else.
+  static absl::StatusOr<std::unique_ptr<SharedMemoryKeyFetcherManager>> Open(
+      absl::string_view name);
+
+  ~SharedMemoryKeyFetcherManager();
+
+  SharedMemoryKeyFetcherManager(const SharedMemoryKeyFetcherManager&) = delete;
+  SharedMemoryKeyFetcherManager& operator=(
+      const SharedMemoryKeyFetcherManager&) = delete;
+
+  void Start() noexcept override {}
+
+  // Returns a random public key from the latest snapshot.
+  absl::StatusOr<google::cmrt::sdk::public_key_service::v1::PublicKey>
+  GetPublicKey() noexcept override;
+
+  // Returns the private key with `key_id` from the latest snapshot, if any.
+  std::optional<PrivateKey> GetPrivateKey(
+      const google::scp::cpio::PublicPrivateKeyPairId& key_id) noexcept
+      override;
+
+  // Returns the sequence number of the latest snapshot. It is 0 until the
+  // first snapshot is published and grows with every publication. It starts
+  // over at 0 when a restarted writer replaces the segment.
+  uint64_t GetVersion();
+
+ private:
+  // A read-only mapping of one segment.
+  class Segment;
+
+  SharedMemoryKeyFetcherManager(std::string name,
+                                std::shared_ptr<const Segment> segment);
+
+  // Returns the segment to read from. Once the mapped segment is retired,
+  // re-opens `name_`, at most every few milliseconds, and switches to the
+  // segment of the new writer, if there is one yet.
+  std::shared_ptr<const Segment> CurrentSegment()
+      ABSL_LOCKS_EXCLUDED(segment_mutex_);
+
+  const std::string name_;
+
+  absl::Mutex segment_mutex_;
+  std::shared_ptr<const Segment> segment_ ABSL_GUARDED_BY(segment_mutex_);
+  absl::Time next_reopen_ ABSL_GUARDED_BY(segment_mutex_) =
+      absl::InfinitePast();
+
+  absl::Mutex mutex_;
+  // BitGen for randomly choosing a public key to return in GetPublicKey().
+  absl::BitGen bitgen_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace privacy_sandbox::server_common
+
+#endif  // SRC_CPP_ENCRYPTION_KEY_FETCHER_SHARED_MEMORY_KEY_SNAPSHOT_H_
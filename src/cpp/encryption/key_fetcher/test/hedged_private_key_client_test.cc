@@ -0,0 +1,225 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/cpp/encryption/key_fetcher/src/hedged_private_key_client.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <grpc/event_engine/event_engine.h>
+#include <grpc/grpc.h>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "cc/public/cpio/interface/private_key_client/private_key_client_interface.h"
+#include "include/gtest/gtest.h"
+#include "public/core/interface/execution_result.h"
+#include "src/cpp/concurrent/event_engine_executor.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+using ::google::cmrt::sdk::private_key_service::v1::ListPrivateKeysRequest;
+using ::google::cmrt::sdk::private_key_service::v1::ListPrivateKeysResponse;
+using ::google::scp::core::ExecutionResult;
+using ::google::scp::core::FailureExecutionResult;
+using ::google::scp::core::SuccessExecutionResult;
+using ::google::scp::cpio::Callback;
+using ::google::scp::cpio::PrivateKeyClientInterface;
+
+// Stand-in for a private key client replica that answers after a fixed latency
+// on its own thread, with a response carrying `key_id`.
+class FakePrivateKeyClient : public PrivateKeyClientInterface {
+ public:
+  FakePrivateKeyClient(absl::Duration latency, ExecutionResult result,
+                       std::string key_id, std::atomic<int>* calls)
+      : latency_(latency),
+        result_(result),
+        key_id_(std::move(key_id)),
+        calls_(calls) {}
+
+  ~FakePrivateKeyClient() {
+    absl::MutexLock l(&mutex_);
+    for (std::thread& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  ExecutionResult Init() noexcept override { return SuccessExecutionResult(); }
+  ExecutionResult Run() noexcept override { return SuccessExecutionResult(); }
+  ExecutionResult Stop() noexcept override { return SuccessExecutionResult(); }
+
+  ExecutionResult ListPrivateKeys(
+      ListPrivateKeysRequest request,
+      Callback<ListPrivateKeysResponse> callback) noexcept override {
+    ++*calls_;
+    ListPrivateKeysResponse response;
+    if (result_.Successful()) {
+      response.add_private_keys()->set_key_id(key_id_);
+    }
+    absl::MutexLock l(&mutex_);
+    threads_.emplace_back([latency = latency_, result = result_,
+                           response = std::move(response),
+                           callback = std::move(callback)]() {
+      absl::SleepFor(latency);
+      callback(result, response);
+    });
+    return SuccessExecutionResult();
+  }
+
+ private:
+  absl::Duration latency_;
+  ExecutionResult result_;
+  std::string key_id_;
+  std::atomic<int>* calls_;
+  absl::Mutex mutex_;
+  std::vector<std::thread> threads_ ABSL_GUARDED_BY(mutex_);
+};
+
+class HedgedPrivateKeyClientTest : public ::testing::Test {
+ protected:
+  HedgedPrivateKeyClientTest() {
+    grpc_init();
+    std::unique_ptr<grpc_event_engine::experimental::EventEngine> event_engine =
+        grpc_event_engine::experimental::CreateEventEngine();
+    grpc_shutdown();
+    executor_ = std::make_shared<EventEngineExecutor>(std::move(event_engine));
+  }
+
+  // Adds a replica that answers with `result` after `latency`.
+  void AddReplica(absl::Duration latency, ExecutionResult result,
+                  std::string key_id) {
+    calls_.push_back(std::make_unique<std::atomic<int>>(0));
+    clients_.push_back(std::make_unique<FakePrivateKeyClient>(
+        latency, result, std::move(key_id), calls_.back().get()));
+  }
+
+  int Calls(int replica) { return *calls_[replica]; }
+
+  // Runs a hedged ListPrivateKeys() call and waits for its callback.
+  void ListPrivateKeys(HedgedPrivateKeyClient& client) {
+    absl::Notification done;
+    std::atomic<int> callbacks = 0;
+    ExecutionResult start_result = client.ListPrivateKeys(
+        ListPrivateKeysRequest(),
+        [&](const ExecutionResult result, ListPrivateKeysResponse response) {
+          result_ = result;
+          response_ = std::move(response);
+          ++callbacks;
+          done.Notify();
+        });
+    ASSERT_TRUE(start_result.Successful());
+    done.WaitForNotification();
+    EXPECT_EQ(callbacks, 1);
+  }
+
+  std::shared_ptr<Executor> executor_;
+  std::vector<std::unique_ptr<std::atomic<int>>> calls_;
+  std::vector<std::unique_ptr<PrivateKeyClientInterface>> clients_;
+  ExecutionResult result_;
+  ListPrivateKeysResponse response_;
+};
+
+TEST_F(HedgedPrivateKeyClientTest, FastPrimaryIsNotHedged) {
+  AddReplica(absl::ZeroDuration(), SuccessExecutionResult(), "primary");
+  AddReplica(absl::ZeroDuration(), SuccessExecutionResult(), "replica");
+  HedgedPrivateKeyClient client(std::move(clients_), absl::Seconds(10),
+                                executor_);
+
+  ListPrivateKeys(client);
+
+  EXPECT_TRUE(result_.Successful());
+  ASSERT_EQ(response_.private_keys_size(), 1);
+  EXPECT_EQ(response_.private_keys(0).key_id(), "primary");
+  EXPECT_EQ(Calls(0), 1);
+  EXPECT_EQ(Calls(1), 0);
+}
+
+TEST_F(HedgedPrivateKeyClientTest, SlowPrimaryIsHedgedAfterDelay) {
+  AddReplica(absl::Seconds(1), SuccessExecutionResult(), "primary");
+  AddReplica(absl::ZeroDuration(), SuccessExecutionResult(), "replica");
+  HedgedPrivateKeyClient client(std::move(clients_), absl::Milliseconds(10),
+                                executor_);
+
+  absl::Time start = absl::Now();
+  ListPrivateKeys(client);
+
+  EXPECT_LT(absl::Now() - start, absl::Seconds(1));
+  EXPECT_TRUE(result_.Successful());
+  ASSERT_EQ(response_.private_keys_size(), 1);
+  EXPECT_EQ(response_.private_keys(0).key_id(), "replica");
+  EXPECT_EQ(Calls(0), 1);
+  EXPECT_EQ(Calls(1), 1);
+}
+
+TEST_F(HedgedPrivateKeyClientTest, FailedPrimaryIsHedgedWithoutDelay) {
+  AddReplica(absl::ZeroDuration(), FailureExecutionResult(0), "primary");
+  AddReplica(absl::ZeroDuration(), SuccessExecutionResult(), "replica");
+  HedgedPrivateKeyClient client(std::move(clients_), absl::Hours(1),
+                                executor_);
+
+  ListPrivateKeys(client);
+
+  EXPECT_TRUE(result_.Successful());
+  ASSERT_EQ(response_.private_keys_size(), 1);
+  EXPECT_EQ(response_.private_keys(0).key_id(), "replica");
+}
+
+TEST_F(HedgedPrivateKeyClientTest, ReportsFailureOnceAllReplicasFail) {
+  AddReplica(absl::Milliseconds(50), FailureExecutionResult(0), "primary");
+  AddReplica(absl::ZeroDuration(), FailureExecutionResult(0), "replica");
+  HedgedPrivateKeyClient client(std::move(clients_), absl::Milliseconds(1),
+                                executor_);
+
+  ListPrivateKeys(client);
+
+  EXPECT_FALSE(result_.Successful());
+  EXPECT_EQ(response_.private_keys_size(), 0);
+  EXPECT_EQ(Calls(0), 1);
+  EXPECT_EQ(Calls(1), 1);
+}
+
+TEST_F(HedgedPrivateKeyClientTest, ReportsFailureWhenDestroyedBeforeHedging) {
+  AddReplica(absl::Milliseconds(200), FailureExecutionResult(42), "primary");
+  AddReplica(absl::ZeroDuration(), SuccessExecutionResult(), "replica");
+  auto client = std::make_unique<HedgedPrivateKeyClient>(
+      std::move(clients_), absl::Hours(1), executor_);
+
+  absl::Notification done;
+  ASSERT_TRUE(client
+                  ->ListPrivateKeys(ListPrivateKeysRequest(),
+                                    [&](const ExecutionResult result,
+                                        ListPrivateKeysResponse response) {
+                                      result_ = result;
+                                      done.Notify();
+                                    })
+                  .Successful());
+  // The primary fails while the replicas are being destroyed, so the replica
+  // it would hedge to is gone.
+  client.reset();
+
+  ASSERT_TRUE(done.WaitForNotificationWithTimeout(absl::Seconds(10)));
+  EXPECT_FALSE(result_.Successful());
+  EXPECT_EQ(result_.status_code, 42);
+  EXPECT_EQ(Calls(0), 1);
+  EXPECT_EQ(Calls(1), 0);
+}
+
+}  // namespace
+}  // namespace privacy_sandbox::server_common
@@ -14,6 +14,8 @@
 
 #include "src/cpp/encryption/key_fetcher/src/key_fetcher_manager.h"
 
+#include <unistd.h>
+
 #include <memory>
 #include <string>
 #include <utility>
@@ -21,6 +23,7 @@
 #include <grpc/event_engine/event_engine.h>
 #include <grpc/grpc.h>
 
+#include "absl/strings/str_cat.h"
 #include "absl/synchronization/blocking_counter.h"
 #include "absl/time/clock.h"
 #include "googletest/include/gtest/gtest.h"
@@ -31,6 +34,7 @@
 #include "src/cpp/encryption/key_fetcher/interface/private_key_fetcher_interface.h"
 #include "src/cpp/encryption/key_fetcher/mock/mock_private_key_fetcher.h"
 #include "src/cpp/encryption/key_fetcher/mock/mock_public_key_fetcher.h"
+#include "src/cpp/encryption/key_fetcher/src/shared_memory_key_snapshot.h"
 
 namespace privacy_sandbox::server_common {
 namespace {
@@ -108,5 +112,51 @@ TEST_F(KeyFetcherManagerTest, SuccessfulPublicKeyRefreshNoPrivateKeysToFetch) {
   absl::SleepFor(absl::Milliseconds(5));
 }
 
+TEST_F(KeyFetcherManagerTest, SuccessfulRefreshPublishesKeySnapshot) {
+  std::unique_ptr<MockPublicKeyFetcher> public_key_fetcher =
+      std::make_unique<MockPublicKeyFetcher>();
+  std::unique_ptr<MockPrivateKeyFetcher> private_key_fetcher =
+      std::make_unique<MockPrivateKeyFetcher>();
+
+  google::cmrt::sdk::public_key_service::v1::PublicKey public_key;
+  public_key.set_key_id("key_id");
+  PrivateKey private_key = {"key_id", "private_key", absl::Now()};
+  EXPECT_CALL(*public_key_fetcher, Refresh)
+      .WillRepeatedly([&]() -> absl::Status { return absl::OkStatus(); });
+  EXPECT_CALL(*public_key_fetcher, GetKeys)
+      .WillRepeatedly(
+          [&]() -> std::vector<
+                    google::cmrt::sdk::public_key_service::v1::PublicKey> {
+            return {public_key};
+          });
+  EXPECT_CALL(*private_key_fetcher, Refresh)
+      .WillRepeatedly([&]() -> absl::Status { return absl::OkStatus(); });
+  EXPECT_CALL(*private_key_fetcher, GetKeys)
+      .WillRepeatedly(
+          [&]() -> std::vector<PrivateKey> { return {private_key}; });
+
+  const std::string segment_name =
+      absl::StrCat("/key_fetcher_manager_test_", getpid());
+  absl::StatusOr<std::unique_ptr<SharedMemoryKeySnapshotWriter>> writer =
+      SharedMemoryKeySnapshotWriter::Create(segment_name, 4096);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  absl::StatusOr<std::unique_ptr<SharedMemoryKeyFetcherManager>> reader =
+      SharedMemoryKeyFetcherManager::Open(segment_name);
+  ASSERT_TRUE(reader.ok()) << reader.status();
+
+  KeyFetcherManager manager(absl::Minutes(1), std::move(public_key_fetcher),
+                            std::move(private_key_fetcher),
+                            std::move(executor_), *std::move(writer));
+  manager.Start();
+
+  std::optional<PrivateKey> shared_key = (*reader)->GetPrivateKey("key_id");
+  ASSERT_TRUE(shared_key.has_value());
+  EXPECT_EQ(shared_key->private_key, "private_key");
+  absl::StatusOr<google::cmrt::sdk::public_key_service::v1::PublicKey>
+      shared_public_key = (*reader)->GetPublicKey();
+  ASSERT_TRUE(shared_public_key.ok()) << shared_public_key.status();
+  EXPECT_EQ(shared_public_key->key_id(), "key_id");
+}
+
 }  // namespace
 }  // namespace privacy_sandbox::server_common
@@ -0,0 +1,220 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/cpp/encryption/key_fetcher/src/shared_key_fetcher_manager.h"
+
+#include <memory>
+#include <thread>
+#include <utility>
+
+#include <grpc/event_engine/event_engine.h>
+#include <grpc/grpc.h>
+
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "include/gtest/gtest.h"
+#include "src/cpp/concurrent/event_engine_executor.h"
+#include "src/cpp/concurrent/executor.h"
+#include "src/cpp/encryption/key_fetcher/mock/mock_private_key_fetcher.h"
+#include "src/cpp/encryption/key_fetcher/mock/mock_public_key_fetcher.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+using ::testing::Return;
+
+class SharedKeyFetcherManagerTest : public ::testing::Test {
+ protected:
+  SharedKeyFetcherManagerTest() {
+    grpc_init();
+    std::unique_ptr<grpc_event_engine::experimental::EventEngine> event_engine =
+        grpc_event_engine::experimental::CreateEventEngine();
+    grpc_shutdown();
+    executor_ = std::make_shared<EventEngineExecutor>(std::move(event_engine));
+  }
+
+  // Returns a config with one public and one private key endpoint.
+  static KeyFetcherConfig DefaultConfig() {
+    KeyFetcherConfig config;
+    config.public_key_endpoints = {"https://public.example.com"};
+    config.primary_private_key_endpoint.private_key_vending_service_endpoint =
+        "https://private.example.com";
+    config.private_key_ttl = absl::Hours(1);
+    config.key_refresh_period = absl::Minutes(1);
+    return config;
+  }
+
+  // Creates a handle for `config`. Fetchers, if created, come from
+  // `public_key_fetcher_` and `private_key_fetcher_`.
+  std::unique_ptr<SharedKeyFetcherManager> CreateManager(
+      const KeyFetcherConfig& config) {
+    return SharedKeyFetcherManager::Create(
+        config,
+        [this]() -> std::unique_ptr<PublicKeyFetcherInterface> {
+          ++fetchers_created_;
+          return std::move(public_key_fetcher_);
+        },
+        [this]() -> std::unique_ptr<PrivateKeyFetcherInterface> {
+          return std::move(private_key_fetcher_);
+        },
+        executor_);
+  }
+
+  // Returns how many caches are created for live handles to `first` and
+  // `second`.
+  int CachesCreated(const KeyFetcherConfig& first,
+                    const KeyFetcherConfig& second) {
+    const int fetchers_created = fetchers_created_;
+    std::unique_ptr<SharedKeyFetcherManager> first_manager =
+        CreateManager(first);
+    public_key_fetcher_ = std::make_unique<MockPublicKeyFetcher>();
+    private_key_fetcher_ = std::make_unique<MockPrivateKeyFetcher>();
+    std::unique_ptr<SharedKeyFetcherManager> second_manager =
+        CreateManager(second);
+    public_key_fetcher_ = std::make_unique<MockPublicKeyFetcher>();
+    private_key_fetcher_ = std::make_unique<MockPrivateKeyFetcher>();
+    return fetchers_created_ - fetchers_created;
+  }
+
+  std::shared_ptr<Executor> executor_;
+  std::unique_ptr<MockPublicKeyFetcher> public_key_fetcher_ =
+      std::make_unique<MockPublicKeyFetcher>();
+  std::unique_ptr<MockPrivateKeyFetcher> private_key_fetcher_ =
+      std::make_unique<MockPrivateKeyFetcher>();
+  int fetchers_created_ = 0;
+};
+
+TEST_F(SharedKeyFetcherManagerTest, SameConfigSharesKeys) {
+  PrivateKey key = {"key_id", "private_key", absl::Now()};
+  EXPECT_CALL(*private_key_fetcher_, GetKey("key_id"))
+      .Times(2)
+      .WillRepeatedly(Return(key));
+
+  std::unique_ptr<SharedKeyFetcherManager> first =
+      CreateManager(DefaultConfig());
+  std::unique_ptr<SharedKeyFetcherManager> second =
+      CreateManager(DefaultConfig());
+
+  EXPECT_EQ(fetchers_created_, 1);
+  EXPECT_EQ(first->GetPrivateKey("key_id")->private_key, "private_key");
+  EXPECT_EQ(second->GetPrivateKey("key_id")->private_key, "private_key");
+}
+
+TEST_F(SharedKeyFetcherManagerTest, DifferentPublicKeyEndpointsDoNotShare) {
+  KeyFetcherConfig config = DefaultConfig();
+  config.public_key_endpoints.push_back("https://public2.example.com");
+
+  EXPECT_EQ(CachesCreated(DefaultConfig(), config), 2);
+}
+
+TEST_F(SharedKeyFetcherManagerTest, DifferentPrivateKeyEndpointsDoNotShare) {
+  KeyFetcherConfig primary = DefaultConfig();
+  primary.primary_private_key_endpoint.private_key_vending_service_endpoint =
+      "https://private2.example.com";
+  KeyFetcherConfig secondary = DefaultConfig();
+  secondary.secondary_private_key_endpoints.push_back(
+      primary.primary_private_key_endpoint);
+
+  EXPECT_EQ(CachesCreated(DefaultConfig(), primary), 2);
+  EXPECT_EQ(CachesCreated(DefaultConfig(), secondary), 2);
+}
+
+TEST_F(SharedKeyFetcherManagerTest, DifferentTimingsDoNotShare) {
+  KeyFetcherConfig ttl = DefaultConfig();
+  ttl.private_key_ttl = absl::Hours(2);
+  KeyFetcherConfig refresh_period = DefaultConfig();
+  refresh_period.key_refresh_period = absl::Minutes(2);
+
+  EXPECT_EQ(CachesCreated(DefaultConfig(), ttl), 2);
+  EXPECT_EQ(CachesCreated(DefaultConfig(), refresh_period), 2);
+}
+
+TEST_F(SharedKeyFetcherManagerTest, CacheIsRecreatedAfterLastHandle) {
+  CreateManager(DefaultConfig()).reset();
+  public_key_fetcher_ = std::make_unique<MockPublicKeyFetcher>();
+  private_key_fetcher_ = std::make_unique<MockPrivateKeyFetcher>();
+  std::unique_ptr<SharedKeyFetcherManager> manager =
+      CreateManager(DefaultConfig());
+
+  EXPECT_EQ(fetchers_created_, 2);
+}
+
+TEST_F(SharedKeyFetcherManagerTest, KeepsCacheRegisteredWhileCreatingFetchers) {
+  PrivateKey key = {"key_id", "private_key", absl::Now()};
+  EXPECT_CALL(*private_key_fetcher_, GetKey("key_id")).WillOnce(Return(key));
+
+  // The factories run without the registry lock, so another handle for the
+  // same config can be created, and its cache registered, in the meantime.
+  std::unique_ptr<SharedKeyFetcherManager> first;
+  std::unique_ptr<SharedKeyFetcherManager> second =
+      SharedKeyFetcherManager::Create(
+          DefaultConfig(),
+          [&]() -> std::unique_ptr<PublicKeyFetcherInterface> {
+            first = CreateManager(DefaultConfig());
+            return std::make_unique<MockPublicKeyFetcher>();
+          },
+          []() -> std::unique_ptr<PrivateKeyFetcherInterface> {
+            return std::make_unique<MockPrivateKeyFetcher>();
+          },
+          executor_);
+
+  EXPECT_EQ(second->GetPrivateKey("key_id")->private_key, "private_key");
+}
+
+TEST_F(SharedKeyFetcherManagerTest, StartRunsOneRefreshLoop) {
+  EXPECT_CALL(*public_key_fetcher_, Refresh)
+      .WillOnce(Return(absl::OkStatus()));
+  EXPECT_CALL(*private_key_fetcher_, Refresh)
+      .WillOnce(Return(absl::OkStatus()));
+
+  std::unique_ptr<SharedKeyFetcherManager> first =
+      CreateManager(DefaultConfig());
+  std::unique_ptr<SharedKeyFetcherManager> second =
+      CreateManager(DefaultConfig());
+  first->Start();
+  second->Start();
+}
+
+TEST_F(SharedKeyFetcherManagerTest, ConcurrentRefreshesShareOneFetch) {
+  absl::Notification refresh_started;
+  absl::Notification release_refresh;
+  EXPECT_CALL(*public_key_fetcher_, Refresh).WillOnce([&]() {
+    refresh_started.Notify();
+    release_refresh.WaitForNotification();
+    return absl::OkStatus();
+  });
+  EXPECT_CALL(*private_key_fetcher_, Refresh)
+      .WillOnce(Return(absl::UnavailableError("unavailable")));
+
+  std::unique_ptr<SharedKeyFetcherManager> first =
+      CreateManager(DefaultConfig());
+  std::unique_ptr<SharedKeyFetcherManager> second =
+      CreateManager(DefaultConfig());
+  absl::Status first_status;
+  absl::Status second_status;
+  std::thread first_refresh([&]() { first_status = first->Refresh(); });
+  refresh_started.WaitForNotification();
+  std::thread second_refresh([&]() { second_status = second->Refresh(); });
+  // Give the second refresh time to join the one in flight.
+  absl::SleepFor(absl::Milliseconds(50));
+  release_refresh.Notify();
+  first_refresh.join();
+  second_refresh.join();
+
+  EXPECT_EQ(first_status.code(), absl::StatusCode::kUnavailable);
+  EXPECT_EQ(second_status.code(), absl::StatusCode::kUnavailable);
+}
+
+}  // namespace
+}  // namespace privacy_sandbox::server_common
@@ -0,0 +1,265 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/cpp/encryption/key_fetcher/src/shared_memory_key_snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "absl/time/clock.h"
+#include "include/gtest/gtest.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+using ::google::cmrt::sdk::public_key_service::v1::PublicKey;
+
+// Returns a segment name that is unique to the test process and `test_name`.
+std::string SegmentName(absl::string_view test_name) {
+  return absl::StrCat("/key_snapshot_test_", getpid(), "_", test_name);
+}
+
+PublicKey CreatePublicKey(absl::string_view key_id) {
+  PublicKey key;
+  key.set_key_id(std::string(key_id));
+  key.set_public_key("public_key");
+  return key;
+}
+
+TEST(SharedMemoryKeySnapshotTest, ServesPublishedKeys) {
+  const std::string name = SegmentName("serves");
+  absl::StatusOr<std::unique_ptr<SharedMemoryKeySnapshotWriter>> writer =
+      SharedMemoryKeySnapshotWriter::Create(name, 4096);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  absl::StatusOr<std::unique_ptr<SharedMemoryKeyFetcherManager>> reader =
+      SharedMemoryKeyFetcherManager::Open(name);
+  ASSERT_TRUE(reader.ok()) << reader.status();
+
+  const absl::Time creation_time = absl::FromUnixSeconds(1700000000);
+  KeySnapshot snapshot;
+  snapshot.public_keys.push_back(CreatePublicKey("64"));
+  snapshot.private_keys.push_back({"64", "private_key_a", creation_time});
+  snapshot.private_keys.push_back({"65", "private_key_b", creation_time});
+  ASSERT_TRUE((*writer)->Publish(snapshot).ok());
+
+  std::optional<PrivateKey> private_key = (*reader)->GetPrivateKey("65");
+  ASSERT_TRUE(private_key.has_value());
+  EXPECT_EQ(private_key->key_id, "65");
+  EXPECT_EQ(private_key->private_key, "private_key_b");
+  EXPECT_EQ(private_key->creation_time, creation_time);
+  EXPECT_FALSE((*reader)->GetPrivateKey("66").has_value());
+
+  absl::StatusOr<PublicKey> public_key = (*reader)->GetPublicKey();
+  ASSERT_TRUE(public_key.ok()) << public_key.status();
+  EXPECT_EQ(public_key->key_id(), "64");
+  EXPECT_EQ(public_key->public_key(), "public_key");
+}
+
+TEST(SharedMemoryKeySnapshotTest, ServesLatestSnapshot) {
+  const std::string name = SegmentName("latest");
+  absl::StatusOr<std::unique_ptr<SharedMemoryKeySnapshotWriter>> writer =
+      SharedMemoryKeySnapshotWriter::Create(name, 4096);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  absl::StatusOr<std::unique_ptr<SharedMemoryKeyFetcherManager>> reader =
+      SharedMemoryKeyFetcherManager::Open(name);
+  ASSERT_TRUE(reader.ok()) << reader.status();
+
+  KeySnapshot snapshot;
+  snapshot.private_keys.push_back({"64", "old", absl::Now()});
+  ASSERT_TRUE((*writer)->Publish(snapshot).ok());
+  const uint64_t first_version = (*reader)->GetVersion();
+  snapshot.private_keys[0].private_key = "new";
+  ASSERT_TRUE((*writer)->Publish(snapshot).ok());
+
+  EXPECT_GT((*reader)->GetVersion(), first_version);
+  EXPECT_EQ((*reader)->GetPrivateKey("64")->private_key, "new");
+}
+
+TEST(SharedMemoryKeySnapshotTest, NothingPublishedYet) {
+  const std::string name = SegmentName("empty");
+  absl::StatusOr<std::unique_ptr<SharedMemoryKeySnapshotWriter>> writer =
+      SharedMemoryKeySnapshotWriter::Create(name, 4096);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  absl::StatusOr<std::unique_ptr<SharedMemoryKeyFetcherManager>> reader =
+      SharedMemoryKeyFetcherManager::Open(name);
+  ASSERT_TRUE(reader.ok()) << reader.status();
+
+  EXPECT_EQ((*reader)->GetVersion(), 0);
+  EXPECT_FALSE((*reader)->GetPrivateKey("64").has_value());
+  EXPECT_EQ((*reader)->GetPublicKey().status().code(),
+            absl::StatusCode::kFailedPrecondition);
+}
+
+TEST(SharedMemoryKeySnapshotTest, PublishFailsWhenSnapshotDoesNotFit) {
+  absl::StatusOr<std::unique_ptr<SharedMemoryKeySnapshotWriter>> writer =
+      SharedMemoryKeySnapshotWriter::Create(SegmentName("small"), 16);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+
+  KeySnapshot snapshot;
+  snapshot.private_keys.push_back({"64", "private_key", absl::Now()});
+  EXPECT_EQ((*writer)->Publish(snapshot).code(),
+            absl::StatusCode::kResourceExhausted);
+}
+
+TEST(SharedMemoryKeySnapshotTest, OpenFailsWithoutWriter) {
+  EXPECT_FALSE(
+      SharedMemoryKeyFetcherManager::Open(SegmentName("missing")).ok());
+}
+
+TEST(SharedMemoryKeySnapshotTest, SegmentIsPrivateToUser) {
+  const std::string name = SegmentName("private");
+  absl::StatusOr<std::unique_ptr<SharedMemoryKeySnapshotWriter>> writer =
+      SharedMemoryKeySnapshotWriter::Create(name, 4096);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  ASSERT_GE(fd, 0);
+  struct stat segment_stat;
+  ASSERT_EQ(fstat(fd, &segment_stat), 0);
+  close(fd);
+  EXPECT_EQ(segment_stat.st_uid, geteuid());
+  EXPECT_EQ(segment_stat.st_mode & (S_IRWXG | S_IRWXO), 0);
+}
+
+TEST(SharedMemoryKeySnapshotTest, OpenFailsForSegmentAccessibleToOthers) {
+  const std::string name = SegmentName("shared");
+  absl::StatusOr<std::unique_ptr<SharedMemoryKeySnapshotWriter>> writer =
+      SharedMemoryKeySnapshotWriter::Create(name, 4096);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(fchmod(fd, 0644), 0);
+  close(fd);
+
+  EXPECT_EQ(SharedMemoryKeyFetcherManager::Open(name).status().code(),
+            absl::StatusCode::kPermissionDenied);
+}
+
+TEST(SharedMemoryKeySnapshotTest, ReaderSwitchesToRestartedWriter) {
+  const std::string name = SegmentName("restarted");
+  absl::StatusOr<std::unique_ptr<SharedMemoryKeySnapshotWriter>> writer =
+      SharedMemoryKeySnapshotWriter::Create(name, 4096);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  KeySnapshot snapshot;
+  snapshot.private_keys.push_back({"64", "old", absl::Now()});
+  ASSERT_TRUE((*writer)->Publish(snapshot).ok());
+  absl::StatusOr<std::unique_ptr<SharedMemoryKeyFetcherManager>> reader =
+      SharedMemoryKeyFetcherManager::Open(name);
+  ASSERT_TRUE(reader.ok()) << reader.status();
+
+  // The last snapshot is still served while there is no writer.
+  writer->reset();
+  EXPECT_EQ((*reader)->GetPrivateKey("64")->private_key, "old");
+
+  writer = SharedMemoryKeySnapshotWriter::Create(name, 8192);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  snapshot.private_keys[0].private_key = "new";
+  ASSERT_TRUE((*writer)->Publish(snapshot).ok());
+  // Re-opening is rate-limited after the failed attempt above.
+  absl::SleepFor(absl::Milliseconds(200));
+
+  EXPECT_EQ((*reader)->GetPrivateKey("64")->private_key, "new");
+}
+
+TEST(SharedMemoryKeySnapshotTest, NewWriterReplacesSegmentOfStaleWriter) {
+  const std::string name = SegmentName("replaced");
+  absl::StatusOr<std::unique_ptr<SharedMemoryKeySnapshotWriter>> stale_writer =
+      SharedMemoryKeySnapshotWriter::Create(name, 4096);
+  ASSERT_TRUE(stale_writer.ok()) << stale_writer.status();
+  KeySnapshot snapshot;
+  snapshot.private_keys.push_back({"64", "old", absl::Now()});
+  ASSERT_TRUE((*stale_writer)->Publish(snapshot).ok());
+  absl::StatusOr<std::unique_ptr<SharedMemoryKeyFetcherManager>> reader =
+      SharedMemoryKeyFetcherManager::Open(name);
+  ASSERT_TRUE(reader.ok()) << reader.status();
+
+  absl::StatusOr<std::unique_ptr<SharedMemoryKeySnapshotWriter>> writer =
+      SharedMemoryKeySnapshotWriter::Create(name, 4096);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  snapshot.private_keys[0].private_key = "new";
+  ASSERT_TRUE((*writer)->Publish(snapshot).ok());
+
+  EXPECT_EQ((*reader)->GetPrivateKey("64")->private_key, "new");
+  EXPECT_EQ((*stale_writer)->Publish(snapshot).code(),
+            absl::StatusCode::kFailedPrecondition);
+  // Destroying the stale writer leaves the segment of the new one in place.
+  stale_writer->reset();
+  EXPECT_TRUE(SharedMemoryKeyFetcherManager::Open(name).ok());
+}
+
+TEST(SharedMemoryKeySnapshotTest, StaleWriterKeepsSegmentOfUnflaggingWriter) {
+  const std::string name = SegmentName("overlap");
+  absl::StatusOr<std::unique_ptr<SharedMemoryKeySnapshotWriter>> stale_writer =
+      SharedMemoryKeySnapshotWriter::Create(name, 4096);
+  ASSERT_TRUE(stale_writer.ok()) << stale_writer.status();
+  // A new writer that unlinked the old segment before getting to retire it.
+  ASSERT_EQ(shm_unlink(name.c_str()), 0);
+  absl::StatusOr<std::unique_ptr<SharedMemoryKeySnapshotWriter>> writer =
+      SharedMemoryKeySnapshotWriter::Create(name, 4096);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+
+  stale_writer->reset();
+  KeySnapshot snapshot;
+  snapshot.private_keys.push_back({"64", "new", absl::Now()});
+  ASSERT_TRUE((*writer)->Publish(snapshot).ok());
+  absl::StatusOr<std::unique_ptr<SharedMemoryKeyFetcherManager>> reader =
+      SharedMemoryKeyFetcherManager::Open(name);
+  ASSERT_TRUE(reader.ok()) << reader.status();
+  EXPECT_EQ((*reader)->GetPrivateKey("64")->private_key, "new");
+}
+
+TEST(SharedMemoryKeySnapshotTest, ConcurrentReadsSeeWholeSnapshots) {
+  const std::string name = SegmentName("concurrent");
+  absl::StatusOr<std::unique_ptr<SharedMemoryKeySnapshotWriter>> writer =
+      SharedMemoryKeySnapshotWriter::Create(name, 4096);
+  ASSERT_TRUE(writer.ok()) << writer.status();
+  absl::StatusOr<std::unique_ptr<SharedMemoryKeyFetcherManager>> reader =
+      SharedMemoryKeyFetcherManager::Open(name);
+  ASSERT_TRUE(reader.ok()) << reader.status();
+
+  // Every snapshot holds a key made of a single repeated character, so a torn
+  // read would show up as a mix of characters.
+  std::atomic<bool> done = false;
+  std::thread publisher([&]() {
+    for (int i = 0; i < 2000; ++i) {
+      KeySnapshot snapshot;
+      snapshot.private_keys.push_back(
+          {"64", std::string(1000, 'a' + i % 26), absl::Now()});
+      EXPECT_TRUE((*writer)->Publish(snapshot).ok());
+    }
+    done = true;
+  });
+  while (!done) {
+    std::optional<PrivateKey> key = (*reader)->GetPrivateKey("64");
+    if (!key.has_value()) {
+      continue;
+    }
+    ASSERT_EQ(key->private_key.size(), 1000);
+    EXPECT_EQ(key->private_key.find_first_not_of(key->private_key[0]),
+              std::string::npos);
+  }
+  publisher.join();
+}
+
+}  // namespace
+}  // namespace privacy_sandbox::server_common
@@ -0,0 +1,104 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Run with: bazel run -c opt //src/cpp/telemetry:metrics_recorder_benchmark
+
+#include <chrono>
+#include <memory>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/time/time.h"
+#include "benchmark/benchmark.h"
+#include "opentelemetry/metrics/provider.h"
+#include "opentelemetry/sdk/metrics/meter_provider.h"
+#include "opentelemetry/sdk/metrics/metric_reader.h"
+#include "opentelemetry/sdk/metrics/view/view_registry.h"
+#include "src/cpp/telemetry/metrics_recorder.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+namespace metric_sdk = opentelemetry::sdk::metrics;
+
+// Collects nothing, so that the benchmarks measure the recording path without
+// any exporter.
+class NoopMetricReader : public metric_sdk::MetricReader {
+ public:
+  metric_sdk::AggregationTemporality GetAggregationTemporality(
+      metric_sdk::InstrumentType) const noexcept override {
+    return metric_sdk::AggregationTemporality::kCumulative;
+  }
+
+ private:
+  bool OnForceFlush(std::chrono::microseconds) noexcept override {
+    return true;
+  }
+  bool OnShutDown(std::chrono::microseconds) noexcept override { return true; }
+};
+
+MetricsRecorder& GetMetricsRecorder() {
+  static MetricsRecorder* const metrics_recorder = [] {
+    auto provider = std::make_shared<metric_sdk::MeterProvider>(
+        std::make_unique<metric_sdk::ViewRegistry>());
+    provider->AddMetricReader(std::make_shared<NoopMetricReader>());
+    opentelemetry::metrics::Provider::SetMeterProvider(
+        std::shared_ptr<opentelemetry::metrics::MeterProvider>(provider));
+    return MetricsRecorder::Create("benchmark", "1").release();
+  }();
+  return *metrics_recorder;
+}
+
+void BM_IncrementEventCounter(benchmark::State& state) {
+  MetricsRecorder& metrics_recorder = GetMetricsRecorder();
+  for (auto _ : state) {
+    metrics_recorder.IncrementEventCounter("event");
+  }
+}
+
+void BM_IncrementEventStatus(benchmark::State& state) {
+  MetricsRecorder& metrics_recorder = GetMetricsRecorder();
+  const absl::Status status = absl::InvalidArgumentError("benchmark");
+  for (auto _ : state) {
+    metrics_recorder.IncrementEventStatus("event", status);
+  }
+}
+
+void BM_RecordLatency(benchmark::State& state) {
+  MetricsRecorder& metrics_recorder = GetMetricsRecorder();
+  for (auto _ : state) {
+    metrics_recorder.RecordLatency("event", absl::Microseconds(250));
+  }
+}
+
+void BM_RecordHistogramEvent(benchmark::State& state) {
+  MetricsRecorder& metrics_recorder = GetMetricsRecorder();
+  metrics_recorder.RegisterHistogram("size", "Size of something.", "byte",
+                                     {1024, 4096, 16384, 65536});
+  int64_t value = 0;
+  for (auto _ : state) {
+    metrics_recorder.RecordHistogramEvent("size", value);
+    value = (value + 997) % 100'000;
+  }
+}
+
+BENCHMARK(BM_IncrementEventCounter)->ThreadRange(1, 8);
+BENCHMARK(BM_IncrementEventStatus)->ThreadRange(1, 8);
+BENCHMARK(BM_RecordLatency)->ThreadRange(1, 8);
+BENCHMARK(BM_RecordHistogramEvent)->ThreadRange(1, 8);
+
+}  // namespace
+}  // namespace privacy_sandbox::server_common
+
+BENCHMARK_MAIN();
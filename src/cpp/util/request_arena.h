@@ -0,0 +1,76 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_CPP_UTIL_REQUEST_ARENA_H_
+#define SRC_CPP_UTIL_REQUEST_ARENA_H_
+
+#include <cstddef>
+#include <memory_resource>
+
+namespace privacy_sandbox::server_common {
+
+// Bump allocator for the transient buffers of one request, e.g. the decoded
+// payload and the decompressed compression groups. Allocations only move a
+// pointer forward, deallocation is a no-op, and all memory is released at once
+// when the arena is destroyed or reset. Memory is taken from `upstream` in
+// blocks, starting with `initial_block_size` and growing geometrically, so a
+// request of typical size costs one upstream allocation.
+//
+// Pass the arena as the std::pmr::memory_resource of the functions and
+// containers handling the request. Everything allocated from it must not
+// outlive it. Not thread-safe; use one arena per request.
+class RequestArena final : public std::pmr::memory_resource {
+ public:
+  static constexpr size_t kDefaultInitialBlockSize = 64 * 1024;
+
+  explicit RequestArena(
+      size_t initial_block_size = kDefaultInitialBlockSize,
+      std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+      : resource_(initial_block_size, upstream) {}
+
+  RequestArena(const RequestArena&) = delete;
+  RequestArena& operator=(const RequestArena&) = delete;
+
+  // Bytes handed out since construction or the last Reset(). Useful to size
+  // `initial_block_size`.
+  size_t bytes_allocated() const { return bytes_allocated_; }
+
+  // Releases all memory. Everything allocated from the arena is invalidated.
+  void Reset() {
+    resource_.release();
+    bytes_allocated_ = 0;
+  }
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    bytes_allocated_ += bytes;
+    return resource_.allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void*, size_t, size_t) override {}
+
+  bool do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  std::pmr::monotonic_buffer_resource resource_;
+  size_t bytes_allocated_ = 0;
+};
+
+}  // namespace privacy_sandbox::server_common
+
+#endif  // SRC_CPP_UTIL_REQUEST_ARENA_H_
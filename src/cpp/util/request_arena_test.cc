@@ -0,0 +1,106 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/cpp/util/request_arena.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+// Counts the allocations the arena makes from its upstream resource.
+class CountingResource : public std::pmr::memory_resource {
+ public:
+  int allocations() const { return allocations_; }
+  int outstanding() const { return outstanding_; }
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    ++allocations_;
+    ++outstanding_;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    --outstanding_;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+  int allocations_ = 0;
+  int outstanding_ = 0;
+};
+
+TEST(RequestArenaTest, ServesSmallAllocationsFromOneBlock) {
+  CountingResource upstream;
+  {
+    RequestArena arena(/*initial_block_size=*/4096, &upstream);
+    std::pmr::vector<std::pmr::string> strings(&arena);
+    for (int i = 0; i < 16; ++i) {
+      strings.emplace_back(100, 'a' + i);
+    }
+    EXPECT_EQ(std::string_view(strings[15]), std::string(100, 'a' + 15));
+    EXPECT_EQ(upstream.allocations(), 1);
+    EXPECT_GE(arena.bytes_allocated(), 16 * 100);
+  }
+  EXPECT_EQ(upstream.outstanding(), 0);
+}
+
+TEST(RequestArenaTest, GrowsBeyondInitialBlock) {
+  CountingResource upstream;
+  RequestArena arena(/*initial_block_size=*/1024, &upstream);
+  std::pmr::string large(&arena);
+  large.assign(64 * 1024, 'x');
+  EXPECT_EQ(large.size(), 64 * 1024);
+  EXPECT_GE(upstream.allocations(), 1);
+  EXPECT_GE(arena.bytes_allocated(), 64 * 1024);
+}
+
+TEST(RequestArenaTest, RespectsAlignment) {
+  RequestArena arena;
+  static_cast<void>(arena.allocate(1, 1));
+  void* p = arena.allocate(64, 64);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % 64, 0);
+}
+
+TEST(RequestArenaTest, ResetReleasesMemory) {
+  CountingResource upstream;
+  RequestArena arena(/*initial_block_size=*/1024, &upstream);
+  static_cast<void>(arena.allocate(512, alignof(std::max_align_t)));
+  EXPECT_EQ(upstream.outstanding(), 1);
+  arena.Reset();
+  EXPECT_EQ(upstream.outstanding(), 0);
+  EXPECT_EQ(arena.bytes_allocated(), 0);
+}
+
+TEST(RequestArenaTest, IsOnlyEqualToItself) {
+  RequestArena arena;
+  RequestArena other;
+  EXPECT_TRUE(arena.is_equal(arena));
+  EXPECT_FALSE(arena.is_equal(other));
+}
+
+}  // namespace
+}  // namespace privacy_sandbox::server_common
@@ -0,0 +1,270 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "testing/benchmark/benchmark_compare.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "src/cpp/communication/json_utils.h"
+
+namespace privacy_sandbox::server_common::benchmark {
+namespace {
+
+// Two-sided 95% critical values of Student's t distribution for 1 to 30
+// degrees of freedom.
+constexpr double kTCritical95[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+double TCritical95(double degrees_of_freedom) {
+  if (degrees_of_freedom < 1) {
+    return kTCritical95[0];
+  }
+  if (degrees_of_freedom <= std::size(kTCritical95)) {
+    // Rounding down is conservative.
+    return kTCritical95[static_cast<int>(degrees_of_freedom) - 1];
+  }
+  if (degrees_of_freedom <= 60) {
+    return 2.021;
+  }
+  if (degrees_of_freedom <= 120) {
+    return 2.000;
+  }
+  return 1.980;
+}
+
+double NanosPerUnit(absl::string_view time_unit) {
+  if (time_unit == "us") {
+    return 1e3;
+  }
+  if (time_unit == "ms") {
+    return 1e6;
+  }
+  if (time_unit == "s") {
+    return 1e9;
+  }
+  return 1;
+}
+
+struct Samples {
+  std::vector<double> values;
+  bool failed = false;
+
+  double Mean() const {
+    double sum = 0;
+    for (double value : values) {
+      sum += value;
+    }
+    return sum / values.size();
+  }
+
+  // Unbiased sample variance.
+  double Variance() const {
+    const double mean = Mean();
+    double sum = 0;
+    for (double value : values) {
+      sum += (value - mean) * (value - mean);
+    }
+    return sum / (values.size() - 1);
+  }
+};
+
+// Groups the repetitions of every benchmark, keeping the order in which the
+// benchmarks first appear.
+std::vector<std::pair<std::string, Samples>> CollectSamples(
+    const BenchmarkResults& results, const CompareOptions& options) {
+  std::vector<std::pair<std::string, Samples>> samples;
+  absl::flat_hash_map<std::string, int> index;
+  for (const BenchmarkRun& run : results.benchmarks()) {
+    if (run.run_type() == "aggregate") {
+      continue;
+    }
+    const std::string& name = run.run_name().empty() ? run.name()
+                                                     : run.run_name();
+    auto [it, inserted] = index.try_emplace(name, samples.size());
+    if (inserted) {
+      samples.emplace_back(name, Samples());
+    }
+    Samples& benchmark_samples = samples[it->second].second;
+    if (run.error_occurred()) {
+      benchmark_samples.failed = true;
+      continue;
+    }
+    const double time =
+        options.use_real_time ? run.real_time() : run.cpu_time();
+    benchmark_samples.values.push_back(time * NanosPerUnit(run.time_unit()));
+  }
+  return samples;
+}
+
+BenchmarkComparison Compare(const std::string& name, const Samples& baseline,
+                            const Samples& current,
+                            const CompareOptions& options) {
+  BenchmarkComparison comparison;
+  comparison.name = name;
+  comparison.baseline_samples = baseline.values.size();
+  comparison.current_samples = current.values.size();
+  if (baseline.values.empty()) {
+    comparison.verdict = Verdict::kNew;
+    return comparison;
+  }
+  comparison.baseline_mean = baseline.Mean();
+  if (current.failed || current.values.empty()) {
+    comparison.verdict = Verdict::kMissing;
+    return comparison;
+  }
+  comparison.current_mean = current.Mean();
+  const double difference = comparison.current_mean - comparison.baseline_mean;
+  comparison.change = difference / comparison.baseline_mean;
+  comparison.change_low = comparison.change;
+  comparison.change_high = comparison.change;
+
+  const int n1 = baseline.values.size();
+  const int n2 = current.values.size();
+  if (n1 < 2 || n2 < 2) {
+    comparison.verdict = Verdict::kInsufficientSamples;
+    return comparison;
+  }
+  // Welch's t-test, which does not assume equal variances.
+  const double v1 = baseline.Variance() / n1;
+  const double v2 = current.Variance() / n2;
+  const double standard_error = std::sqrt(v1 + v2);
+  const double degrees_of_freedom =
+      standard_error == 0
+          ? n1 + n2 - 2
+          : std::pow(v1 + v2, 2) / (v1 * v1 / (n1 - 1) + v2 * v2 / (n2 - 1));
+  const double margin = TCritical95(degrees_of_freedom) * standard_error;
+  comparison.change_low = (difference - margin) / comparison.baseline_mean;
+  comparison.change_high = (difference + margin) / comparison.baseline_mean;
+
+  if (comparison.change > options.threshold && comparison.change_low > 0) {
+    comparison.verdict = Verdict::kRegressed;
+  } else if (comparison.change < -options.threshold &&
+             comparison.change_high < 0) {
+    comparison.verdict = Verdict::kImproved;
+  }
+  return comparison;
+}
+
+std::string FormatNanos(double nanos) {
+  if (nanos >= 1e9) {
+    return absl::StrFormat("%.3fs", nanos / 1e9);
+  }
+  if (nanos >= 1e6) {
+    return absl::StrFormat("%.3fms", nanos / 1e6);
+  }
+  if (nanos >= 1e3) {
+    return absl::StrFormat("%.3fus", nanos / 1e3);
+  }
+  return absl::StrFormat("%.1fns", nanos);
+}
+
+}  // namespace
+
+absl::string_view VerdictName(Verdict verdict) {
+  switch (verdict) {
+    case Verdict::kUnchanged:
+      return "unchanged";
+    case Verdict::kImproved:
+      return "improved";
+    case Verdict::kRegressed:
+      return "REGRESSED";
+    case Verdict::kNew:
+      return "new";
+    case Verdict::kMissing:
+      return "MISSING";
+    case Verdict::kInsufficientSamples:
+      return "TOO FEW SAMPLES";
+  }
+  return "unknown";
+}
+
+absl::StatusOr<BenchmarkResults> ParseBenchmarkResults(absl::string_view json) {
+  return JsonToProto<BenchmarkResults>(json);
+}
+
+std::vector<BenchmarkComparison> CompareBenchmarks(
+    const BenchmarkResults& baseline, const BenchmarkResults& current,
+    const CompareOptions& options) {
+  std::vector<std::pair<std::string, Samples>> current_samples =
+      CollectSamples(current, options);
+  absl::flat_hash_map<std::string, const Samples*> current_by_name;
+  for (const auto& [name, samples] : current_samples) {
+    current_by_name[name] = &samples;
+  }
+
+  std::vector<BenchmarkComparison> comparisons;
+  absl::flat_hash_set<std::string> in_baseline;
+  const Samples no_samples;
+  for (const auto& [name, samples] : CollectSamples(baseline, options)) {
+    in_baseline.insert(name);
+    const auto it = current_by_name.find(name);
+    comparisons.push_back(
+        Compare(name, samples,
+                it == current_by_name.end() ? no_samples : *it->second,
+                options));
+  }
+  for (const auto& [name, samples] : current_samples) {
+    if (!in_baseline.contains(name)) {
+      comparisons.push_back(Compare(name, no_samples, samples, options));
+    }
+  }
+  return comparisons;
+}
+
+std::string FormatComparisons(
+    const std::vector<BenchmarkComparison>& comparisons) {
+  size_t name_width = 9;
+  for (const BenchmarkComparison& comparison : comparisons) {
+    name_width = std::max(name_width, comparison.name.size());
+  }
+  std::string output = absl::StrFormat(
+      "%-*s %12s %12s %8s %20s  %s\n", name_width, "benchmark", "baseline",
+      "current", "change", "95% interval", "verdict");
+  for (const BenchmarkComparison& comparison : comparisons) {
+    const bool has_both = comparison.verdict != Verdict::kNew &&
+                          comparison.verdict != Verdict::kMissing;
+    absl::StrAppend(
+        &output,
+        absl::StrFormat(
+            "%-*s %12s %12s %8s %20s  %s\n", name_width, comparison.name,
+            comparison.baseline_samples > 0
+                ? FormatNanos(comparison.baseline_mean)
+                : "-",
+            has_both ? FormatNanos(comparison.current_mean) : "-",
+            has_both ? absl::StrFormat("%+.1f%%", 100 * comparison.change)
+                     : "-",
+            has_both && comparison.verdict != Verdict::kInsufficientSamples
+                ? absl::StrFormat("[%+.1f%%, %+.1f%%]",
+                                  100 * comparison.change_low,
+                                  100 * comparison.change_high)
+                : "-",
+            VerdictName(comparison.verdict)));
+  }
+  return output;
+}
+
+}  // namespace privacy_sandbox::server_common::benchmark
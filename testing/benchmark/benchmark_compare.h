@@ -0,0 +1,90 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TESTING_BENCHMARK_BENCHMARK_COMPARE_H_
+#define TESTING_BENCHMARK_BENCHMARK_COMPARE_H_
+
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "testing/benchmark/benchmark_results.pb.h"
+
+namespace privacy_sandbox::server_common::benchmark {
+
+struct CompareOptions {
+  // Relative slowdown of the mean that counts as a regression, e.g. 0.05 for
+  // 5%.
+  double threshold = 0.05;
+  // Compares wall time instead of CPU time. Useful for multi-threaded
+  // benchmarks.
+  bool use_real_time = false;
+};
+
+enum class Verdict {
+  kUnchanged,
+  kImproved,
+  kRegressed,
+  // Only in the current run; add it to the baseline.
+  kNew,
+  // Only in the baseline, or failed in the current run.
+  kMissing,
+  // Fewer than two samples on either side, so there is no confidence
+  // interval to judge the change by. Rerun with --benchmark_repetitions=2 or
+  // more.
+  kInsufficientSamples,
+};
+
+absl::string_view VerdictName(Verdict verdict);
+
+struct BenchmarkComparison {
+  std::string name;
+  int baseline_samples = 0;
+  int current_samples = 0;
+  // Mean time per iteration in nanoseconds.
+  double baseline_mean = 0;
+  double current_mean = 0;
+  // Relative change of the mean, positive if the current run is slower.
+  double change = 0;
+  // 95% confidence interval of `change`. Only set with at least two samples
+  // on both sides, otherwise equal to `change` and the verdict is
+  // kInsufficientSamples.
+  double change_low = 0;
+  double change_high = 0;
+  Verdict verdict = Verdict::kUnchanged;
+};
+
+// Parses the output of a benchmark run with --benchmark_format=json.
+absl::StatusOr<BenchmarkResults> ParseBenchmarkResults(absl::string_view json);
+
+// Compares every benchmark in `current` against `baseline`. Repetitions of a
+// benchmark (--benchmark_repetitions) are treated as independent samples, and
+// aggregates are ignored. A benchmark only regresses or improves if its mean
+// changed by more than `options.threshold` and the whole confidence interval of
+// the change, based on Welch's t-test, is on the same side of zero. That keeps
+// noisy benchmarks from failing the comparison.
+std::vector<BenchmarkComparison> CompareBenchmarks(
+    const BenchmarkResults& baseline, const BenchmarkResults& current,
+    const CompareOptions& options);
+
+// Formats `comparisons` as a table, one line per benchmark.
+std::string FormatComparisons(
+    const std::vector<BenchmarkComparison>& comparisons);
+
+}  // namespace privacy_sandbox::server_common::benchmark
+
+#endif  // TESTING_BENCHMARK_BENCHMARK_COMPARE_H_
@@ -0,0 +1,92 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Compares two outputs of a benchmark binary run with
+// --benchmark_out_format=json and prints the change of every benchmark.
+// Exits with 1 if any benchmark regressed, went missing or has fewer than two
+// samples on either side, and with 2 if the inputs could not be read.
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "testing/benchmark/benchmark_compare.h"
+
+ABSL_FLAG(std::string, baseline, "", "JSON results to compare against.");
+ABSL_FLAG(std::string, current, "", "JSON results of the current run.");
+ABSL_FLAG(double, threshold, 0.05,
+          "Relative slowdown of a benchmark that counts as a regression.");
+ABSL_FLAG(bool, use_real_time, false,
+          "Compare wall time instead of CPU time.");
+
+namespace privacy_sandbox::server_common::benchmark {
+namespace {
+
+absl::StatusOr<BenchmarkResults> ReadBenchmarkResults(const std::string& path) {
+  std::ifstream file(path);
+  if (!file) {
+    return absl::NotFoundError(absl::StrCat("Unable to open ", path));
+  }
+  std::stringstream json;
+  json << file.rdbuf();
+  absl::StatusOr<BenchmarkResults> results = ParseBenchmarkResults(json.str());
+  if (!results.ok()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Unable to parse ", path, ": ", results.status().message()));
+  }
+  return results;
+}
+
+}  // namespace
+}  // namespace privacy_sandbox::server_common::benchmark
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  namespace benchmark = privacy_sandbox::server_common::benchmark;
+
+  const auto baseline =
+      benchmark::ReadBenchmarkResults(absl::GetFlag(FLAGS_baseline));
+  if (!baseline.ok()) {
+    std::cerr << baseline.status() << std::endl;
+    return 2;
+  }
+  const auto current =
+      benchmark::ReadBenchmarkResults(absl::GetFlag(FLAGS_current));
+  if (!current.ok()) {
+    std::cerr << current.status() << std::endl;
+    return 2;
+  }
+
+  benchmark::CompareOptions options;
+  options.threshold = absl::GetFlag(FLAGS_threshold);
+  options.use_real_time = absl::GetFlag(FLAGS_use_real_time);
+  const std::vector<benchmark::BenchmarkComparison> comparisons =
+      benchmark::CompareBenchmarks(*baseline, *current, options);
+  std::cout << benchmark::FormatComparisons(comparisons);
+
+  bool failed = false;
+  for (const auto& comparison : comparisons) {
+    failed |= comparison.verdict == benchmark::Verdict::kRegressed ||
+              comparison.verdict == benchmark::Verdict::kMissing ||
+              comparison.verdict == benchmark::Verdict::kInsufficientSamples;
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,231 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "testing/benchmark/benchmark_compare.h"
+
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace privacy_sandbox::server_common::benchmark {
+namespace {
+
+using ::testing::DoubleNear;
+using ::testing::HasSubstr;
+using ::testing::SizeIs;
+
+void AddRepetitions(const std::string& name, const std::vector<double>& times,
+                    BenchmarkResults& results) {
+  for (double time : times) {
+    BenchmarkRun* run = results.add_benchmarks();
+    run->set_name(name);
+    run->set_run_name(name);
+    run->set_run_type("iteration");
+    run->set_cpu_time(time);
+    run->set_real_time(time);
+    run->set_time_unit("ns");
+  }
+}
+
+TEST(BenchmarkCompareTest, ParsesGoogleBenchmarkOutput) {
+  const auto results = ParseBenchmarkResults(R"json({
+    "context": {
+      "date": "2023-06-01T10:00:00+00:00",
+      "host_name": "host",
+      "num_cpus": 8,
+      "mhz_per_cpu": 2200,
+      "caches": [{"type": "Data", "level": 1, "size": 32768}],
+      "library_build_type": "release"
+    },
+    "benchmarks": [
+      {
+        "name": "BM_Compress/1024",
+        "family_index": 0,
+        "run_name": "BM_Compress/1024",
+        "run_type": "iteration",
+        "repetitions": 2,
+        "repetition_index": 0,
+        "iterations": 1000,
+        "real_time": 1.5,
+        "cpu_time": 1.25,
+        "time_unit": "us",
+        "bytes_per_second": 1.0e9
+      },
+      {
+        "name": "BM_Compress/1024_mean",
+        "run_name": "BM_Compress/1024",
+        "run_type": "aggregate",
+        "aggregate_name": "mean",
+        "real_time": 1.5,
+        "cpu_time": 1.25,
+        "time_unit": "us"
+      }
+    ]
+  })json");
+  ASSERT_TRUE(results.ok()) << results.status();
+  EXPECT_EQ(results->context().num_cpus(), 8);
+  ASSERT_THAT(results->benchmarks(), SizeIs(2));
+  EXPECT_EQ(results->benchmarks(0).run_name(), "BM_Compress/1024");
+  EXPECT_EQ(results->benchmarks(0).cpu_time(), 1.25);
+  EXPECT_EQ(results->benchmarks(1).aggregate_name(), "mean");
+}
+
+TEST(BenchmarkCompareTest, RejectsMalformedJson) {
+  EXPECT_FALSE(ParseBenchmarkResults("{\"benchmarks\": [").ok());
+}
+
+TEST(BenchmarkCompareTest, DetectsRegression) {
+  BenchmarkResults baseline;
+  AddRepetitions("BM_A", {100, 101, 99, 100, 100}, baseline);
+  BenchmarkResults current;
+  AddRepetitions("BM_A", {120, 121, 119, 120, 120}, current);
+
+  const auto comparisons = CompareBenchmarks(baseline, current, {});
+  ASSERT_THAT(comparisons, SizeIs(1));
+  EXPECT_EQ(comparisons[0].verdict, Verdict::kRegressed);
+  EXPECT_THAT(comparisons[0].change, DoubleNear(0.2, 1e-9));
+  EXPECT_GT(comparisons[0].change_low, 0.15);
+  EXPECT_LT(comparisons[0].change_high, 0.25);
+  EXPECT_THAT(FormatComparisons(comparisons), HasSubstr("REGRESSED"));
+}
+
+TEST(BenchmarkCompareTest, DetectsImprovement) {
+  BenchmarkResults baseline;
+  AddRepetitions("BM_A", {100, 101, 99}, baseline);
+  BenchmarkResults current;
+  AddRepetitions("BM_A", {50, 51, 49}, current);
+
+  const auto comparisons = CompareBenchmarks(baseline, current, {});
+  ASSERT_THAT(comparisons, SizeIs(1));
+  EXPECT_EQ(comparisons[0].verdict, Verdict::kImproved);
+}
+
+TEST(BenchmarkCompareTest, IgnoresNoise) {
+  BenchmarkResults baseline;
+  AddRepetitions("BM_A", {100, 60, 140, 80, 120}, baseline);
+  BenchmarkResults current;
+  AddRepetitions("BM_A", {150, 70, 110, 90, 130}, current);
+
+  // The mean went up by 10%, but well within the spread of the samples.
+  const auto comparisons = CompareBenchmarks(baseline, current, {});
+  ASSERT_THAT(comparisons, SizeIs(1));
+  EXPECT_GT(comparisons[0].change, 0.05);
+  EXPECT_LT(comparisons[0].change_low, 0);
+  EXPECT_EQ(comparisons[0].verdict, Verdict::kUnchanged);
+}
+
+TEST(BenchmarkCompareTest, IgnoresChangesBelowThreshold) {
+  BenchmarkResults baseline;
+  AddRepetitions("BM_A", {100, 100, 100}, baseline);
+  BenchmarkResults current;
+  AddRepetitions("BM_A", {103, 103, 103}, current);
+
+  EXPECT_EQ(CompareBenchmarks(baseline, current, {})[0].verdict,
+            Verdict::kUnchanged);
+  CompareOptions options;
+  options.threshold = 0.01;
+  EXPECT_EQ(CompareBenchmarks(baseline, current, options)[0].verdict,
+            Verdict::kRegressed);
+}
+
+TEST(BenchmarkCompareTest, ReportsInsufficientSamples) {
+  BenchmarkResults baseline;
+  AddRepetitions("BM_A", {100}, baseline);
+  AddRepetitions("BM_B", {100, 100, 100}, baseline);
+  BenchmarkResults current;
+  AddRepetitions("BM_A", {200, 200, 200}, current);
+  AddRepetitions("BM_B", {200}, current);
+
+  const auto comparisons = CompareBenchmarks(baseline, current, {});
+  ASSERT_THAT(comparisons, SizeIs(2));
+  for (const BenchmarkComparison& comparison : comparisons) {
+    EXPECT_EQ(comparison.verdict, Verdict::kInsufficientSamples)
+        << comparison.name;
+    EXPECT_THAT(comparison.change, DoubleNear(1.0, 1e-9));
+    EXPECT_EQ(comparison.change_low, comparison.change);
+    EXPECT_EQ(comparison.change_high, comparison.change);
+  }
+  EXPECT_THAT(FormatComparisons(comparisons), HasSubstr("TOO FEW SAMPLES"));
+}
+
+TEST(BenchmarkCompareTest, ConvertsTimeUnits) {
+  BenchmarkResults baseline;
+  AddRepetitions("BM_A", {1000, 1000}, baseline);
+  BenchmarkResults current;
+  AddRepetitions("BM_A", {1, 1}, current);
+  current.mutable_benchmarks(0)->set_time_unit("us");
+  current.mutable_benchmarks(1)->set_time_unit("us");
+
+  const auto comparisons = CompareBenchmarks(baseline, current, {});
+  ASSERT_THAT(comparisons, SizeIs(1));
+  EXPECT_EQ(comparisons[0].current_mean, 1000);
+  EXPECT_EQ(comparisons[0].verdict, Verdict::kUnchanged);
+}
+
+TEST(BenchmarkCompareTest, ComparesRealTimeOnRequest) {
+  BenchmarkResults baseline;
+  AddRepetitions("BM_A", {100, 100}, baseline);
+  BenchmarkResults current;
+  AddRepetitions("BM_A", {100, 100}, current);
+  current.mutable_benchmarks(0)->set_real_time(200);
+  current.mutable_benchmarks(1)->set_real_time(200);
+
+  EXPECT_EQ(CompareBenchmarks(baseline, current, {})[0].verdict,
+            Verdict::kUnchanged);
+  CompareOptions options;
+  options.use_real_time = true;
+  EXPECT_EQ(CompareBenchmarks(baseline, current, options)[0].verdict,
+            Verdict::kRegressed);
+}
+
+TEST(BenchmarkCompareTest, IgnoresAggregates) {
+  BenchmarkResults baseline;
+  AddRepetitions("BM_A", {100, 100}, baseline);
+  BenchmarkResults current;
+  AddRepetitions("BM_A", {100, 100}, current);
+  BenchmarkRun* mean = current.add_benchmarks();
+  mean->set_name("BM_A_mean");
+  mean->set_run_name("BM_A");
+  mean->set_run_type("aggregate");
+  mean->set_cpu_time(1000);
+
+  const auto comparisons = CompareBenchmarks(baseline, current, {});
+  ASSERT_THAT(comparisons, SizeIs(1));
+  EXPECT_EQ(comparisons[0].current_samples, 2);
+  EXPECT_EQ(comparisons[0].verdict, Verdict::kUnchanged);
+}
+
+TEST(BenchmarkCompareTest, ReportsNewAndMissingBenchmarks) {
+  BenchmarkResults baseline;
+  AddRepetitions("BM_Removed", {100}, baseline);
+  AddRepetitions("BM_Failed", {100}, baseline);
+  BenchmarkResults current;
+  AddRepetitions("BM_Added", {100}, current);
+  AddRepetitions("BM_Failed", {100}, current);
+  current.mutable_benchmarks(1)->set_error_occurred(true);
+
+  const auto comparisons = CompareBenchmarks(baseline, current, {});
+  ASSERT_THAT(comparisons, SizeIs(3));
+  EXPECT_EQ(comparisons[0].name, "BM_Removed");
+  EXPECT_EQ(comparisons[0].verdict, Verdict::kMissing);
+  EXPECT_EQ(comparisons[1].name, "BM_Failed");
+  EXPECT_EQ(comparisons[1].verdict, Verdict::kMissing);
+  EXPECT_EQ(comparisons[2].name, "BM_Added");
+  EXPECT_EQ(comparisons[2].verdict, Verdict::kNew);
+}
+
+}  // namespace
+}  // namespace privacy_sandbox::server_common::benchmark
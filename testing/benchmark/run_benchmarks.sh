@@ -0,0 +1,110 @@
+#!/bin/bash
+# Copyright 2023 Google LLC
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Runs the benchmarks of this repository and compares them against the
+# baselines in testing/benchmark/baselines. Run with:
+#
+#   bazel run -c opt //testing/benchmark:run_benchmarks -- [flags]
+#
+# Flags:
+#   --update          Overwrite the baselines with the results of this run.
+#   --repetitions=N   Repetitions per benchmark, used as samples for the
+#                     comparison. At least 2, defaults to 5.
+#   --filter=REGEX    Only run matching benchmarks (--benchmark_filter).
+#   --threshold=X     Relative slowdown that counts as a regression.
+#                     Defaults to 0.05.
+#
+# Exits with a non-zero status if any benchmark regressed.
+
+set -o errexit
+set -o nounset
+set -o pipefail
+
+declare UPDATE=0
+declare REPETITIONS=5
+declare FILTER=.
+declare THRESHOLD=0.05
+
+for arg in "$@"; do
+  case "${arg}" in
+    --update) UPDATE=1 ;;
+    --repetitions=*) REPETITIONS="${arg#*=}" ;;
+    --filter=*) FILTER="${arg#*=}" ;;
+    --threshold=*) THRESHOLD="${arg#*=}" ;;
+    *)
+      printf "Unknown flag: %s\n" "${arg}" >&2
+      exit 2
+      ;;
+  esac
+done
+
+# The comparison needs two samples per side for a confidence interval.
+if ! [[ ${REPETITIONS} =~ ^[0-9]+$ ]] || [[ ${REPETITIONS} -lt 2 ]]; then
+  printf "--repetitions must be at least 2, got %s\n" "${REPETITIONS}" >&2
+  exit 2
+fi
+
+if [[ -z ${BUILD_WORKSPACE_DIRECTORY:-} ]]; then
+  printf "Run this script with bazel run.\n" >&2
+  exit 2
+fi
+declare -r BASELINE_DIR="${BUILD_WORKSPACE_DIRECTORY}/testing/benchmark/baselines"
+declare -r COMPARE=testing/benchmark/benchmark_compare_main
+declare -a -r BENCHMARKS=(
+  src/cpp/communication/compression_benchmark
+  src/cpp/communication/encoding_utils_benchmark
+  src/cpp/communication/json_codec_benchmark
+  src/cpp/communication/json_utils_benchmark
+  src/cpp/communication/ohttp_utils_benchmark
+  src/cpp/telemetry/metrics_recorder_benchmark
+  testing/benchmark/scalability_benchmark
+)
+# Multi-threaded benchmarks are compared by wall time, since time spent waiting
+# for a lock does not show up as CPU time.
+declare -A -r USE_REAL_TIME=(
+  [scalability_benchmark]=true
+)
+
+declare RESULTS_DIR
+RESULTS_DIR="$(mktemp --directory)"
+readonly RESULTS_DIR
+trap 'rm -rf "${RESULTS_DIR}"' EXIT
+
+declare -i STATUS=0
+for benchmark in "${BENCHMARKS[@]}"; do
+  declare name="${benchmark##*/}"
+  declare result="${RESULTS_DIR}/${name}.json"
+  printf "==> %s\n" "${name}"
+  "${benchmark}" \
+    --benchmark_filter="${FILTER}" \
+    --benchmark_repetitions="${REPETITIONS}" \
+    --benchmark_out="${result}" \
+    --benchmark_out_format=json \
+    >/dev/null
+  if [[ ${UPDATE} -eq 1 ]]; then
+    mkdir -p "${BASELINE_DIR}"
+    cp "${result}" "${BASELINE_DIR}/${name}.json"
+    printf "Updated %s\n" "${BASELINE_DIR}/${name}.json"
+  elif [[ -f ${BASELINE_DIR}/${name}.json ]]; then
+    "${COMPARE}" \
+      --baseline="${BASELINE_DIR}/${name}.json" \
+      --current="${result}" \
+      --threshold="${THRESHOLD}" \
+      --use_real_time="${USE_REAL_TIME[${name}]:-false}" || STATUS=1
+  else
+    printf "No baseline for %s, rerun with --update to record one.\n" "${name}"
+  fi
+done
+exit ${STATUS}
@@ -0,0 +1,301 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measures how operations on state shared by all request threads scale with
+// the number of threads. Every benchmark runs from one thread up to the number
+// of cores, and reports `items_per_thread`, which stays flat if the operation
+// scales. With `refresh:1` a background thread keeps updating the shared state
+// the way the periodic refresh of a server does, so that readers contend with
+// a writer.
+//
+// Run with: bazel run -c opt //testing/benchmark:scalability_benchmark
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "absl/functional/any_invocable.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_format.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "benchmark/benchmark.h"
+#include "cc/public/cpio/interface/private_key_client/private_key_client_interface.h"
+#include "cc/public/cpio/interface/public_key_client/public_key_client_interface.h"
+#include "opentelemetry/metrics/provider.h"
+#include "opentelemetry/sdk/metrics/meter_provider.h"
+#include "opentelemetry/sdk/metrics/metric_reader.h"
+#include "opentelemetry/sdk/metrics/view/view_registry.h"
+#include "proto/hpke.pb.h"
+#include "proto/tink.pb.h"
+#include "public/core/interface/execution_result.h"
+#include "src/cpp/encryption/key_fetcher/src/key_fetcher_utils.h"
+#include "src/cpp/encryption/key_fetcher/src/private_key_fetcher.h"
+#include "src/cpp/encryption/key_fetcher/src/public_key_fetcher.h"
+#include "src/cpp/telemetry/metrics_recorder.h"
+#include "src/cpp/telemetry/trace_generator_aws.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+using ::google::cmrt::sdk::private_key_service::v1::ListPrivateKeysRequest;
+using ::google::cmrt::sdk::private_key_service::v1::ListPrivateKeysResponse;
+using ::google::cmrt::sdk::public_key_service::v1::ListPublicKeysRequest;
+using ::google::cmrt::sdk::public_key_service::v1::ListPublicKeysResponse;
+using ::google::scp::core::ExecutionResult;
+using ::google::scp::core::SuccessExecutionResult;
+using ::google::scp::cpio::Callback;
+
+namespace metric_sdk = opentelemetry::sdk::metrics;
+
+// Number of keys served by the fake key services, as many as the real ones
+// keep active at a time.
+constexpr int kNumKeys = 5;
+// Pause between two background updates.
+constexpr absl::Duration kRefreshPause = absl::Milliseconds(1);
+
+// Runs `update` repeatedly on a separate thread until destroyed.
+class BackgroundUpdater {
+ public:
+  explicit BackgroundUpdater(absl::AnyInvocable<void()> update)
+      : thread_([this, update = std::move(update)]() mutable {
+          do {
+            update();
+            num_updates_.fetch_add(1, std::memory_order_relaxed);
+          } while (!stop_.WaitForNotificationWithTimeout(kRefreshPause));
+        }) {}
+
+  ~BackgroundUpdater() {
+    stop_.Notify();
+    thread_.join();
+  }
+
+  int num_updates() const {
+    return num_updates_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  absl::Notification stop_;
+  std::atomic<int> num_updates_ = 0;
+  std::thread thread_;
+};
+
+// Starts a BackgroundUpdater on the first benchmark thread if the benchmark
+// argument asks for one. All threads start measuring together, after it runs.
+std::unique_ptr<BackgroundUpdater> MaybeStartUpdater(
+    const benchmark::State& state, absl::AnyInvocable<void()> update) {
+  if (state.thread_index() != 0 || state.range(0) == 0) {
+    return nullptr;
+  }
+  return std::make_unique<BackgroundUpdater>(std::move(update));
+}
+
+void ReportThroughput(benchmark::State& state,
+                      std::unique_ptr<BackgroundUpdater> updater) {
+  state.SetItemsProcessed(state.iterations());
+  state.counters["items_per_thread"] = benchmark::Counter(
+      state.iterations(), benchmark::Counter::kAvgThreadsRate);
+  if (updater != nullptr) {
+    state.counters["updates"] = updater->num_updates();
+  }
+}
+
+class FakePrivateKeyClient
+    : public google::scp::cpio::PrivateKeyClientInterface {
+ public:
+  FakePrivateKeyClient() {
+    for (int i = 0; i < kNumKeys; ++i) {
+      google::crypto::tink::HpkePrivateKey hpke_private_key;
+      hpke_private_key.set_private_key(std::string(32, 'a' + i));
+      google::crypto::tink::Keyset keyset;
+      keyset.add_key()->mutable_key_data()->set_value(
+          hpke_private_key.SerializeAsString());
+      auto* private_key = response_.add_private_keys();
+      private_key->set_key_id(absl::StrFormat("%02X0000000", i));
+      private_key->set_private_key(
+          absl::Base64Escape(keyset.SerializeAsString()));
+    }
+  }
+
+  ExecutionResult Init() noexcept override { return SuccessExecutionResult(); }
+  ExecutionResult Run() noexcept override { return SuccessExecutionResult(); }
+  ExecutionResult Stop() noexcept override { return SuccessExecutionResult(); }
+
+  ExecutionResult ListPrivateKeys(
+      ListPrivateKeysRequest request,
+      Callback<ListPrivateKeysResponse> callback) noexcept override {
+    // Fresh creation times keep the keys from expiring.
+    ListPrivateKeysResponse response = response_;
+    for (auto& private_key : *response.mutable_private_keys()) {
+      private_key.mutable_creation_time()->set_seconds(
+          absl::ToUnixSeconds(absl::Now()));
+    }
+    callback(SuccessExecutionResult(), std::move(response));
+    return SuccessExecutionResult();
+  }
+
+ private:
+  ListPrivateKeysResponse response_;
+};
+
+class FakePublicKeyClient : public google::scp::cpio::PublicKeyClientInterface {
+ public:
+  FakePublicKeyClient() {
+    for (int i = 0; i < kNumKeys; ++i) {
+      auto* public_key = response_.add_public_keys();
+      public_key->set_key_id(absl::StrFormat("%02X0000000", i));
+      public_key->set_public_key(std::string(32, 'a' + i));
+    }
+  }
+
+  ExecutionResult Init() noexcept override { return SuccessExecutionResult(); }
+  ExecutionResult Run() noexcept override { return SuccessExecutionResult(); }
+  ExecutionResult Stop() noexcept override { return SuccessExecutionResult(); }
+
+  ExecutionResult ListPublicKeys(
+      ListPublicKeysRequest request,
+      Callback<ListPublicKeysResponse> callback) noexcept override {
+    callback(SuccessExecutionResult(), response_);
+    return SuccessExecutionResult();
+  }
+
+ private:
+  ListPublicKeysResponse response_;
+};
+
+// Collects nothing, so that recording is measured without any exporter.
+class NoopMetricReader : public metric_sdk::MetricReader {
+ public:
+  metric_sdk::AggregationTemporality GetAggregationTemporality(
+      metric_sdk::InstrumentType) const noexcept override {
+    return metric_sdk::AggregationTemporality::kCumulative;
+  }
+
+ private:
+  bool OnForceFlush(std::chrono::microseconds) noexcept override {
+    return true;
+  }
+  bool OnShutDown(std::chrono::microseconds) noexcept override { return true; }
+};
+
+PrivateKeyFetcher& GetPrivateKeyFetcher() {
+  static PrivateKeyFetcher* const fetcher = [] {
+    auto* fetcher = new PrivateKeyFetcher(
+        std::make_unique<FakePrivateKeyClient>(), absl::Hours(1));
+    fetcher->Refresh().IgnoreError();
+    return fetcher;
+  }();
+  return *fetcher;
+}
+
+PublicKeyFetcher& GetPublicKeyFetcher() {
+  static PublicKeyFetcher* const fetcher = [] {
+    auto* fetcher =
+        new PublicKeyFetcher(std::make_unique<FakePublicKeyClient>());
+    fetcher->Refresh().IgnoreError();
+    return fetcher;
+  }();
+  return *fetcher;
+}
+
+MetricsRecorder& GetMetricsRecorder() {
+  static MetricsRecorder* const metrics_recorder = [] {
+    auto provider = std::make_shared<metric_sdk::MeterProvider>(
+        std::make_unique<metric_sdk::ViewRegistry>());
+    provider->AddMetricReader(std::make_shared<NoopMetricReader>());
+    opentelemetry::metrics::Provider::SetMeterProvider(
+        std::shared_ptr<opentelemetry::metrics::MeterProvider>(provider));
+    MetricsRecorder* metrics_recorder =
+        MetricsRecorder::Create("benchmark", "1").release();
+    metrics_recorder->RegisterHistogram("size", "Size of something.", "byte");
+    return metrics_recorder;
+  }();
+  return *metrics_recorder;
+}
+
+void BM_PrivateKeyFetcherGetKey(benchmark::State& state) {
+  PrivateKeyFetcher& fetcher = GetPrivateKeyFetcher();
+  auto updater = MaybeStartUpdater(
+      state, [&fetcher] { fetcher.Refresh().IgnoreError(); });
+  const std::string key_id =
+      ToOhttpKeyId(absl::StrFormat("%02X0000000", state.thread_index() %
+                                                      kNumKeys));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fetcher.GetKey(key_id));
+  }
+  ReportThroughput(state, std::move(updater));
+}
+
+void BM_PublicKeyFetcherGetKey(benchmark::State& state) {
+  PublicKeyFetcher& fetcher = GetPublicKeyFetcher();
+  auto updater = MaybeStartUpdater(
+      state, [&fetcher] { fetcher.Refresh().IgnoreError(); });
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fetcher.GetKey());
+  }
+  ReportThroughput(state, std::move(updater));
+}
+
+void BM_RecordHistogramEvent(benchmark::State& state) {
+  MetricsRecorder& metrics_recorder = GetMetricsRecorder();
+  // Registering an existing histogram again takes the exclusive lock, as code
+  // that registers its histograms lazily does.
+  auto updater = MaybeStartUpdater(state, [&metrics_recorder] {
+    metrics_recorder.RegisterHistogram("size", "Size of something.", "byte");
+  });
+  int64_t value = state.thread_index();
+  for (auto _ : state) {
+    metrics_recorder.RecordHistogramEvent("size", value);
+    value = (value + 997) % 100'000;
+  }
+  ReportThroughput(state, std::move(updater));
+}
+
+void BM_XRayGenerateTraceId(benchmark::State& state) {
+  // One generator for all threads, as the tracer provider shares it. Note
+  // that XRayIdGenerator draws from a single absl::BitGen without a lock.
+  static opentelemetry::sdk::trace::IdGenerator* const generator =
+      CreateXrayIdGenerator().release();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(generator->GenerateTraceId());
+  }
+  ReportThroughput(state, nullptr);
+}
+
+int MaxThreads() {
+  return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+// Runs with and without a background updater, from one thread up to the
+// number of cores.
+void WithAndWithoutRefresh(benchmark::internal::Benchmark* b) {
+  b->ArgName("refresh")->Arg(0)->Arg(1)->ThreadRange(1, MaxThreads());
+  b->UseRealTime();
+}
+
+BENCHMARK(BM_PrivateKeyFetcherGetKey)->Apply(WithAndWithoutRefresh);
+BENCHMARK(BM_PublicKeyFetcherGetKey)->Apply(WithAndWithoutRefresh);
+BENCHMARK(BM_RecordHistogramEvent)->Apply(WithAndWithoutRefresh);
+// The XRay generator has no state to refresh.
+BENCHMARK(BM_XRayGenerateTraceId)->ThreadRange(1, MaxThreads())->UseRealTime();
+
+}  // namespace
+}  // namespace privacy_sandbox::server_common
+
+BENCHMARK_MAIN();
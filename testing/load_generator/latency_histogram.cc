@@ -0,0 +1,110 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "testing/load_generator/latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "absl/numeric/bits.h"
+#include "absl/time/time.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+constexpr int64_t kSubBucketCount = int64_t{1}
+                                    << LatencyHistogram::kSubBucketBits;
+// Values below kSubBucketCount get one bucket each, every following power of
+// two gets kSubBucketCount buckets.
+constexpr int kBucketCount =
+    (absl::bit_width(static_cast<uint64_t>(
+         LatencyHistogram::kMaxTrackableNanos)) -
+     LatencyHistogram::kSubBucketBits + 1) *
+    kSubBucketCount;
+
+}  // namespace
+
+LatencyHistogram::LatencyHistogram() : counts_(kBucketCount) {}
+
+int LatencyHistogram::BucketIndex(int64_t nanos) {
+  if (nanos < kSubBucketCount) {
+    return nanos;
+  }
+  const int shift =
+      absl::bit_width(static_cast<uint64_t>(nanos)) - 1 - kSubBucketBits;
+  return (shift + 1) * kSubBucketCount + (nanos >> shift) - kSubBucketCount;
+}
+
+int64_t LatencyHistogram::BucketUpperBound(int index) {
+  if (index < kSubBucketCount) {
+    return index;
+  }
+  const int shift = index / kSubBucketCount - 1;
+  const int64_t top = index % kSubBucketCount + kSubBucketCount;
+  return ((top + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(absl::Duration latency) {
+  const int64_t nanos = std::clamp<int64_t>(absl::ToInt64Nanoseconds(latency),
+                                            0, kMaxTrackableNanos);
+  ++counts_[BucketIndex(nanos)];
+  ++count_;
+  min_nanos_ = std::min(min_nanos_, nanos);
+  max_nanos_ = std::max(max_nanos_, nanos);
+  sum_nanos_ += nanos;
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+  for (int i = 0; i < kBucketCount; ++i) {
+    counts_[i] += other.counts_[i];
+  }
+  count_ += other.count_;
+  min_nanos_ = std::min(min_nanos_, other.min_nanos_);
+  max_nanos_ = std::max(max_nanos_, other.max_nanos_);
+  sum_nanos_ += other.sum_nanos_;
+}
+
+absl::Duration LatencyHistogram::min() const {
+  return count_ == 0 ? absl::ZeroDuration() : absl::Nanoseconds(min_nanos_);
+}
+
+absl::Duration LatencyHistogram::max() const {
+  return absl::Nanoseconds(max_nanos_);
+}
+
+absl::Duration LatencyHistogram::mean() const {
+  return count_ == 0 ? absl::ZeroDuration()
+                     : absl::Nanoseconds(sum_nanos_ / count_);
+}
+
+absl::Duration LatencyHistogram::ValueAtPercentile(double percentile) const {
+  if (count_ == 0) {
+    return absl::ZeroDuration();
+  }
+  const int64_t rank = std::max<int64_t>(
+      1, static_cast<int64_t>(
+             std::ceil(std::clamp(percentile, 0.0, 100.0) / 100 * count_)));
+  int64_t seen = 0;
+  for (int i = 0; i < kBucketCount; ++i) {
+    seen += counts_[i];
+    if (seen >= rank) {
+      return absl::Nanoseconds(
+          std::clamp(BucketUpperBound(i), min_nanos_, max_nanos_));
+    }
+  }
+  return max();
+}
+
+}  // namespace privacy_sandbox::server_common
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TESTING_LOAD_GENERATOR_LATENCY_HISTOGRAM_H_
+#define TESTING_LOAD_GENERATOR_LATENCY_HISTOGRAM_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/time/time.h"
+
+namespace privacy_sandbox::server_common {
+
+// High dynamic range latency histogram in the style of HdrHistogram. Every
+// power of two is split into 2^kSubBucketBits linear buckets, so any recorded
+// latency is reported within 0.4% of its actual value, from 1ns up to
+// kMaxTrackable. Longer latencies are clamped.
+//
+// Recording is O(1) and allocation free. Not thread-safe; keep one histogram
+// per thread and Merge() them when reporting.
+class LatencyHistogram {
+ public:
+  static constexpr int kSubBucketBits = 8;
+  // About 18 minutes.
+  static constexpr int64_t kMaxTrackableNanos = (int64_t{1} << 40) - 1;
+
+  LatencyHistogram();
+
+  void Record(absl::Duration latency);
+  void Merge(const LatencyHistogram& other);
+
+  int64_t count() const { return count_; }
+  absl::Duration min() const;
+  absl::Duration max() const;
+  absl::Duration mean() const;
+
+  // Returns the latency that `percentile` percent of the recorded latencies
+  // are at or below, e.g. ValueAtPercentile(99.9). Returns zero if nothing was
+  // recorded.
+  absl::Duration ValueAtPercentile(double percentile) const;
+
+ private:
+  static int BucketIndex(int64_t nanos);
+  // Returns the largest value that maps to bucket `index`.
+  static int64_t BucketUpperBound(int index);
+
+  std::vector<int64_t> counts_;
+  int64_t count_ = 0;
+  int64_t min_nanos_ = kMaxTrackableNanos;
+  int64_t max_nanos_ = 0;
+  // Summed in double to not overflow on long runs.
+  double sum_nanos_ = 0;
+};
+
+}  // namespace privacy_sandbox::server_common
+
+#endif  // TESTING_LOAD_GENERATOR_LATENCY_HISTOGRAM_H_
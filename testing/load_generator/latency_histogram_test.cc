@@ -0,0 +1,93 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "testing/load_generator/latency_histogram.h"
+
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+// Allowed relative error of the reported percentiles.
+constexpr double kPrecision = 1.0 / (1 << LatencyHistogram::kSubBucketBits);
+
+void ExpectNear(absl::Duration actual, absl::Duration expected) {
+  EXPECT_LE(absl::AbsDuration(actual - expected),
+            absl::Nanoseconds(1) + expected * kPrecision)
+      << "actual: " << actual << " expected: " << expected;
+}
+
+TEST(LatencyHistogramTest, EmptyHistogram) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(histogram.count(), 0);
+  EXPECT_EQ(histogram.min(), absl::ZeroDuration());
+  EXPECT_EQ(histogram.max(), absl::ZeroDuration());
+  EXPECT_EQ(histogram.mean(), absl::ZeroDuration());
+  EXPECT_EQ(histogram.ValueAtPercentile(50), absl::ZeroDuration());
+}
+
+TEST(LatencyHistogramTest, SmallValuesAreExact) {
+  LatencyHistogram histogram;
+  for (int i = 1; i <= 100; ++i) {
+    histogram.Record(absl::Nanoseconds(i));
+  }
+  EXPECT_EQ(histogram.count(), 100);
+  EXPECT_EQ(histogram.min(), absl::Nanoseconds(1));
+  EXPECT_EQ(histogram.max(), absl::Nanoseconds(100));
+  EXPECT_EQ(histogram.ValueAtPercentile(50), absl::Nanoseconds(50));
+  EXPECT_EQ(histogram.ValueAtPercentile(99), absl::Nanoseconds(99));
+  EXPECT_EQ(histogram.ValueAtPercentile(100), absl::Nanoseconds(100));
+  EXPECT_EQ(histogram.ValueAtPercentile(0), absl::Nanoseconds(1));
+}
+
+TEST(LatencyHistogramTest, LargeValuesKeepRelativePrecision) {
+  LatencyHistogram histogram;
+  // 1us, 2us, ..., 10000us.
+  for (int i = 1; i <= 10000; ++i) {
+    histogram.Record(absl::Microseconds(i));
+  }
+  ExpectNear(histogram.ValueAtPercentile(50), absl::Microseconds(5000));
+  ExpectNear(histogram.ValueAtPercentile(90), absl::Microseconds(9000));
+  ExpectNear(histogram.ValueAtPercentile(99.9), absl::Microseconds(9990));
+  EXPECT_EQ(histogram.ValueAtPercentile(100), absl::Microseconds(10000));
+  ExpectNear(histogram.mean(), absl::Microseconds(5000.5));
+}
+
+TEST(LatencyHistogramTest, ClampsOutOfRangeValues) {
+  LatencyHistogram histogram;
+  histogram.Record(-absl::Seconds(1));
+  histogram.Record(absl::Hours(1));
+  EXPECT_EQ(histogram.min(), absl::ZeroDuration());
+  EXPECT_EQ(histogram.max(),
+            absl::Nanoseconds(LatencyHistogram::kMaxTrackableNanos));
+}
+
+TEST(LatencyHistogramTest, MergeCombinesCounts) {
+  LatencyHistogram fast;
+  LatencyHistogram slow;
+  for (int i = 0; i < 99; ++i) {
+    fast.Record(absl::Microseconds(10));
+  }
+  slow.Record(absl::Milliseconds(5));
+  fast.Merge(slow);
+  EXPECT_EQ(fast.count(), 100);
+  ExpectNear(fast.ValueAtPercentile(99), absl::Microseconds(10));
+  EXPECT_EQ(fast.ValueAtPercentile(99.9), absl::Milliseconds(5));
+  EXPECT_EQ(fast.min(), absl::Microseconds(10));
+  EXPECT_EQ(fast.max(), absl::Milliseconds(5));
+}
+
+}  // namespace
+}  // namespace privacy_sandbox::server_common
@@ -0,0 +1,170 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "testing/load_generator/load_generator.h"
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_format.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "src/cpp/util/duration.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+// Results of one thread, merged into the LoadReport once all threads finish.
+struct WorkerResult {
+  int64_t num_requests = 0;
+  int64_t num_failures = 0;
+  absl::Duration cpu_time;
+  LatencyHistogram end_to_end;
+  std::array<LatencyHistogram, kNumStages> stages;
+};
+
+void RunWorker(const RequestPath& request_path, const LoadOptions& options,
+               const std::vector<std::string>& requests, SteadyTime start,
+               SteadyTime end, WorkerResult& result) {
+  CpuThreadTimeStopwatch cpu_time;
+  const absl::Duration interval =
+      options.target_qps > 0
+          ? absl::Seconds(options.num_threads / options.target_qps)
+          : absl::ZeroDuration();
+  SteadyTime scheduled = start;
+  for (int64_t i = 0;; ++i) {
+    SteadyTime now = SteadyTime::Now();
+    if (interval > absl::ZeroDuration()) {
+      if (now < scheduled) {
+        absl::SleepFor(scheduled - now);
+      }
+    } else {
+      scheduled = now;
+    }
+    if (scheduled >= end) {
+      break;
+    }
+
+    StageLatencies latencies = {};
+    const absl::StatusOr<std::string> response = request_path.HandleRequest(
+        requests[i % requests.size()], latencies);
+    result.end_to_end.Record(SteadyTime::Now() - scheduled);
+    scheduled += interval;
+    ++result.num_requests;
+    if (!response.ok()) {
+      ++result.num_failures;
+      continue;
+    }
+    for (int stage = 0; stage < kNumStages; ++stage) {
+      result.stages[stage].Record(latencies[stage]);
+    }
+  }
+  result.cpu_time = cpu_time.GetElapsedTime();
+}
+
+std::string FormatLatencies(absl::string_view name,
+                            const LatencyHistogram& histogram) {
+  auto micros = [](absl::Duration d) { return absl::ToDoubleMicroseconds(d); };
+  return absl::StrFormat(
+      "%-14s %10d %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", name,
+      histogram.count(), micros(histogram.mean()),
+      micros(histogram.ValueAtPercentile(50)),
+      micros(histogram.ValueAtPercentile(90)),
+      micros(histogram.ValueAtPercentile(99)),
+      micros(histogram.ValueAtPercentile(99.9)), micros(histogram.max()));
+}
+
+}  // namespace
+
+double LoadReport::Throughput() const {
+  return elapsed > absl::ZeroDuration()
+             ? num_requests / absl::ToDoubleSeconds(elapsed)
+             : 0;
+}
+
+double LoadReport::ThroughputPerCore() const {
+  return cpu_time > absl::ZeroDuration()
+             ? num_requests / absl::ToDoubleSeconds(cpu_time)
+             : 0;
+}
+
+absl::StatusOr<LoadReport> RunLoad(const RequestPath& request_path,
+                                   const LoadOptions& options) {
+  // Requests are built up front so that the client side is not measured.
+  std::vector<std::vector<std::string>> requests(options.num_threads);
+  for (int thread = 0; thread < options.num_threads; ++thread) {
+    for (int i = 0; i < std::max(1, options.num_distinct_requests); ++i) {
+      auto request = request_path.EncapsulateRequest(MakeRequest(
+          request_path.options(), thread * options.num_distinct_requests + i));
+      if (!request.ok()) {
+        return request.status();
+      }
+      requests[thread].push_back(std::move(request->encapsulated_request));
+    }
+  }
+
+  std::vector<WorkerResult> results(options.num_threads);
+  std::vector<std::thread> threads;
+  const SteadyTime start = SteadyTime::Now();
+  const SteadyTime end = start + options.duration;
+  for (int thread = 0; thread < options.num_threads; ++thread) {
+    threads.emplace_back(RunWorker, std::cref(request_path), std::cref(options),
+                         std::cref(requests[thread]), start, end,
+                         std::ref(results[thread]));
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  LoadReport report;
+  report.elapsed = SteadyTime::Now() - start;
+  for (const WorkerResult& result : results) {
+    report.num_requests += result.num_requests;
+    report.num_failures += result.num_failures;
+    report.cpu_time += result.cpu_time;
+    report.end_to_end.Merge(result.end_to_end);
+    for (int stage = 0; stage < kNumStages; ++stage) {
+      report.stages[stage].Merge(result.stages[stage]);
+    }
+  }
+  return report;
+}
+
+std::string FormatLoadReport(const LoadReport& report) {
+  std::string output = absl::StrFormat(
+      "requests: %d  failures: %d  elapsed: %s  cpu: %s\n"
+      "throughput: %.1f req/s  per core: %.1f req/s\n\n",
+      report.num_requests, report.num_failures,
+      absl::FormatDuration(report.elapsed),
+      absl::FormatDuration(report.cpu_time), report.Throughput(),
+      report.ThroughputPerCore());
+  absl::StrAppend(&output,
+                  absl::StrFormat("%-14s %10s %10s %10s %10s %10s %10s %10s\n",
+                                  "stage (us)", "count", "mean", "p50", "p90",
+                                  "p99", "p99.9", "max"));
+  for (int stage = 0; stage < kNumStages; ++stage) {
+    absl::StrAppend(&output,
+                    FormatLatencies(StageName(static_cast<Stage>(stage)),
+                                    report.stages[stage]));
+  }
+  absl::StrAppend(&output, FormatLatencies("end_to_end", report.end_to_end));
+  return output;
+}
+
+}  // namespace privacy_sandbox::server_common
@@ -0,0 +1,68 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TESTING_LOAD_GENERATOR_LOAD_GENERATOR_H_
+#define TESTING_LOAD_GENERATOR_LOAD_GENERATOR_H_
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
+#include "testing/load_generator/latency_histogram.h"
+#include "testing/load_generator/request_path.h"
+
+namespace privacy_sandbox::server_common {
+
+struct LoadOptions {
+  int num_threads = 1;
+  absl::Duration duration = absl::Seconds(10);
+  // Requests per second over all threads. Zero runs a closed loop where every
+  // thread sends its next request as soon as the previous one is done.
+  // Otherwise requests are sent on a fixed schedule (open loop), and latency
+  // is measured from the scheduled send time so that a stalled request path
+  // shows up as queueing instead of hiding it.
+  double target_qps = 0;
+  // Number of distinct requests each thread cycles through.
+  int num_distinct_requests = 16;
+};
+
+struct LoadReport {
+  int64_t num_requests = 0;
+  int64_t num_failures = 0;
+  absl::Duration elapsed;
+  // Thread CPU time summed over all threads.
+  absl::Duration cpu_time;
+  LatencyHistogram end_to_end;
+  std::array<LatencyHistogram, kNumStages> stages;
+
+  double Throughput() const;
+  // Requests handled per second of CPU time, i.e. per fully used core.
+  double ThroughputPerCore() const;
+};
+
+// Sends requests through `request_path` from `options.num_threads` threads for
+// `options.duration`. Returns an error if the requests cannot be built.
+absl::StatusOr<LoadReport> RunLoad(const RequestPath& request_path,
+                                   const LoadOptions& options);
+
+// Formats throughput and latency percentiles per stage as a table.
+std::string FormatLoadReport(const LoadReport& report);
+
+}  // namespace privacy_sandbox::server_common
+
+#endif  // TESTING_LOAD_GENERATOR_LOAD_GENERATOR_H_
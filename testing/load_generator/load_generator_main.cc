@@ -0,0 +1,85 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Drives synthetic requests through the request path of this library and
+// reports throughput and latency percentiles per stage. Example:
+//
+//   bazel run -c opt //testing/load_generator:load_generator_main -- \
+//     --threads=4 --duration=30s
+//
+// Pass --qps to send at a fixed rate instead of as fast as possible.
+
+#include <iostream>
+#include <string>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/time/time.h"
+#include "src/cpp/encryption/key_fetcher/src/fake_key_fetcher_manager.h"
+#include "testing/load_generator/load_generator.h"
+#include "testing/load_generator/request_path.h"
+
+ABSL_FLAG(int, threads, 1, "Number of threads sending requests.");
+ABSL_FLAG(absl::Duration, duration, absl::Seconds(10), "How long to run.");
+ABSL_FLAG(double, qps, 0,
+          "Requests per second over all threads. 0 sends each request as soon "
+          "as the previous one on the same thread completed.");
+ABSL_FLAG(int, partitions, 8, "Partitions per request.");
+ABSL_FLAG(int, keys_per_partition, 16, "Keys looked up per partition.");
+ABSL_FLAG(int, compression_groups, 2, "Compression groups per response.");
+ABSL_FLAG(std::string, compression, "brotli",
+          "One of uncompressed, brotli or gzip.");
+
+int main(int argc, char** argv) {
+  absl::ParseCommandLine(argc, argv);
+  using privacy_sandbox::server_common::CompressionType;
+
+  privacy_sandbox::server_common::RequestOptions request_options;
+  request_options.num_partitions = absl::GetFlag(FLAGS_partitions);
+  request_options.keys_per_partition = absl::GetFlag(FLAGS_keys_per_partition);
+  request_options.num_compression_groups =
+      absl::GetFlag(FLAGS_compression_groups);
+  const std::string compression = absl::GetFlag(FLAGS_compression);
+  if (compression == "uncompressed") {
+    request_options.compression_type = CompressionType::kUncompressed;
+  } else if (compression == "brotli") {
+    request_options.compression_type = CompressionType::kBrotli;
+  } else if (compression == "gzip") {
+    request_options.compression_type = CompressionType::kGzip;
+  } else {
+    std::cerr << "Unknown --compression: " << compression << std::endl;
+    return 1;
+  }
+  if (request_options.num_compression_groups < 1) {
+    std::cerr << "--compression_groups must be positive" << std::endl;
+    return 1;
+  }
+
+  privacy_sandbox::server_common::LoadOptions load_options;
+  load_options.num_threads = absl::GetFlag(FLAGS_threads);
+  load_options.duration = absl::GetFlag(FLAGS_duration);
+  load_options.target_qps = absl::GetFlag(FLAGS_qps);
+
+  privacy_sandbox::server_common::FakeKeyFetcherManager key_fetcher_manager;
+  const privacy_sandbox::server_common::RequestPath request_path(
+      key_fetcher_manager, request_options);
+  const auto report =
+      privacy_sandbox::server_common::RunLoad(request_path, load_options);
+  if (!report.ok()) {
+    std::cerr << "Failed to run load: " << report.status() << std::endl;
+    return 1;
+  }
+  std::cout << privacy_sandbox::server_common::FormatLoadReport(*report);
+  return report->num_failures == 0 ? 0 : 1;
+}
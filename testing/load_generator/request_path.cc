@@ -0,0 +1,286 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "testing/load_generator/request_path.h"
+
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "src/cpp/communication/compression_brotli.h"
+#include "src/cpp/communication/compression_gzip.h"
+#include "src/cpp/communication/json_utils.h"
+#include "src/cpp/communication/ohttp_utils.h"
+#include "src/cpp/communication/uncompressed.h"
+#include "src/cpp/util/duration.h"
+#include "src/cpp/util/request_arena.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+using json_test::TestRequest;
+
+std::unique_ptr<CompressionGroupConcatenator> CreateConcatenator(
+    CompressionType type) {
+  switch (type) {
+    case CompressionType::kBrotli:
+      return std::make_unique<BrotliCompressionGroupConcatenator>();
+    case CompressionType::kGzip:
+      return std::make_unique<GzipCompressionGroupConcatenator>();
+    default:
+      return std::make_unique<UncompressedConcatenator>();
+  }
+}
+
+std::unique_ptr<CompressedBlobReader> CreateBlobReader(
+    CompressionType type, absl::string_view compressed) {
+  switch (type) {
+    case CompressionType::kBrotli:
+      return std::make_unique<BrotliCompressionBlobReader>(compressed);
+    case CompressionType::kGzip:
+      return std::make_unique<GzipCompressionBlobReader>(compressed);
+    default:
+      return std::make_unique<UncompressedBlobReader>(compressed);
+  }
+}
+
+// Frames `compressed` without padding.
+absl::StatusOr<std::string> Encode(CompressionType type,
+                                   absl::string_view compressed) {
+  return EncodeResponsePayload(type, compressed,
+                               kFramingVersionAndCompressionTypeSizeBytes +
+                                   kCompressedDataSizeBytes +
+                                   compressed.size());
+}
+
+// Decodes, decompresses and parses every compression group of `payload` into
+// `message`.
+absl::Status DecodeAndMerge(absl::string_view payload, TestRequest& message) {
+  absl::StatusOr<DecodedRequest> decoded = DecodeRequestPayload(payload);
+  if (!decoded.ok()) {
+    return decoded.status();
+  }
+  std::unique_ptr<CompressedBlobReader> reader =
+      CreateBlobReader(decoded->compression_type, decoded->compressed_data);
+  while (!reader->IsDoneReading()) {
+    absl::StatusOr<std::string> group = reader->ExtractOneCompressionGroup();
+    if (!group.ok()) {
+      return group.status();
+    }
+    TestRequest group_message;
+    if (auto s = JsonToProto(*group, &group_message); !s.ok()) {
+      return s;
+    }
+    message.MergeFrom(group_message);
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+absl::string_view StageName(Stage stage) {
+  switch (stage) {
+    case Stage::kDecrypt:
+      return "decrypt";
+    case Stage::kDecode:
+      return "decode";
+    case Stage::kDecompress:
+      return "decompress";
+    case Stage::kJsonToProto:
+      return "json_to_proto";
+    case Stage::kProtoToJson:
+      return "proto_to_json";
+    case Stage::kCompress:
+      return "compress";
+    case Stage::kEncode:
+      return "encode";
+    case Stage::kEncrypt:
+      return "encrypt";
+  }
+  return "unknown";
+}
+
+TestRequest MakeRequest(const RequestOptions& options, int seed) {
+  TestRequest request;
+  request.set_client_version("load_generator");
+  (*request.mutable_metadata())["hostname"] = "www.example.com";
+  for (int i = 0; i < options.num_partitions; ++i) {
+    auto* partition = request.add_partitions();
+    partition->set_id(i);
+    partition->set_compression_group_id(i % options.num_compression_groups);
+    auto* argument = partition->add_arguments();
+    argument->add_tags("custom");
+    argument->add_tags("keys");
+    for (int j = 0; j < options.keys_per_partition; ++j) {
+      argument->add_data(absl::StrCat("ad_render_id_", seed, "_", i, "_", j));
+    }
+  }
+  return request;
+}
+
+absl::StatusOr<ClientRequest> RequestPath::EncapsulateRequest(
+    const TestRequest& request) const {
+  const auto public_key = key_fetcher_manager_.GetPublicKey();
+  if (!public_key.ok()) {
+    return public_key.status();
+  }
+
+  absl::StatusOr<std::string> json = ProtoToJson(request);
+  if (!json.ok()) {
+    return json.status();
+  }
+  std::unique_ptr<CompressionGroupConcatenator> concatenator =
+      CreateConcatenator(options_.compression_type);
+  concatenator->AddCompressionGroup(*std::move(json));
+  absl::StatusOr<std::string> compressed = concatenator->Build();
+  if (!compressed.ok()) {
+    return compressed.status();
+  }
+  absl::StatusOr<std::string> encoded =
+      Encode(options_.compression_type, *compressed);
+  if (!encoded.ok()) {
+    return encoded.status();
+  }
+
+  auto oblivious_request =
+      client_cache_.EncapsulateRequest(*std::move(encoded), *public_key);
+  if (!oblivious_request.ok()) {
+    return oblivious_request.status();
+  }
+  std::string encapsulated_request =
+      oblivious_request->EncapsulateAndSerialize();
+  return ClientRequest{std::move(encapsulated_request),
+                       std::move(*oblivious_request).ReleaseContext()};
+}
+
+absl::StatusOr<TestRequest> RequestPath::DecryptResponse(
+    std::string encapsulated_response, ClientRequest& request) const {
+  absl::StatusOr<std::string> response =
+      server_common::DecryptResponse(std::move(encapsulated_response),
+                                     request.context);
+  if (!response.ok()) {
+    return response.status();
+  }
+  TestRequest message;
+  if (auto s = DecodeAndMerge(*response, message); !s.ok()) {
+    return s;
+  }
+  return message;
+}
+
+absl::StatusOr<std::string> RequestPath::HandleRequest(
+    absl::string_view encapsulated_request, StageLatencies& latencies) const {
+  auto record = [&latencies](Stage stage, Stopwatch& stopwatch) {
+    latencies[static_cast<int>(stage)] += stopwatch.GetElapsedTime();
+    stopwatch.Reset();
+  };
+  Stopwatch stopwatch;
+
+  const absl::StatusOr<uint8_t> key_id = ParseKeyId(encapsulated_request);
+  if (!key_id.ok()) {
+    return key_id.status();
+  }
+  const std::optional<PrivateKey> private_key =
+      key_fetcher_manager_.GetPrivateKey(absl::StrCat(*key_id));
+  if (!private_key.has_value()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Unknown key ID: ", *key_id));
+  }
+  absl::StatusOr<quiche::ObliviousHttpRequest> oblivious_request =
+      DecryptEncapsulatedRequest(*private_key, encapsulated_request);
+  if (!oblivious_request.ok()) {
+    return oblivious_request.status();
+  }
+  record(Stage::kDecrypt, stopwatch);
+
+  // Holds the intermediate buffers of the request, which are all released
+  // together when the request is done.
+  RequestArena arena;
+  absl::StatusOr<PmrDecodedRequest> decoded =
+      DecodeRequestPayload(oblivious_request->GetPlaintextData(), &arena);
+  if (!decoded.ok()) {
+    return decoded.status();
+  }
+  record(Stage::kDecode, stopwatch);
+
+  std::unique_ptr<CompressedBlobReader> reader =
+      CreateBlobReader(decoded->compression_type, decoded->compressed_data);
+  absl::StatusOr<std::pmr::string> json =
+      reader->ExtractOneCompressionGroup(&arena);
+  if (!json.ok()) {
+    return json.status();
+  }
+  record(Stage::kDecompress, stopwatch);
+
+  TestRequest request;
+  if (auto s = JsonToProto(*json, &request); !s.ok()) {
+    return s;
+  }
+  record(Stage::kJsonToProto, stopwatch);
+
+  // Echoes every key as its value, grouped like the request asked for.
+  std::vector<TestRequest> groups(options_.num_compression_groups);
+  for (auto& partition : *request.mutable_partitions()) {
+    for (auto& argument : *partition.mutable_arguments()) {
+      for (std::string& data : *argument.mutable_data()) {
+        data.insert(0, "value_for_");
+      }
+    }
+    const int group =
+        partition.compression_group_id() % options_.num_compression_groups;
+    *groups[group].add_partitions() = std::move(partition);
+  }
+  stopwatch.Reset();
+
+  std::vector<std::string> group_jsons(groups.size());
+  for (size_t i = 0; i < groups.size(); ++i) {
+    if (auto s = ProtoToJson(groups[i], &group_jsons[i]); !s.ok()) {
+      return s;
+    }
+  }
+  record(Stage::kProtoToJson, stopwatch);
+
+  std::unique_ptr<CompressionGroupConcatenator> concatenator =
+      CreateConcatenator(decoded->compression_type);
+  for (std::string& group_json : group_jsons) {
+    concatenator->AddCompressionGroup(std::move(group_json));
+  }
+  absl::StatusOr<std::string> compressed = concatenator->Build();
+  if (!compressed.ok()) {
+    return compressed.status();
+  }
+  record(Stage::kCompress, stopwatch);
+
+  absl::StatusOr<std::string> encoded =
+      Encode(decoded->compression_type, *compressed);
+  if (!encoded.ok()) {
+    return encoded.status();
+  }
+  record(Stage::kEncode, stopwatch);
+
+  quiche::ObliviousHttpRequest::Context context =
+      std::move(*oblivious_request).ReleaseContext();
+  absl::StatusOr<std::string> response = EncryptAndEncapsulateResponse(
+      *std::move(encoded), *private_key, context);
+  record(Stage::kEncrypt, stopwatch);
+  return response;
+}
+
+}  // namespace privacy_sandbox::server_common
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2023 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TESTING_LOAD_GENERATOR_REQUEST_PATH_H_
+#define TESTING_LOAD_GENERATOR_REQUEST_PATH_H_
+
+#include <array>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/time/time.h"
+#include "quiche/oblivious_http/buffers/oblivious_http_request.h"
+#include "src/cpp/communication/encoding_utils.h"
+#include "src/cpp/communication/ohttp_utils.h"
+#include "src/cpp/communication/test_request.pb.h"
+#include "src/cpp/encryption/key_fetcher/interface/key_fetcher_manager_interface.h"
+
+namespace privacy_sandbox::server_common {
+
+// Steps a request and its response go through on the server, in order.
+enum class Stage {
+  kDecrypt = 0,
+  kDecode,
+  kDecompress,
+  kJsonToProto,
+  kProtoToJson,
+  kCompress,
+  kEncode,
+  kEncrypt,
+};
+inline constexpr int kNumStages = static_cast<int>(Stage::kEncrypt) + 1;
+
+absl::string_view StageName(Stage stage);
+
+// Time spent in each Stage by one request.
+using StageLatencies = std::array<absl::Duration, kNumStages>;
+
+// Parameters of the synthetic requests.
+struct RequestOptions {
+  int num_partitions = 8;
+  int keys_per_partition = 16;
+  // Partitions are spread round-robin over this many compression groups in
+  // the response.
+  int num_compression_groups = 2;
+  CompressionType compression_type = CompressionType::kBrotli;
+};
+
+// Builds a key/value lookup request following `options`. `seed` makes the keys
+// of different requests differ.
+json_test::TestRequest MakeRequest(const RequestOptions& options, int seed);
+
+// A request as sent by the client, with the context needed to decrypt the
+// response.
+struct ClientRequest {
+  std::string encapsulated_request;
+  quiche::ObliviousHttpRequest::Context context;
+};
+
+// Runs requests through the same steps as a server that uses this library, and
+// builds the requests like a client would. Keys come from a
+// KeyFetcherManagerInterface, usually FakeKeyFetcherManager, so nothing goes
+// over the network.
+//
+// Request:  OHTTP(framing(compression group(JSON(TestRequest))))
+// Response: OHTTP(framing(compression groups(JSON(TestRequest))))
+//
+// Thread-safe.
+class RequestPath {
+ public:
+  // Does not take ownership of `key_fetcher_manager`.
+  RequestPath(KeyFetcherManagerInterface& key_fetcher_manager,
+              RequestOptions options)
+      : key_fetcher_manager_(key_fetcher_manager),
+        options_(std::move(options)) {}
+
+  const RequestOptions& options() const { return options_; }
+
+  // Encodes, compresses and encrypts `request` with the public key.
+  absl::StatusOr<ClientRequest> EncapsulateRequest(
+      const json_test::TestRequest& request) const;
+
+  // Decrypts a response returned by HandleRequest() for `request` and merges
+  // all of its compression groups into one message.
+  absl::StatusOr<json_test::TestRequest> DecryptResponse(
+      std::string encapsulated_response, ClientRequest& request) const;
+
+  // Decrypts, decodes, decompresses and parses `encapsulated_request`, builds a
+  // response echoing every looked up key, and sends it back out through the
+  // same steps. Adds the time spent per stage to `latencies`.
+  absl::StatusOr<std::string> HandleRequest(
+      absl::string_view encapsulated_request, StageLatencies& latencies) const;
+
+ private:
+  KeyFetcherManagerInterface& key_fetcher_manager_;
+  const RequestOptions options_;
+  // Thread-safe, and a cache only.
+  mutable ObliviousHttpClientCache client_cache_;
+};
+
+}  // namespace privacy_sandbox::server_common
+
+#endif  // TESTING_LOAD_GENERATOR_REQUEST_PATH_H_
@@ -0,0 +1,115 @@
+// Copyright 2023 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "testing/load_generator/request_path.h"
+
+#include <string>
+
+#include "absl/time/time.h"
+#include "gtest/gtest.h"
+#include "src/cpp/encryption/key_fetcher/src/fake_key_fetcher_manager.h"
+#include "testing/load_generator/load_generator.h"
+
+namespace privacy_sandbox::server_common {
+namespace {
+
+class RequestPathTest : public testing::TestWithParam<CompressionType> {
+ protected:
+  RequestOptions Options() const {
+    RequestOptions options;
+    options.num_partitions = 3;
+    options.keys_per_partition = 2;
+    options.num_compression_groups = 2;
+    options.compression_type = GetParam();
+    return options;
+  }
+
+  FakeKeyFetcherManager key_fetcher_manager_;
+};
+
+TEST_P(RequestPathTest, RoundTrip) {
+  const RequestPath request_path(key_fetcher_manager_, Options());
+  auto request = request_path.EncapsulateRequest(MakeRequest(Options(), 7));
+  ASSERT_TRUE(request.ok()) << request.status();
+
+  StageLatencies latencies = {};
+  auto response =
+      request_path.HandleRequest(request->encapsulated_request, latencies);
+  ASSERT_TRUE(response.ok()) << response.status();
+  absl::Duration total;
+  for (int stage = 0; stage < kNumStages; ++stage) {
+    EXPECT_GE(latencies[stage], absl::ZeroDuration())
+        << StageName(static_cast<Stage>(stage));
+    total += latencies[stage];
+  }
+  EXPECT_GT(total, absl::ZeroDuration());
+
+  auto decrypted = request_path.DecryptResponse(*std::move(response), *request);
+  ASSERT_TRUE(decrypted.ok()) << decrypted.status();
+  // Partitions come back grouped by compression group: 0 and 2, then 1.
+  ASSERT_EQ(decrypted->partitions_size(), 3);
+  EXPECT_EQ(decrypted->partitions(0).id(), 0);
+  EXPECT_EQ(decrypted->partitions(1).id(), 2);
+  EXPECT_EQ(decrypted->partitions(2).id(), 1);
+  EXPECT_EQ(decrypted->partitions(1).arguments(0).data(1),
+            "value_for_ad_render_id_7_2_1");
+}
+
+TEST_P(RequestPathTest, RejectsCorruptedRequest) {
+  const RequestPath request_path(key_fetcher_manager_, Options());
+  auto request = request_path.EncapsulateRequest(MakeRequest(Options(), 0));
+  ASSERT_TRUE(request.ok()) << request.status();
+  request->encapsulated_request.back() ^= 1;
+
+  StageLatencies latencies = {};
+  EXPECT_FALSE(
+      request_path.HandleRequest(request->encapsulated_request, latencies)
+          .ok());
+}
+
+TEST_P(RequestPathTest, RunLoad) {
+  const RequestPath request_path(key_fetcher_manager_, Options());
+  LoadOptions options;
+  options.num_threads = 2;
+  options.duration = absl::Milliseconds(200);
+  options.num_distinct_requests = 2;
+  auto report = RunLoad(request_path, options);
+  ASSERT_TRUE(report.ok()) << report.status();
+  EXPECT_GT(report->num_requests, 0);
+  EXPECT_EQ(report->num_failures, 0);
+  EXPECT_EQ(report->end_to_end.count(), report->num_requests);
+  EXPECT_EQ(report->stages[0].count(), report->num_requests);
+  EXPECT_GT(report->ThroughputPerCore(), 0);
+  EXPECT_NE(FormatLoadReport(*report).find("json_to_proto"), std::string::npos);
+}
+
+TEST_P(RequestPathTest, RunLoadAtFixedRate) {
+  const RequestPath request_path(key_fetcher_manager_, Options());
+  LoadOptions options;
+  options.duration = absl::Milliseconds(200);
+  options.target_qps = 50;
+  auto report = RunLoad(request_path, options);
+  ASSERT_TRUE(report.ok()) << report.status();
+  // 10 requests are scheduled, allow for some to be late.
+  EXPECT_GE(report->num_requests, 5);
+  EXPECT_LE(report->num_requests, 10);
+}
+
+INSTANTIATE_TEST_SUITE_P(CompressionTypes, RequestPathTest,
+                         testing::Values(CompressionType::kUncompressed,
+                                         CompressionType::kBrotli,
+                                         CompressionType::kGzip));
+
+}  // namespace
+}  // namespace privacy_sandbox::server_common
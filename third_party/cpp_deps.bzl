@@ -81,6 +81,15 @@ def cpp_dependencies():
             "https://github.com/google/googletest/archive/refs/tags/v1.13.0.zip",
         ],
     )
+    maybe(
+        http_archive,
+        name = "com_github_google_benchmark",
+        sha256 = "6bc180a57d23d4d9515519f92b0c83d61b05b5bab188961f36ac7b06b0d9e9ce",
+        strip_prefix = "benchmark-1.8.3",
+        urls = [
+            "https://github.com/google/benchmark/archive/refs/tags/v1.8.3.tar.gz",
+        ],
+    )
     maybe(
         http_archive,
         name = "io_opentelemetry_cpp",
@@ -93,9 +102,21 @@ def cpp_dependencies():
     maybe(
         http_archive,
         name = "brotli",
-        sha256 = "84a9a68ada813a59db94d83ea10c54155f1d34399baf377842ff3ab9b3b3256e",
-        strip_prefix = "brotli-3914999fcc1fda92e750ef9190aa6db9bf7bdb07",
-        urls = ["https://github.com/google/brotli/archive/3914999fcc1fda92e750ef9190aa6db9bf7bdb07.zip"],  # 2022-11-17
+        sha256 = "e720a6ca29428b803f4ad165371771f5398faba397edf6778837a18599ea13ff",
+        strip_prefix = "brotli-1.1.0",
+        urls = [
+            "https://github.com/google/brotli/archive/refs/tags/v1.1.0.tar.gz",
+        ],
+    )
+    maybe(
+        http_archive,
+        name = "libdeflate",
+        build_file = Label("//third_party:libdeflate.BUILD"),
+        sha256 = "27bf62d71cd64728ff43a9feb92f2ac2f2bf748986d856133cc1e51992428c25",
+        strip_prefix = "libdeflate-1.19",
+        urls = [
+            "https://github.com/ebiggers/libdeflate/archive/refs/tags/v1.19.tar.gz",
+        ],
     )
     maybe(
         http_archive,